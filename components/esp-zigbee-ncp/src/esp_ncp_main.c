@@ -120,8 +120,13 @@ static void esp_ncp_main_task(void *pv)
 esp_err_t esp_ncp_init(esp_ncp_host_connection_mode_t mode)
 {
     esp_ncp_bus_t *bus = NULL;
-    esp_err_t ret = esp_ncp_bus_init(&bus);
+    esp_err_t ret = esp_ncp_frame_init();
 
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = esp_ncp_bus_init(&bus);
     s_ncp_dev.bus = bus;
 
     return (bus && bus->init) ? bus->init(mode) : ret;
@@ -141,6 +146,7 @@ esp_err_t esp_ncp_deinit(void)
 
     esp_ncp_bus_deinit(bus);
     s_ncp_dev.bus = NULL;
+    esp_ncp_frame_deinit();
 
     return ESP_OK;
 }
@@ -0,0 +1,474 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+
+#include "esp_ncp_frame.h"
+#include "esp_ncp_zb.h"
+#include "esp_ncp_node.h"
+
+#define NCP_NODE_NVS_NAMESPACE      "ncp_node"              /*!< The NVS namespace of the node table, one blob per slot */
+#define NCP_NODE_FLUSH_DELAY_MS     1000                    /*!< The delay to save the structural changes, the bursts of announcements are saved together */
+
+static const char *TAG = "ESP_NCP_NODE";
+
+/**
+ * @brief Type to represent an endpoint of a node.
+ *
+ */
+typedef struct {
+    uint8_t     endpoint;                                   /*!< The endpoint identifier */
+    uint16_t    profile_id;                                 /*!< The profile identifier of the endpoint */
+    uint8_t     cluster_count;                              /*!< The number of the clusters in the cluster list */
+    uint16_t    cluster_list[ESP_NCP_NODE_CLUSTER_NUM];     /*!< The clusters discovered on the endpoint */
+} esp_ncp_node_ep_t;
+
+/**
+ * @brief Type to represent a node in the node table, it is saved to the NVS as it is.
+ *
+ */
+typedef struct {
+    bool        in_use;                                     /*!< The slot holds a node */
+    uint16_t    short_addr;                                 /*!< The short address of the node */
+    uint8_t     ieee_addr[8];                               /*!< The IEEE address of the node */
+    uint8_t     capability;                                 /*!< The MAC capability of the node */
+    uint8_t     lqi;                                        /*!< The LQI of the last frame received from the node, not saved */
+    uint8_t     ep_count;                                   /*!< The number of the endpoints */
+    esp_ncp_node_ep_t ep[ESP_NCP_NODE_EP_NUM];              /*!< The endpoints of the node */
+    int64_t     seen;                                       /*!< The time the node was last seen in microseconds, 0 if not seen since boot, not saved */
+} esp_ncp_node_t;
+
+static esp_ncp_node_t s_node_table[CONFIG_NCP_NODE_TABLE_SIZE];
+static uint32_t s_node_dirty[(CONFIG_NCP_NODE_TABLE_SIZE + 31) / 32];      /*!< The slots to be saved to the NVS */
+static uint32_t s_node_generation;                                          /*!< Bumped by each clear, the slots copied before are stale */
+static uint32_t s_node_saved_generation;                                    /*!< The generation the storage holds, only used by the flush */
+static SemaphoreHandle_t s_node_lock;
+static TimerHandle_t s_node_timer;
+
+static void esp_ncp_node_key(uint16_t index, char *key, size_t size)
+{
+    snprintf(key, size, "node%03d", index);
+}
+
+/* Must be called with the lock held, only the membership and identity changes are saved, the LQI and last seen time stay in the memory */
+static void esp_ncp_node_mark_dirty(uint16_t index)
+{
+    s_node_dirty[index / 32] |= (1UL << (index % 32));
+    xTimerChangePeriod(s_node_timer, pdMS_TO_TICKS(NCP_NODE_FLUSH_DELAY_MS), 0);
+}
+
+/* Must be called with the lock held */
+static int esp_ncp_node_find_short(uint16_t short_addr)
+{
+    for (int i = 0; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        if (s_node_table[i].in_use && s_node_table[i].short_addr == short_addr) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Must be called with the lock held */
+static int esp_ncp_node_find_ieee(const uint8_t ieee_addr[8])
+{
+    for (int i = 0; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        if (s_node_table[i].in_use && !memcmp(s_node_table[i].ieee_addr, ieee_addr, sizeof(s_node_table[i].ieee_addr))) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Allocate a slot for a new node, the node seen least recently is replaced if the table is full, must be called with the lock held.
+ */
+static int esp_ncp_node_alloc(const uint8_t ieee_addr[8])
+{
+    int index = 0;
+
+    for (int i = 0; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        if (!s_node_table[i].in_use) {
+            index = i;
+            break;
+        }
+        if (s_node_table[i].seen < s_node_table[index].seen) {
+            index = i;
+        }
+    }
+
+    if (s_node_table[index].in_use) {
+        ESP_LOGW(TAG, "Node table full, drop the node 0x%04hx", s_node_table[index].short_addr);
+    }
+
+    memset(&s_node_table[index], 0, sizeof(esp_ncp_node_t));
+    s_node_table[index].in_use = true;
+    memcpy(s_node_table[index].ieee_addr, ieee_addr, sizeof(s_node_table[index].ieee_addr));
+
+    return index;
+}
+
+static uint16_t esp_ncp_node_encode(const esp_ncp_node_t *node, int64_t now, uint8_t *buffer, uint16_t size)
+{
+    uint16_t len = sizeof(esp_ncp_zb_node_t);
+
+    for (int i = 0; i < node->ep_count; i ++) {
+        len += sizeof(esp_ncp_zb_node_ep_t) + node->ep[i].cluster_count * sizeof(uint16_t);
+    }
+
+    if (len > size) {
+        return 0;
+    }
+
+    esp_ncp_zb_node_t *entry = (esp_ncp_zb_node_t *)buffer;
+    entry->short_addr = node->short_addr;
+    memcpy(entry->ieee_addr, node->ieee_addr, sizeof(entry->ieee_addr));
+    entry->capability = node->capability;
+    entry->lqi = node->lqi;
+    entry->age = node->seen ? (uint32_t)((now - node->seen) / 1000000) : UINT32_MAX;
+    entry->ep_count = node->ep_count;
+    buffer += sizeof(esp_ncp_zb_node_t);
+
+    for (int i = 0; i < node->ep_count; i ++) {
+        esp_ncp_zb_node_ep_t *ep = (esp_ncp_zb_node_ep_t *)buffer;
+        ep->endpoint = node->ep[i].endpoint;
+        ep->profile_id = node->ep[i].profile_id;
+        ep->cluster_count = node->ep[i].cluster_count;
+        buffer += sizeof(esp_ncp_zb_node_ep_t);
+        memcpy(buffer, node->ep[i].cluster_list, node->ep[i].cluster_count * sizeof(uint16_t));
+        buffer += node->ep[i].cluster_count * sizeof(uint16_t);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Save the dirty slots to the NVS, it runs in the timer task so the Zigbee task is not blocked by the flash.
+ */
+static void esp_ncp_node_table_flush(TimerHandle_t timer)
+{
+    nvs_handle_t handle = 0;
+    esp_ncp_node_t node;
+    char key[16];
+    uint16_t saved = 0;
+    uint32_t generation = 0;
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    generation = s_node_generation;
+    xSemaphoreGive(s_node_lock);
+
+    esp_err_t ret = nvs_open(NCP_NODE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open the node table storage: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    /* The table was cleared since the last flush, the slots a flush saved meanwhile are erased with the rest */
+    if (generation != s_node_saved_generation) {
+        ret = nvs_erase_all(handle);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to erase the node table storage: %s", esp_err_to_name(ret));
+            xTimerChangePeriod(s_node_timer, pdMS_TO_TICKS(NCP_NODE_FLUSH_DELAY_MS), 0);
+            nvs_close(handle);
+            return;
+        }
+        s_node_saved_generation = generation;
+        saved ++;
+    }
+
+    for (uint16_t i = 0; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        bool dirty = false;
+        bool cleared = false;
+
+        xSemaphoreTake(s_node_lock, portMAX_DELAY);
+        cleared = (s_node_generation != generation);
+        if (!cleared && (s_node_dirty[i / 32] & (1UL << (i % 32)))) {
+            s_node_dirty[i / 32] &= ~(1UL << (i % 32));
+            memcpy(&node, &s_node_table[i], sizeof(esp_ncp_node_t));
+            dirty = true;
+        }
+        xSemaphoreGive(s_node_lock);
+
+        if (cleared) {
+            /* The flush scheduled by the clear starts over */
+            break;
+        }
+        if (!dirty) {
+            continue;
+        }
+
+        /* The blob only changes with the membership and identity of the node */
+        node.lqi = 0;
+        node.seen = 0;
+        esp_ncp_node_key(i, key, sizeof(key));
+        ret = node.in_use ? nvs_set_blob(handle, key, &node, sizeof(esp_ncp_node_t)) : nvs_erase_key(handle, key);
+        if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Failed to save the node slot %d: %s", i, esp_err_to_name(ret));
+            xSemaphoreTake(s_node_lock, portMAX_DELAY);
+            if (s_node_generation == generation) {
+                esp_ncp_node_mark_dirty(i);
+            }
+            xSemaphoreGive(s_node_lock);
+            continue;
+        }
+        saved ++;
+    }
+
+    if (saved) {
+        nvs_commit(handle);
+        ESP_LOGD(TAG, "Saved %d node slots", saved);
+    }
+    nvs_close(handle);
+}
+
+esp_err_t esp_ncp_node_table_init(void)
+{
+    nvs_handle_t handle = 0;
+    uint16_t loaded = 0;
+    char key[16];
+
+    if (s_node_lock) {
+        return ESP_OK;
+    }
+
+    s_node_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_node_lock, ESP_ERR_NO_MEM, TAG, "Failed to create the node table lock");
+    s_node_timer = xTimerCreate("ncp_node", pdMS_TO_TICKS(NCP_NODE_FLUSH_DELAY_MS), pdFALSE, NULL, esp_ncp_node_table_flush);
+    if (!s_node_timer) {
+        vSemaphoreDelete(s_node_lock);
+        s_node_lock = NULL;
+        ESP_LOGE(TAG, "Failed to create the node table timer");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = nvs_open(NCP_NODE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        /* Nothing saved yet */
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to open the node table storage");
+
+    for (uint16_t i = 0; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        size_t size = sizeof(esp_ncp_node_t);
+
+        esp_ncp_node_key(i, key, sizeof(key));
+        if (nvs_get_blob(handle, key, &s_node_table[i], &size) != ESP_OK || size != sizeof(esp_ncp_node_t)) {
+            /* The slot saved by another layout is dropped */
+            memset(&s_node_table[i], 0, sizeof(esp_ncp_node_t));
+            continue;
+        }
+        s_node_table[i].lqi = 0;
+        s_node_table[i].seen = 0;
+        loaded += s_node_table[i].in_use ? 1 : 0;
+    }
+    nvs_close(handle);
+
+    ESP_LOGI(TAG, "Loaded %d nodes from the node table", loaded);
+
+    return ESP_OK;
+}
+
+void esp_ncp_node_table_announce(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t capability)
+{
+    if (!s_node_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    int index = esp_ncp_node_find_ieee(ieee_addr);
+    bool changed = (index < 0);
+
+    if (index < 0) {
+        index = esp_ncp_node_alloc(ieee_addr);
+    }
+
+    /* Another node may hold the short address after an address conflict, it will announce again */
+    int stale = esp_ncp_node_find_short(short_addr);
+    if (stale >= 0 && stale != index) {
+        s_node_table[stale].short_addr = 0xFFFF;
+        esp_ncp_node_mark_dirty(stale);
+    }
+
+    changed |= (s_node_table[index].short_addr != short_addr || s_node_table[index].capability != capability);
+    s_node_table[index].short_addr = short_addr;
+    s_node_table[index].capability = capability;
+    s_node_table[index].seen = esp_timer_get_time();
+    if (changed) {
+        esp_ncp_node_mark_dirty(index);
+    }
+    xSemaphoreGive(s_node_lock);
+}
+
+void esp_ncp_node_table_leave(const uint8_t ieee_addr[8])
+{
+    if (!s_node_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    int index = esp_ncp_node_find_ieee(ieee_addr);
+    if (index >= 0) {
+        s_node_table[index].in_use = false;
+        esp_ncp_node_mark_dirty(index);
+    }
+    xSemaphoreGive(s_node_lock);
+}
+
+void esp_ncp_node_table_endpoint(uint16_t short_addr, uint8_t endpoint, uint16_t profile_id, const uint16_t *cluster_list, uint8_t cluster_count)
+{
+    uint8_t ieee_addr[8] = {0};
+    esp_ncp_node_ep_t *ep = NULL;
+    bool changed = false;
+
+    if (!s_node_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    int index = esp_ncp_node_find_short(short_addr);
+    if (index < 0) {
+        /* The node joined before the table was cleared, it is only kept if the stack knows its IEEE address */
+        if (esp_zb_ieee_address_by_short(short_addr, ieee_addr) != ESP_OK) {
+            xSemaphoreGive(s_node_lock);
+            return;
+        }
+        index = esp_ncp_node_alloc(ieee_addr);
+        s_node_table[index].short_addr = short_addr;
+        changed = true;
+    }
+
+    esp_ncp_node_t *node = &s_node_table[index];
+    for (int i = 0; i < node->ep_count; i ++) {
+        if (node->ep[i].endpoint == endpoint) {
+            ep = &node->ep[i];
+            break;
+        }
+    }
+
+    if (!ep && node->ep_count < ESP_NCP_NODE_EP_NUM) {
+        ep = &node->ep[node->ep_count ++];
+        ep->endpoint = endpoint;
+        changed = true;
+    }
+
+    if (ep) {
+        changed |= (ep->profile_id != profile_id);
+        ep->profile_id = profile_id;
+        for (int i = 0; i < cluster_count && cluster_list; i ++) {
+            bool known = false;
+            for (int j = 0; j < ep->cluster_count && !known; j ++) {
+                known = (ep->cluster_list[j] == cluster_list[i]);
+            }
+            if (!known && ep->cluster_count < ESP_NCP_NODE_CLUSTER_NUM) {
+                ep->cluster_list[ep->cluster_count ++] = cluster_list[i];
+                changed = true;
+            }
+        }
+    }
+
+    node->seen = esp_timer_get_time();
+    if (changed) {
+        esp_ncp_node_mark_dirty(index);
+    }
+    xSemaphoreGive(s_node_lock);
+}
+
+void esp_ncp_node_table_seen(uint16_t short_addr, int lqi)
+{
+    if (!s_node_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    int index = esp_ncp_node_find_short(short_addr);
+    if (index >= 0) {
+        if (lqi >= 0) {
+            s_node_table[index].lqi = (uint8_t)lqi;
+        }
+        s_node_table[index].seen = esp_timer_get_time();
+    }
+    xSemaphoreGive(s_node_lock);
+}
+
+esp_err_t esp_ncp_node_table_dump(uint16_t index, uint8_t max_count, uint8_t *buffer, uint16_t size, uint16_t *len, uint8_t *count, uint16_t *next_index)
+{
+    int64_t now = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(buffer && len && count && next_index, ESP_ERR_INVALID_ARG, TAG, "Invalid node table dump");
+
+    *len = 0;
+    *count = 0;
+    *next_index = ESP_NCP_NODE_INDEX_END;
+
+    if (!s_node_lock) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    for (uint16_t i = index; i < CONFIG_NCP_NODE_TABLE_SIZE; i ++) {
+        if (!s_node_table[i].in_use) {
+            continue;
+        }
+
+        uint16_t n = (max_count && *count >= max_count) ? 0 : esp_ncp_node_encode(&s_node_table[i], now, buffer + *len, size - *len);
+        if (!n) {
+            ret = (*count) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+            *next_index = i;
+            break;
+        }
+        *len += n;
+        (*count) ++;
+    }
+    xSemaphoreGive(s_node_lock);
+
+    return ret;
+}
+
+esp_err_t esp_ncp_node_table_query(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t *buffer, uint16_t size, uint16_t *len)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(buffer && len, ESP_ERR_INVALID_ARG, TAG, "Invalid node table query");
+    ESP_RETURN_ON_FALSE(s_node_lock, ESP_ERR_NOT_FOUND, TAG, "Node table not loaded");
+
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    int index = (short_addr != 0xFFFF) ? esp_ncp_node_find_short(short_addr) : esp_ncp_node_find_ieee(ieee_addr);
+    if (index >= 0) {
+        *len = esp_ncp_node_encode(&s_node_table[index], esp_timer_get_time(), buffer, size);
+        ret = (*len) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    }
+    xSemaphoreGive(s_node_lock);
+
+    return ret;
+}
+
+esp_err_t esp_ncp_node_table_clear(void)
+{
+    ESP_RETURN_ON_FALSE(s_node_lock, ESP_ERR_INVALID_STATE, TAG, "Node table not loaded");
+
+    /* The storage is erased by the flush, so a flush running now can not save a slot after the erase */
+    xSemaphoreTake(s_node_lock, portMAX_DELAY);
+    memset(s_node_table, 0, sizeof(s_node_table));
+    memset(s_node_dirty, 0, sizeof(s_node_dirty));
+    s_node_generation ++;
+    xTimerChangePeriod(s_node_timer, pdMS_TO_TICKS(NCP_NODE_FLUSH_DELAY_MS), 0);
+    xSemaphoreGive(s_node_lock);
+
+    return ESP_OK;
+}
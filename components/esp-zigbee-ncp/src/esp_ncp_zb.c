@@ -4,11 +4,15 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stddef.h>
 #include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
 
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_system.h"
@@ -18,13 +22,27 @@
 #include "zdo/esp_zigbee_zdo_command.h"
 #include "zcl/esp_zigbee_zcl_common.h"
 #include "aps/esp_zigbee_aps.h"
+#include "esp_zigbee_ota.h"
 
 #include "esp_ncp_bus.h"
 #include "esp_ncp_frame.h"
 #include "esp_ncp_main.h"
 #include "esp_ncp_zb.h"
+#include "esp_ncp_node.h"
 #include "esp_zb_ncp.h"
 
+#define NCP_APS_CHUNK_SESSION_NUM   4                       /*!< The maximum number of the chunked transfers in progress */
+#define NCP_APS_CHUNK_TIMEOUT_MS    5000                    /*!< The chunked transfer is dropped if no progress in this time */
+#define NCP_OTA_IMAGE_NUM           8                       /*!< The maximum number of the OTA images registered by the host */
+#define NCP_OTA_FETCH_SIZE          256                     /*!< The maximum size of the OTA image data requested from the host at once */
+#define NCP_OTA_FETCH_TIMEOUT_MS    200                     /*!< The data requested from the host and not received in this time is requested again */
+#define NCP_OTA_BLOCK_REQUEST_CMD   0x03                    /*!< The command ID of the Image Block Request of the OTA upgrade cluster */
+#define NCP_OTA_SESSION_TIMEOUT_MS  60000                   /*!< The prefetch cache of a silent OTA client could be reused after this time */
+#define NCP_ZCL_FANOUT_SESSION_NUM  2                       /*!< The maximum number of the fan-out reads in progress */
+#define NCP_ZCL_FANOUT_WINDOW       4                       /*!< The maximum number of the read requests waiting for the response in a fan-out read */
+#define NCP_ZCL_FANOUT_INTERVAL_MS  50                      /*!< The default interval between two read requests of a fan-out read */
+#define NCP_ZCL_FANOUT_TIMEOUT_MS   3000                    /*!< The default time to wait for the response of a target */
+
 static const char *TAG = "ESP_NCP_ZB";
 
 static bool s_init_flag = false;
@@ -56,6 +74,36 @@ typedef struct {
     void            *data;                  /*!< Data on the event */
 } esp_ncp_zb_ctx_t;
 
+typedef struct {
+    uint8_t states;                     /*!< The states of the device */
+    uint8_t dst_addr_mode;              /*!< Reserved, the addressing mode for the destination address used in this primitive and of the APDU that has been received.*/
+    esp_zb_addr_u dst_addr;             /*!< The individual device address or group address to which the ASDU is directed.*/
+    uint8_t dst_endpoint;               /*!< The target endpoint on the local entity to which the ASDU is directed.*/
+    uint8_t src_addr_mode;              /*!< Reserved, The addressing mode for the source address used in this primitive and of the APDU that has been received.*/
+    esp_zb_addr_u src_addr;             /*!< The individual device address of the entity from which the ASDU has been received.*/
+    uint8_t src_endpoint;               /*!< The number of the individual endpoint of the entity from which the ASDU has been received.*/
+    uint16_t profile_id;                /*!< The identifier of the profile from which this frame originated.*/
+    uint16_t cluster_id;                /*!< The identifier of the received object.*/
+    uint8_t indication_status;          /*!< The status of the incoming frame processing, 0: on success */
+    uint8_t security_status;            /*!< UNSECURED if the ASDU was received without any security. SECURED_NWK_KEY if the received ASDU was secured with the NWK key.*/
+    uint8_t lqi;                        /*!< The link quality indication delivered by the NLDE.*/
+    int rx_time;                        /*!< Reserved, a time indication for the received packet based on the local clock */
+    uint32_t asdu_length;               /*!< The number of octets comprising the ASDU being indicated by the APSDE.*/
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_data_ind_t;
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t basic_cmd;                       /*!< Basic command info */
+    uint8_t  dst_addr_mode;                                 /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+    uint16_t profile_id;                                    /*!< Profile id */
+    uint16_t cluster_id;                                    /*!< Cluster id */
+    uint8_t tx_options;                                     /*!< The transmission options for the ASDU to be transferred, refer to esp_zb_apsde_tx_opt_t */
+    bool use_alias;                                         /*!< The next higher layer may use the UseAlias parameter to request alias usage by NWK layer for the current frame.*/
+    esp_zb_addr_u alias_src_addr;                           /*!< The source address to be used for this NSDU. If the use_alias is true */
+    uint8_t alias_seq_num;                                  /*!< The sequence number to be used for this NSDU. If the use_alias is true */
+    uint8_t radius;                                         /*!< The distance, in hops, that a transmitted frame will be allowed to travel through the network.*/
+    uint32_t asdu_length;                                   /*!< The number of octets comprising the ASDU to be transferred */
+} ESP_NCP_ZB_PACKED_STRUCT esp_zb_aps_data_t;
+
 static esp_err_t esp_ncp_zb_aps_data_handle(uint16_t id, const void *buffer, uint16_t len)
 {
     QueueHandle_t event_queue = (id == ESP_NCP_APS_DATA_CONFIRM) ? s_aps_data_confirm : s_aps_data_indication;
@@ -86,26 +134,276 @@ static esp_err_t esp_ncp_zb_aps_data_handle(uint16_t id, const void *buffer, uin
     }
 }
 
+/**
+ * @brief Type to represent a chunked transfer of the large APS data.
+ *
+ */
+typedef struct {
+    bool        in_use;                     /*!< The session is in progress */
+    bool        tx;                         /*!< true: from the NCP to the host, false: from the host to the NCP */
+    uint8_t     block;                      /*!< The first block in the pool */
+    uint8_t     block_count;                /*!< The number of blocks in the pool */
+    uint16_t    chunk_size;                 /*!< The maximum payload length of one chunk */
+    uint8_t     window;                     /*!< The number of chunks could be sent before waiting for the acknowledgement */
+    uint32_t    total_length;               /*!< The total length of the ASDU */
+    uint32_t    offset;                     /*!< The next offset to receive or to send */
+    uint32_t    acked;                      /*!< The offset acknowledged by the host */
+    TickType_t  tick;                       /*!< The tick of the last progress */
+    union {
+        esp_zb_aps_data_t           req;    /*!< The APS data request from the host */
+        esp_ncp_zb_aps_data_ind_t   ind;    /*!< The APS data indication to the host */
+    } desc;
+} esp_ncp_zb_aps_chunk_session_t;
+
+/**
+ * @brief Type to represent an APS data request sent by the host in chunks and waiting for its confirm.
+ *
+ */
+typedef struct {
+    bool        in_use;                     /*!< The confirm is expected */
+    uint8_t     dst_addr_mode;              /*!< The addressing mode of the destination address */
+    uint16_t    dst_short_addr;             /*!< The destination short address, unused for the 64-bit address mode */
+    uint8_t     dst_endpoint;               /*!< The destination endpoint */
+    uint8_t     src_endpoint;               /*!< The source endpoint */
+    uint32_t    asdu_length;                /*!< The length of the ASDU */
+} esp_ncp_zb_aps_chunk_confirm_t;
+
+static uint8_t s_aps_chunk_pool[CONFIG_NCP_APS_CHUNK_POOL_BLOCKS][CONFIG_NCP_APS_CHUNK_SIZE];
+static uint32_t s_aps_chunk_pool_map;
+static esp_ncp_zb_aps_chunk_session_t s_aps_chunk_session[NCP_APS_CHUNK_SESSION_NUM];
+static esp_ncp_zb_aps_chunk_confirm_t s_aps_chunk_confirm[NCP_APS_CHUNK_SESSION_NUM];
+static uint8_t s_aps_chunk_confirm_next;
+static portMUX_TYPE s_aps_chunk_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void esp_ncp_zb_aps_chunk_session_release(esp_ncp_zb_aps_chunk_session_t *session)
+{
+    s_aps_chunk_pool_map &= ~(((1ULL << session->block_count) - 1) << session->block);
+    session->in_use = false;
+}
+
+static esp_ncp_zb_aps_chunk_session_t *esp_ncp_zb_aps_chunk_session_alloc(bool tx, uint32_t total_length)
+{
+    esp_ncp_zb_aps_chunk_session_t *session = NULL;
+    uint32_t block_count = (total_length + CONFIG_NCP_APS_CHUNK_SIZE - 1) / CONFIG_NCP_APS_CHUNK_SIZE;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!block_count || block_count > CONFIG_NCP_APS_CHUNK_POOL_BLOCKS) {
+        return NULL;
+    }
+
+    portENTER_CRITICAL_SAFE(&s_aps_chunk_lock);
+    for (int i = 0; i < NCP_APS_CHUNK_SESSION_NUM; i ++) {
+        if (s_aps_chunk_session[i].in_use && (now - s_aps_chunk_session[i].tick) > pdMS_TO_TICKS(NCP_APS_CHUNK_TIMEOUT_MS)) {
+            esp_ncp_zb_aps_chunk_session_release(&s_aps_chunk_session[i]);
+        }
+        if (!session && !s_aps_chunk_session[i].in_use) {
+            session = &s_aps_chunk_session[i];
+        }
+    }
+
+    if (session) {
+        uint32_t mask = (uint32_t)((1ULL << block_count) - 1);
+        int block = 0;
+        for (; block + block_count <= CONFIG_NCP_APS_CHUNK_POOL_BLOCKS; block ++) {
+            if (!(s_aps_chunk_pool_map & (mask << block))) {
+                break;
+            }
+        }
+
+        if (block + block_count <= CONFIG_NCP_APS_CHUNK_POOL_BLOCKS) {
+            s_aps_chunk_pool_map |= (mask << block);
+            memset(session, 0, sizeof(esp_ncp_zb_aps_chunk_session_t));
+            session->in_use = true;
+            session->tx = tx;
+            session->block = block;
+            session->block_count = block_count;
+            session->chunk_size = CONFIG_NCP_APS_CHUNK_SIZE;
+            session->window = CONFIG_NCP_APS_CHUNK_WINDOW;
+            session->total_length = total_length;
+            session->tick = now;
+        } else {
+            session = NULL;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_aps_chunk_lock);
+
+    return session;
+}
+
+static void esp_ncp_zb_aps_chunk_session_free(esp_ncp_zb_aps_chunk_session_t *session)
+{
+    portENTER_CRITICAL_SAFE(&s_aps_chunk_lock);
+    if (session->in_use) {
+        esp_ncp_zb_aps_chunk_session_release(session);
+    }
+    portEXIT_CRITICAL_SAFE(&s_aps_chunk_lock);
+}
+
+static esp_ncp_zb_aps_chunk_session_t *esp_ncp_zb_aps_chunk_session_get(uint8_t handle, bool tx)
+{
+    if (handle >= NCP_APS_CHUNK_SESSION_NUM || !s_aps_chunk_session[handle].in_use || s_aps_chunk_session[handle].tx != tx) {
+        return NULL;
+    }
+
+    return &s_aps_chunk_session[handle];
+}
+
+/* Remember the request sent in chunks, the oldest one is forgotten if its confirm never comes */
+static esp_ncp_zb_aps_chunk_confirm_t *esp_ncp_zb_aps_chunk_confirm_add(const esp_zb_aps_data_t *req)
+{
+    esp_ncp_zb_aps_chunk_confirm_t *confirm = NULL;
+
+    portENTER_CRITICAL_SAFE(&s_aps_chunk_lock);
+    confirm = &s_aps_chunk_confirm[s_aps_chunk_confirm_next];
+    s_aps_chunk_confirm_next = (s_aps_chunk_confirm_next + 1) % NCP_APS_CHUNK_SESSION_NUM;
+    confirm->in_use = true;
+    confirm->dst_addr_mode = req->dst_addr_mode;
+    confirm->dst_short_addr = req->basic_cmd.dst_addr_u.addr_short;
+    confirm->dst_endpoint = req->basic_cmd.dst_endpoint;
+    confirm->src_endpoint = req->basic_cmd.src_endpoint;
+    confirm->asdu_length = req->asdu_length;
+    portEXIT_CRITICAL_SAFE(&s_aps_chunk_lock);
+
+    return confirm;
+}
+
+static void esp_ncp_zb_aps_chunk_confirm_remove(esp_ncp_zb_aps_chunk_confirm_t *confirm)
+{
+    portENTER_CRITICAL_SAFE(&s_aps_chunk_lock);
+    confirm->in_use = false;
+    portEXIT_CRITICAL_SAFE(&s_aps_chunk_lock);
+}
+
+/* Whether the confirm answers a request sent in chunks, the request is forgotten once confirmed */
+static bool esp_ncp_zb_aps_chunk_confirm_take(const esp_zb_apsde_data_confirm_t *confirm)
+{
+    bool found = false;
+
+    portENTER_CRITICAL_SAFE(&s_aps_chunk_lock);
+    for (int i = 0; i < NCP_APS_CHUNK_SESSION_NUM && !found; i ++) {
+        esp_ncp_zb_aps_chunk_confirm_t *entry = &s_aps_chunk_confirm[i];
+        if (entry->in_use && entry->dst_addr_mode == confirm->dst_addr_mode && entry->asdu_length == confirm->asdu_length
+                && entry->dst_endpoint == confirm->dst_endpoint && entry->src_endpoint == confirm->src_endpoint
+                && (confirm->dst_addr_mode == ESP_ZB_APS_ADDR_MODE_64_ENDP_PRESENT || entry->dst_short_addr == confirm->dst_addr.addr_short)) {
+            entry->in_use = false;
+            found = true;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_aps_chunk_lock);
+
+    return found;
+}
+
+static inline uint8_t esp_ncp_zb_aps_chunk_session_handle(esp_ncp_zb_aps_chunk_session_t *session)
+{
+    return (uint8_t)(session - s_aps_chunk_session);
+}
+
+static inline uint8_t *esp_ncp_zb_aps_chunk_session_buffer(esp_ncp_zb_aps_chunk_session_t *session)
+{
+    return s_aps_chunk_pool[session->block];
+}
+
+static bool esp_ncp_zb_aps_chunk_need_ack(esp_ncp_zb_aps_chunk_session_t *session, uint32_t offset, uint16_t len)
+{
+    return (((offset / session->chunk_size) + 1) % session->window == 0) || (offset + len >= session->total_length);
+}
+
+/**
+ * @brief Stream the chunks of the large APS data to the host until the window is full,
+ * and end the transfer once all the chunks have been acknowledged.
+ */
+static void esp_ncp_zb_aps_chunk_send_window(esp_ncp_zb_aps_chunk_session_t *session)
+{
+    esp_ncp_zb_aps_chunk_t chunk = {
+        .session = esp_ncp_zb_aps_chunk_session_handle(session),
+        .total_length = session->total_length,
+    };
+    esp_ncp_header_t ncp_header = {
+        .id = ESP_NCP_APS_DATA_CHUNK,
+    };
+
+    if (session->acked >= session->total_length) {
+        chunk.offset = session->total_length;
+        ncp_header.id = ESP_NCP_APS_DATA_CHUNK_END;
+        ncp_header.sn = esp_random() % 0xFF;
+        esp_ncp_noti_input(&ncp_header, &chunk, sizeof(esp_ncp_zb_aps_chunk_t));
+        esp_ncp_zb_aps_chunk_session_free(session);
+        return;
+    }
+
+    uint8_t *buffer = calloc(1, sizeof(esp_ncp_zb_aps_chunk_t) + session->chunk_size);
+    if (!buffer) {
+        return;
+    }
+
+    uint32_t limit = session->acked + session->window * session->chunk_size;
+    while (session->offset < session->total_length && session->offset < limit) {
+        uint16_t len = MIN(session->chunk_size, session->total_length - session->offset);
+        chunk.offset = session->offset;
+        memcpy(buffer, &chunk, sizeof(esp_ncp_zb_aps_chunk_t));
+        memcpy(buffer + sizeof(esp_ncp_zb_aps_chunk_t), esp_ncp_zb_aps_chunk_session_buffer(session) + session->offset, len);
+        ncp_header.sn = esp_random() % 0xFF;
+        if (esp_ncp_noti_input(&ncp_header, buffer, sizeof(esp_ncp_zb_aps_chunk_t) + len) != ESP_OK) {
+            break;
+        }
+        session->offset += len;
+    }
+
+    free(buffer);
+    buffer = NULL;
+}
+
+static esp_err_t esp_ncp_zb_aps_chunk_indication(const esp_ncp_zb_aps_data_ind_t *aps_data, const uint8_t *asdu)
+{
+    esp_ncp_zb_aps_chunk_session_t *session = esp_ncp_zb_aps_chunk_session_alloc(true, aps_data->asdu_length);
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NO_MEM, TAG, "No chunk pool for the APS data indication with length %" PRIu32, aps_data->asdu_length);
+
+    memcpy(&session->desc.ind, aps_data, sizeof(esp_ncp_zb_aps_data_ind_t));
+    memcpy(esp_ncp_zb_aps_chunk_session_buffer(session), asdu, aps_data->asdu_length);
+
+    struct {
+        esp_ncp_zb_aps_chunk_begin_t begin;
+        esp_ncp_zb_aps_data_ind_t    ind;
+    } ESP_NCP_ZB_PACKED_STRUCT chunk_begin = {
+        .begin = {
+            .chunk = {
+                .session = esp_ncp_zb_aps_chunk_session_handle(session),
+                .total_length = session->total_length,
+                .offset = 0,
+            },
+            .chunk_size = session->chunk_size,
+            .window = session->window,
+        },
+    };
+    memcpy(&chunk_begin.ind, aps_data, sizeof(esp_ncp_zb_aps_data_ind_t));
+
+    esp_ncp_header_t ncp_header = {
+        .sn = esp_random() % 0xFF,
+        .id = ESP_NCP_APS_DATA_CHUNK_BEGIN,
+    };
+    esp_err_t ret = esp_ncp_noti_input(&ncp_header, &chunk_begin, sizeof(chunk_begin));
+    if (ret == ESP_OK) {
+        esp_ncp_zb_aps_chunk_send_window(session);
+    } else {
+        esp_ncp_zb_aps_chunk_session_free(session);
+    }
+
+    return ret;
+}
+
+static void esp_ncp_zb_ota_block_request(const esp_zb_apsde_data_ind_t *ind);
+
 static bool esp_ncp_zb_aps_data_indication_handler(esp_zb_apsde_data_ind_t ind)
 {
-    typedef struct {
-        uint8_t states;                     /*!< The states of the device */
-        uint8_t dst_addr_mode;              /*!< Reserved, the addressing mode for the destination address used in this primitive and of the APDU that has been received.*/
-        esp_zb_addr_u dst_addr;             /*!< The individual device address or group address to which the ASDU is directed.*/
-        uint8_t dst_endpoint;               /*!< The target endpoint on the local entity to which the ASDU is directed.*/
-        uint8_t src_addr_mode;              /*!< Reserved, The addressing mode for the source address used in this primitive and of the APDU that has been received.*/
-        esp_zb_addr_u src_addr;             /*!< The individual device address of the entity from which the ASDU has been received.*/
-        uint8_t src_endpoint;               /*!< The number of the individual endpoint of the entity from which the ASDU has been received.*/
-        uint16_t profile_id;                /*!< The identifier of the profile from which this frame originated.*/
-        uint16_t cluster_id;                /*!< The identifier of the received object.*/
-        uint8_t indication_status;          /*!< The status of the incoming frame processing, 0: on success */
-        uint8_t security_status;            /*!< UNSECURED if the ASDU was received without any security. SECURED_NWK_KEY if the received ASDU was secured with the NWK key.*/
-        uint8_t lqi;                        /*!< The link quality indication delivered by the NLDE.*/
-        int rx_time;                        /*!< Reserved, a time indication for the received packet based on the local clock */
-        uint32_t asdu_length;               /*!< The number of octets comprising the ASDU being indicated by the APSDE.*/
-    } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_data_ind_t;
-
-    uint16_t outlen = sizeof(esp_ncp_zb_aps_data_ind_t) + ind.asdu_length;
+    if (ind.src_addr_mode != ESP_ZB_APS_ADDR_MODE_64_ENDP_PRESENT) {
+        esp_ncp_node_table_seen(ind.src_short_addr, ind.lqi);
+    }
+    esp_ncp_zb_ota_block_request(&ind);
+
+    bool chunked = (!s_aps_data_indication && (esp_ncp_frame_caps()->features & ESP_NCP_FEATURE_APS_CHUNK)
+                    && ind.asdu && ind.asdu_length > CONFIG_NCP_APS_CHUNK_SIZE);
+    uint16_t outlen = sizeof(esp_ncp_zb_aps_data_ind_t) + (chunked ? 0 : ind.asdu_length);
     uint8_t *output = calloc(1, outlen);
     if (!output) {
         return false;
@@ -138,11 +436,15 @@ static bool esp_ncp_zb_aps_data_indication_handler(esp_zb_apsde_data_ind_t ind)
     aps_data->rx_time = ind.rx_time;
 
     aps_data->asdu_length = ind.asdu_length;
-    if (ind.asdu && ind.asdu_length) {
-        memcpy(output + sizeof(esp_ncp_zb_aps_data_ind_t), ind.asdu, ind.asdu_length);
-    }
+    if (chunked) {
+        esp_ncp_zb_aps_chunk_indication(aps_data, ind.asdu);
+    } else {
+        if (ind.asdu && ind.asdu_length) {
+            memcpy(output + sizeof(esp_ncp_zb_aps_data_ind_t), ind.asdu, ind.asdu_length);
+        }
 
-    esp_ncp_zb_aps_data_handle(ESP_NCP_APS_DATA_INDICATION, output, outlen);
+        esp_ncp_zb_aps_data_handle(ESP_NCP_APS_DATA_INDICATION, output, outlen);
+    }
     free(output);
     output = NULL;
 
@@ -161,7 +463,9 @@ static void esp_ncp_zb_aps_data_confirm_handler(esp_zb_apsde_data_confirm_t conf
         uint32_t asdu_length;               /*!< The length of ASDU*/
     } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_data_confirm_t;
 
-    uint16_t outlen = sizeof(esp_ncp_zb_aps_data_confirm_t) + confirm.asdu_length;
+    /* The large ASDU has been sent by the host in chunks, do not echo it back in one frame */
+    uint32_t asdu_length = esp_ncp_zb_aps_chunk_confirm_take(&confirm) ? 0 : confirm.asdu_length;
+    uint16_t outlen = sizeof(esp_ncp_zb_aps_data_confirm_t) + asdu_length;
     uint8_t *output = calloc(1, outlen);
     if (!output) {
         return;
@@ -178,8 +482,8 @@ static void esp_ncp_zb_aps_data_confirm_handler(esp_zb_apsde_data_confirm_t conf
     aps_data->confirm_status = confirm.status;
     aps_data->asdu_length = confirm.asdu_length;
 
-    if (confirm.asdu && confirm.asdu_length) {
-        memcpy(output + sizeof(esp_ncp_zb_aps_data_confirm_t), confirm.asdu, confirm.asdu_length);
+    if (confirm.asdu && asdu_length) {
+        memcpy(output + sizeof(esp_ncp_zb_aps_data_confirm_t), confirm.asdu, asdu_length);
     }
 
     esp_ncp_zb_aps_data_handle(ESP_NCP_APS_DATA_CONFIRM, output, outlen);
@@ -242,6 +546,17 @@ static void esp_ncp_zb_unbind_cb(esp_zb_zdp_status_t zdo_status, void *user_ctx)
     esp_ncp_noti_input(&ncp_header, &parameters, sizeof(esp_ncp_zb_unbind_parameters_t));
 }
 
+/**
+ * @brief Type to represent the context of a match descriptor request, the clusters matched are recorded in the node table.
+ *
+ */
+typedef struct {
+    esp_ncp_zb_user_cb_t zdo_cb;                        /*!< A ZDO match desc request callback, must be the first */
+    uint16_t    profile_id;                             /*!< The profile ID of the request */
+    uint8_t     cluster_count;                          /*!< The number of the clusters in the cluster list */
+    uint16_t    cluster_list[ESP_NCP_NODE_CLUSTER_NUM]; /*!< The clusters of the request */
+} esp_ncp_zb_find_ctx_t;
+
 static void esp_ncp_zb_find_match_cb(esp_zb_zdp_status_t zdo_status, uint16_t addr, uint8_t endpoint, void *user_ctx)
 {
     esp_ncp_header_t ncp_header = {
@@ -263,7 +578,11 @@ static void esp_ncp_zb_find_match_cb(esp_zb_zdp_status_t zdo_status, uint16_t ad
     };
 
     if (user_ctx) {
-        memcpy(&parameters.zdo_cb, user_ctx, sizeof(esp_ncp_zb_user_cb_t));
+        esp_ncp_zb_find_ctx_t *find_ctx = (esp_ncp_zb_find_ctx_t *)user_ctx;
+        memcpy(&parameters.zdo_cb, &find_ctx->zdo_cb, sizeof(esp_ncp_zb_user_cb_t));
+        if (zdo_status == ESP_ZB_ZDP_STATUS_SUCCESS) {
+            esp_ncp_node_table_endpoint(addr, endpoint, find_ctx->profile_id, find_ctx->cluster_list, find_ctx->cluster_count);
+        }
         free(user_ctx);
     }
 
@@ -300,41 +619,87 @@ static void esp_ncp_zb_zdo_scan_complete_handler(esp_zb_zdp_status_t zdo_status,
     }
 }
 
+static void esp_ncp_zb_zcl_addr_encode(const esp_zb_zcl_addr_t *addr, uint8_t *addr_type, uint8_t src_addr[8])
+{
+    *addr_type = addr->addr_type;
+    memset(src_addr, 0, 8);
+    if (addr->addr_type == ESP_ZB_ZCL_ADDR_TYPE_SHORT) {
+        memcpy(src_addr, &addr->u.short_addr, sizeof(uint16_t));
+    } else if (addr->addr_type == ESP_ZB_ZCL_ADDR_TYPE_SRC_ID_GPD) {
+        memcpy(src_addr, &addr->u.src_id, sizeof(uint32_t));
+    } else {
+        memcpy(src_addr, addr->u.ieee_addr, sizeof(esp_zb_ieee_addr_t));
+    }
+}
+
+static void esp_ncp_zb_zcl_cmd_info_encode(const esp_zb_zcl_cmd_info_t *info, esp_ncp_zb_zcl_cmd_info_t *wire)
+{
+    wire->status = info->status;
+    wire->fc = info->header.fc;
+    wire->manuf_code = info->header.manuf_code;
+    wire->tsn = info->header.tsn;
+    wire->rssi = info->header.rssi;
+    esp_ncp_zb_zcl_addr_encode(&info->src_address, &wire->addr_type, wire->src_addr);
+    wire->dst_address = info->dst_address;
+    wire->src_endpoint = info->src_endpoint;
+    wire->dst_endpoint = info->dst_endpoint;
+    wire->cluster = info->cluster;
+    wire->profile = info->profile;
+    wire->cmd_id = info->command.id;
+    wire->direction = info->command.direction;
+    wire->is_common = info->command.is_common;
+}
+
 static esp_err_t esp_ncp_zb_read_attr_resp_handler(const esp_zb_zcl_cmd_read_attr_resp_message_t *message, uint8_t **output, uint16_t *outlen)
 {
     ESP_RETURN_ON_FALSE(message, ESP_FAIL, TAG, "Empty message");
     ESP_RETURN_ON_FALSE(message->info.status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Received message: error status(%d)",
                         message->info.status);
     ESP_LOGI(TAG, "Read attribute response: status(%d), cluster(0x%x)", message->info.status, message->info.cluster);
-    
-    uint16_t data_head_len = sizeof(esp_zb_zcl_cmd_info_t);
-    uint16_t id_len = sizeof(uint16_t), TYPE_LEN = sizeof(esp_zb_zcl_attr_type_t), SIZE_LEN = sizeof(uint8_t);
+    esp_ncp_node_table_seen(message->info.src_address.u.short_addr, -1);
+
+    uint16_t data_head_len = sizeof(esp_ncp_zb_zcl_cmd_info_t);
+    uint16_t attr_head_len = sizeof(uint8_t) + sizeof(esp_ncp_zb_zcl_attr_t);
     uint8_t index = 0;
     uint16_t length = (data_head_len + 1);
-    uint8_t *outbuf = calloc(1, length);
-    uint8_t *variables_data = NULL;
-    uint8_t  variables_data_len = 0;
-    uint8_t  variables_len = (id_len + TYPE_LEN + SIZE_LEN);
 
-    if (outbuf) {
-        memcpy(outbuf, &message->info, data_head_len);
-        for (esp_zb_zcl_read_attr_resp_variable_t *variables = message->variables; variables != NULL; variables = variables->next) {
-            ESP_LOGI(TAG, "attribute(0x%x), type(0x%x), value(%d)", variables->attribute.id, variables->attribute.data.type, variables->attribute.data.value ? *(uint8_t *)variables->attribute.data.value : 0);
-            
-            variables_data_len = (variables_len + variables->attribute.data.size);
-            length += variables_data_len;
-            
-            outbuf = realloc(outbuf, length);
-            variables_data = &outbuf[length - variables_data_len];
+    for (esp_zb_zcl_read_attr_resp_variable_t *variables = message->variables; variables != NULL; variables = variables->next) {
+        if (variables->attribute.data.size <= UINT8_MAX) {
+            length += attr_head_len + (variables->attribute.data.value ? variables->attribute.data.size : 0);
+        }
+    }
 
-            memcpy(variables_data, &variables->attribute.id, variables_len);
-            variables_data += variables_len;
+    uint8_t *outbuf = calloc(1, length);
+    ESP_RETURN_ON_FALSE(outbuf, ESP_ERR_NO_MEM, TAG, "No memory for the read attribute response");
+
+    /* Each record is the status of the attribute, the attribute header and the value */
+    esp_ncp_zb_zcl_cmd_info_t info = { 0 };
+    esp_ncp_zb_zcl_cmd_info_encode(&message->info, &info);
+    memcpy(outbuf, &info, data_head_len);
+
+    uint16_t offset = data_head_len + 1;
+    for (esp_zb_zcl_read_attr_resp_variable_t *variables = message->variables; variables != NULL; variables = variables->next) {
+        ESP_LOGI(TAG, "attribute(0x%x), type(0x%x), value(%d)", variables->attribute.id, variables->attribute.data.type, variables->attribute.data.value ? *(uint8_t *)variables->attribute.data.value : 0);
+        if (variables->attribute.data.size > UINT8_MAX) {
+            ESP_LOGW(TAG, "Skip the attribute(0x%x) with size %d", variables->attribute.id, variables->attribute.data.size);
+            continue;
+        }
 
-            memcpy(variables_data, variables->attribute.data.value, variables->attribute.data.size);
-            index ++;
+        esp_ncp_zb_zcl_attr_t attr = {
+            .id = variables->attribute.id,
+            .type = variables->attribute.data.type,
+            .size = variables->attribute.data.value ? variables->attribute.data.size : 0,
+        };
+        outbuf[offset] = variables->status;
+        memcpy(outbuf + offset + sizeof(uint8_t), &attr, sizeof(esp_ncp_zb_zcl_attr_t));
+        offset += attr_head_len;
+        if (attr.size) {
+            memcpy(outbuf + offset, variables->attribute.data.value, attr.size);
         }
-        outbuf[data_head_len] = index;
+        offset += attr.size;
+        index ++;
     }
+    outbuf[data_head_len] = index;
 
     *output = outbuf;
     *outlen = length;
@@ -426,67 +791,653 @@ static esp_err_t esp_ncp_zb_disc_attr_resp_handler(const esp_zb_zcl_cmd_discover
     uint8_t *outbuf = calloc(1, length);
     uint8_t variables_data_len = (id_len + status_len);
 
-    if (outbuf) {
-        memcpy(outbuf, &message->info, data_head_len);
-        for (esp_zb_zcl_disc_attr_variable_t *variables = message->variables; variables != NULL; variables = variables->next) {
-            ESP_LOGI(TAG, "attribute(0x%x), data_type(0x%0x)", variables->attr_id, variables->data_type);
-            length += variables_data_len;
-            
-            outbuf = realloc(outbuf, length);
-            memcpy(&outbuf[length - variables_data_len], &variables->attr_id, variables_data_len);
+    if (outbuf) {
+        memcpy(outbuf, &message->info, data_head_len);
+        for (esp_zb_zcl_disc_attr_variable_t *variables = message->variables; variables != NULL; variables = variables->next) {
+            ESP_LOGI(TAG, "attribute(0x%x), data_type(0x%0x)", variables->attr_id, variables->data_type);
+            length += variables_data_len;
+            
+            outbuf = realloc(outbuf, length);
+            memcpy(&outbuf[length - variables_data_len], &variables->attr_id, variables_data_len);
+
+            index ++;
+        }
+        outbuf[data_head_len] = index;
+    }
+
+    *output = outbuf;
+    *outlen = length;
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_report_attr_handler(const esp_zb_zcl_report_attr_message_t *message, uint8_t **output, uint16_t *outlen)
+{
+    ESP_RETURN_ON_FALSE(message, ESP_FAIL, TAG, "Empty message");
+    ESP_RETURN_ON_FALSE(message->status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Received message: error status(%d)",
+                        message->status);
+    ESP_LOGI(TAG, "Reveived report from address(0x%x) src endpoint(%d) to dst endpoint(%d) cluster(0x%x)", message->src_address.u.short_addr,
+             message->src_endpoint, message->dst_endpoint, message->cluster);
+    esp_ncp_node_table_seen(message->src_address.u.short_addr, -1);
+    
+    ESP_LOGI(TAG, "Received report information: attribute(0x%x), type(0x%x), value(%d)\n", message->attribute.id, message->attribute.data.type,
+             message->attribute.data.value ? *(uint8_t *)message->attribute.data.value : 0);
+
+    ESP_RETURN_ON_FALSE(message->attribute.data.size <= UINT8_MAX, ESP_ERR_INVALID_SIZE, TAG, "Unsupported attribute size %d",
+                        message->attribute.data.size);
+
+    uint16_t data_head_len = sizeof(esp_ncp_zb_zcl_report_attr_t);
+    uint16_t attr_head_len = sizeof(esp_ncp_zb_zcl_attr_t);
+    uint16_t length = data_head_len + attr_head_len + (message->attribute.data.value ? message->attribute.data.size : 0);
+    uint8_t *outbuf = calloc(1, length);
+    ESP_RETURN_ON_FALSE(outbuf, ESP_ERR_NO_MEM, TAG, "No memory for the attribute report");
+
+    esp_ncp_zb_zcl_report_attr_t report = {
+        .status = message->status,
+        .src_endpoint = message->src_endpoint,
+        .dst_endpoint = message->dst_endpoint,
+        .cluster = message->cluster,
+    };
+    esp_ncp_zb_zcl_addr_encode(&message->src_address, &report.addr_type, report.src_addr);
+    esp_ncp_zb_zcl_attr_t attr = {
+        .id = message->attribute.id,
+        .type = message->attribute.data.type,
+        .size = message->attribute.data.value ? message->attribute.data.size : 0,
+    };
+
+    memcpy(outbuf, &report, data_head_len);
+    memcpy(outbuf + data_head_len, &attr, attr_head_len);
+    if (attr.size) {
+        memcpy(outbuf + data_head_len + attr_head_len, message->attribute.data.value, attr.size);
+    }
+
+    *output = outbuf;
+    *outlen = length;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Type to represent the state of a target in the fan-out request.
+ *
+ */
+typedef enum {
+    ESP_NCP_ZB_FANOUT_IDLE,                 /*!< The request is not sent yet */
+    ESP_NCP_ZB_FANOUT_PENDING,              /*!< The request is waiting for the response */
+    ESP_NCP_ZB_FANOUT_DONE,                 /*!< The result of the target is recorded */
+} esp_ncp_zb_fanout_state_t;
+
+/**
+ * @brief Type to represent the progress of a target in the fan-out request.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                 /*!< The short address of the target */
+    uint8_t     endpoint;                   /*!< The endpoint of the target */
+    uint8_t     state;                      /*!< The state of the target, refer to esp_ncp_zb_fanout_state_t */
+    uint8_t     tsn;                        /*!< The ZCL sequence number of the request */
+    TickType_t  tick;                       /*!< The tick the request is sent */
+} esp_ncp_zb_fanout_target_state_t;
+
+/**
+ * @brief Type to represent a fan-out request in progress, it reads the attributes or configures the reporting of many targets.
+ *
+ */
+typedef struct {
+    bool        in_use;                     /*!< The session is allocated to a fan-out request, guarded by s_fanout_lock */
+    bool        started;                    /*!< The session is owned by the Zigbee task, set by its first tick */
+    uint16_t    id;                         /*!< The frame ID of the request, ESP_NCP_ZCL_ATTR_READ_FANOUT or ESP_NCP_ZCL_REPORT_CONFIG_BULK */
+    uint8_t     handle;                     /*!< The handle chosen by the host */
+    uint8_t     src_endpoint;               /*!< The source endpoint of the requests */
+    uint16_t    cluster_id;                 /*!< The cluster to read or to configure */
+    uint16_t    interval_ms;                /*!< The interval between two requests */
+    TickType_t  timeout;                    /*!< The ticks to wait for the response of a target */
+    uint8_t     field_number;               /*!< The number of the attributes to read or the reporting records */
+    void        *field;                     /*!< The attributes to read or the reporting records */
+    uint8_t     *change;                    /*!< The reportable changes the reporting records refer to */
+    uint16_t    target_count;               /*!< The number of the targets */
+    uint16_t    head;                       /*!< The targets before this index are all done */
+    uint16_t    next;                       /*!< The index of the next target to send the request */
+    uint16_t    pending;                    /*!< The number of the requests waiting for the response */
+    uint16_t    done;                       /*!< The number of the targets done */
+    esp_ncp_zb_fanout_target_state_t *target;   /*!< The targets */
+    uint8_t     *result;                    /*!< The results not notified yet, led by esp_ncp_zb_fanout_result_t */
+    uint16_t    result_len;                 /*!< The bytes in the result buffer */
+    uint16_t    result_size;                /*!< The size of the result buffer, the maximum frame size */
+} esp_ncp_zb_fanout_session_t;
+
+/* The frame task claims a free session and fills it, then the Zigbee task owns it from its first tick until it is freed */
+static esp_ncp_zb_fanout_session_t s_fanout_session[NCP_ZCL_FANOUT_SESSION_NUM];
+static portMUX_TYPE s_fanout_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void esp_ncp_zb_fanout_session_free(esp_ncp_zb_fanout_session_t *session)
+{
+    free(session->field);
+    free(session->change);
+    free(session->target);
+    free(session->result);
+    session->field = NULL;
+    session->change = NULL;
+    session->target = NULL;
+    session->result = NULL;
+    portENTER_CRITICAL_SAFE(&s_fanout_lock);
+    memset(session, 0, sizeof(esp_ncp_zb_fanout_session_t));
+    portEXIT_CRITICAL_SAFE(&s_fanout_lock);
+}
+
+static void esp_ncp_zb_fanout_flush(esp_ncp_zb_fanout_session_t *session, bool done)
+{
+    esp_ncp_zb_fanout_result_t *result = (esp_ncp_zb_fanout_result_t *)session->result;
+    esp_ncp_header_t ncp_header = {
+        .sn = esp_random() % 0xFF,
+        .id = (session->id == ESP_NCP_ZCL_ATTR_READ_FANOUT) ? ESP_NCP_ZCL_ATTR_READ_FANOUT_RESULT : ESP_NCP_ZCL_REPORT_CONFIG_BULK_RESULT,
+    };
+
+    if (!result->count && !done) {
+        return;
+    }
+
+    result->done = done;
+    esp_ncp_noti_input(&ncp_header, session->result, session->result_len);
+    result->count = 0;
+    session->result_len = sizeof(esp_ncp_zb_fanout_result_t);
+}
+
+/**
+ * @brief Encode the attributes of a response into the result, only the bytes are counted if the data is NULL.
+ *
+ * @return The bytes of the attributes
+ */
+static uint32_t esp_ncp_zb_fanout_encode(const esp_ncp_zb_fanout_session_t *session, const void *variables, uint8_t *data, uint8_t *count)
+{
+    uint32_t len = 0;
+
+    *count = 0;
+    if (session->id == ESP_NCP_ZCL_ATTR_READ_FANOUT) {
+        for (const esp_zb_zcl_read_attr_resp_variable_t *variable = variables; variable; variable = variable->next) {
+            esp_ncp_zb_fanout_attr_t attr = {
+                .id = variable->attribute.id,
+                .status = variable->status,
+                .type = variable->attribute.data.type,
+                .size = variable->attribute.data.value ? variable->attribute.data.size : 0,
+            };
+            if (data) {
+                memcpy(data + len, &attr, sizeof(esp_ncp_zb_fanout_attr_t));
+                if (attr.size) {
+                    memcpy(data + len + sizeof(esp_ncp_zb_fanout_attr_t), variable->attribute.data.value, attr.size);
+                }
+            }
+            len += sizeof(esp_ncp_zb_fanout_attr_t) + attr.size;
+            (*count) ++;
+        }
+    } else {
+        for (const esp_zb_zcl_config_report_resp_variable_t *variable = variables; variable; variable = variable->next) {
+            esp_ncp_zb_fanout_config_status_t config_status = {
+                .status = variable->status,
+                .direction = variable->direction,
+                .attribute_id = variable->attribute_id,
+            };
+            if (data) {
+                memcpy(data + len, &config_status, sizeof(esp_ncp_zb_fanout_config_status_t));
+            }
+            len += sizeof(esp_ncp_zb_fanout_config_status_t);
+            (*count) ++;
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @brief Append the result of a target, the results are notified once the buffer could not hold the next one.
+ *
+ */
+static void esp_ncp_zb_fanout_record(esp_ncp_zb_fanout_session_t *session, esp_ncp_zb_fanout_target_state_t *target, uint8_t status,
+                                     const void *variables)
+{
+    esp_ncp_zb_fanout_result_t *result = (esp_ncp_zb_fanout_result_t *)session->result;
+    esp_ncp_zb_fanout_record_t record = {
+        .short_addr = target->short_addr,
+        .endpoint = target->endpoint,
+        .status = status,
+        .attr_count = 0,
+    };
+    uint32_t len = sizeof(esp_ncp_zb_fanout_record_t) + esp_ncp_zb_fanout_encode(session, variables, NULL, &record.attr_count);
+
+    if (len > session->result_size - sizeof(esp_ncp_zb_fanout_result_t)) {
+        /* The attributes never fit in a notification, report the target without them */
+        record.status = ESP_ZB_ZCL_STATUS_INSUFF_SPACE;
+        variables = NULL;
+        len = sizeof(esp_ncp_zb_fanout_record_t);
+    }
+    if (session->result_len + len > session->result_size || result->count == UINT8_MAX) {
+        esp_ncp_zb_fanout_flush(session, false);
+    }
+
+    esp_ncp_zb_fanout_encode(session, variables, session->result + session->result_len + sizeof(esp_ncp_zb_fanout_record_t), &record.attr_count);
+    memcpy(session->result + session->result_len, &record, sizeof(esp_ncp_zb_fanout_record_t));
+    session->result_len += len;
+    result->count ++;
+
+    target->state = ESP_NCP_ZB_FANOUT_DONE;
+    session->pending --;
+    session->done ++;
+}
+
+static uint8_t esp_ncp_zb_fanout_send(esp_ncp_zb_fanout_session_t *session, const esp_ncp_zb_fanout_target_state_t *target)
+{
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd = {
+        .dst_addr_u.addr_short = target->short_addr,
+        .dst_endpoint = target->endpoint,
+        .src_endpoint = session->src_endpoint,
+    };
+
+    if (session->id == ESP_NCP_ZCL_ATTR_READ_FANOUT) {
+        esp_zb_zcl_read_attr_cmd_t read_req = {
+            .zcl_basic_cmd = zcl_basic_cmd,
+            .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+            .clusterID = session->cluster_id,
+            .attr_number = session->field_number,
+            .attr_field = session->field,
+        };
+
+        return esp_zb_zcl_read_attr_cmd_req(&read_req);
+    }
+
+    esp_zb_zcl_config_report_cmd_t report_cmd = {
+        .zcl_basic_cmd = zcl_basic_cmd,
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = session->cluster_id,
+        .record_number = session->field_number,
+        .record_field = session->field,
+    };
+
+    return esp_zb_zcl_config_report_cmd_req(&report_cmd);
+}
+
+static void esp_ncp_zb_fanout_tick(uint8_t index)
+{
+    esp_ncp_zb_fanout_session_t *session = &s_fanout_session[index];
+    TickType_t now = xTaskGetTickCount();
+
+    if (!session->in_use) {
+        return;
+    }
+    session->started = true;
+
+    for (uint16_t i = session->head; i < session->next; i ++) {
+        esp_ncp_zb_fanout_target_state_t *target = &session->target[i];
+        if (target->state == ESP_NCP_ZB_FANOUT_PENDING && now - target->tick >= session->timeout) {
+            esp_ncp_zb_fanout_record(session, target, ESP_ZB_ZCL_STATUS_TIMEOUT, NULL);
+        }
+    }
+    while (session->head < session->next && session->target[session->head].state == ESP_NCP_ZB_FANOUT_DONE) {
+        session->head ++;
+    }
+
+    /* One request per tick, the window bounds the requests in the air when the targets are slow to answer */
+    if (session->next < session->target_count && session->pending < NCP_ZCL_FANOUT_WINDOW) {
+        esp_ncp_zb_fanout_target_state_t *target = &session->target[session->next ++];
+
+        target->tsn = esp_ncp_zb_fanout_send(session, target);
+        target->tick = now;
+        target->state = ESP_NCP_ZB_FANOUT_PENDING;
+        session->pending ++;
+    }
+
+    if (session->done == session->target_count) {
+        ESP_LOGI(TAG, "Fan-out request 0x%04hx %d of %d targets done", session->id, session->handle, session->target_count);
+        esp_ncp_zb_fanout_flush(session, true);
+        esp_ncp_zb_fanout_session_free(session);
+        return;
+    }
+
+    esp_zb_scheduler_alarm(esp_ncp_zb_fanout_tick, index, session->interval_ms);
+}
+
+/**
+ * @brief Record the response of a fan-out request target.
+ *
+ * @return true if the response belongs to a fan-out request, it is not notified to the host on its own
+ */
+static bool esp_ncp_zb_fanout_resp(uint16_t id, const esp_zb_zcl_cmd_info_t *info, const void *variables)
+{
+    for (int i = 0; i < NCP_ZCL_FANOUT_SESSION_NUM; i ++) {
+        esp_ncp_zb_fanout_session_t *session = &s_fanout_session[i];
+        if (!session->started || session->id != id || session->cluster_id != info->cluster) {
+            continue;
+        }
+        for (uint16_t j = session->head; j < session->next; j ++) {
+            esp_ncp_zb_fanout_target_state_t *target = &session->target[j];
+            if (target->state == ESP_NCP_ZB_FANOUT_PENDING && target->tsn == info->header.tsn
+                && target->short_addr == info->src_address.u.short_addr) {
+                esp_ncp_node_table_seen(target->short_addr, -1);
+                esp_ncp_zb_fanout_record(session, target, info->status, variables);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool esp_ncp_zb_fanout_read_attr_resp(const esp_zb_zcl_cmd_read_attr_resp_message_t *message)
+{
+    return message && esp_ncp_zb_fanout_resp(ESP_NCP_ZCL_ATTR_READ_FANOUT, &message->info, message->variables);
+}
+
+static bool esp_ncp_zb_fanout_report_config_resp(const esp_zb_zcl_cmd_config_report_resp_message_t *message)
+{
+    return message && esp_ncp_zb_fanout_resp(ESP_NCP_ZCL_REPORT_CONFIG_BULK, &message->info, message->variables);
+}
+
+/**
+ * @brief Type to represent the prefetch cache of the OTA image data for one OTA client.
+ *
+ */
+typedef struct {
+    bool        in_use;                     /*!< The cache is allocated to the client */
+    bool        failed;                     /*!< The host fails to read the data requested */
+    uint16_t    short_addr;                 /*!< The short address of the OTA client */
+    uint8_t     index;                      /*!< The index of the OTA image */
+    uint16_t    filled;                     /*!< The bytes received from the host in the cache */
+    uint32_t    offset;                     /*!< The offset of the next block served to the client */
+    uint32_t    base;                       /*!< The offset of the first byte in the cache */
+    uint32_t    requested;                  /*!< The data before this offset has been requested from the host */
+    bool        block_request;              /*!< The file offset of the Image Block Request being served is known */
+    uint32_t    block_offset;               /*!< The file offset of the Image Block Request being served */
+    TickType_t  tick;                       /*!< The tick of the last block served */
+    TickType_t  fetch_tick;                 /*!< The tick of the last data requested from the host */
+    uint8_t     cache[CONFIG_NCP_OTA_CACHE_SIZE]; /*!< The data of the OTA image from the base offset */
+} esp_ncp_zb_ota_session_t;
+
+static esp_ncp_zb_ota_image_t s_ota_image[NCP_OTA_IMAGE_NUM];      /*!< The OTA images registered, the size is 0 if not registered */
+static esp_ncp_zb_ota_session_t s_ota_session[CONFIG_NCP_OTA_SESSION_NUM];
+static SemaphoreHandle_t s_ota_lock;                                /*!< The lock of the prefetch caches */
+
+static esp_err_t esp_ncp_zb_ota_next_data_cb(esp_zb_ota_zcl_information_t message, uint16_t index, uint8_t size, uint8_t **data);
+
+static esp_err_t esp_ncp_zb_ota_server_register(const esp_ncp_zb_ota_image_t *image, bool notify_on)
+{
+    esp_zb_ota_upgrade_server_notify_req_t req = {
+        .endpoint = image->endpoint,
+        .index = image->index,
+        .notify_on = notify_on,
+        .ota_upgrade_time = image->ota_upgrade_time,
+        .ota_file_header = {
+            .manufacturer_code = image->manufacturer_code,
+            .image_type = image->image_type,
+            .file_version = image->file_version,
+            .image_size = image->image_size,
+        },
+        .next_data_cb = esp_ncp_zb_ota_next_data_cb,
+    };
+
+    return esp_zb_ota_upgrade_server_notify_req(&req);
+}
+
+/* Must be called with the lock held */
+static esp_ncp_zb_ota_session_t *esp_ncp_zb_ota_session_get(uint16_t short_addr, bool alloc)
+{
+    esp_ncp_zb_ota_session_t *session = NULL;
+    TickType_t now = xTaskGetTickCount();
+
+    for (int i = 0; i < CONFIG_NCP_OTA_SESSION_NUM; i ++) {
+        if (s_ota_session[i].in_use && s_ota_session[i].short_addr == short_addr) {
+            return &s_ota_session[i];
+        }
+    }
+
+    if (!alloc) {
+        return NULL;
+    }
+
+    for (int i = 0; i < CONFIG_NCP_OTA_SESSION_NUM; i ++) {
+        if (!s_ota_session[i].in_use || (now - s_ota_session[i].tick) > pdMS_TO_TICKS(NCP_OTA_SESSION_TIMEOUT_MS)) {
+            session = &s_ota_session[i];
+            memset(session, 0, offsetof(esp_ncp_zb_ota_session_t, cache));
+            session->in_use = true;
+            session->short_addr = short_addr;
+            session->tick = now;
+            break;
+        }
+    }
+
+    return session;
+}
+
+/* Must be called with the lock held */
+static void esp_ncp_zb_ota_session_reset(esp_ncp_zb_ota_session_t *session, uint8_t index)
+{
+    session->index = index;
+    session->failed = false;
+    session->filled = 0;
+    session->offset = 0;
+    session->base = 0;
+    session->requested = 0;
+}
+
+/**
+ * @brief Reserve the range of the OTA image to request from the host to fill the cache, must be called with the lock held.
+ *
+ * @note The range shorter than one fetch is not requested unless forced, to save the frames on the link.
+ */
+static uint32_t esp_ncp_zb_ota_prefetch_reserve(esp_ncp_zb_ota_session_t *session, bool force, esp_ncp_zb_ota_block_t *block)
+{
+    uint32_t image_size = s_ota_image[session->index].image_size;
+    uint32_t end = MIN(image_size, session->base + CONFIG_NCP_OTA_CACHE_SIZE);
+    uint32_t len = (end > session->requested) ? end - session->requested : 0;
+
+    if (!force && len < NCP_OTA_FETCH_SIZE && end < image_size) {
+        return 0;
+    }
+
+    block->short_addr = session->short_addr;
+    block->index = session->index;
+    block->offset = session->requested;
+    session->requested += len;
+
+    return len;
+}
+
+/**
+ * @brief Request the reserved range from the host, answered by ESP_NCP_OTA_SERVER_BLOCK_DATA frames.
+ *
+ * @note It must not be called with the lock held, as the link could be waiting for the frame handler.
+ */
+static void esp_ncp_zb_ota_prefetch(esp_ncp_zb_ota_block_t *block, uint32_t len)
+{
+    uint16_t fetch_size = MIN(NCP_OTA_FETCH_SIZE, esp_ncp_frame_caps()->max_frame_size - sizeof(esp_ncp_zb_ota_block_t));
+    esp_ncp_header_t ncp_header = {
+        .id = ESP_NCP_OTA_SERVER_BLOCK_REQUEST,
+    };
+
+    while (len) {
+        block->size = MIN(fetch_size, len);
+        ncp_header.sn = esp_random() % 0xFF;
+        if (esp_ncp_noti_input_nowait(&ncp_header, block, sizeof(esp_ncp_zb_ota_block_t)) != ESP_OK) {
+            /* The range is requested again once the client waits for it */
+            break;
+        }
+        block->offset += block->size;
+        len -= block->size;
+    }
+}
+
+/**
+ * @brief Record the file offset of the Image Block Request from the OTA client, the stack does not pass it to the next data
+ * callback. It runs in the Zigbee task before the stack handles the request.
+ */
+static void esp_ncp_zb_ota_block_request(const esp_zb_apsde_data_ind_t *ind)
+{
+    const uint8_t *zcl = ind->asdu;
+    uint16_t head = 3;
+
+    if (!s_ota_lock || ind->status != 0 || ind->cluster_id != ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE || !zcl || ind->asdu_length < head) {
+        return;
+    }
+
+    /* The cluster specific command to the server, the manufacturer code is present if the frame control tells */
+    if (zcl[0] & 0x04) {
+        head += 2;
+    }
+    if ((zcl[0] & 0x03) != 0x01 || (zcl[0] & 0x08) || ind->asdu_length < head + 14 || zcl[head - 1] != NCP_OTA_BLOCK_REQUEST_CMD) {
+        return;
+    }
+
+    /* Field control, manufacturer code, image type and file version come before the file offset */
+    const uint8_t *payload = zcl + head + 9;
+    xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+    esp_ncp_zb_ota_session_t *session = esp_ncp_zb_ota_session_get(ind->src_short_addr, true);
+    if (session) {
+        session->block_offset = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((uint32_t)payload[3] << 24);
+        session->block_request = true;
+    }
+    xSemaphoreGive(s_ota_lock);
+}
+
+/**
+ * @brief Serve the block to the OTA client from the prefetch cache, it never waits for the host or the link.
+ *
+ * @note The block is served from the file offset of the Image Block Request, so a request repeated after a lost response gets
+ *       the same data again. The block stays in the cache until the client requests beyond it. The blocks are assumed in sequence
+ *       only if the request has not been seen, e.g. for the first block of a new client. On a cache miss the missing data is
+ *       requested from the host and the block fails, the client requests it again.
+ */
+static esp_err_t esp_ncp_zb_ota_next_data_cb(esp_zb_ota_zcl_information_t message, uint16_t index, uint8_t size, uint8_t **data)
+{
+    esp_ncp_zb_ota_session_t *session = NULL;
+    esp_ncp_zb_ota_block_t block;
+    TickType_t now = xTaskGetTickCount();
+    uint32_t offset = 0;
+    uint32_t len = 0;
+    esp_err_t ret = ESP_ERR_NOT_FINISHED;
+
+    ESP_RETURN_ON_FALSE(index < NCP_OTA_IMAGE_NUM && s_ota_image[index].image_size, ESP_ERR_NOT_FOUND, TAG,
+                        "Failed to locate the OTA image using the index (%d)", index);
+
+    xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+    session = esp_ncp_zb_ota_session_get(message.src_addr.u.short_addr, true);
+    if (!session) {
+        xSemaphoreGive(s_ota_lock);
+        ESP_LOGW(TAG, "No OTA prefetch cache for the client 0x%04hx", message.src_addr.u.short_addr);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (session->index != index) {
+        esp_ncp_zb_ota_session_reset(session, index);
+    }
+
+    offset = session->block_request ? session->block_offset : session->offset;
+    session->block_request = false;
+    if (offset + size > s_ota_image[index].image_size) {
+        xSemaphoreGive(s_ota_lock);
+        ESP_LOGW(TAG, "The OTA client 0x%04hx requests beyond the image", session->short_addr);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (offset < session->base || offset > session->base + session->filled) {
+        /* The client moves out of the cache, fill it again from the offset requested */
+        session->failed = false;
+        session->filled = 0;
+        session->base = offset;
+        session->requested = offset;
+    } else if (offset > session->base) {
+        /* The data before the block is no longer referenced by the stack, make room for the next data */
+        uint32_t consumed = offset - session->base;
+        memmove(session->cache, session->cache + consumed, session->filled - consumed);
+        session->filled -= consumed;
+        session->base = offset;
+    }
+
+    if (session->base + session->filled >= offset + size) {
+        *data = session->cache + (offset - session->base);
+        session->offset = offset + size;
+        session->tick = now;
+        /* Keep the cache ahead of the client, the next block requests do not miss */
+        len = esp_ncp_zb_ota_prefetch_reserve(session, false, &block);
+        ret = ESP_OK;
+    } else if (session->failed) {
+        session->failed = false;
+        ret = ESP_FAIL;
+    } else {
+        /* The data requested is lost if it does not arrive in time, request it again */
+        if (session->requested >= offset + size && (now - session->fetch_tick) >= pdMS_TO_TICKS(NCP_OTA_FETCH_TIMEOUT_MS)) {
+            session->requested = session->base + session->filled;
+        }
+        len = (session->requested < offset + size) ? esp_ncp_zb_ota_prefetch_reserve(session, true, &block) : 0;
+    }
+    if (len) {
+        session->fetch_tick = now;
+    }
+    xSemaphoreGive(s_ota_lock);
+
+    esp_ncp_zb_ota_prefetch(&block, len);
+
+    if (ret != ESP_OK) {
+        ESP_LOGD(TAG, "OTA image data at %" PRIu32 " not ready for the client 0x%04hx: %s", offset, message.src_addr.u.short_addr,
+                 esp_err_to_name(ret));
+    }
+
+    return ret;
+}
+
+static esp_err_t esp_ncp_zb_ota_server_status_handler(const esp_zb_zcl_ota_upgrade_server_status_message_t *message, uint8_t **output, uint16_t *outlen)
+{
+    esp_ncp_zb_ota_status_t status = {
+        .short_addr = message->zcl_addr.u.short_addr,
+        .index = 0xFF,
+        .status = message->server_status,
+    };
+
+    ESP_RETURN_ON_FALSE(message->info.status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Invalid OTA server status message");
 
-            index ++;
+    if (s_ota_lock) {
+        xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+        esp_ncp_zb_ota_session_t *session = esp_ncp_zb_ota_session_get(status.short_addr, false);
+        if (session) {
+            status.index = session->index;
+            status.offset = session->offset;
+            if (message->server_status != ESP_ZB_ZCL_OTA_UPGRADE_SERVER_STARTED) {
+                session->in_use = false;
+            }
         }
-        outbuf[data_head_len] = index;
+        xSemaphoreGive(s_ota_lock);
     }
 
-    *output = outbuf;
-    *outlen = length;
+    *output = calloc(1, sizeof(esp_ncp_zb_ota_status_t));
+    ESP_RETURN_ON_FALSE(*output, ESP_ERR_NO_MEM, TAG, "Malloc OTA server status fail");
+
+    *outlen = sizeof(esp_ncp_zb_ota_status_t);
+    memcpy(*output, &status, *outlen);
 
     return ESP_OK;
 }
 
-static esp_err_t esp_ncp_zb_report_attr_handler(const esp_zb_zcl_report_attr_message_t *message, uint8_t **output, uint16_t *outlen)
+static esp_err_t esp_ncp_zb_ota_server_query_image_handler(const esp_zb_zcl_ota_upgrade_server_query_image_message_t *message)
 {
-    ESP_RETURN_ON_FALSE(message, ESP_FAIL, TAG, "Empty message");
-    ESP_RETURN_ON_FALSE(message->status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Received message: error status(%d)",
-                        message->status);
-    ESP_LOGI(TAG, "Reveived report from address(0x%x) src endpoint(%d) to dst endpoint(%d) cluster(0x%x)", message->src_address.u.short_addr,
-             message->src_endpoint, message->dst_endpoint, message->cluster);
-    
-    ESP_LOGI(TAG, "Received report information: attribute(0x%x), type(0x%x), value(%d)\n", message->attribute.id, message->attribute.data.type,
-             message->attribute.data.value ? *(uint8_t *)message->attribute.data.value : 0);
-
-    typedef struct {
-        esp_zb_zcl_status_t status;       /*!< The status of the report attribute response, which can refer to esp_zb_zcl_status_t */
-        esp_zb_zcl_addr_t src_address;    /*!< The struct of address contains short and ieee address, which can refer to esp_zb_zcl_addr_s */
-        uint8_t src_endpoint;             /*!< The endpoint id which comes from report device */
-        uint8_t dst_endpoint;             /*!< The destination endpoint id */
-        uint16_t cluster;                 /*!< The cluster id that reported */
-    } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_report_attr_t;
-
-    typedef struct {
-        uint16_t id;                                    /*!< The identify of attribute */
-        uint8_t  type;                                  /*!< The type of attribute, which can refer to esp_zb_zcl_attr_type_t */
-        uint8_t  size;                                  /*!< The value size of attribute  */
-    } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_attr_data_t;
+    const esp_ncp_zb_ota_image_t *image = NULL;
 
-    uint16_t data_head_len = sizeof(esp_ncp_zb_report_attr_t);
-    uint16_t attr_head_len = sizeof(esp_ncp_zb_attr_data_t);
-    uint16_t length = data_head_len + attr_head_len + message->attribute.data.size;
-    uint8_t *outbuf = calloc(1, length);
+    ESP_RETURN_ON_FALSE(message->info.status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Invalid OTA server query image message");
 
-    if (outbuf) {
-        memcpy(outbuf, message, data_head_len + attr_head_len);
-        if (message->attribute.data.value) {
-            memcpy(outbuf + data_head_len + attr_head_len, message->attribute.data.value, message->attribute.data.size);
+    for (int i = 0; i < NCP_OTA_IMAGE_NUM; i ++) {
+        if (s_ota_image[i].image_size && s_ota_image[i].manufacturer_code == message->manufacturer_code
+            && s_ota_image[i].image_type == message->image_type && s_ota_image[i].file_version > message->version
+            && (!image || s_ota_image[i].file_version > image->file_version)) {
+            image = &s_ota_image[i];
         }
     }
+    ESP_RETURN_ON_FALSE(image, ESP_ERR_NOT_FOUND, TAG, "No OTA image for the client 0x%04hx", message->zcl_addr.u.short_addr);
 
-    *output = outbuf;
-    *outlen = length;
+    /* The client queries again after it gives up a transfer, restart its prefetch from the beginning of the image */
+    xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+    esp_ncp_zb_ota_session_t *session = esp_ncp_zb_ota_session_get(message->zcl_addr.u.short_addr, false);
+    if (session) {
+        esp_ncp_zb_ota_session_reset(session, image->index);
+    }
+    xSemaphoreGive(s_ota_lock);
 
-    return ESP_OK;
+    return esp_ncp_zb_ota_server_register(image, false);
 }
 
 static esp_err_t esp_ncp_zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
@@ -500,6 +1451,9 @@ static esp_err_t esp_ncp_zb_action_handler(esp_zb_core_action_callback_id_t call
 
     switch (callback_id) {
         case ESP_ZB_CORE_CMD_READ_ATTR_RESP_CB_ID:
+            if (esp_ncp_zb_fanout_read_attr_resp((esp_zb_zcl_cmd_read_attr_resp_message_t *)message)) {
+                break;
+            }
             ncp_header.id = ESP_NCP_ZCL_ATTR_READ;
             ret = esp_ncp_zb_read_attr_resp_handler((esp_zb_zcl_cmd_read_attr_resp_message_t *)message, &output, &outlen);
             break;
@@ -508,6 +1462,9 @@ static esp_err_t esp_ncp_zb_action_handler(esp_zb_core_action_callback_id_t call
             ret = esp_ncp_zb_write_attr_resp_handler((esp_zb_zcl_cmd_write_attr_resp_message_t *)message, &output, &outlen);
             break;
         case ESP_ZB_CORE_CMD_REPORT_CONFIG_RESP_CB_ID:
+            if (esp_ncp_zb_fanout_report_config_resp((esp_zb_zcl_cmd_config_report_resp_message_t *)message)) {
+                break;
+            }
             ncp_header.id = ESP_NCP_ZCL_REPORT_CONFIG;
             ret = esp_ncp_zb_report_configure_resp_handler((esp_zb_zcl_cmd_config_report_resp_message_t *)message, &output, &outlen);
             break;
@@ -519,6 +1476,13 @@ static esp_err_t esp_ncp_zb_action_handler(esp_zb_core_action_callback_id_t call
             ncp_header.id = ESP_NCP_ZCL_ATTR_REPORT;
             ret = esp_ncp_zb_report_attr_handler((esp_zb_zcl_report_attr_message_t *)message, &output, &outlen);
             break;
+        case ESP_ZB_CORE_OTA_UPGRADE_SRV_STATUS_CB_ID:
+            ncp_header.id = ESP_NCP_OTA_SERVER_STATUS;
+            ret = esp_ncp_zb_ota_server_status_handler((esp_zb_zcl_ota_upgrade_server_status_message_t *)message, &output, &outlen);
+            break;
+        case ESP_ZB_CORE_OTA_UPGRADE_SRV_QUERY_IMAGE_CB_ID:
+            ret = esp_ncp_zb_ota_server_query_image_handler((esp_zb_zcl_ota_upgrade_server_query_image_message_t *)message);
+            break;
         default:
             ESP_LOGW(TAG, "Receive Zigbee action(0x%x) callback", callback_id);
             break;
@@ -560,9 +1524,16 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE:
             dev_annce_params = (esp_zb_zdo_signal_device_annce_params_t *)esp_zb_app_signal_get_params(p_sg_p);
             ESP_LOGI(TAG, "New device commissioned or rejoined (short: 0x%04hx)", dev_annce_params->device_short_addr);
+            esp_ncp_node_table_announce(dev_annce_params->device_short_addr, dev_annce_params->ieee_addr, dev_annce_params->capability);
             ncp_header.id = ESP_NCP_NETWORK_JOINNETWORK;
             esp_ncp_noti_input(&ncp_header, dev_annce_params, sizeof(esp_zb_zdo_signal_device_annce_params_t));
             break;
+        case ESP_ZB_ZDO_SIGNAL_LEAVE_INDICATION:
+            dev_leave_params = (esp_zb_zdo_signal_leave_indication_params_t *)esp_zb_app_signal_get_params(p_sg_p);
+            if (!dev_leave_params->rejoin) {
+                esp_ncp_node_table_leave(dev_leave_params->device_addr);
+            }
+            break;
         case ESP_ZB_ZDO_SIGNAL_LEAVE:
             dev_leave_params = (esp_zb_zdo_signal_leave_indication_params_t *)esp_zb_app_signal_get_params(p_sg_p);
             ESP_LOGI(TAG, "Leave Indication parameters (short: 0x%04hx)", dev_leave_params->short_addr);
@@ -623,7 +1594,6 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         case ESP_ZB_BDB_SIGNAL_TOUCHLINK_TARGET_FINISHED:
         case ESP_ZB_BDB_SIGNAL_TOUCHLINK_ADD_DEVICE_TO_NWK:
         case ESP_ZB_NWK_SIGNAL_DEVICE_ASSOCIATED:
-        case ESP_ZB_ZDO_SIGNAL_LEAVE_INDICATION:
         case ESP_ZB_BDB_SIGNAL_WWAH_REJOIN_STARTED:
         case ESP_ZB_ZGP_SIGNAL_COMMISSIONING:
         case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
@@ -706,6 +1676,10 @@ static esp_err_t esp_ncp_zb_network_init_fn(const uint8_t *input, uint16_t inlen
         if (ret == ESP_OK) {
             s_init_flag = true;
             status = ESP_NCP_SUCCESS;
+            /* The node table is only a cache of the network, the NCP keeps working without it */
+            if (esp_ncp_node_table_init() != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to load the node table");
+            }
         }
     }
 
@@ -1099,6 +2073,246 @@ static esp_err_t esp_ncp_zb_read_attr_fn(const uint8_t *input, uint16_t inlen, u
     return ret;
 }
 
+/**
+ * @brief Start a fan-out request, the field and the change are owned by the session, or freed on failure.
+ *
+ */
+static esp_err_t esp_ncp_zb_fanout_start(uint16_t id, const esp_ncp_zb_fanout_t *request, void *field, uint8_t *change,
+                                         const esp_ncp_zb_fanout_target_t *target)
+{
+    uint16_t size = esp_ncp_frame_caps()->max_frame_size;
+    esp_ncp_zb_fanout_session_t *session = NULL;
+    esp_err_t ret = ESP_OK;
+    uint8_t index = 0;
+
+    /* The session is claimed under the lock, the Zigbee task does not look at it before the first tick */
+    portENTER_CRITICAL_SAFE(&s_fanout_lock);
+    for (int i = 0; i < NCP_ZCL_FANOUT_SESSION_NUM; i ++) {
+        if (s_fanout_session[i].in_use && s_fanout_session[i].handle == request->handle) {
+            ret = ESP_ERR_INVALID_STATE;
+            session = NULL;
+            break;
+        } else if (!s_fanout_session[i].in_use && !session) {
+            session = &s_fanout_session[i];
+            index = i;
+        }
+    }
+    if (session) {
+        session->in_use = true;
+        session->handle = request->handle;
+    }
+    portEXIT_CRITICAL_SAFE(&s_fanout_lock);
+
+    if (ret == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Fan-out request %d in progress", request->handle);
+    } else if (!session) {
+        ESP_LOGW(TAG, "No fan-out session available");
+        ret = ESP_ERR_NO_MEM;
+    }
+
+    if (ret == ESP_OK) {
+        session->target = calloc(request->target_count, sizeof(esp_ncp_zb_fanout_target_state_t));
+        session->result = calloc(1, size);
+        ret = (session->target && session->result) ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+
+    if (ret != ESP_OK) {
+        free(field);
+        free(change);
+        if (session) {
+            esp_ncp_zb_fanout_session_free(session);
+        }
+        return ret;
+    }
+
+    for (uint16_t i = 0; i < request->target_count; i ++) {
+        session->target[i].short_addr = target[i].short_addr;
+        session->target[i].endpoint = target[i].endpoint;
+    }
+    session->id = id;
+    session->handle = request->handle;
+    session->src_endpoint = request->src_endpoint;
+    session->cluster_id = request->cluster_id;
+    session->interval_ms = request->interval_ms ? request->interval_ms : NCP_ZCL_FANOUT_INTERVAL_MS;
+    session->timeout = pdMS_TO_TICKS(request->timeout_ms ? request->timeout_ms : NCP_ZCL_FANOUT_TIMEOUT_MS);
+    session->field_number = request->field_number;
+    session->field = field;
+    session->change = change;
+    session->target_count = request->target_count;
+    session->result_size = size;
+    session->result_len = sizeof(esp_ncp_zb_fanout_result_t);
+    ((esp_ncp_zb_fanout_result_t *)session->result)->handle = request->handle;
+    ((esp_ncp_zb_fanout_result_t *)session->result)->cluster_id = request->cluster_id;
+
+    ESP_LOGI(TAG, "Fan-out request 0x%04hx %d cluster 0x%04hx to %d targets", id, request->handle, request->cluster_id, request->target_count);
+    /* The Zigbee task takes the session over from here */
+    esp_zb_scheduler_alarm(esp_ncp_zb_fanout_tick, index, 0);
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_read_attr_fanout_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_fanout_t), ESP_ERR_INVALID_ARG, TAG, "Invalid fan-out read length %d", inlen);
+
+    const esp_ncp_zb_fanout_t *request = (const esp_ncp_zb_fanout_t *)input;
+    uint16_t attr_len = request->field_number * sizeof(uint16_t);
+    uint16_t size = esp_ncp_frame_caps()->max_frame_size;
+    esp_ncp_status_t status = ESP_NCP_ERR_FATAL;
+    uint16_t *attr_field = NULL;
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(request->field_number && request->target_count, ESP_ERR_INVALID_ARG, TAG, "Empty fan-out read");
+    ESP_RETURN_ON_FALSE(inlen == sizeof(esp_ncp_zb_fanout_t) + attr_len + request->target_count * sizeof(esp_ncp_zb_fanout_target_t),
+                        ESP_ERR_INVALID_SIZE, TAG, "Invalid fan-out read length %d", inlen);
+    ESP_RETURN_ON_FALSE(size > sizeof(esp_ncp_zb_fanout_result_t) + sizeof(esp_ncp_zb_fanout_record_t), ESP_ERR_INVALID_SIZE, TAG,
+                        "Frame too small for the fan-out read");
+
+    attr_field = calloc(1, attr_len);
+    ESP_RETURN_ON_FALSE(attr_field, ESP_ERR_NO_MEM, TAG, "Malloc fan-out attributes fail");
+    memcpy(attr_field, input + sizeof(esp_ncp_zb_fanout_t), attr_len);
+
+    ret = esp_ncp_zb_fanout_start(ESP_NCP_ZCL_ATTR_READ_FANOUT, request, attr_field, NULL,
+                                  (const esp_ncp_zb_fanout_target_t *)(input + sizeof(esp_ncp_zb_fanout_t) + attr_len));
+    status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
+/**
+ * @brief Parse the reporting records, the reportable changes are kept in one buffer the records refer to.
+ *
+ * @param[in]  input         The records in the wire format, refer to esp_ncp_zb_report_config_record_t
+ * @param[in]  inlen         The bytes available from the input
+ * @param[in]  record_number The number of the records
+ * @param[out] record_field  The records parsed, freed by the caller
+ * @param[out] change        The reportable changes, freed by the caller
+ * @param[out] len           The bytes of the records in the wire format
+ *
+ */
+static esp_err_t esp_ncp_zb_report_config_parse(const uint8_t *input, uint16_t inlen, uint16_t record_number,
+                                                esp_zb_zcl_config_report_record_t **record_field, uint8_t **change, uint16_t *len)
+{
+    uint16_t offset = 0;
+
+    ESP_RETURN_ON_FALSE(record_number, ESP_ERR_INVALID_ARG, TAG, "No reporting record");
+    for (int i = 0; i < record_number; i ++) {
+        ESP_RETURN_ON_FALSE(inlen >= offset + sizeof(esp_ncp_zb_report_config_record_t), ESP_ERR_INVALID_SIZE, TAG,
+                            "Truncated reporting record %d", i);
+        offset += sizeof(esp_ncp_zb_report_config_record_t) + ((const esp_ncp_zb_report_config_record_t *)(input + offset))->change_size;
+        ESP_RETURN_ON_FALSE(inlen >= offset, ESP_ERR_INVALID_SIZE, TAG, "Truncated reportable change %d", i);
+    }
+
+    *record_field = calloc(record_number, sizeof(esp_zb_zcl_config_report_record_t));
+    *change = calloc(1, offset);
+    if (!*record_field || !*change) {
+        free(*record_field);
+        free(*change);
+        *record_field = NULL;
+        *change = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(*change, input, offset);
+    *len = offset;
+    offset = 0;
+    for (int i = 0; i < record_number; i ++) {
+        const esp_ncp_zb_report_config_record_t *record = (const esp_ncp_zb_report_config_record_t *)(*change + offset);
+        (*record_field)[i].direction = record->direction;
+        (*record_field)[i].attributeID = record->attribute_id;
+        (*record_field)[i].attrType = record->attr_type;
+        (*record_field)[i].min_interval = record->min_interval;
+        (*record_field)[i].max_interval = record->max_interval;
+        (*record_field)[i].reportable_change = record->change_size ? (void *)(record + 1) : NULL;
+        offset += sizeof(esp_ncp_zb_report_config_record_t) + record->change_size;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_report_config_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    typedef struct {
+        esp_zb_zcl_basic_cmd_t  zcl_basic_cmd;          /*!< Basic command info */
+        uint8_t                 address_mode;           /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+        uint16_t                cluster_id;             /*!< Cluster ID to configure */
+        uint16_t                record_number;          /*!< Number of the reporting records */
+    } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_report_config_t;
+
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_report_config_t), ESP_ERR_INVALID_ARG, TAG, "Invalid report config length %d", inlen);
+
+    const esp_ncp_zb_report_config_t *zb_report_config = (const esp_ncp_zb_report_config_t *)input;
+    esp_zb_zcl_config_report_record_t *record_field = NULL;
+    uint8_t *change = NULL;
+    uint16_t len = 0;
+    esp_err_t ret = esp_ncp_zb_report_config_parse(input + sizeof(esp_ncp_zb_report_config_t), inlen - sizeof(esp_ncp_zb_report_config_t),
+                                                   zb_report_config->record_number, &record_field, &change, &len);
+    esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Report config addr %02x, dst_endpoint %0x, src_endpoint %0x, address_mode %0x, cluster_id %02x, records %d",
+                        zb_report_config->zcl_basic_cmd.dst_addr_u.addr_short, zb_report_config->zcl_basic_cmd.dst_endpoint,
+                        zb_report_config->zcl_basic_cmd.src_endpoint, zb_report_config->address_mode, zb_report_config->cluster_id,
+                        zb_report_config->record_number);
+
+        esp_zb_zcl_config_report_cmd_t report_cmd = {
+            .zcl_basic_cmd = zb_report_config->zcl_basic_cmd,
+            .address_mode = zb_report_config->address_mode,
+            .clusterID = zb_report_config->cluster_id,
+            .record_number = zb_report_config->record_number,
+            .record_field = record_field,
+        };
+
+        esp_zb_zcl_config_report_cmd_req(&report_cmd);
+    }
+
+    free(record_field);
+    record_field = NULL;
+    free(change);
+    change = NULL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
+static esp_err_t esp_ncp_zb_report_config_bulk_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_fanout_t), ESP_ERR_INVALID_ARG, TAG, "Invalid bulk report config length %d", inlen);
+
+    const esp_ncp_zb_fanout_t *request = (const esp_ncp_zb_fanout_t *)input;
+    uint16_t size = esp_ncp_frame_caps()->max_frame_size;
+    esp_zb_zcl_config_report_record_t *record_field = NULL;
+    esp_ncp_status_t status = ESP_NCP_ERR_FATAL;
+    uint8_t *change = NULL;
+    uint16_t len = 0;
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(request->field_number && request->target_count, ESP_ERR_INVALID_ARG, TAG, "Empty bulk report config");
+    ESP_RETURN_ON_FALSE(size > sizeof(esp_ncp_zb_fanout_result_t) + sizeof(esp_ncp_zb_fanout_record_t), ESP_ERR_INVALID_SIZE, TAG,
+                        "Frame too small for the bulk report config");
+    ESP_RETURN_ON_ERROR(esp_ncp_zb_report_config_parse(input + sizeof(esp_ncp_zb_fanout_t), inlen - sizeof(esp_ncp_zb_fanout_t),
+                                                       request->field_number, &record_field, &change, &len), TAG, "Invalid reporting records");
+
+    if (inlen != sizeof(esp_ncp_zb_fanout_t) + len + request->target_count * sizeof(esp_ncp_zb_fanout_target_t)) {
+        ESP_LOGE(TAG, "Invalid bulk report config length %d", inlen);
+        free(record_field);
+        free(change);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* Every target is configured with the same records, the requests are paced like the fan-out read */
+    ret = esp_ncp_zb_fanout_start(ESP_NCP_ZCL_REPORT_CONFIG_BULK, request, record_field, change,
+                                  (const esp_ncp_zb_fanout_target_t *)(input + sizeof(esp_ncp_zb_fanout_t) + len));
+    status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
 static esp_err_t esp_ncp_zb_write_attr_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
 {
     typedef struct {
@@ -1586,9 +2800,15 @@ static esp_err_t esp_ncp_zb_find_match_fn(const uint8_t *input, uint16_t inlen,
             .cluster_list = (inlen != sizeof(esp_zb_zdo_match_desc_t)) ? (uint16_t *)(input + sizeof(esp_zb_zdo_match_desc_t)) : NULL,
         };
 
-        uint32_t *user_ctx = calloc(1, sizeof(esp_ncp_zb_user_cb_t));
+        esp_ncp_zb_find_ctx_t *user_ctx = calloc(1, sizeof(esp_ncp_zb_find_ctx_t));
         if (user_ctx) {
-            memcpy(user_ctx, input, sizeof(esp_ncp_zb_user_cb_t));
+            memcpy(&user_ctx->zdo_cb, input, sizeof(esp_ncp_zb_user_cb_t));
+            user_ctx->profile_id = zdo_data->profile_id;
+            if (desc_req.cluster_list) {
+                user_ctx->cluster_count = MIN(zdo_data->num_in_clusters + zdo_data->num_out_clusters, ESP_NCP_NODE_CLUSTER_NUM);
+                user_ctx->cluster_count = MIN(user_ctx->cluster_count, (inlen - sizeof(esp_zb_zdo_match_desc_t)) / sizeof(uint16_t));
+                memcpy(user_ctx->cluster_list, desc_req.cluster_list, user_ctx->cluster_count * sizeof(uint16_t));
+            }
         }
 
         ret = esp_zb_zdo_match_cluster(&desc_req, esp_ncp_zb_find_match_cb, user_ctx);
@@ -1603,52 +2823,194 @@ static esp_err_t esp_ncp_zb_find_match_fn(const uint8_t *input, uint16_t inlen,
     return ret;
 }
 
+static esp_err_t esp_ncp_zb_aps_data_request(const esp_zb_aps_data_t *aps_data, const uint8_t *asdu)
+{
+    esp_zb_apsde_data_req_t data_req = {
+        .dst_addr_mode  = aps_data->dst_addr_mode,
+        .dst_short_addr = aps_data->basic_cmd.dst_addr_u.addr_short,
+        .dst_endpoint   = aps_data->basic_cmd.dst_endpoint,
+        .src_endpoint   = aps_data->basic_cmd.src_endpoint,
+        .profile_id     = aps_data->profile_id,
+        .cluster_id     = aps_data->cluster_id,
+        .tx_options     = aps_data->tx_options,
+        .use_alias      = aps_data->use_alias,
+        .alias_src_addr = aps_data->alias_src_addr.addr_short,
+        .alias_seq_num  = aps_data->alias_seq_num,
+        .radius         = aps_data->radius,
+        .asdu_length    = aps_data->asdu_length,
+        .asdu           = aps_data->asdu_length ? (uint8_t *)asdu : NULL,
+    };
+
+    ESP_LOGI(TAG, "dst_addr_mode %0x, dst_short_addr %02x, dst_endpoint %0x, src_endpoint %0x, profile_id %02x, cluster_id %02x, tx_options %02x, use_alias %02x, radius %0x",
+                    data_req.dst_addr_mode, data_req.dst_short_addr, data_req.dst_endpoint, data_req.src_endpoint, data_req.profile_id, data_req.cluster_id,
+                    data_req.tx_options, data_req.use_alias, data_req.radius);
+
+    if (data_req.asdu && data_req.asdu_length) {
+        ESP_LOG_BUFFER_HEX_LEVEL(TAG, data_req.asdu, data_req.asdu_length, ESP_LOG_DEBUG);
+    }
+
+    esp_zb_aps_data_indication_handler_register(esp_ncp_zb_aps_data_indication_handler);
+    esp_zb_aps_data_confirm_handler_register(esp_ncp_zb_aps_data_confirm_handler);
+    return esp_zb_aps_data_request(&data_req);
+}
+
 static esp_err_t esp_ncp_zb_aps_data_request_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
 {
     esp_err_t ret = input ? ESP_OK : ESP_ERR_INVALID_ARG;
 
+    if (input) {
+        ret = esp_ncp_zb_aps_data_request((const esp_zb_aps_data_t *)input, input + sizeof(esp_zb_aps_data_t));
+    }
+
+    esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
+static esp_err_t esp_ncp_zb_aps_data_chunk_begin_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
     typedef struct {
-        esp_zb_zcl_basic_cmd_t basic_cmd;                       /*!< Basic command info */
-        uint8_t  dst_addr_mode;                                 /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
-        uint16_t profile_id;                                    /*!< Profile id */
-        uint16_t cluster_id;                                    /*!< Cluster id */
-        uint8_t tx_options;                                     /*!< The transmission options for the ASDU to be transferred, refer to esp_zb_apsde_tx_opt_t */
-        bool use_alias;                                         /*!< The next higher layer may use the UseAlias parameter to request alias usage by NWK layer for the current frame.*/
-        esp_zb_addr_u alias_src_addr;                           /*!< The source address to be used for this NSDU. If the use_alias is true */
-        uint8_t alias_seq_num;                                  /*!< The sequence number to be used for this NSDU. If the use_alias is true */
-        uint8_t radius;                                         /*!< The distance, in hops, that a transmitted frame will be allowed to travel through the network.*/
-        uint32_t asdu_length;                                   /*!< The number of octets comprising the ASDU to be transferred */
-    } ESP_NCP_ZB_PACKED_STRUCT esp_zb_aps_data_t;
+        uint8_t status;                                         /*!< The status of the transfer, refer to esp_ncp_status_t */
+        esp_ncp_zb_aps_chunk_begin_t begin;                     /*!< The negotiated parameters of the transfer */
+    } ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_chunk_begin_rsp_t;
 
-    if (input) {
-        esp_zb_aps_data_t *aps_data = (esp_zb_aps_data_t *)input;
-        esp_zb_apsde_data_req_t data_req = {
-            .dst_addr_mode  = aps_data->dst_addr_mode,
-            .dst_short_addr = aps_data->basic_cmd.dst_addr_u.addr_short,
-            .dst_endpoint   = aps_data->basic_cmd.dst_endpoint,
-            .src_endpoint   = aps_data->basic_cmd.src_endpoint,
-            .profile_id     = aps_data->profile_id,
-            .cluster_id     = aps_data->cluster_id,
-            .tx_options     = aps_data->tx_options,
-            .use_alias      = aps_data->use_alias,
-            .alias_src_addr = aps_data->alias_src_addr.addr_short,
-            .alias_seq_num  = aps_data->alias_seq_num,
-            .radius         = aps_data->radius,
-            .asdu_length    = aps_data->asdu_length,
-            .asdu           = aps_data->asdu_length ? (uint8_t *)(input + sizeof(esp_zb_aps_data_t)) : NULL,
-        };
+    esp_ncp_zb_aps_chunk_session_t *session = NULL;
+    esp_ncp_zb_aps_chunk_begin_rsp_t begin_rsp = {
+        .status = ESP_NCP_BAD_ARGUMENT,
+    };
+
+    if (input && inlen >= sizeof(esp_ncp_zb_aps_chunk_begin_t) + sizeof(esp_zb_aps_data_t)) {
+        const esp_ncp_zb_aps_chunk_begin_t *begin = (const esp_ncp_zb_aps_chunk_begin_t *)input;
+        session = esp_ncp_zb_aps_chunk_session_alloc(false, begin->chunk.total_length);
+        if (session) {
+            memcpy(&session->desc.req, input + sizeof(esp_ncp_zb_aps_chunk_begin_t), sizeof(esp_zb_aps_data_t));
+            session->desc.req.asdu_length = session->total_length;
+            if (begin->chunk_size) {
+                session->chunk_size = MIN(session->chunk_size, begin->chunk_size);
+            }
+            if (begin->window) {
+                session->window = MIN(session->window, begin->window);
+            }
+            begin_rsp.status = ESP_NCP_SUCCESS;
+            begin_rsp.begin.chunk.session = esp_ncp_zb_aps_chunk_session_handle(session);
+            begin_rsp.begin.chunk.total_length = session->total_length;
+            begin_rsp.begin.chunk_size = session->chunk_size;
+            begin_rsp.begin.window = session->window;
+        } else {
+            begin_rsp.status = ESP_NCP_ERR_NO_MEM;
+        }
+    }
+
+    *output = calloc(1, sizeof(esp_ncp_zb_aps_chunk_begin_rsp_t));
+    if (!*output) {
+        if (session) {
+            esp_ncp_zb_aps_chunk_session_free(session);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    *outlen = sizeof(esp_ncp_zb_aps_chunk_begin_rsp_t);
+    memcpy(*output, &begin_rsp, *outlen);
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_aps_data_chunk_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    esp_ncp_zb_aps_chunk_session_t *session = NULL;
+    esp_ncp_zb_aps_chunk_ack_t chunk_ack = {
+        .status = ESP_NCP_BAD_ARGUMENT,
+    };
+
+    if (!input || inlen < sizeof(esp_ncp_zb_aps_chunk_t)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const esp_ncp_zb_aps_chunk_t *chunk = (const esp_ncp_zb_aps_chunk_t *)input;
+    uint16_t len = inlen - sizeof(esp_ncp_zb_aps_chunk_t);
+
+    chunk_ack.session = chunk->session;
+    session = esp_ncp_zb_aps_chunk_session_get(chunk->session, false);
+    if (!session) {
+        /* Most chunks are not answered, the host waiting for the window end gives up on its timeout */
+        ESP_LOGD(TAG, "Drop the APS data chunk of the unknown session %d", chunk->session);
+        return ESP_ERR_NOT_FINISHED;
+    }
 
-        ESP_LOGI(TAG, "dst_addr_mode %0x, dst_short_addr %02x, dst_endpoint %0x, src_endpoint %0x, profile_id %02x, cluster_id %02x, tx_options %02x, use_alias %02x, radius %0x",
-                        data_req.dst_addr_mode, data_req.dst_short_addr, data_req.dst_endpoint, data_req.src_endpoint, data_req.profile_id, data_req.cluster_id,
-                        data_req.tx_options, data_req.use_alias, data_req.radius);
+    /* Only the chunk in sequence is accepted, the host resends from the acknowledged offset on a gap */
+    if (chunk->offset == session->offset && len <= session->chunk_size && chunk->offset + len <= session->total_length) {
+        memcpy(esp_ncp_zb_aps_chunk_session_buffer(session) + chunk->offset, input + sizeof(esp_ncp_zb_aps_chunk_t), len);
+        session->offset += len;
+        session->tick = xTaskGetTickCount();
+    }
+    chunk_ack.status = ESP_NCP_SUCCESS;
+    chunk_ack.offset = session->offset;
+    if (!esp_ncp_zb_aps_chunk_need_ack(session, chunk->offset, len)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    *output = calloc(1, sizeof(esp_ncp_zb_aps_chunk_ack_t));
+    if (!*output) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    *outlen = sizeof(esp_ncp_zb_aps_chunk_ack_t);
+    memcpy(*output, &chunk_ack, *outlen);
+
+    return ESP_OK;
+}
 
-        if (data_req.asdu && data_req.asdu_length) {
-            ESP_LOG_BUFFER_HEX_LEVEL(TAG, data_req.asdu, data_req.asdu_length, ESP_LOG_DEBUG);
+static esp_err_t esp_ncp_zb_aps_data_chunk_end_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (input && inlen >= sizeof(esp_ncp_zb_aps_chunk_t)) {
+        const esp_ncp_zb_aps_chunk_t *chunk = (const esp_ncp_zb_aps_chunk_t *)input;
+        esp_ncp_zb_aps_chunk_session_t *session = esp_ncp_zb_aps_chunk_session_get(chunk->session, false);
+        if (session) {
+            if (session->offset == session->total_length) {
+                esp_ncp_zb_aps_chunk_confirm_t *confirm = esp_ncp_zb_aps_chunk_confirm_add(&session->desc.req);
+                ret = esp_ncp_zb_aps_data_request(&session->desc.req, esp_ncp_zb_aps_chunk_session_buffer(session));
+                if (ret != ESP_OK) {
+                    esp_ncp_zb_aps_chunk_confirm_remove(confirm);
+                }
+            } else {
+                ret = ESP_ERR_INVALID_SIZE;
+            }
+            esp_ncp_zb_aps_chunk_session_free(session);
         }
+    }
+
+    esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
 
-        esp_zb_aps_data_indication_handler_register(esp_ncp_zb_aps_data_indication_handler);
-        esp_zb_aps_data_confirm_handler_register(esp_ncp_zb_aps_data_confirm_handler);
-        ret = esp_zb_aps_data_request(&data_req);
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
+static esp_err_t esp_ncp_zb_aps_data_chunk_ack_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (input && inlen >= sizeof(esp_ncp_zb_aps_chunk_ack_t)) {
+        const esp_ncp_zb_aps_chunk_ack_t *chunk_ack = (const esp_ncp_zb_aps_chunk_ack_t *)input;
+        esp_ncp_zb_aps_chunk_session_t *session = esp_ncp_zb_aps_chunk_session_get(chunk_ack->session, true);
+        if (session) {
+            if (chunk_ack->status != ESP_NCP_SUCCESS) {
+                ESP_LOGW(TAG, "The host aborts the APS data chunk session %d with status %d", chunk_ack->session, chunk_ack->status);
+                esp_ncp_zb_aps_chunk_session_free(session);
+                ret = ESP_OK;
+            } else if (chunk_ack->offset <= session->total_length) {
+                /* Go back to the acknowledged offset, the chunks after it have been dropped by the host */
+                session->acked = chunk_ack->offset;
+                session->offset = chunk_ack->offset;
+                session->tick = xTaskGetTickCount();
+                esp_ncp_zb_aps_chunk_send_window(session);
+                ret = ESP_OK;
+            }
+        }
     }
 
     esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
@@ -1702,6 +3064,137 @@ static esp_err_t esp_ncp_zb_aps_data_confirm_fn(const uint8_t *input, uint16_t i
     return (*output) ? ESP_OK : ESP_ERR_NO_MEM;
 }
 
+static esp_err_t esp_ncp_zb_system_hello_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_frame_caps_t), ESP_ERR_INVALID_ARG, TAG, "Invalid hello length %d", inlen);
+
+    *output = calloc(1, sizeof(esp_ncp_frame_caps_t));
+    ESP_RETURN_ON_FALSE(*output, ESP_ERR_NO_MEM, TAG, "Malloc hello fail");
+
+    /* Answer the local capabilities, the link switches to the negotiated mode before the answer is sent */
+    esp_ncp_frame_caps_get((esp_ncp_frame_caps_t *)*output);
+    *outlen = sizeof(esp_ncp_frame_caps_t);
+
+    return esp_ncp_frame_caps_negotiate((const esp_ncp_frame_caps_t *)input);
+}
+
+static esp_err_t esp_ncp_zb_ota_server_notify_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (input && inlen >= sizeof(esp_ncp_zb_ota_image_t)) {
+        const esp_ncp_zb_ota_image_t *image = (const esp_ncp_zb_ota_image_t *)input;
+        if (!s_ota_lock) {
+            s_ota_lock = xSemaphoreCreateMutex();
+        }
+        if (!s_ota_lock) {
+            ret = ESP_ERR_NO_MEM;
+        } else if (image->index < NCP_OTA_IMAGE_NUM && image->image_size) {
+            xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+            /* The image registered again may differ, drop the data prefetched from it */
+            for (int i = 0; i < CONFIG_NCP_OTA_SESSION_NUM; i ++) {
+                if (s_ota_session[i].in_use && s_ota_session[i].index == image->index) {
+                    esp_ncp_zb_ota_session_reset(&s_ota_session[i], image->index);
+                }
+            }
+            memcpy(&s_ota_image[image->index], image, sizeof(esp_ncp_zb_ota_image_t));
+            xSemaphoreGive(s_ota_lock);
+            ret = esp_ncp_zb_ota_server_register(image, image->notify_on);
+        }
+    }
+
+    esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
+static esp_err_t esp_ncp_zb_ota_server_block_data_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_ota_block_t) && s_ota_lock, ESP_ERR_INVALID_ARG, TAG, "Invalid OTA block data");
+
+    const esp_ncp_zb_ota_block_t *block = (const esp_ncp_zb_ota_block_t *)input;
+    ESP_RETURN_ON_FALSE(block->size <= inlen - sizeof(esp_ncp_zb_ota_block_t), ESP_ERR_INVALID_SIZE, TAG, "Invalid OTA block size %d", block->size);
+
+    xSemaphoreTake(s_ota_lock, portMAX_DELAY);
+    esp_ncp_zb_ota_session_t *session = esp_ncp_zb_ota_session_get(block->short_addr, false);
+    if (session && session->index == block->index) {
+        if (!block->size) {
+            session->failed = true;
+        } else if (block->offset == session->base + session->filled && session->filled + block->size <= CONFIG_NCP_OTA_CACHE_SIZE) {
+            memcpy(session->cache + session->filled, input + sizeof(esp_ncp_zb_ota_block_t), block->size);
+            session->filled += block->size;
+        }
+        /* Otherwise the data was requested before the client moved in the image, drop it */
+    }
+    xSemaphoreGive(s_ota_lock);
+
+    /* The host streams the data without waiting for the answer */
+    return ESP_ERR_NOT_FINISHED;
+}
+
+static esp_err_t esp_ncp_zb_node_table_dump_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    uint16_t size = esp_ncp_frame_caps()->max_frame_size;
+    uint16_t len = 0;
+    uint16_t next_index = ESP_NCP_NODE_INDEX_END;
+    uint8_t count = 0;
+    esp_ncp_zb_node_page_t *page = NULL;
+
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_node_dump_t), ESP_ERR_INVALID_ARG, TAG, "Invalid node table dump");
+    ESP_RETURN_ON_FALSE(size > sizeof(esp_ncp_zb_node_page_t), ESP_ERR_INVALID_SIZE, TAG, "Frame too small for the node table");
+
+    const esp_ncp_zb_node_dump_t *dump = (const esp_ncp_zb_node_dump_t *)input;
+    page = calloc(1, size);
+    ESP_RETURN_ON_FALSE(page, ESP_ERR_NO_MEM, TAG, "Malloc node table page fail");
+
+    esp_err_t ret = esp_ncp_node_table_dump(dump->index, dump->count, (uint8_t *)(page + 1), size - sizeof(esp_ncp_zb_node_page_t), &len,
+                                            &count, &next_index);
+    page->status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+    page->count = count;
+    page->next_index = next_index;
+
+    *output = (uint8_t *)page;
+    *outlen = sizeof(esp_ncp_zb_node_page_t) + len;
+
+    /* The failure is answered by the status of the page */
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_node_table_query_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    uint16_t size = esp_ncp_frame_caps()->max_frame_size;
+    uint16_t len = 0;
+    uint8_t *buffer = NULL;
+
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_ncp_zb_node_query_t), ESP_ERR_INVALID_ARG, TAG, "Invalid node table query");
+    ESP_RETURN_ON_FALSE(size > sizeof(uint8_t), ESP_ERR_INVALID_SIZE, TAG, "Frame too small for the node table");
+
+    const esp_ncp_zb_node_query_t *query = (const esp_ncp_zb_node_query_t *)input;
+    buffer = calloc(1, size);
+    ESP_RETURN_ON_FALSE(buffer, ESP_ERR_NO_MEM, TAG, "Malloc node table query fail");
+
+    esp_err_t ret = esp_ncp_node_table_query(query->short_addr, query->ieee_addr, buffer + sizeof(uint8_t), size - sizeof(uint8_t), &len);
+    buffer[0] = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    *output = buffer;
+    *outlen = sizeof(uint8_t) + len;
+
+    /* The node not found is answered by the status, followed by no node */
+    return ESP_OK;
+}
+
+static esp_err_t esp_ncp_zb_node_table_clear_fn(const uint8_t *input, uint16_t inlen, uint8_t **output, uint16_t *outlen)
+{
+    esp_err_t ret = esp_ncp_node_table_clear();
+    esp_ncp_status_t status = (ret == ESP_OK) ? ESP_NCP_SUCCESS : ESP_NCP_ERR_FATAL;
+
+    ESP_NCP_ZB_STATUS();
+
+    return ret;
+}
+
 static const esp_ncp_zb_func_t ncp_zb_func_table[] = {
     {ESP_NCP_NETWORK_INIT, esp_ncp_zb_network_init_fn},
     {ESP_NCP_NETWORK_PAN_ID_SET, esp_ncp_zb_pan_id_set_fn},
@@ -1754,22 +3247,35 @@ static const esp_ncp_zb_func_t ncp_zb_func_table[] = {
     {ESP_NCP_ZCL_ATTR_DISC, esp_ncp_zb_disc_attr_fn},
     {ESP_NCP_ZCL_READ, esp_ncp_zb_zcl_read_fn},
     {ESP_NCP_ZCL_WRITE, esp_ncp_zb_zcl_write_fn},
-    {ESP_NCP_ZCL_REPORT_CONFIG, NULL},
+    {ESP_NCP_ZCL_REPORT_CONFIG, esp_ncp_zb_report_config_fn},
+    {ESP_NCP_ZCL_ATTR_READ_FANOUT, esp_ncp_zb_read_attr_fanout_fn},
+    {ESP_NCP_ZCL_REPORT_CONFIG_BULK, esp_ncp_zb_report_config_bulk_fn},
     {ESP_NCP_ZDO_BIND_SET, esp_ncp_zb_set_bind_fn},
     {ESP_NCP_ZDO_UNBIND_SET, esp_ncp_zb_set_unbind_fn},
     {ESP_NCP_ZDO_FIND_MATCH, esp_ncp_zb_find_match_fn},
     {ESP_NCP_APS_DATA_REQUEST, esp_ncp_zb_aps_data_request_fn},
     {ESP_NCP_APS_DATA_INDICATION, esp_ncp_zb_aps_data_indication_fn},
     {ESP_NCP_APS_DATA_CONFIRM, esp_ncp_zb_aps_data_confirm_fn},
+    {ESP_NCP_APS_DATA_CHUNK_BEGIN, esp_ncp_zb_aps_data_chunk_begin_fn},
+    {ESP_NCP_APS_DATA_CHUNK, esp_ncp_zb_aps_data_chunk_fn},
+    {ESP_NCP_APS_DATA_CHUNK_END, esp_ncp_zb_aps_data_chunk_end_fn},
+    {ESP_NCP_APS_DATA_CHUNK_ACK, esp_ncp_zb_aps_data_chunk_ack_fn},
+    {ESP_NCP_SYSTEM_HELLO, esp_ncp_zb_system_hello_fn},
+    {ESP_NCP_OTA_SERVER_NOTIFY, esp_ncp_zb_ota_server_notify_fn},
+    {ESP_NCP_OTA_SERVER_BLOCK_DATA, esp_ncp_zb_ota_server_block_data_fn},
+    {ESP_NCP_NODE_TABLE_DUMP, esp_ncp_zb_node_table_dump_fn},
+    {ESP_NCP_NODE_TABLE_QUERY, esp_ncp_zb_node_table_query_fn},
+    {ESP_NCP_NODE_TABLE_CLEAR, esp_ncp_zb_node_table_clear_fn},
 };
 
 esp_err_t esp_ncp_zb_output(esp_ncp_header_t *ncp_header, const void *buffer, uint16_t len)
 {
     uint8_t *output = NULL;
     uint16_t outlen = 0;
-    esp_err_t ret = ESP_OK;
+    /* Answer an error for the unknown frame ID, e.g. a newer host probes the capabilities */
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
 
-    for (int i = 0; i <= sizeof(ncp_zb_func_table) / sizeof(ncp_zb_func_table[0]); i ++) {
+    for (int i = 0; i < sizeof(ncp_zb_func_table) / sizeof(ncp_zb_func_table[0]); i ++) {
         if (ncp_header->id != ncp_zb_func_table[i].id) {
             continue;
         }
@@ -1778,6 +3284,9 @@ esp_err_t esp_ncp_zb_output(esp_ncp_header_t *ncp_header, const void *buffer, ui
             ret = ncp_zb_func_table[i].set_func(buffer, len, &output, &outlen);
             if (ret == ESP_OK) {
                 esp_ncp_resp_input(ncp_header, output, outlen);
+            } else if (ret == ESP_ERR_NOT_FINISHED) {
+                /* The frame is acknowledged later together with others, e.g. the chunk inside a window */
+                ret = ESP_OK;
             }
         } else {
             ret = ESP_ERR_INVALID_ARG;
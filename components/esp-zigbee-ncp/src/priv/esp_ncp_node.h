@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_NCP_NODE_EP_NUM         4           /*!< The maximum number of the endpoints kept for a node */
+#define ESP_NCP_NODE_CLUSTER_NUM    8           /*!< The maximum number of the clusters kept for an endpoint */
+#define ESP_NCP_NODE_INDEX_END      0xFFFF      /*!< The next index of the last page */
+
+/**
+ * @brief   Load the node table from the NVS.
+ *
+ * @note It is called once the Zigbee platform is configured, the nodes are not seen since the NCP boots until they talk again.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ *
+ */
+esp_err_t esp_ncp_node_table_init(void);
+
+/**
+ * @brief   Add or refresh a node on its device announcement.
+ *
+ * @note The node already known by the IEEE address keeps its endpoints, only the short address is updated.
+ *
+ * @param[in] short_addr The short address of the node
+ * @param[in] ieee_addr  The IEEE address of the node
+ * @param[in] capability The MAC capability of the node
+ *
+ */
+void esp_ncp_node_table_announce(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t capability);
+
+/**
+ * @brief   Remove a node which leaves the network.
+ *
+ * @param[in] ieee_addr  The IEEE address of the node
+ *
+ */
+void esp_ncp_node_table_leave(const uint8_t ieee_addr[8]);
+
+/**
+ * @brief   Record an endpoint of a node from the match descriptor result.
+ *
+ * @note The clusters are merged into the ones already known for the endpoint, the extra clusters are dropped.
+ *
+ * @param[in] short_addr    The short address of the node
+ * @param[in] endpoint      The endpoint identifier
+ * @param[in] profile_id    The profile identifier of the endpoint
+ * @param[in] cluster_list  The clusters matched on the endpoint
+ * @param[in] cluster_count The number of the clusters
+ *
+ */
+void esp_ncp_node_table_endpoint(uint16_t short_addr, uint8_t endpoint, uint16_t profile_id, const uint16_t *cluster_list, uint8_t cluster_count);
+
+/**
+ * @brief   Update the LQI and the last seen time of a known node.
+ *
+ * @note The LQI and the last seen time are kept in the memory only, they are not saved to the NVS.
+ *
+ * @param[in] short_addr The short address of the node
+ * @param[in] lqi        The LQI of the frame received, negative if unknown
+ *
+ */
+void esp_ncp_node_table_seen(uint16_t short_addr, int lqi);
+
+/**
+ * @brief   Dump a page of the node table in the wire format, refer to esp_ncp_zb_node_t.
+ *
+ * @param[in]  index      The slot to start from
+ * @param[in]  max_count  The maximum number of the nodes, 0 for as many as fit in the buffer
+ * @param[out] buffer     The buffer to store the nodes
+ * @param[in]  size       The size of the buffer
+ * @param[out] len        The bytes of the nodes stored
+ * @param[out] count      The number of the nodes stored
+ * @param[out] next_index The slot to start the next page from, ESP_NCP_NODE_INDEX_END if it is the last page
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_INVALID_SIZE: The buffer could not hold a single node
+ *
+ */
+esp_err_t esp_ncp_node_table_dump(uint16_t index, uint8_t max_count, uint8_t *buffer, uint16_t size, uint16_t *len, uint8_t *count, uint16_t *next_index);
+
+/**
+ * @brief   Query a node in the wire format by its short address or, if the short address is 0xFFFF, by its IEEE address.
+ *
+ * @param[in]  short_addr The short address of the node
+ * @param[in]  ieee_addr  The IEEE address of the node
+ * @param[out] buffer     The buffer to store the node
+ * @param[in]  size       The size of the buffer
+ * @param[out] len        The bytes of the node stored
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_NOT_FOUND: The node is not in the table
+ *    - ESP_ERR_INVALID_SIZE: The buffer could not hold the node
+ *
+ */
+esp_err_t esp_ncp_node_table_query(uint16_t short_addr, const uint8_t ieee_addr[8], uint8_t *buffer, uint16_t size, uint16_t *len);
+
+/**
+ * @brief   Remove all the nodes from the table and the NVS.
+ *
+ * @note The NVS is erased in the background right after, by the same task that saves the changes.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ *
+ */
+esp_err_t esp_ncp_node_table_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
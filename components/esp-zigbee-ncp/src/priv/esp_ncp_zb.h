@@ -59,6 +59,250 @@ typedef struct {
     uint32_t user_ctx;                  /*!< User information context */
 } esp_ncp_zb_user_cb_t;
 
+/**
+ * @brief Type to represent the chunk header of a large APS data transfer.
+ *
+ */
+typedef struct {
+    uint8_t     session;                                /*!< The session handle of the chunked transfer */
+    uint32_t    total_length;                           /*!< The total length of the ASDU */
+    uint32_t    offset;                                 /*!< The offset of this chunk in the ASDU */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_chunk_t;
+
+/**
+ * @brief Type to represent the parameters to begin a large APS data transfer.
+ *
+ */
+typedef struct {
+    esp_ncp_zb_aps_chunk_t chunk;                       /*!< The chunk header, the offset is always 0 */
+    uint16_t    chunk_size;                             /*!< The maximum payload length of one chunk */
+    uint8_t     window;                                 /*!< The number of chunks could be sent before waiting for the acknowledgement */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_chunk_begin_t;
+
+/**
+ * @brief Type to represent the acknowledgement of a large APS data transfer.
+ *
+ */
+typedef struct {
+    uint8_t     status;                                 /*!< The status of the transfer, refer to esp_ncp_status_t */
+    uint8_t     session;                                /*!< The session handle of the chunked transfer */
+    uint32_t    offset;                                 /*!< The offset of the next expected chunk, all the data before it has been received */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_aps_chunk_ack_t;
+
+/**
+ * @brief Type to represent the ZCL command information on the wire, followed by the command payload.
+ *
+ * @note It is filled field by field from esp_zb_zcl_cmd_info_t, the host parses it with the same layout.
+ *
+ */
+typedef struct {
+    uint8_t     status;                                 /*!< The status of the command, refer to esp_zb_zcl_status_t */
+    uint8_t     fc;                                     /*!< The frame control of the ZCL header */
+    uint16_t    manuf_code;                             /*!< The manufacturer code */
+    uint8_t     tsn;                                    /*!< The transaction sequence number */
+    int8_t      rssi;                                   /*!< The signal strength */
+    uint8_t     addr_type;                              /*!< The type of the source address, refer to ESP_ZB_ZCL_ADDR_TYPE_SHORT */
+    uint8_t     src_addr[8];                            /*!< The source address, the short address is in the first two bytes */
+    uint16_t    dst_address;                            /*!< The destination short address */
+    uint8_t     src_endpoint;                           /*!< The source endpoint */
+    uint8_t     dst_endpoint;                           /*!< The destination endpoint */
+    uint16_t    cluster;                                /*!< The cluster identifier */
+    uint16_t    profile;                                /*!< The profile identifier */
+    uint8_t     cmd_id;                                 /*!< The command identifier */
+    uint8_t     direction;                              /*!< The command direction */
+    uint8_t     is_common;                              /*!< The command is a common command */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_zcl_cmd_info_t;
+
+/**
+ * @brief Type to represent the source of the attribute report on the wire, followed by the attribute.
+ *
+ */
+typedef struct {
+    uint8_t     status;                                 /*!< The status of the report, refer to esp_zb_zcl_status_t */
+    uint8_t     addr_type;                              /*!< The type of the source address, refer to ESP_ZB_ZCL_ADDR_TYPE_SHORT */
+    uint8_t     src_addr[8];                            /*!< The source address, the short address is in the first two bytes */
+    uint8_t     src_endpoint;                           /*!< The source endpoint */
+    uint8_t     dst_endpoint;                           /*!< The destination endpoint */
+    uint16_t    cluster;                                /*!< The cluster identifier */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_zcl_report_attr_t;
+
+/**
+ * @brief Type to represent an attribute reported or read on the wire, followed by the value.
+ *
+ */
+typedef struct {
+    uint16_t    id;                                     /*!< The attribute identifier */
+    uint8_t     type;                                   /*!< The type of the attribute, refer to esp_zb_zcl_attr_type_t */
+    uint8_t     size;                                   /*!< The size of the value */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_zcl_attr_t;
+
+/**
+ * @brief Type to represent an OTA image registered by the host, the image data stays on the host.
+ *
+ */
+typedef struct {
+    uint8_t     endpoint;                               /*!< The endpoint of the OTA upgrade server cluster */
+    uint8_t     index;                                  /*!< The index of the OTA image */
+    uint8_t     notify_on;                              /*!< Send the image notify to the clients directly */
+    uint32_t    ota_upgrade_time;                       /*!< The time the clients upgrade after the download */
+    uint16_t    manufacturer_code;                      /*!< The manufacturer code of the OTA image */
+    uint16_t    image_type;                             /*!< The image type of the OTA image */
+    uint32_t    file_version;                           /*!< The file version of the OTA image */
+    uint32_t    image_size;                             /*!< The size of the OTA image in bytes */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_ota_image_t;
+
+/**
+ * @brief Type to represent a range of the OTA image data prefetched from the host.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the OTA client the data is prefetched for */
+    uint8_t     index;                                  /*!< The index of the OTA image */
+    uint32_t    offset;                                 /*!< The offset of the data in the OTA image */
+    uint16_t    size;                                   /*!< The size of the data, 0 in the answer if the host fails to read it */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_ota_block_t;
+
+/**
+ * @brief Type to represent the status of an OTA client transfer reported to the host.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the OTA client */
+    uint8_t     index;                                  /*!< The index of the OTA image */
+    uint8_t     status;                                 /*!< The status of the OTA upgrade server, refer to esp_zb_ota_upgrade_server_status_t */
+    uint32_t    offset;                                 /*!< The bytes of the OTA image served to the client */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_ota_status_t;
+
+/**
+ * @brief Type to represent the request to dump a page of the node table.
+ *
+ */
+typedef struct {
+    uint16_t    index;                                  /*!< The slot of the node table to start from, 0 for the first page */
+    uint8_t     count;                                  /*!< The maximum number of the nodes in the page, 0 for as many as fit in the frame */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_node_dump_t;
+
+/**
+ * @brief Type to represent a page of the node table, followed by the nodes.
+ *
+ */
+typedef struct {
+    uint8_t     status;                                 /*!< The status of the dump, refer to esp_ncp_status_t */
+    uint16_t    next_index;                             /*!< The slot to start the next page from, 0xFFFF if it is the last page */
+    uint8_t     count;                                  /*!< The number of the nodes in the page */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_node_page_t;
+
+/**
+ * @brief Type to represent the request to query a node, it is looked up by the IEEE address if the short address is 0xFFFF.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the node */
+    uint8_t     ieee_addr[8];                           /*!< The IEEE address of the node */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_node_query_t;
+
+/**
+ * @brief Type to represent a node in the node table, followed by the endpoints.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the node */
+    uint8_t     ieee_addr[8];                           /*!< The IEEE address of the node */
+    uint8_t     capability;                             /*!< The MAC capability of the node from the device announcement */
+    uint8_t     lqi;                                    /*!< The LQI of the last frame received from the node */
+    uint32_t    age;                                    /*!< The seconds since the node was last seen, 0xFFFFFFFF if not seen since the NCP boots */
+    uint8_t     ep_count;                               /*!< The number of the endpoints */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_node_t;
+
+/**
+ * @brief Type to represent an endpoint of a node, followed by the cluster list.
+ *
+ */
+typedef struct {
+    uint8_t     endpoint;                               /*!< The endpoint identifier */
+    uint16_t    profile_id;                             /*!< The profile identifier of the endpoint */
+    uint8_t     cluster_count;                          /*!< The number of the clusters discovered on the endpoint */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_node_ep_t;
+
+/**
+ * @brief Type to represent the request sent to many nodes, followed by the attribute list or the reporting records and the target list.
+ *
+ */
+typedef struct {
+    uint8_t     handle;                                 /*!< The handle chosen by the host to match the results */
+    uint8_t     src_endpoint;                           /*!< The source endpoint of the requests */
+    uint16_t    cluster_id;                             /*!< The cluster to read or to configure */
+    uint16_t    interval_ms;                            /*!< The interval between two requests, 0 for the default */
+    uint16_t    timeout_ms;                             /*!< The time to wait for the response of a target, 0 for the default */
+    uint8_t     field_number;                           /*!< The number of the attributes to read or the reporting records */
+    uint16_t    target_count;                           /*!< The number of the targets in the target list */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_t;
+
+/**
+ * @brief Type to represent a target of the fan-out request.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the target */
+    uint8_t     endpoint;                               /*!< The endpoint of the target */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_target_t;
+
+/**
+ * @brief Type to represent the results of the fan-out request, followed by the records.
+ *
+ */
+typedef struct {
+    uint8_t     handle;                                 /*!< The handle of the fan-out request */
+    uint16_t    cluster_id;                             /*!< The cluster read or configured */
+    uint8_t     count;                                  /*!< The number of the records */
+    uint8_t     done;                                   /*!< All the targets are answered or timed out with this notification */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_result_t;
+
+/**
+ * @brief Type to represent the result of a target, followed by the attributes.
+ *
+ */
+typedef struct {
+    uint16_t    short_addr;                             /*!< The short address of the target */
+    uint8_t     endpoint;                               /*!< The endpoint of the target */
+    uint8_t     status;                                 /*!< The status of the response, refer to esp_zb_zcl_status_t */
+    uint8_t     attr_count;                             /*!< The number of the attributes */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_record_t;
+
+/**
+ * @brief Type to represent an attribute of the result, followed by the value.
+ *
+ */
+typedef struct {
+    uint16_t    id;                                     /*!< The attribute identifier */
+    uint8_t     status;                                 /*!< The status of the attribute, refer to esp_zb_zcl_status_t */
+    uint8_t     type;                                   /*!< The type of the attribute, refer to esp_zb_zcl_attr_type_t */
+    uint16_t    size;                                   /*!< The size of the value */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_attr_t;
+
+/**
+ * @brief Type to represent the status of an attribute in the result of the reporting configuration.
+ *
+ */
+typedef struct {
+    uint8_t     status;                                 /*!< The status of the reporting configuration, refer to esp_zb_zcl_status_t */
+    uint8_t     direction;                              /*!< The direction of the reporting configuration */
+    uint16_t    attribute_id;                           /*!< The attribute identifier, 0xFFFF if all the attributes succeed */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_fanout_config_status_t;
+
+/**
+ * @brief Type to represent a reporting configuration record, followed by the reportable change.
+ *
+ */
+typedef struct {
+    uint8_t     direction;                              /*!< The direction of the reporting configuration */
+    uint16_t    attribute_id;                           /*!< The attribute identifier */
+    uint8_t     attr_type;                              /*!< The type of the attribute, refer to esp_zb_zcl_attr_type_t */
+    uint16_t    min_interval;                           /*!< The minimum reporting interval */
+    uint16_t    max_interval;                           /*!< The maximum reporting interval */
+    uint8_t     change_size;                            /*!< The size of the reportable change, 0 for the discrete attribute */
+} ESP_NCP_ZB_PACKED_STRUCT esp_ncp_zb_report_config_record_t;
+
 /** Definition of the frame ID on the NCP.
  *
  */
@@ -117,12 +361,28 @@ typedef struct {
 #define ESP_NCP_ZCL_READ                        0x0106  /*!< Read APS on NCP endpoints */
 #define ESP_NCP_ZCL_WRITE                       0x0107  /*!< Write APS on NCP endpoints */
 #define ESP_NCP_ZCL_REPORT_CONFIG               0x0108  /*!< Report configure on NCP endpoints */
+#define ESP_NCP_ZCL_ATTR_READ_FANOUT            0x0109  /*!< Read the attributes from many nodes with paced requests */
+#define ESP_NCP_ZCL_ATTR_READ_FANOUT_RESULT     0x010A  /*!< Notify the aggregated results of the fan-out read */
+#define ESP_NCP_ZCL_REPORT_CONFIG_BULK          0x010B  /*!< Configure the same reporting on many nodes with paced requests */
+#define ESP_NCP_ZCL_REPORT_CONFIG_BULK_RESULT   0x010C  /*!< Notify the aggregated results of the bulk reporting configuration */
 #define ESP_NCP_ZDO_BIND_SET                    0x0200  /*!< Create a binding between two endpoints on two nodes */
 #define ESP_NCP_ZDO_UNBIND_SET                  0x0201  /*!< Remove a binding between two endpoints on two nodes */
 #define ESP_NCP_ZDO_FIND_MATCH                  0x0202  /*!< Send match desc request to find matched Zigbee device */
 #define ESP_NCP_APS_DATA_REQUEST                0x0300  /*!< Request the aps data */
 #define ESP_NCP_APS_DATA_INDICATION             0x0301  /*!< Indication the aps data */
 #define ESP_NCP_APS_DATA_CONFIRM                0x0302  /*!< Confirm the aps data */
+#define ESP_NCP_APS_DATA_CHUNK_BEGIN            0x0303  /*!< Begin a chunked transfer of the large aps data */
+#define ESP_NCP_APS_DATA_CHUNK                  0x0304  /*!< Carry one chunk of the large aps data */
+#define ESP_NCP_APS_DATA_CHUNK_END              0x0305  /*!< End a chunked transfer of the large aps data */
+#define ESP_NCP_APS_DATA_CHUNK_ACK              0x0306  /*!< Acknowledge a window of the large aps data chunks */
+#define ESP_NCP_SYSTEM_HELLO                    0x0400  /*!< Exchange the protocol version and the capabilities with the host */
+#define ESP_NCP_OTA_SERVER_NOTIFY               0x0500  /*!< Register an OTA image stored on the host and notify the clients */
+#define ESP_NCP_OTA_SERVER_BLOCK_REQUEST        0x0501  /*!< Request the data of the OTA image from the host ahead of the clients */
+#define ESP_NCP_OTA_SERVER_BLOCK_DATA           0x0502  /*!< Carry the data of the OTA image requested from the host */
+#define ESP_NCP_OTA_SERVER_STATUS               0x0503  /*!< Notify the host when the transfer to an OTA client ends */
+#define ESP_NCP_NODE_TABLE_DUMP                 0x0600  /*!< Dump a page of the node table */
+#define ESP_NCP_NODE_TABLE_QUERY                0x0601  /*!< Query a node in the node table by its address */
+#define ESP_NCP_NODE_TABLE_CLEAR                0x0602  /*!< Clear the node table */
 
 /**
  * @brief   Process the frame ID on the NCP and response it to the host.
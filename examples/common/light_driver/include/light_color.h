@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee light driver example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* LED gamma curve in hundredths, the output is linear with 100 */
+#define LIGHT_COLOR_GAMMA_LINEAR    100
+
+/**
+* @brief Build the hue and gamma lookup tables, be invoked before any conversion
+*
+* @param  gamma  The LED gamma curve in hundredths, e.g. 220 for 2.2
+*/
+void light_color_init(uint16_t gamma);
+
+/**
+* @brief Convert color xy to RGB with the Q15 fixed-point matrix, no float operation is used
+*
+* @param  color_x  The color x in 1/65535
+* @param  color_y  The color y in 1/65535
+* @param  red      The red color converted
+* @param  green    The green color converted
+* @param  blue     The blue color converted
+*/
+void light_color_xy_to_rgb(uint16_t color_x, uint16_t color_y, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+/**
+* @brief Convert hue saturation to RGB with the hue lookup table, no float operation is used
+*
+* @param  hue    The hue to be converted
+* @param  sat    The sat to be converted
+* @param  red    The red color converted
+* @param  green  The green color converted
+* @param  blue   The blue color converted
+*/
+void light_color_hue_sat_to_rgb(uint8_t hue, uint8_t sat, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+/**
+* @brief Scale a color by the light level and apply the LED gamma curve, no float operation is used
+*
+* @param  color  The color to be scaled
+* @param  level  The light level
+*
+* @return The value to be set to the LED
+*/
+uint8_t light_color_level(uint8_t color, uint8_t level);
+
+/**
+* @brief Convert color xy to RGB with the float XYZ to RGB matrix, the negative colors are clamped to 0
+*/
+void light_color_xy_to_rgb_float(uint16_t color_x, uint16_t color_y, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+/**
+* @brief Convert hue saturation to RGB with the float HSV to RGB conversion
+*/
+void light_color_hue_sat_to_rgb_float(uint8_t hue, uint8_t sat, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+/**
+* @brief Scale a color by the float level ratio and apply the LED gamma curve
+*/
+uint8_t light_color_level_float(uint8_t color, uint8_t level);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -28,7 +28,37 @@ extern "C" {
 
 /* LED strip configuration */
 #define CONFIG_EXAMPLE_STRIP_LED_GPIO   8
+#ifndef CONFIG_EXAMPLE_STRIP_LED_NUMBER
 #define CONFIG_EXAMPLE_STRIP_LED_NUMBER 1
+#endif
+
+/* Color conversion, 1 for the fixed-point conversion with lookup tables, 0 for the float conversion */
+#ifndef LIGHT_DRIVER_FIXED_POINT
+#define LIGHT_DRIVER_FIXED_POINT 1
+#endif
+
+/* LED gamma curve in hundredths, 100 keeps the output linear */
+#ifndef LIGHT_DRIVER_GAMMA
+#define LIGHT_DRIVER_GAMMA 100
+#endif
+
+/* Number of segments of the strip driven as separate lights, up to 32, the pixels are split evenly among them */
+#ifndef LIGHT_DRIVER_SEGMENT_NUM
+#define LIGHT_DRIVER_SEGMENT_NUM 1
+#endif
+
+/* Segment index to address all the segments at once */
+#define LIGHT_DRIVER_SEGMENT_ALL 0xFF
+
+/* Frame period of the LED strip in milliseconds, the changes within a frame are written with one refresh */
+#ifndef LIGHT_DRIVER_REFRESH_MS
+#define LIGHT_DRIVER_REFRESH_MS 20
+#endif
+
+/* Transition time in milliseconds to smooth the steps between the updates from the Zigbee stack */
+#ifndef LIGHT_DRIVER_TRANSITION_MS
+#define LIGHT_DRIVER_TRANSITION_MS 100
+#endif
 
 
 /** Convert Hue,Saturation,V to RGB
@@ -95,6 +125,17 @@ void light_driver_init(bool power);
 */
 void light_driver_set_level(uint8_t level);
 
+/**
+* @brief Fade light level from the current level to the target one
+*
+* @note The driver refreshes the LED strip every LIGHT_DRIVER_REFRESH_MS until the target is reached, a fade in
+*       progress is retargeted from the level it has reached. The light functions address all the segments.
+*
+* @param  level          The target light level
+* @param  transition_ms  The transition time in milliseconds, 0 to set the level at the next frame
+*/
+void light_driver_set_level_transition(uint8_t level, uint16_t transition_ms);
+
 /**
 * @brief Set light color from RGB
 *
@@ -112,6 +153,17 @@ void light_driver_set_color_RGB(uint8_t red, uint8_t green, uint8_t blue);
 */
 void light_driver_set_color_xy(uint16_t color_current_x, uint16_t color_current_y);
 
+/**
+* @brief Fade light color from the current color xy to the target one
+*
+* @note The color fades in the xy space, there is no fade if the current color is set from hue saturation or RGB.
+*
+* @param  color_current_x  The target color x
+* @param  color_current_y  The target color y
+* @param  transition_ms    The transition time in milliseconds, 0 to set the color at the next frame
+*/
+void light_driver_set_color_xy_transition(uint16_t color_current_x, uint16_t color_current_y, uint16_t transition_ms);
+
 /**
 * @brief Set light color from hue saturation
 *
@@ -120,6 +172,55 @@ void light_driver_set_color_xy(uint16_t color_current_x, uint16_t color_current_
 */
 void light_driver_set_color_hue_sat(uint8_t hue, uint8_t sat);
 
+/**
+* @brief Set the power of a segment
+*
+* @note The segment functions only mark the segment changed, all the segments changed are written to the strip
+*       with one refresh at the next frame, within LIGHT_DRIVER_REFRESH_MS.
+*
+* @param  index  The segment index, e.g. mapped from the Zigbee endpoint, or LIGHT_DRIVER_SEGMENT_ALL
+* @param  power  The light power to be set
+*/
+void light_driver_segment_set_power(uint8_t index, bool power);
+
+/**
+* @brief Fade the level of a segment to the target one
+*
+* @param  index          The segment index or LIGHT_DRIVER_SEGMENT_ALL
+* @param  level          The target light level
+* @param  transition_ms  The transition time in milliseconds, 0 to set the level at the next frame
+*/
+void light_driver_segment_set_level_transition(uint8_t index, uint8_t level, uint16_t transition_ms);
+
+/**
+* @brief Set the color of a segment from RGB
+*
+* @param  index  The segment index or LIGHT_DRIVER_SEGMENT_ALL
+* @param  red    The red color to be set
+* @param  green  The green color to be set
+* @param  blue   The blue color to be set
+*/
+void light_driver_segment_set_color_RGB(uint8_t index, uint8_t red, uint8_t green, uint8_t blue);
+
+/**
+* @brief Fade the color of a segment to the target color xy
+*
+* @param  index            The segment index or LIGHT_DRIVER_SEGMENT_ALL
+* @param  color_current_x  The target color x
+* @param  color_current_y  The target color y
+* @param  transition_ms    The transition time in milliseconds, 0 to set the color at the next frame
+*/
+void light_driver_segment_set_color_xy_transition(uint8_t index, uint16_t color_current_x, uint16_t color_current_y, uint16_t transition_ms);
+
+/**
+* @brief Set the color of a segment from hue saturation
+*
+* @param  index  The segment index or LIGHT_DRIVER_SEGMENT_ALL
+* @param  hue    The hue to be set
+* @param  sat    The sat to be set
+*/
+void light_driver_segment_set_color_hue_sat(uint8_t index, uint8_t hue, uint8_t sat);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
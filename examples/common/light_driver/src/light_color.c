@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee light driver example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "light_color.h"
+#include "light_driver.h"
+
+/* Q15 fixed-point of the XYZ to linear RGB matrix used by XYZ_to_RGB() */
+#define LIGHT_COLOR_Q15(v)          ((int32_t)((v) * 32768 + (((v) < 0) ? -0.5 : 0.5)))
+#define LIGHT_COLOR_HUE_SECTOR      (UINT8_MAX / 6)
+
+static const int32_t s_xyz_to_rgb[3][3] = {
+    {LIGHT_COLOR_Q15(3.240479), LIGHT_COLOR_Q15(-1.537150), LIGHT_COLOR_Q15(-0.498535)},
+    {LIGHT_COLOR_Q15(-0.969256), LIGHT_COLOR_Q15(1.875992), LIGHT_COLOR_Q15(0.041556)},
+    {LIGHT_COLOR_Q15(0.055648), LIGHT_COLOR_Q15(-0.204043), LIGHT_COLOR_Q15(1.057311)},
+};
+
+/* The drop of each channel below the full value in 1 / LIGHT_COLOR_HUE_SECTOR of the saturation */
+static uint8_t s_hue_drop[UINT8_MAX + 1][3];
+static uint8_t s_gamma[UINT8_MAX + 1];
+
+void light_color_init(uint16_t gamma)
+{
+    for (int hue = 0; hue <= UINT8_MAX; hue ++) {
+        uint8_t sector = hue / LIGHT_COLOR_HUE_SECTOR;
+        uint8_t fraction = hue % LIGHT_COLOR_HUE_SECTOR;
+        uint8_t p = LIGHT_COLOR_HUE_SECTOR;
+        uint8_t q = fraction;
+        uint8_t t = LIGHT_COLOR_HUE_SECTOR - fraction;
+        uint8_t *drop = s_hue_drop[hue];
+
+        /* The same sectors as HSV_to_RGB(), the last hues beyond the sixth sector belong to the sixth one */
+        switch (sector) {
+            case 0: drop[0] = 0; drop[1] = t; drop[2] = p; break;
+            case 1: drop[0] = q; drop[1] = 0; drop[2] = p; break;
+            case 2: drop[0] = p; drop[1] = 0; drop[2] = t; break;
+            case 3: drop[0] = p; drop[1] = q; drop[2] = 0; break;
+            case 4: drop[0] = t; drop[1] = p; drop[2] = 0; break;
+            case 5:
+            default: drop[0] = 0; drop[1] = p; drop[2] = q; break;
+        }
+    }
+
+    for (int i = 0; i <= UINT8_MAX; i ++) {
+        s_gamma[i] = (uint8_t)(UINT8_MAX * powf((float)i / UINT8_MAX, (float)gamma / 100) + 0.5f);
+    }
+}
+
+static uint8_t light_color_xy_channel(const int32_t *row, int32_t x, int32_t y, int32_t z)
+{
+    int64_t sum = (int64_t)row[0] * x + (int64_t)row[1] * y + (int64_t)row[2] * z;
+
+    /* The channel is clamped before the division, so the division in range takes 32 bits only */
+    if (sum <= 0) {
+        return 0;
+    }
+    if (sum >= ((int64_t)y << 15)) {
+        return UINT8_MAX;
+    }
+
+    return (uint8_t)((((int32_t)sum / y) * UINT8_MAX) >> 15);
+}
+
+void light_color_xy_to_rgb(uint16_t color_x, uint16_t color_y, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    /* With the full light level Y = 1, X = x / y and Z = z / y, so every channel is (M * [x, y, z]) / y */
+    int32_t y = color_y ? color_y : 1;
+    int32_t z = UINT16_MAX - (int32_t)color_x - y;
+
+    *red = light_color_xy_channel(s_xyz_to_rgb[0], color_x, y, z);
+    *green = light_color_xy_channel(s_xyz_to_rgb[1], color_x, y, z);
+    *blue = light_color_xy_channel(s_xyz_to_rgb[2], color_x, y, z);
+}
+
+void light_color_hue_sat_to_rgb(uint8_t hue, uint8_t sat, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    const uint8_t *drop = s_hue_drop[hue];
+
+    /* The drop is rounded up, so the result is the truncation of the exact HSV conversion */
+    *red = UINT8_MAX - (sat * drop[0] + LIGHT_COLOR_HUE_SECTOR - 1) / LIGHT_COLOR_HUE_SECTOR;
+    *green = UINT8_MAX - (sat * drop[1] + LIGHT_COLOR_HUE_SECTOR - 1) / LIGHT_COLOR_HUE_SECTOR;
+    *blue = UINT8_MAX - (sat * drop[2] + LIGHT_COLOR_HUE_SECTOR - 1) / LIGHT_COLOR_HUE_SECTOR;
+}
+
+uint8_t light_color_level(uint8_t color, uint8_t level)
+{
+    /* (x * 0x8081) >> 23 equals x / 255 for any 16 bits x */
+    return s_gamma[((uint32_t)color * level * 0x8081) >> 23];
+}
+
+void light_color_xy_to_rgb_float(uint16_t color_x, uint16_t color_y, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    float red_f = 0, green_f = 0, blue_f = 0, x, y;
+    x = (float)color_x / 65535;
+    y = (float)color_y / 65535;
+    /* assume color_Y is full light level value 1  (0-1.0) */
+    float color_X = x / y;
+    float color_Z = (1 - x - y) / y;
+    /* change from xy to linear RGB NOT sRGB */
+    XYZ_to_RGB(color_X, 1, color_Z, red_f, green_f, blue_f);
+    *red = (red_f > 0) ? (uint8_t)(red_f * (float)255) : 0;
+    *green = (green_f > 0) ? (uint8_t)(green_f * (float)255) : 0;
+    *blue = (blue_f > 0) ? (uint8_t)(blue_f * (float)255) : 0;
+}
+
+void light_color_hue_sat_to_rgb_float(uint8_t hue, uint8_t sat, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    float red_f, green_f, blue_f;
+    HSV_to_RGB(hue, sat, UINT8_MAX, red_f, green_f, blue_f);
+    *red = (uint8_t)red_f;
+    *green = (uint8_t)green_f;
+    *blue = (uint8_t)blue_f;
+}
+
+uint8_t light_color_level_float(uint8_t color, uint8_t level)
+{
+    float ratio = (float)level / 255;
+    return s_gamma[(uint8_t)(color * ratio)];
+}
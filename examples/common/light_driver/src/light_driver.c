@@ -13,65 +13,288 @@
  */
 
 
+#include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "led_strip.h"
+#include "light_color.h"
 #include "light_driver.h"
 
+#if LIGHT_DRIVER_FIXED_POINT
+#define light_driver_xy_to_rgb          light_color_xy_to_rgb
+#define light_driver_hue_sat_to_rgb     light_color_hue_sat_to_rgb
+#define light_driver_level              light_color_level
+#else
+#define light_driver_xy_to_rgb          light_color_xy_to_rgb_float
+#define light_driver_hue_sat_to_rgb     light_color_hue_sat_to_rgb_float
+#define light_driver_level              light_color_level_float
+#endif
+
+static const char *TAG = "LIGHT_DRIVER";
+
+#define LIGHT_DRIVER_SEGMENT_PIXELS     (CONFIG_EXAMPLE_STRIP_LED_NUMBER / LIGHT_DRIVER_SEGMENT_NUM)
+
+_Static_assert(LIGHT_DRIVER_SEGMENT_NUM >= 1 && LIGHT_DRIVER_SEGMENT_NUM <= 32, "The dirty bitmap holds up to 32 segments");
+_Static_assert(LIGHT_DRIVER_SEGMENT_NUM <= CONFIG_EXAMPLE_STRIP_LED_NUMBER, "A segment has one pixel at least");
+
+/* A value fading linearly from the start to the target, it is settled if the duration is 0 */
+typedef struct {
+    uint16_t from;
+    uint16_t to;
+    int64_t start_us;
+    int64_t duration_us;
+} light_driver_fade_t;
+
+/* A segment of the strip driven as a separate light */
+typedef struct {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t level;
+    bool power;
+    bool color_xy;
+    light_driver_fade_t fade_level;
+    light_driver_fade_t fade_x;
+    light_driver_fade_t fade_y;
+} light_driver_segment_t;
+
 static led_strip_handle_t s_led_strip;
-static uint8_t s_red = 255, s_green = 255, s_blue = 255, s_level = 255;
+static light_driver_segment_t s_segment[LIGHT_DRIVER_SEGMENT_NUM];
+static uint32_t s_dirty;
+static esp_timer_handle_t s_frame_timer;
+static SemaphoreHandle_t s_lock;
+
+static uint16_t light_driver_fade_value(light_driver_fade_t *fade, int64_t now)
+{
+    int64_t elapsed = now - fade->start_us;
+
+    if (elapsed >= fade->duration_us) {
+        fade->duration_us = 0;
+        return fade->to;
+    }
+
+    return fade->from + ((int32_t)fade->to - fade->from) * elapsed / fade->duration_us;
+}
+
+/* Retarget a fade, a fade in progress goes on from its current value so there is no jump */
+static void light_driver_fade_start(light_driver_fade_t *fade, uint16_t target, uint16_t transition_ms, int64_t now)
+{
+    fade->from = light_driver_fade_value(fade, now);
+    fade->to = target;
+    fade->start_us = now;
+    fade->duration_us = (int64_t)transition_ms * 1000;
+}
+
+static bool light_driver_segment_fading(const light_driver_segment_t *segment)
+{
+    return segment->fade_level.duration_us || (segment->color_xy && (segment->fade_x.duration_us || segment->fade_y.duration_us));
+}
+
+/* Render the fades of a segment at the time given */
+static void light_driver_segment_render(light_driver_segment_t *segment, int64_t now)
+{
+    segment->level = light_driver_fade_value(&segment->fade_level, now);
+    if (segment->color_xy) {
+        light_driver_xy_to_rgb(light_driver_fade_value(&segment->fade_x, now), light_driver_fade_value(&segment->fade_y, now),
+                               &segment->red, &segment->green, &segment->blue);
+    }
+}
+
+static void light_driver_segment_write(uint8_t index)
+{
+    const light_driver_segment_t *segment = &s_segment[index];
+    uint32_t first = index * LIGHT_DRIVER_SEGMENT_PIXELS;
+    /* The last segment takes the pixels left over by the division */
+    uint32_t last = (index == LIGHT_DRIVER_SEGMENT_NUM - 1) ? CONFIG_EXAMPLE_STRIP_LED_NUMBER : first + LIGHT_DRIVER_SEGMENT_PIXELS;
+    uint8_t red = light_driver_level(segment->red, segment->level) * segment->power;
+    uint8_t green = light_driver_level(segment->green, segment->level) * segment->power;
+    uint8_t blue = light_driver_level(segment->blue, segment->level) * segment->power;
+
+    for (uint32_t pixel = first; pixel < last; pixel ++) {
+        ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, pixel, red, green, blue));
+    }
+}
+
+/* One frame: render the fades, write the dirty segments and refresh the strip once */
+static void light_driver_frame_tick(void *arg)
+{
+    bool fading = false;
+    int64_t now = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    now = esp_timer_get_time();
+    for (uint8_t i = 0; i < LIGHT_DRIVER_SEGMENT_NUM; i ++) {
+        if (light_driver_segment_fading(&s_segment[i])) {
+            light_driver_segment_render(&s_segment[i], now);
+            fading |= light_driver_segment_fading(&s_segment[i]);
+            s_dirty |= 1UL << i;
+        }
+    }
+    if (s_dirty) {
+        for (uint8_t i = 0; i < LIGHT_DRIVER_SEGMENT_NUM; i ++) {
+            if (s_dirty & (1UL << i)) {
+                light_driver_segment_write(i);
+            }
+        }
+        ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+        s_dirty = 0;
+    }
+    /* The timer runs only while there is anything to refresh */
+    if (!fading) {
+        esp_timer_stop(s_frame_timer);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+/* Mark a segment dirty, it is written by the next frame tick together with the others changed meanwhile */
+static void light_driver_segment_commit(uint8_t index)
+{
+    s_dirty |= 1UL << index;
+    if (!esp_timer_is_active(s_frame_timer)) {
+        ESP_ERROR_CHECK(esp_timer_start_periodic(s_frame_timer, LIGHT_DRIVER_REFRESH_MS * 1000));
+    }
+}
+
+static void light_driver_segment_color_xy(light_driver_segment_t *segment, uint16_t color_x, uint16_t color_y, uint16_t transition_ms,
+                                          int64_t now)
+{
+    /* The colour set by hue saturation or RGB has no xy to fade from */
+    if (!segment->color_xy) {
+        segment->fade_x = (light_driver_fade_t){.from = color_x, .to = color_x};
+        segment->fade_y = (light_driver_fade_t){.from = color_y, .to = color_y};
+        segment->color_xy = true;
+    }
+    light_driver_fade_start(&segment->fade_x, color_x, transition_ms, now);
+    light_driver_fade_start(&segment->fade_y, color_y, transition_ms, now);
+    light_driver_segment_render(segment, now);
+    segment->power = true;
+}
+
+static void light_driver_segment_color_rgb(light_driver_segment_t *segment, uint8_t red, uint8_t green, uint8_t blue)
+{
+    segment->color_xy = false;
+    segment->red = red;
+    segment->green = green;
+    segment->blue = blue;
+    segment->power = true;
+}
+
+/* The range of the segments addressed, LIGHT_DRIVER_SEGMENT_ALL for all of them */
+static bool light_driver_segment_range(uint8_t index, uint8_t *first, uint8_t *last)
+{
+    ESP_RETURN_ON_FALSE(index < LIGHT_DRIVER_SEGMENT_NUM || index == LIGHT_DRIVER_SEGMENT_ALL, false, TAG, "Invalid segment %d", index);
+    *first = (index == LIGHT_DRIVER_SEGMENT_ALL) ? 0 : index;
+    *last = (index == LIGHT_DRIVER_SEGMENT_ALL) ? LIGHT_DRIVER_SEGMENT_NUM : index + 1;
+    return true;
+}
+
+void light_driver_segment_set_color_xy_transition(uint8_t index, uint16_t color_current_x, uint16_t color_current_y, uint16_t transition_ms)
+{
+    uint8_t first, last;
+
+    if (!light_driver_segment_range(index, &first, &last)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = first; i < last; i ++) {
+        light_driver_segment_color_xy(&s_segment[i], color_current_x, color_current_y, transition_ms, now);
+        light_driver_segment_commit(i);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void light_driver_segment_set_color_hue_sat(uint8_t index, uint8_t hue, uint8_t sat)
+{
+    uint8_t red, green, blue;
+
+    light_driver_hue_sat_to_rgb(hue, sat, &red, &green, &blue);
+    light_driver_segment_set_color_RGB(index, red, green, blue);
+}
+
+void light_driver_segment_set_color_RGB(uint8_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    uint8_t first, last;
+
+    if (!light_driver_segment_range(index, &first, &last)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = first; i < last; i ++) {
+        light_driver_segment_color_rgb(&s_segment[i], red, green, blue);
+        light_driver_segment_commit(i);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void light_driver_segment_set_power(uint8_t index, bool power)
+{
+    uint8_t first, last;
+
+    if (!light_driver_segment_range(index, &first, &last)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = first; i < last; i ++) {
+        s_segment[i].power = power;
+        light_driver_segment_commit(i);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void light_driver_segment_set_level_transition(uint8_t index, uint8_t level, uint16_t transition_ms)
+{
+    uint8_t first, last;
+
+    if (!light_driver_segment_range(index, &first, &last)) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = first; i < last; i ++) {
+        light_driver_fade_start(&s_segment[i].fade_level, level, transition_ms, now);
+        light_driver_segment_render(&s_segment[i], now);
+        s_segment[i].power = true;
+        light_driver_segment_commit(i);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void light_driver_set_color_xy_transition(uint16_t color_current_x, uint16_t color_current_y, uint16_t transition_ms)
+{
+    light_driver_segment_set_color_xy_transition(LIGHT_DRIVER_SEGMENT_ALL, color_current_x, color_current_y, transition_ms);
+}
 
 void light_driver_set_color_xy(uint16_t color_current_x, uint16_t color_current_y)
 {
-    float red_f = 0, green_f = 0, blue_f = 0, color_x, color_y;
-    color_x = (float)color_current_x / 65535;
-    color_y = (float)color_current_y / 65535;
-    /* assume color_Y is full light level value 1  (0-1.0) */
-    float color_X = color_x / color_y;
-    float color_Z = (1 - color_x - color_y) / color_y;
-    /* change from xy to linear RGB NOT sRGB */
-    XYZ_to_RGB(color_X, 1, color_Z, red_f, green_f, blue_f);
-    float ratio = (float)s_level / 255;
-    s_red = (uint8_t)(red_f * (float)255);
-    s_green = (uint8_t)(green_f * (float)255);
-    s_blue = (uint8_t)(blue_f * (float)255);
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, s_red * ratio, s_green * ratio, s_blue * ratio));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+    light_driver_segment_set_color_xy_transition(LIGHT_DRIVER_SEGMENT_ALL, color_current_x, color_current_y, 0);
 }
 
 void light_driver_set_color_hue_sat(uint8_t hue, uint8_t sat)
 {
-    float red_f, green_f, blue_f;
-    HSV_to_RGB(hue, sat, UINT8_MAX, red_f, green_f, blue_f);
-    float ratio = (float)s_level / 255;
-    s_red = (uint8_t)red_f;
-    s_green = (uint8_t)green_f;
-    s_blue = (uint8_t)blue_f;
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, s_red * ratio, s_green * ratio, s_blue * ratio));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+    light_driver_segment_set_color_hue_sat(LIGHT_DRIVER_SEGMENT_ALL, hue, sat);
 }
 
 void light_driver_set_color_RGB(uint8_t red, uint8_t green, uint8_t blue)
 {
-    float ratio = (float)s_level / 255;
-    s_red = red;
-    s_green = green;
-    s_blue = blue;
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, red * ratio, green * ratio, blue * ratio));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+    light_driver_segment_set_color_RGB(LIGHT_DRIVER_SEGMENT_ALL, red, green, blue);
 }
 
 void light_driver_set_power(bool power)
 {
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, s_red * power, s_green * power, s_blue * power));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+    light_driver_segment_set_power(LIGHT_DRIVER_SEGMENT_ALL, power);
+}
+
+void light_driver_set_level_transition(uint8_t level, uint16_t transition_ms)
+{
+    light_driver_segment_set_level_transition(LIGHT_DRIVER_SEGMENT_ALL, level, transition_ms);
 }
 
 void light_driver_set_level(uint8_t level)
 {
-    s_level = level;
-    float ratio = (float)s_level / 255;
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, s_red * ratio, s_green * ratio, s_blue * ratio));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+    light_driver_segment_set_level_transition(LIGHT_DRIVER_SEGMENT_ALL, level, 0);
 }
 
 void light_driver_init(bool power)
@@ -85,5 +308,21 @@ void light_driver_init(bool power)
     };
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&led_strip_conf, &rmt_conf, &s_led_strip));
 
+    for (uint8_t i = 0; i < LIGHT_DRIVER_SEGMENT_NUM; i ++) {
+        s_segment[i] = (light_driver_segment_t){
+            .red = 255, .green = 255, .blue = 255, .level = 255,
+            .fade_level = {.from = 255, .to = 255},
+        };
+    }
+
+    const esp_timer_create_args_t frame_timer_args = {
+        .callback = light_driver_frame_tick,
+        .name = "light_frame",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&frame_timer_args, &s_frame_timer));
+    s_lock = xSemaphoreCreateMutex();
+    assert(s_lock);
+
+    light_color_init(LIGHT_DRIVER_GAMMA);
     light_driver_set_power(power);
 }
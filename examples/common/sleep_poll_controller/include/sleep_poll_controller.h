@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee sleepy end device poll controller example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The defaults suit the deep sleep, where every wake-up reboots the chip and attaches to the parent again, so the
+ * wake-ups are kept tens of seconds apart. A light sleep device could define shorter intervals. */
+
+/* The poll interval while transactions are in flight or the parent has data pending */
+#ifndef SLEEP_POLL_ACTIVE_INTERVAL_MS
+#define SLEEP_POLL_ACTIVE_INTERVAL_MS 250
+#endif
+
+/* The poll interval for a while after the last activity, so the commands that follow are answered quickly */
+#ifndef SLEEP_POLL_FAST_INTERVAL_MS
+#define SLEEP_POLL_FAST_INTERVAL_MS 15000
+#endif
+
+/* How long the fast poll interval is kept after the last activity */
+#ifndef SLEEP_POLL_FAST_HOLD_MS
+#define SLEEP_POLL_FAST_HOLD_MS 60000
+#endif
+
+/* The idle poll interval starts from the minimum and doubles on every idle poll up to the maximum */
+#ifndef SLEEP_POLL_IDLE_MIN_INTERVAL_MS
+#define SLEEP_POLL_IDLE_MIN_INTERVAL_MS 60000
+#endif
+
+#ifndef SLEEP_POLL_IDLE_MAX_INTERVAL_MS
+#define SLEEP_POLL_IDLE_MAX_INTERVAL_MS 1800000
+#endif
+
+/**
+ * @brief The states of the poll controller
+ *
+ */
+typedef enum {
+    SLEEP_POLL_STATE_ACTIVE,    /*!< Transactions are in flight or the parent has data pending */
+    SLEEP_POLL_STATE_FAST,      /*!< Within SLEEP_POLL_FAST_HOLD_MS after the last activity */
+    SLEEP_POLL_STATE_IDLE,      /*!< Backing off exponentially */
+    SLEEP_POLL_STATE_MAX,
+} sleep_poll_state_t;
+
+/**
+ * @brief The counters of a state of the poll controller
+ *
+ */
+typedef struct {
+    uint32_t wake_count;        /*!< The number of the wake-ups in the state */
+    uint64_t radio_on_ms;       /*!< The time awake in the state in milliseconds, the radio is on while awake */
+} sleep_poll_stats_t;
+
+/** Poll interval callback
+ *
+ * @param[in] interval_ms   the poll interval to apply, e.g. the wake-up timer of the deep sleep
+ * @param[in] user_ctx      the user context passed to sleep_poll_controller_init()
+ *
+ */
+typedef void (*sleep_poll_apply_callback_t)(uint32_t interval_ms, void *user_ctx);
+
+/**
+ * @brief init function for the poll controller
+ *
+ * @note The state is kept in the RTC memory, it is reset only if the chip does not wake up from the deep sleep.
+ *
+ * @param cb                    callback to apply the poll interval when it changes, could be NULL.
+ * @param user_ctx              user context passed to the callback.
+ *
+ * @return ESP_OK on success.
+ */
+esp_err_t sleep_poll_controller_init(sleep_poll_apply_callback_t cb, void *user_ctx);
+
+/**
+ * @brief Mark the start of a transaction, e.g. a ZCL request waiting for its response or an OTA upgrade
+ *
+ */
+void sleep_poll_controller_transaction_begin(void);
+
+/**
+ * @brief Mark the end of a transaction started by sleep_poll_controller_transaction_begin()
+ *
+ */
+void sleep_poll_controller_transaction_end(void);
+
+/**
+ * @brief Set whether the parent has data pending for the device, e.g. from the frame pending bit of a poll
+ *
+ * @param pending               true if the parent has data pending.
+ */
+void sleep_poll_controller_data_pending(bool pending);
+
+/**
+ * @brief Note an activity, e.g. a command received, it restarts the fast poll interval and resets the back-off
+ *
+ */
+void sleep_poll_controller_activity(void);
+
+/**
+ * @brief Get the state of the poll controller
+ *
+ * @return the current state.
+ */
+sleep_poll_state_t sleep_poll_controller_state(void);
+
+/**
+ * @brief Enter the sleep, be invoked right before the device sleeps
+ *
+ * @note The idle back-off advances by one step on every call in the idle state.
+ *
+ * @return the poll interval in milliseconds for this sleep.
+ */
+uint32_t sleep_poll_controller_sleep(void);
+
+/**
+ * @brief Leave the sleep, be invoked right after the device wakes up
+ *
+ */
+void sleep_poll_controller_wake(void);
+
+/**
+ * @brief Get the counters of a state
+ *
+ * @param state                 the state.
+ * @param stats                 pointer of the counters.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the state is invalid.
+ */
+esp_err_t sleep_poll_controller_get_stats(sleep_poll_state_t state, sleep_poll_stats_t *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
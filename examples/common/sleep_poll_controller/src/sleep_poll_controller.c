@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee sleepy end device poll controller example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "sleep_poll_controller.h"
+
+#include <sys/time.h>
+
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @brief:
+ * This example code shows how to adapt the poll interval of a sleepy end device to its activity.
+ *
+ * @note:
+ * The device polls quickly while it has anything in flight and for a while after the last activity, then the
+ * interval doubles on every idle poll. The time is taken from the RTC, so the state survives the deep sleep.
+ *
+ */
+
+typedef struct {
+    uint32_t transactions;                          /* transactions in flight */
+    bool data_pending;                              /* the parent has data pending */
+    sleep_poll_state_t state;                       /* state of the last sleep */
+    int64_t last_activity_ms;                       /* time of the last activity */
+    int64_t wake_ms;                                /* time of the last wake-up */
+    uint32_t idle_interval_ms;                      /* next idle poll interval */
+    uint32_t interval_ms;                           /* poll interval applied */
+    sleep_poll_stats_t stats[SLEEP_POLL_STATE_MAX];
+} sleep_poll_ctx_t;
+
+static RTC_DATA_ATTR sleep_poll_ctx_t s_ctx;
+static sleep_poll_apply_callback_t s_apply_cb;
+static void *s_user_ctx;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *TAG = "ESP_SLEEP_POLL_CONTROLLER";
+
+static int64_t sleep_poll_controller_now_ms(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static sleep_poll_state_t sleep_poll_controller_evaluate(int64_t now)
+{
+    if (s_ctx.transactions || s_ctx.data_pending) {
+        return SLEEP_POLL_STATE_ACTIVE;
+    }
+    if (now - s_ctx.last_activity_ms < SLEEP_POLL_FAST_HOLD_MS) {
+        return SLEEP_POLL_STATE_FAST;
+    }
+    return SLEEP_POLL_STATE_IDLE;
+}
+
+esp_err_t sleep_poll_controller_init(sleep_poll_apply_callback_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(SLEEP_POLL_IDLE_MIN_INTERVAL_MS && SLEEP_POLL_IDLE_MIN_INTERVAL_MS <= SLEEP_POLL_IDLE_MAX_INTERVAL_MS,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid idle poll interval range");
+    int64_t now = sleep_poll_controller_now_ms();
+
+    s_apply_cb = cb;
+    s_user_ctx = user_ctx;
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED) {
+        /* Not a deep sleep reset, start in the fast state as after an activity */
+        s_ctx = (sleep_poll_ctx_t){
+            .state = SLEEP_POLL_STATE_FAST,
+            .last_activity_ms = now,
+            .wake_ms = now,
+            .idle_interval_ms = SLEEP_POLL_IDLE_MIN_INTERVAL_MS,
+        };
+    } else {
+        /* Nothing in flight survives the deep sleep, neither does the poll interval applied */
+        s_ctx.transactions = 0;
+        s_ctx.data_pending = false;
+        s_ctx.interval_ms = 0;
+        sleep_poll_controller_wake();
+    }
+    return ESP_OK;
+}
+
+void sleep_poll_controller_transaction_begin(void)
+{
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_ctx.transactions ++;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+void sleep_poll_controller_transaction_end(void)
+{
+    int64_t now = sleep_poll_controller_now_ms();
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_ctx.transactions) {
+        s_ctx.transactions --;
+    }
+    /* The end of a transaction is an activity, a command may follow its response */
+    s_ctx.last_activity_ms = now;
+    s_ctx.idle_interval_ms = SLEEP_POLL_IDLE_MIN_INTERVAL_MS;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+void sleep_poll_controller_data_pending(bool pending)
+{
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_ctx.data_pending = pending;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+void sleep_poll_controller_activity(void)
+{
+    int64_t now = sleep_poll_controller_now_ms();
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_ctx.last_activity_ms = now;
+    s_ctx.idle_interval_ms = SLEEP_POLL_IDLE_MIN_INTERVAL_MS;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+sleep_poll_state_t sleep_poll_controller_state(void)
+{
+    int64_t now = sleep_poll_controller_now_ms();
+    sleep_poll_state_t state;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    state = sleep_poll_controller_evaluate(now);
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    return state;
+}
+
+uint32_t sleep_poll_controller_sleep(void)
+{
+    int64_t now = sleep_poll_controller_now_ms();
+    uint32_t interval_ms = 0;
+    bool changed = false;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    sleep_poll_state_t state = sleep_poll_controller_evaluate(now);
+    /* The time awake is counted to the state the device goes to sleep in */
+    s_ctx.stats[state].radio_on_ms += now - s_ctx.wake_ms;
+    switch (state) {
+    case SLEEP_POLL_STATE_ACTIVE:
+        interval_ms = SLEEP_POLL_ACTIVE_INTERVAL_MS;
+        break;
+    case SLEEP_POLL_STATE_FAST:
+        interval_ms = SLEEP_POLL_FAST_INTERVAL_MS;
+        break;
+    default:
+        interval_ms = s_ctx.idle_interval_ms;
+        s_ctx.idle_interval_ms = (s_ctx.idle_interval_ms > SLEEP_POLL_IDLE_MAX_INTERVAL_MS / 2) ? SLEEP_POLL_IDLE_MAX_INTERVAL_MS
+                                                                                             : s_ctx.idle_interval_ms * 2;
+        break;
+    }
+    s_ctx.state = state;
+    changed = (interval_ms != s_ctx.interval_ms);
+    s_ctx.interval_ms = interval_ms;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+
+    if (changed && s_apply_cb) {
+        s_apply_cb(interval_ms, s_user_ctx);
+    }
+    return interval_ms;
+}
+
+void sleep_poll_controller_wake(void)
+{
+    int64_t now = sleep_poll_controller_now_ms();
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_ctx.stats[s_ctx.state].wake_count ++;
+    s_ctx.wake_ms = now;
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+esp_err_t sleep_poll_controller_get_stats(sleep_poll_state_t state, sleep_poll_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(state < SLEEP_POLL_STATE_MAX && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid poll controller state");
+    portENTER_CRITICAL_SAFE(&s_lock);
+    *stats = s_ctx.stats[state];
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    return ESP_OK;
+}
@@ -20,6 +20,26 @@
 extern "C" {
 #endif
 
+/* Samples taken in a burst on every update, the median of the burst is used */
+#ifndef TEMP_SENSOR_DRIVER_OVERSAMPLE
+#define TEMP_SENSOR_DRIVER_OVERSAMPLE 8
+#endif
+
+/* Weight of the new median in the exponential moving average as 1 / 2^shift, 0 disables the average */
+#ifndef TEMP_SENSOR_DRIVER_EMA_SHIFT
+#define TEMP_SENSOR_DRIVER_EMA_SHIFT 2
+#endif
+
+/* Change from the last value passed to the callback to pass a new one, in 0.01 degrees Celsius */
+#ifndef TEMP_SENSOR_DRIVER_THRESHOLD
+#define TEMP_SENSOR_DRIVER_THRESHOLD 20
+#endif
+
+/* Minimum interval between two callbacks in seconds, 0 to gate them by the threshold only */
+#ifndef TEMP_SENSOR_DRIVER_MIN_INTERVAL
+#define TEMP_SENSOR_DRIVER_MIN_INTERVAL 10
+#endif
+
 /** Temperature sensor callback
  *
  * @param[in] temperature temperature value in degrees Celsius from sensor
@@ -30,6 +50,10 @@ typedef void (*esp_temp_sensor_callback_t)(float temperature);
 /**
  * @brief init function for temp sensor and callback setup
  *
+ * @note Every update takes TEMP_SENSOR_DRIVER_OVERSAMPLE samples and filters their median. The callback is called
+ *       with the first value, and then only if the filtered value moves by TEMP_SENSOR_DRIVER_THRESHOLD at least
+ *       and TEMP_SENSOR_DRIVER_MIN_INTERVAL has passed since the last callback.
+ *
  * @param config                pointer of temperature sensor config.
  * @param update_interval       sensor value update interval in seconds.
  * @param cb                    callback pointer.
@@ -14,6 +14,9 @@
 
 #include "temp_sensor_driver.h"
 
+#include <math.h>
+#include <stdbool.h>
+
 #include "esp_err.h"
 #include "esp_check.h"
 #include "freertos/FreeRTOS.h"
@@ -24,7 +27,8 @@
  * This example code shows how to configure temperature sensor.
  *
  * @note:
- * The callback will be called with updated temperature sensor value every $interval seconds.
+ * The sensor value is updated every $interval seconds, the callback will be called with the filtered value
+ * only if it changes by the threshold and the minimum interval has passed.
  *
  */
 
@@ -37,6 +41,34 @@ static uint16_t interval = 1;
 
 static const char *TAG = "ESP_TEMP_SENSOR_DRIVER";
 
+/**
+ * @brief Take a burst of samples and return their median, a single spike in the burst is discarded
+ *
+ * @param value      pointer of the median.
+ */
+static esp_err_t temp_sensor_driver_sample(float *value)
+{
+    float samples[TEMP_SENSOR_DRIVER_OVERSAMPLE];
+    int count = 0;
+
+    for (int i = 0; i < TEMP_SENSOR_DRIVER_OVERSAMPLE; i ++) {
+        float sample;
+        if (temperature_sensor_get_celsius(temp_sensor, &sample) != ESP_OK) {
+            continue;
+        }
+        /* Insertion sort, the burst is short */
+        int j = count ++;
+        for (; j > 0 && samples[j - 1] > sample; j --) {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = sample;
+    }
+    ESP_RETURN_ON_FALSE(count, ESP_FAIL, TAG, "Fail to read on-chip temperature sensor");
+
+    *value = (count & 1) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    return ESP_OK;
+}
+
 /**
  * @brief Tasks for updating the sensor value
  *
@@ -44,11 +76,25 @@ static const char *TAG = "ESP_TEMP_SENSOR_DRIVER";
  */
 static void temp_sensor_driver_value_update(void *arg)
 {
+    float filtered = 0;
+    float reported = 0;
+    bool first = true;
+    TickType_t reported_tick = 0;
+
     for (;;) {
         float tsens_value;
-        temperature_sensor_get_celsius(temp_sensor, &tsens_value);
-        if (func_ptr) {
-            func_ptr(tsens_value);
+        if (temp_sensor_driver_sample(&tsens_value) == ESP_OK) {
+            /* The average starts from the first median, so it does not ramp up from 0 */
+            filtered = first ? tsens_value : filtered + (tsens_value - filtered) / (1 << TEMP_SENSOR_DRIVER_EMA_SHIFT);
+            if (first || ((fabsf(filtered - reported) * 100 >= TEMP_SENSOR_DRIVER_THRESHOLD) &&
+                          (xTaskGetTickCount() - reported_tick >= pdMS_TO_TICKS(TEMP_SENSOR_DRIVER_MIN_INTERVAL * 1000)))) {
+                reported = filtered;
+                reported_tick = xTaskGetTickCount();
+                first = false;
+                if (func_ptr) {
+                    func_ptr(reported);
+                }
+            }
         }
         vTaskDelay(pdMS_TO_TICKS(interval * 1000));
     }
@@ -71,10 +117,11 @@ static esp_err_t temp_sensor_driver_sensor_init(temperature_sensor_config_t *con
 esp_err_t temp_sensor_driver_init(temperature_sensor_config_t *config, uint16_t update_interval,
                              esp_temp_sensor_callback_t cb)
 {
+    /* Set before the update task starts, the first value is passed to the callback only once */
+    func_ptr = cb;
+    interval = update_interval;
     if (ESP_OK != temp_sensor_driver_sensor_init(config)) {
         return ESP_FAIL;
     }
-    func_ptr = cb;
-    interval = update_interval;
     return ESP_OK;
 }
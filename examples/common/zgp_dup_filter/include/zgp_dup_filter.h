@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Green Power duplicate filter example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "zgp/esp_zigbee_zgp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of the frames remembered, a power of 2, the oldest frame is forgotten when a new one comes */
+#ifndef ZGP_DUP_FILTER_SIZE
+#define ZGP_DUP_FILTER_SIZE 32
+#endif
+
+/* Time in milliseconds a frame is remembered, the same frame forwarded by another proxy later is taken as a new one */
+#ifndef ZGP_DUP_FILTER_WINDOW_MS
+#define ZGP_DUP_FILTER_WINDOW_MS 2000
+#endif
+
+/**
+ * @brief The counters of the duplicate filter
+ */
+typedef struct zgp_dup_filter_stats_s {
+    uint32_t hits;          /*!< The duplicates dropped */
+    uint32_t misses;        /*!< The new frames passed */
+    uint32_t evictions;     /*!< The frames forgotten before the end of the window, the size is too small if it grows */
+} zgp_dup_filter_stats_t;
+
+/**
+ * @brief init function for the duplicate filter, it forgets all the frames and resets the counters
+ *
+ * @note The filter takes no memory from the heap. All the functions of the duplicate filter should be invoked from
+ *       the same task.
+ *
+ * @note The filter has to run on the raw GPDF, before the frame is translated and acted upon. The sink of
+ *       esp-zigbee-lib translates and executes the GPDF itself and hands only the resulting ZCL message to the action
+ *       handler. That message carries neither the security frame counter nor the MAC sequence number of the GPDF,
+ *       and its ZCL sequence number is assigned by the stack, so the filter can not be fed from the action handler.
+ *       A sink gets the GPDF a proxy forwards as a GP Notification, which carries the GPD identifier and the frame
+ *       counter, so the filter is fed from the APS data indication handler, which drops a duplicate before the
+ *       stack translates it. See the GP combo example.
+ */
+void zgp_dup_filter_init(void);
+
+/**
+ * @brief Check a frame of a GPD, the frame is remembered if it is a new one
+ *
+ * @param zgpd_id               pointer of the GPD identifier.
+ * @param seq                   the security frame counter of the GPDF, or its MAC sequence number if the GPD sends no
+ *                              frame counter.
+ *
+ * @return true if the same frame of the GPD is seen within the window, false otherwise.
+ */
+bool zgp_dup_filter_check(const esp_zb_zgpd_id_t *zgpd_id, uint32_t seq);
+
+/**
+ * @brief Get the counters of the duplicate filter
+ *
+ * @param stats                 pointer of the counters to fill.
+ */
+void zgp_dup_filter_get_stats(zgp_dup_filter_stats_t *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
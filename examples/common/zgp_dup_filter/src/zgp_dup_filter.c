@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Green Power duplicate filter example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "zgp_dup_filter.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+/**
+ * @brief:
+ * This example code shows how to drop the same GPD frame forwarded by several proxies.
+ *
+ * @note:
+ * The frames are kept in a ring in the order they come, the oldest one is overwritten by a new one. The ring slots
+ * are chained in hash buckets by the GPD identifier and the sequence, so a frame is checked without scanning the ring.
+ * The filter has to see the raw GPDF, the ZCL messages the stack hands to the action handler are already translated
+ * and acted upon. The GP combo example feeds it the GP Notifications of the proxies from the APS data indication.
+ *
+ */
+
+#define ZGP_DUP_FILTER_BUCKET_NUM   (ZGP_DUP_FILTER_SIZE * 2)
+#define ZGP_DUP_FILTER_INDEX_NONE   0xFFFF
+
+_Static_assert((ZGP_DUP_FILTER_SIZE & (ZGP_DUP_FILTER_SIZE - 1)) == 0 && ZGP_DUP_FILTER_SIZE < ZGP_DUP_FILTER_INDEX_NONE,
+               "ZGP_DUP_FILTER_SIZE should be a power of 2");
+
+typedef struct zgp_dup_filter_entry_s {
+    esp_zb_zgpd_id_t zgpd_id;       /* the GPD identifier of the frame */
+    uint32_t seq;                   /* the security frame counter or the sequence number of the frame */
+    uint32_t time_ms;               /* the time the frame is first seen */
+    uint16_t bucket;                /* the bucket the slot is chained in, ZGP_DUP_FILTER_INDEX_NONE if the slot is free */
+    uint16_t next;                  /* the next slot in the same bucket */
+} zgp_dup_filter_entry_t;
+
+static zgp_dup_filter_entry_t s_entry[ZGP_DUP_FILTER_SIZE];
+static uint16_t s_bucket[ZGP_DUP_FILTER_BUCKET_NUM];
+static uint16_t s_head;                                 /* the slot to write next, also the oldest frame once the ring is full */
+static zgp_dup_filter_stats_t s_stats;
+
+static uint32_t zgp_dup_filter_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* FNV-1a over the fields ESP_ZB_ZGPD_IDS_COMPARE() compares, then over the sequence */
+static uint16_t zgp_dup_filter_hash(const esp_zb_zgpd_id_t *zgpd_id, uint32_t seq)
+{
+    const uint8_t *addr = (const uint8_t *)&zgpd_id->addr;
+    uint8_t len = (zgpd_id->app_id == ESP_ZB_ZGP_APP_ID_0000) ? sizeof(uint32_t) : sizeof(esp_zb_ieee_addr_t);
+    uint32_t hash = (2166136261UL ^ zgpd_id->app_id) * 16777619UL;
+
+    for (uint8_t i = 0; i < len; i ++) {
+        hash = (hash ^ addr[i]) * 16777619UL;
+    }
+    if (zgpd_id->app_id != ESP_ZB_ZGP_APP_ID_0000) {
+        hash = (hash ^ zgpd_id->endpoint) * 16777619UL;
+    }
+    for (uint8_t i = 0; i < sizeof(uint32_t); i ++) {
+        hash = (hash ^ ((seq >> (i * 8)) & 0xFF)) * 16777619UL;
+    }
+
+    return (uint16_t)(hash ^ (hash >> 16)) & (ZGP_DUP_FILTER_BUCKET_NUM - 1);
+}
+
+/* Take the slot out of its bucket chain */
+static void zgp_dup_filter_unlink(uint16_t slot)
+{
+    uint16_t *link = &s_bucket[s_entry[slot].bucket];
+
+    while (*link != ZGP_DUP_FILTER_INDEX_NONE && *link != slot) {
+        link = &s_entry[*link].next;
+    }
+    if (*link == slot) {
+        *link = s_entry[slot].next;
+    }
+    s_entry[slot].bucket = ZGP_DUP_FILTER_INDEX_NONE;
+}
+
+void zgp_dup_filter_init(void)
+{
+    memset(s_entry, 0, sizeof(s_entry));
+    for (uint16_t i = 0; i < ZGP_DUP_FILTER_SIZE; i ++) {
+        s_entry[i].bucket = ZGP_DUP_FILTER_INDEX_NONE;
+    }
+    memset(s_bucket, 0xFF, sizeof(s_bucket));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_head = 0;
+}
+
+bool zgp_dup_filter_check(const esp_zb_zgpd_id_t *zgpd_id, uint32_t seq)
+{
+    uint32_t now = zgp_dup_filter_now_ms();
+    uint16_t bucket = zgp_dup_filter_hash(zgpd_id, seq);
+    uint16_t slot = s_bucket[bucket];
+
+    while (slot != ZGP_DUP_FILTER_INDEX_NONE) {
+        zgp_dup_filter_entry_t *entry = &s_entry[slot];
+        /* The window starts from the first copy, a GPD reusing the sequence later is not taken as a duplicate */
+        if (entry->seq == seq && (uint32_t)(now - entry->time_ms) < ZGP_DUP_FILTER_WINDOW_MS &&
+            ESP_ZB_ZGPD_IDS_COMPARE(&entry->zgpd_id, zgpd_id)) {
+            s_stats.hits ++;
+            return true;
+        }
+        slot = entry->next;
+    }
+
+    slot = s_head;
+    s_head = (s_head + 1) & (ZGP_DUP_FILTER_SIZE - 1);
+    if (s_entry[slot].bucket != ZGP_DUP_FILTER_INDEX_NONE) {
+        if ((uint32_t)(now - s_entry[slot].time_ms) < ZGP_DUP_FILTER_WINDOW_MS) {
+            s_stats.evictions ++;
+        }
+        zgp_dup_filter_unlink(slot);
+    }
+
+    memcpy(&s_entry[slot].zgpd_id, zgpd_id, sizeof(esp_zb_zgpd_id_t));
+    s_entry[slot].seq = seq;
+    s_entry[slot].time_ms = now;
+    s_entry[slot].bucket = bucket;
+    s_entry[slot].next = s_bucket[bucket];
+    s_bucket[bucket] = slot;
+    s_stats.misses ++;
+
+    return false;
+}
+
+void zgp_dup_filter_get_stats(zgp_dup_filter_stats_t *stats)
+{
+    if (stats) {
+        memcpy(stats, &s_stats, sizeof(zgp_dup_filter_stats_t));
+    }
+}
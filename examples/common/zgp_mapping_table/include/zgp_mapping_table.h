@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Green Power sink mapping table example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "zgp/esp_zigbee_zgp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* NVS namespace of the mapping table, every entry is saved under its own key */
+#ifndef ZGP_MAPPING_TABLE_NVS_NAMESPACE
+#define ZGP_MAPPING_TABLE_NVS_NAMESPACE "zgp_mapping"
+#endif
+
+/* Delay in milliseconds to gather the changes of the mapping table into one NVS commit */
+#ifndef ZGP_MAPPING_TABLE_FLUSH_DELAY_MS
+#define ZGP_MAPPING_TABLE_FLUSH_DELAY_MS 1000
+#endif
+
+/**
+ * @brief init function for the mapping table, it loads the entries saved and hands the table to the ZGP sink
+ *
+ * @note The entries are kept packed at the head of the table, so the sink only scans the entries in use. All the
+ *       functions of the mapping table should be invoked from the Zigbee task, e.g. from the ZGP signal handlers.
+ *
+ * @param capacity              maximum number of the mapping entries.
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_INVALID_ARG: The capacity is 0 or too large
+ *      - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t zgp_mapping_table_init(uint16_t capacity);
+
+/**
+ * @brief Add an entry to the mapping table, it replaces the entry of the same GPD, GPD command, endpoint and cluster
+ *
+ * @note Only the entries with the parsed payload are supported, the ZCL payload is not kept after the entry.
+ *
+ * @param entry                 pointer of the entry to add.
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_INVALID_ARG: The entry carries a ZCL payload
+ *      - ESP_ERR_NO_MEM: The mapping table is full
+ */
+esp_err_t zgp_mapping_table_add(const esp_zb_zgps_mapping_entry_t *entry);
+
+/**
+ * @brief Remove all the entries of a GPD from the mapping table
+ *
+ * @param zgpd_id               pointer of the GPD identifier.
+ *
+ * @return the number of the entries removed.
+ */
+uint16_t zgp_mapping_table_remove(const esp_zb_zgpd_id_t *zgpd_id);
+
+/**
+ * @brief Find the entry mapping a GPD command, the entries for ESP_ZB_GPDF_CMD_UNDEFINED match any command
+ *
+ * @param zgpd_id               pointer of the GPD identifier.
+ * @param gpd_command           the GPD command.
+ *
+ * @return pointer of the entry found, NULL if none is found.
+ */
+const esp_zb_zgps_mapping_entry_t *zgp_mapping_table_find(const esp_zb_zgpd_id_t *zgpd_id, uint8_t gpd_command);
+
+/**
+ * @brief Get the number of the entries in the mapping table
+ *
+ * @return the number of the entries.
+ */
+uint16_t zgp_mapping_table_count(void);
+
+/**
+ * @brief Remove all the entries from the mapping table and the NVS
+ *
+ * @return ESP_OK on success, otherwise the error of the NVS.
+ */
+esp_err_t zgp_mapping_table_clear(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,428 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee Green Power sink mapping table example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "zgp_mapping_table.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "zgp/esp_zigbee_zgps.h"
+
+/**
+ * @brief:
+ * This example code shows how to keep a large mapping table for a ZGP sink.
+ *
+ * @note:
+ * The entries are packed at the head of the table and chained in hash buckets by the GPD identifier, so the entries
+ * of a GPD are found without scanning the table. Every entry is saved under its own NVS key, a change writes the
+ * slots it touched only.
+ *
+ */
+
+#define ZGP_MAPPING_INDEX_NONE      0xFFFF
+
+static esp_zb_zgps_mapping_entry_t *s_entries;          /* the entries, packed at the head */
+static const esp_zb_zgps_mapping_entry_t **s_table;     /* the pointers handed to the sink, NULL beyond the entries */
+static uint16_t *s_next;                                /* the next entry in the same bucket */
+static uint16_t *s_bucket;                              /* the first entry of each bucket */
+static uint32_t *s_dirty;                               /* the slots to save */
+static uint16_t s_bucket_mask;
+static uint16_t s_capacity;
+static uint16_t s_table_size;
+static uint16_t s_count;
+static SemaphoreHandle_t s_lock;
+static TimerHandle_t s_flush_timer;
+
+static const char *TAG = "ESP_ZGP_MAPPING_TABLE";
+
+static void zgp_mapping_table_entry_id(const esp_zb_zgps_mapping_entry_t *entry, esp_zb_zgpd_id_t *zgpd_id)
+{
+    zgpd_id->app_id = entry->options & 7U;
+    zgpd_id->endpoint = entry->gpd_endpoint;
+    memcpy(&zgpd_id->addr, &entry->gpd_id, sizeof(esp_zb_zgpd_addr_t));
+}
+
+static bool zgp_mapping_table_entry_match(uint16_t slot, const esp_zb_zgpd_id_t *zgpd_id)
+{
+    esp_zb_zgpd_id_t id;
+
+    zgp_mapping_table_entry_id(&s_entries[slot], &id);
+    return ESP_ZB_ZGPD_IDS_COMPARE(&id, zgpd_id);
+}
+
+/* FNV-1a over the fields ESP_ZB_ZGPD_IDS_COMPARE() compares, so the same GPD always lands in the same bucket */
+static uint16_t zgp_mapping_table_hash(const esp_zb_zgpd_id_t *zgpd_id)
+{
+    const uint8_t *addr = (const uint8_t *)&zgpd_id->addr;
+    uint8_t len = (zgpd_id->app_id == ESP_ZB_ZGP_APP_ID_0000) ? sizeof(uint32_t) : sizeof(esp_zb_ieee_addr_t);
+    uint32_t hash = (2166136261UL ^ zgpd_id->app_id) * 16777619UL;
+
+    for (uint8_t i = 0; i < len; i ++) {
+        hash = (hash ^ addr[i]) * 16777619UL;
+    }
+    if (zgpd_id->app_id != ESP_ZB_ZGP_APP_ID_0000) {
+        hash = (hash ^ zgpd_id->endpoint) * 16777619UL;
+    }
+
+    return (uint16_t)(hash ^ (hash >> 16)) & s_bucket_mask;
+}
+
+static uint16_t zgp_mapping_table_slot_bucket(uint16_t slot)
+{
+    esp_zb_zgpd_id_t id;
+
+    zgp_mapping_table_entry_id(&s_entries[slot], &id);
+    return zgp_mapping_table_hash(&id);
+}
+
+static void zgp_mapping_table_mark_dirty(uint16_t slot)
+{
+    s_dirty[slot / 32] |= 1UL << (slot % 32);
+}
+
+/* Replace the link to a slot in its bucket chain */
+static void zgp_mapping_table_relink(uint16_t bucket, uint16_t slot, uint16_t new_slot)
+{
+    uint16_t *link = &s_bucket[bucket];
+
+    while (*link != ZGP_MAPPING_INDEX_NONE && *link != slot) {
+        link = &s_next[*link];
+    }
+    if (*link == slot) {
+        *link = new_slot;
+    }
+}
+
+/* Find the slot of the entry with the same GPD, command and target, the key of the mapping */
+static uint16_t zgp_mapping_table_lookup(const esp_zb_zgps_mapping_entry_t *entry)
+{
+    esp_zb_zgpd_id_t zgpd_id;
+    uint16_t slot = ZGP_MAPPING_INDEX_NONE;
+
+    zgp_mapping_table_entry_id(entry, &zgpd_id);
+    for (slot = s_bucket[zgp_mapping_table_hash(&zgpd_id)]; slot != ZGP_MAPPING_INDEX_NONE; slot = s_next[slot]) {
+        const esp_zb_zgps_mapping_entry_t *item = &s_entries[slot];
+        if (zgp_mapping_table_entry_match(slot, &zgpd_id) && item->gpd_command == entry->gpd_command &&
+            item->endpoint == entry->endpoint && item->cluster == entry->cluster) {
+            break;
+        }
+    }
+
+    return slot;
+}
+
+static void zgp_mapping_table_insert(const esp_zb_zgps_mapping_entry_t *entry)
+{
+    uint16_t slot = s_count ++;
+    uint16_t bucket = 0;
+
+    memcpy(&s_entries[slot], entry, sizeof(esp_zb_zgps_mapping_entry_t));
+    bucket = zgp_mapping_table_slot_bucket(slot);
+    s_next[slot] = s_bucket[bucket];
+    s_bucket[bucket] = slot;
+    s_table[slot] = &s_entries[slot];
+    zgp_mapping_table_mark_dirty(slot);
+}
+
+/* Remove a slot and move the last entry into it, so the entries stay packed */
+static void zgp_mapping_table_delete(uint16_t slot)
+{
+    uint16_t last = s_count - 1;
+
+    zgp_mapping_table_relink(zgp_mapping_table_slot_bucket(slot), slot, s_next[slot]);
+    if (slot != last) {
+        memcpy(&s_entries[slot], &s_entries[last], sizeof(esp_zb_zgps_mapping_entry_t));
+        s_next[slot] = s_next[last];
+        zgp_mapping_table_relink(zgp_mapping_table_slot_bucket(slot), last, slot);
+    }
+    s_table[last] = NULL;
+    s_count --;
+    zgp_mapping_table_mark_dirty(slot);
+    zgp_mapping_table_mark_dirty(last);
+}
+
+static void zgp_mapping_table_key(uint16_t slot, char *key, size_t size)
+{
+    snprintf(key, size, "m%04x", slot);
+}
+
+/**
+ * @brief Save the dirty slots to the NVS, it runs in the timer task so the Zigbee task is not blocked by the flash.
+ */
+static void zgp_mapping_table_flush(TimerHandle_t timer)
+{
+    nvs_handle_t handle = 0;
+    esp_zb_zgps_mapping_entry_t entry;
+    char key[16];
+    uint16_t saved = 0;
+
+    esp_err_t ret = nvs_open(ZGP_MAPPING_TABLE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open the mapping table storage: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    for (uint16_t i = 0; i < s_capacity; i ++) {
+        bool dirty = false;
+        bool in_use = false;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (s_dirty[i / 32] & (1UL << (i % 32))) {
+            s_dirty[i / 32] &= ~(1UL << (i % 32));
+            in_use = (i < s_count);
+            if (in_use) {
+                memcpy(&entry, &s_entries[i], sizeof(esp_zb_zgps_mapping_entry_t));
+            }
+            dirty = true;
+        }
+        xSemaphoreGive(s_lock);
+
+        if (!dirty) {
+            continue;
+        }
+
+        zgp_mapping_table_key(i, key, sizeof(key));
+        ret = in_use ? nvs_set_blob(handle, key, &entry, sizeof(esp_zb_zgps_mapping_entry_t)) : nvs_erase_key(handle, key);
+        if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Failed to save the mapping slot %d: %s", i, esp_err_to_name(ret));
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            zgp_mapping_table_mark_dirty(i);
+            xSemaphoreGive(s_lock);
+            continue;
+        }
+        saved ++;
+    }
+
+    if (saved) {
+        nvs_commit(handle);
+        ESP_LOGD(TAG, "Saved %d mapping slots", saved);
+    }
+    nvs_close(handle);
+}
+
+static void zgp_mapping_table_schedule_flush(void)
+{
+    xTimerReset(s_flush_timer, 0);
+}
+
+/* Load the entries saved, return true if they are packed again or deduplicated and some slots have to be saved */
+static bool zgp_mapping_table_load(void)
+{
+    nvs_handle_t handle = 0;
+    esp_zb_zgps_mapping_entry_t entry;
+    char key[16];
+    bool repacked = false;
+
+    if (nvs_open(ZGP_MAPPING_TABLE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        /* Nothing saved yet */
+        return false;
+    }
+
+    for (uint16_t i = 0; i < s_capacity; i ++) {
+        size_t size = sizeof(esp_zb_zgps_mapping_entry_t);
+
+        zgp_mapping_table_key(i, key, sizeof(key));
+        if (nvs_get_blob(handle, key, &entry, &size) != ESP_OK || size != sizeof(esp_zb_zgps_mapping_entry_t)) {
+            continue;
+        }
+        if (zgp_mapping_table_lookup(&entry) != ZGP_MAPPING_INDEX_NONE) {
+            /* A delete interrupted after the last entry was moved leaves a copy in its old key, the copy is erased */
+            zgp_mapping_table_mark_dirty(i);
+            repacked = true;
+            continue;
+        }
+        zgp_mapping_table_insert(&entry);
+        if (s_count - 1 == i) {
+            /* Saved in its slot already */
+            s_dirty[i / 32] &= ~(1UL << (i % 32));
+        } else {
+            /* A slot left behind by an interrupted save is packed again, the key it came from is saved as well */
+            zgp_mapping_table_mark_dirty(i);
+            repacked = true;
+        }
+    }
+    nvs_close(handle);
+
+    ESP_LOGI(TAG, "Loaded %d entries from the mapping table", s_count);
+
+    return repacked;
+}
+
+esp_err_t zgp_mapping_table_init(uint16_t capacity)
+{
+    uint32_t buckets = 1;
+
+    if (s_entries) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(capacity && capacity < ZGP_MAPPING_INDEX_NONE, ESP_ERR_INVALID_ARG, TAG, "Invalid mapping table capacity %d", capacity);
+
+    while (buckets < capacity) {
+        buckets <<= 1;
+    }
+    s_entries = calloc(capacity, sizeof(esp_zb_zgps_mapping_entry_t));
+    s_table = calloc(capacity, sizeof(esp_zb_zgps_mapping_entry_t *));
+    s_next = calloc(capacity, sizeof(uint16_t));
+    s_bucket = calloc(buckets, sizeof(uint16_t));
+    s_dirty = calloc((capacity + 31) / 32, sizeof(uint32_t));
+    s_lock = xSemaphoreCreateMutex();
+    s_flush_timer = xTimerCreate("zgp_mapping", pdMS_TO_TICKS(ZGP_MAPPING_TABLE_FLUSH_DELAY_MS), pdFALSE, NULL, zgp_mapping_table_flush);
+    if (!s_entries || !s_table || !s_next || !s_bucket || !s_dirty || !s_lock || !s_flush_timer) {
+        free(s_entries);
+        free(s_table);
+        free(s_next);
+        free(s_bucket);
+        free(s_dirty);
+        s_entries = NULL;
+        if (s_lock) {
+            vSemaphoreDelete(s_lock);
+            s_lock = NULL;
+        }
+        if (s_flush_timer) {
+            xTimerDelete(s_flush_timer, 0);
+            s_flush_timer = NULL;
+        }
+        ESP_LOGE(TAG, "Failed to allocate the mapping table");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_bucket, 0xFF, buckets * sizeof(uint16_t));
+    s_bucket_mask = buckets - 1;
+    s_capacity = capacity;
+
+    if (zgp_mapping_table_load()) {
+        zgp_mapping_table_schedule_flush();
+    }
+
+    /* The sink may keep the size it is given, so the whole table is handed over and the free slots are NULL */
+    s_table_size = capacity;
+    esp_zb_zgps_set_mapping_table(s_table, &s_table_size);
+
+    return ESP_OK;
+}
+
+esp_err_t zgp_mapping_table_add(const esp_zb_zgps_mapping_entry_t *entry)
+{
+    ESP_RETURN_ON_FALSE(entry, ESP_ERR_INVALID_ARG, TAG, "Invalid mapping entry");
+    ESP_RETURN_ON_FALSE(entry->zcl_payload_length == 0 || entry->zcl_payload_length == ESP_ZB_ZGP_MAPPING_ENTRY_PARSED_PAYLOAD,
+                        ESP_ERR_INVALID_ARG, TAG, "The mapping entry with a ZCL payload is not supported");
+
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint16_t slot = zgp_mapping_table_lookup(entry);
+    if (slot != ZGP_MAPPING_INDEX_NONE) {
+        memcpy(&s_entries[slot], entry, sizeof(esp_zb_zgps_mapping_entry_t));
+        zgp_mapping_table_mark_dirty(slot);
+    } else if (s_count < s_capacity) {
+        zgp_mapping_table_insert(entry);
+    } else {
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(s_lock);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "The mapping table is full");
+    zgp_mapping_table_schedule_flush();
+
+    return ESP_OK;
+}
+
+uint16_t zgp_mapping_table_remove(const esp_zb_zgpd_id_t *zgpd_id)
+{
+    uint16_t removed = 0;
+    uint16_t slot = ZGP_MAPPING_INDEX_NONE;
+
+    ESP_RETURN_ON_FALSE(zgpd_id, 0, TAG, "Invalid GPD identifier");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint16_t bucket = zgp_mapping_table_hash(zgpd_id);
+    slot = s_bucket[bucket];
+    while (slot != ZGP_MAPPING_INDEX_NONE) {
+        if (zgp_mapping_table_entry_match(slot, zgpd_id)) {
+            zgp_mapping_table_delete(slot);
+            removed ++;
+            /* The delete rewrites the chain, it is walked again from the head */
+            slot = s_bucket[bucket];
+        } else {
+            slot = s_next[slot];
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (removed) {
+        zgp_mapping_table_schedule_flush();
+    }
+
+    return removed;
+}
+
+const esp_zb_zgps_mapping_entry_t *zgp_mapping_table_find(const esp_zb_zgpd_id_t *zgpd_id, uint8_t gpd_command)
+{
+    const esp_zb_zgps_mapping_entry_t *found = NULL;
+
+    ESP_RETURN_ON_FALSE(zgpd_id, NULL, TAG, "Invalid GPD identifier");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint16_t slot = s_bucket[zgp_mapping_table_hash(zgpd_id)]; slot != ZGP_MAPPING_INDEX_NONE; slot = s_next[slot]) {
+        if (!zgp_mapping_table_entry_match(slot, zgpd_id)) {
+            continue;
+        }
+        if (s_entries[slot].gpd_command == gpd_command) {
+            found = &s_entries[slot];
+            break;
+        }
+        /* The exact command wins over the entry for any command */
+        if (!found && s_entries[slot].gpd_command == ESP_ZB_GPDF_CMD_UNDEFINED) {
+            found = &s_entries[slot];
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    return found;
+}
+
+uint16_t zgp_mapping_table_count(void)
+{
+    return s_count;
+}
+
+esp_err_t zgp_mapping_table_clear(void)
+{
+    nvs_handle_t handle = 0;
+
+    ESP_RETURN_ON_FALSE(s_entries, ESP_ERR_INVALID_STATE, TAG, "The mapping table is not initialized");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < s_count; i ++) {
+        s_table[i] = NULL;
+    }
+    s_count = 0;
+    memset(s_bucket, 0xFF, (s_bucket_mask + 1) * sizeof(uint16_t));
+    memset(s_dirty, 0, (s_capacity + 31) / 32 * sizeof(uint32_t));
+    xSemaphoreGive(s_lock);
+
+    esp_err_t ret = nvs_open(ZGP_MAPPING_TABLE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to open the mapping table storage");
+    ret = nvs_erase_all(handle);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return ret;
+}
@@ -130,12 +130,12 @@ static esp_err_t zb_attribute_handler(const esp_zb_zcl_set_attr_value_message_t
             } else {
                 ESP_LOGW(TAG, "Color control cluster data: attribute(0x%x), type(0x%x)", message->attribute.id, message->attribute.data.type);
             }
-            light_driver_set_color_xy(light_color_x, light_color_y);
+            light_driver_set_color_xy_transition(light_color_x, light_color_y, LIGHT_DRIVER_TRANSITION_MS);
             break;
         case ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL:
             if (message->attribute.id == ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U8) {
                 light_level = message->attribute.data.value ? *(uint8_t *)message->attribute.data.value : light_level;
-                light_driver_set_level((uint8_t)light_level);
+                light_driver_set_level_transition((uint8_t)light_level, LIGHT_DRIVER_TRANSITION_MS);
                 ESP_LOGI(TAG, "Light level changes to %d", light_level);
             } else {
                 ESP_LOGW(TAG, "Level Control cluster data: attribute(0x%x), type(0x%x)", message->attribute.id, message->attribute.data.type);
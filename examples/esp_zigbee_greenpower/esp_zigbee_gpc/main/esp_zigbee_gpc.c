@@ -20,6 +20,9 @@
 #include <string.h>
 #include "ha/esp_zigbee_ha_standard.h"
 #include "zgp/esp_zigbee_zgps.h"
+#include "aps/esp_zigbee_aps.h"
+#include "zgp_mapping_table.h"
+#include "zgp_dup_filter.h"
 #include "esp_zigbee_gpc.h"
 
 #if ! defined ZB_ZGP_SIMPLE_COMBO_START_AS_ZR && ! defined ZB_COORDINATOR_ROLE
@@ -36,14 +39,6 @@
 
 static const char *TAG = "ESP_ZGP_COMBO";
 
-static esp_zb_zgps_mapping_entry_t zgp_mapping_table_items[ZGP_MAX_MAPPING_TABLE_ENTRIES] = {
-    {0},
-};
-static esp_zb_zgps_mapping_entry_t *zgp_mapping_table[ZGP_MAX_MAPPING_TABLE_ENTRIES] = {
-    NULL,
-};
-static uint16_t zgp_mapping_table_length = ZGP_MAX_MAPPING_TABLE_ENTRIES;
-
 static void zb_zgp_accept_commissioning_handler(esp_zgp_approve_comm_params_t *params);
 static void zb_zgp_commissioning_done_handler(esp_zb_zgpd_id_t zgpd_id, esp_zb_zgp_comm_status_t result);
 static void zb_zgp_mode_change_handler(esp_zb_zgp_mode_t new_mode, esp_zb_zgp_mode_change_reason_t reason);
@@ -196,6 +191,59 @@ static esp_err_t zb_green_power_handler(const esp_zb_zcl_cmd_green_power_recv_me
     return ret;
 }
 
+/* Read the GPD identifier and the security frame counter of a GP Notification, return false if the frame is not one */
+static bool zgp_notification_parse(const esp_zb_apsde_data_ind_t *ind, esp_zb_zgpd_id_t *zgpd_id, uint32_t *seq)
+{
+    const uint8_t *zcl = ind->asdu;
+    uint16_t head = 3;
+    uint16_t options = 0;
+
+    if (!zcl || ind->asdu_length < head) {
+        return false;
+    }
+    /* The cluster specific command to the sink, the manufacturer code is present if the frame control tells */
+    if (zcl[0] & 0x04) {
+        head += 2;
+    }
+    if ((zcl[0] & 0x03) != 0x01 || (zcl[0] & 0x08) || ind->asdu_length < head + 2 || zcl[head - 1] != ZGP_NOTIFICATION_CMD) {
+        return false;
+    }
+    zcl += head;
+    options = zcl[0] | (zcl[1] << 8);
+    memset(zgpd_id, 0, sizeof(esp_zb_zgpd_id_t));
+    zgpd_id->app_id = options & 0x07;
+    zcl += 2;
+    /* The GPD SrcID, or the GPD IEEE address and endpoint, then the security frame counter, which is the MAC
+     * sequence number of the GPDF if the GPD is not secured */
+    if (zgpd_id->app_id == ESP_ZB_ZGP_APP_ID_0000 && ind->asdu_length >= head + 2 + 4 + 4) {
+        zgpd_id->addr.src_id = zcl[0] | (zcl[1] << 8) | (zcl[2] << 16) | ((uint32_t)zcl[3] << 24);
+        zcl += 4;
+    } else if (zgpd_id->app_id == ESP_ZB_ZGP_APP_ID_0010 && ind->asdu_length >= head + 2 + 9 + 4) {
+        memcpy(zgpd_id->addr.ieee_addr, zcl, sizeof(esp_zb_ieee_addr_t));
+        zgpd_id->endpoint = zcl[8];
+        zcl += 9;
+    } else {
+        return false;
+    }
+    *seq = zcl[0] | (zcl[1] << 8) | (zcl[2] << 16) | ((uint32_t)zcl[3] << 24);
+    return true;
+}
+
+/* Drop the copies of a GPDF forwarded by several proxies before the sink translates it, the other frames are
+ * processed by the stack */
+static bool zb_apsde_data_indication_handler(esp_zb_apsde_data_ind_t ind)
+{
+    esp_zb_zgpd_id_t zgpd_id;
+    uint32_t seq = 0;
+
+    if (ind.status == 0 && ind.cluster_id == ESP_ZB_ZCL_CLUSTER_ID_GREEN_POWER && zgp_notification_parse(&ind, &zgpd_id, &seq) &&
+        zgp_dup_filter_check(&zgpd_id, seq)) {
+        ESP_LOGD(TAG, "Drop the duplicate GP Notification from proxy(0x%04hx), frame counter(%lu)", ind.src_short_addr, seq);
+        return true;
+    }
+    return false;
+}
+
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
     esp_err_t ret = ESP_OK;
@@ -220,7 +268,8 @@ static void esp_zb_task(void *pvParameters)
 
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     esp_zb_zgp_set_skip_gpdf(!ZGP_COMBO_PROXY_ENABLED);
-    esp_zb_zgps_set_mapping_table((const esp_zb_zgps_mapping_entry_t **)zgp_mapping_table, &zgp_mapping_table_length);
+    ESP_ERROR_CHECK(zgp_mapping_table_init(ZGP_MAX_MAPPING_TABLE_ENTRIES));
+    zgp_dup_filter_init();
     esp_zb_zgps_set_communication_mode(ESP_ZB_ZGP_COMMUNICATION_MODE_GROUPCAST_DERIVED);
     esp_zb_zgps_set_commissioning_exit_mode(ESP_ZGP_COMMISSIONING_EXIT_MODE_ON_PAIRING_SUCCESS);
     esp_zb_zgps_set_commissioning_window(180);
@@ -239,6 +288,7 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_ep_list_add_ep(ep_list, esp_zb_on_off_light_clusters_create(&light_cfg), endpoint_config);
     esp_zb_device_register(ep_list);
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_aps_data_indication_handler_register(zb_apsde_data_indication_handler);
 
     ESP_ERROR_CHECK(esp_zb_start(false));
     esp_zb_main_loop_iteration();
@@ -257,44 +307,26 @@ void app_main()
 
 static bool mapping_table_delete_entry_by_zgpd_id(esp_zb_zgpd_id_t *zgpd_id)
 {
-    for (uint8_t i = 0; i < ZGP_MAX_MAPPING_TABLE_ENTRIES; i++) {
-        if (zgp_mapping_table[i] != NULL) {
-            esp_zb_zgpd_id_t id = {
-                .app_id = zgp_mapping_table[i]->options & 7U,
-                .endpoint = zgp_mapping_table[i]->gpd_endpoint,
-                .addr = zgp_mapping_table[i]->gpd_id,
-            };
-
-            if (ESP_ZB_ZGPD_IDS_COMPARE(zgpd_id, &id)) {
-                zgp_mapping_table[i] = NULL;
-            }
-        }
-    }
-
+    zgp_mapping_table_remove(zgpd_id);
     return true;
 }
 
 static bool mapping_table_add_entry(esp_zb_zgpd_id_t *zgpd_id, uint8_t gpd_command, uint8_t endpoint, uint16_t profile, uint16_t cluster_id,
                                     uint8_t zcl_command)
 {
-    for (uint8_t i = 0; i < ZGP_MAX_MAPPING_TABLE_ENTRIES; i++) {
-        if (zgp_mapping_table[i] == NULL) {
-            esp_zb_zgps_mapping_entry_t *entry;
-            entry = &zgp_mapping_table_items[i];
-            entry->options = zgpd_id->app_id;
-            memcpy(&entry->gpd_id, &zgpd_id->addr, sizeof(esp_zb_zgpd_addr_t));
-            entry->gpd_endpoint = zgpd_id->endpoint;
-            entry->gpd_command = gpd_command;
-            entry->endpoint = endpoint;
-            entry->profile = profile;
-            entry->cluster = cluster_id;
-            entry->zcl_command = zcl_command;
-            entry->zcl_payload_length = ESP_ZB_ZGP_MAPPING_ENTRY_PARSED_PAYLOAD;
-            zgp_mapping_table[i] = entry;
-            return true;
-        }
-    }
-    return false;
+    esp_zb_zgps_mapping_entry_t entry = {
+        .options = zgpd_id->app_id,
+        .gpd_endpoint = zgpd_id->endpoint,
+        .gpd_command = gpd_command,
+        .endpoint = endpoint,
+        .profile = profile,
+        .cluster = cluster_id,
+        .zcl_command = zcl_command,
+        .zcl_payload_length = ESP_ZB_ZGP_MAPPING_ENTRY_PARSED_PAYLOAD,
+    };
+
+    memcpy(&entry.gpd_id, &zgpd_id->addr, sizeof(esp_zb_zgpd_addr_t));
+    return zgp_mapping_table_add(&entry) == ESP_OK;
 }
 
 static void zb_zgp_accept_commissioning_handler(esp_zgp_approve_comm_params_t *params)
@@ -28,6 +28,7 @@
 #define ESP_ZGP_GPSB_FUNCTIONALITY 0x9ac3f       /*!< GPS functionality, refer to esp_zgp_gps_functionality_t */
 #define ESP_ZGP_GPBB_FUNCTIONALITY 0x9ac3f       /*!< GPP functionality, refer to esp_zgp_gpp_functionality_t */
 #define ESP_ZGP_ACTIVE_FUNCTIONALITY_ID 0xFFFFFF /*!< Active GP functionality */
+#define ZGP_NOTIFICATION_CMD 0x00               /*!< GP Notification command the proxies forward a GPDF with */
 
 /* Zigbee coordinator configuration */
 #define ESP_ZB_ZC_CONFIG()                                              \
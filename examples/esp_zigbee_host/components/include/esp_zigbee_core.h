@@ -13,6 +13,7 @@ extern "C" {
 #include "esp_zigbee_type.h"
 #include "zcl/esp_zigbee_zcl_command.h"
 #include "zdo/esp_zigbee_zdo_command.h"
+#include "aps/esp_zigbee_aps.h"
 
 #define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK 0x07FFF800U /*!< channel 11-26 for compatibility with 2.4GHZ*/
 
@@ -311,6 +312,16 @@ void *esp_zb_app_signal_get_params(uint32_t *signal_p);
  */
 void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time);
 
+/**
+ * @brief Cancel scheduled alarm.
+ *
+ * @note This function cancel previously scheduled alarm.
+ *
+ * @param[in] cb - function to cancel
+ * @param[in] param - parameter to pass to the function to cancel
+ */
+void esp_zb_scheduler_alarm_cancel(esp_zb_callback_t cb, uint8_t param);
+
 /* ZCL attribute, cluster, endpoint, device related */
 
 /**
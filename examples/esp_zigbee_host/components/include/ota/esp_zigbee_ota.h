@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_zigbee_type.h"
+
+/**
+ * @brief The Zigbee ZCL OTA file header struct.
+ *
+ */
+typedef struct esp_zb_ota_file_header_s {
+    uint16_t manufacturer_code;                /*!< OTA header manufacturer code */
+    uint16_t image_type;                       /*!< Image type value to distinguish the products */
+    uint32_t file_version;                     /*!< File version represents the release and build number of the image’s application and stack */
+    uint32_t image_size;                       /*!< Total image size in bytes transferred from the server to the client */
+} esp_zb_ota_file_header_t;
+
+/**
+ * @brief The enumeration of the OTA upgrade server status
+ *
+ */
+typedef enum esp_zb_ota_upgrade_server_status_e {
+    ESP_ZB_ZCL_OTA_UPGRADE_SERVER_STARTED = 0x00,   /*!< The client starts to download the image */
+    ESP_ZB_ZCL_OTA_UPGRADE_SERVER_ABORTED = 0x01,   /*!< The download of the client is aborted */
+    ESP_ZB_ZCL_OTA_UPGRADE_SERVER_END     = 0x02,   /*!< The client completes the download */
+} esp_zb_ota_upgrade_server_status_t;
+
+/**
+ * @brief A callback for the OTA server to read the OTA image data stored on the host
+ *
+ * @note It is called from the main loop when the NCP prefetches the image for a client, the NCP caches the data so the
+ *       clients are served without waiting for the host.
+ *
+ * @param[in]  index  The index of the OTA image
+ * @param[in]  offset The offset of the data in the image
+ * @param[in]  size   The size of the data to read
+ * @param[out] data   The buffer to store the data, at least @p size bytes
+ *
+ * @return
+ *      - ESP_OK: On success, the client is aborted otherwise
+ */
+typedef esp_err_t (*esp_zb_ota_upgrade_server_read_callback_t)(uint8_t index, uint32_t offset, uint16_t size, uint8_t *data);
+
+/**
+ * @brief A callback for the OTA server to report the upgrade status of a client
+ *
+ * @param[in] short_addr The short address of the OTA client
+ * @param[in] index      The index of the OTA image, 0xFF if unknown
+ * @param[in] status     The upgrade status, refer to esp_zb_ota_upgrade_server_status_t
+ * @param[in] offset     The offset of the image served to the client
+ *
+ */
+typedef void (*esp_zb_ota_upgrade_server_status_callback_t)(uint16_t short_addr, uint8_t index, esp_zb_ota_upgrade_server_status_t status, uint32_t offset);
+
+/**
+ * @brief The Zigbee ZCL OTA upgrade server notification request struct
+ *
+ */
+typedef struct esp_zb_ota_upgrade_server_notify_req_s {
+    uint8_t endpoint;                                       /*!< The endpoint identifier for ota server cluster */
+    uint8_t index;                                          /*!< The index of OTA file */
+    uint8_t notify_on;                                      /*!< The field indicates whether send the notification request directly */
+    uint32_t ota_upgrade_time;                              /*!< The time indicates the interval for the OTA file upgrade after the OTA process is completed */
+    esp_zb_ota_file_header_t ota_file_header;               /*!< The header is used to register the basic OTA upgrade information */
+    esp_zb_ota_upgrade_server_read_callback_t read_cb;      /*!< The callback is used to read the OTA data requested by the NCP */
+    esp_zb_ota_upgrade_server_status_callback_t status_cb;  /*!< The callback is used to report the upgrade status of the clients, could be NULL */
+} esp_zb_ota_upgrade_server_notify_req_t;
+
+/********************* Declare functions **************************/
+/**
+ * @brief Notify the image upgrade event of OTA upgrade server
+ *
+ * @note Only the header of the image is sent to the NCP, the image data stays on the host and is read on demand through the
+ *       @p read_cb. The image registered with the same index is replaced.
+ *
+ * @param[in] req The OTA file information request @ref esp_zb_ota_upgrade_server_notify_req_s
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not serve the OTA images from the host
+ *      - ESP_ERR_INVALID_ARG: The input arguments are incorrect or invalid.
+ *      - ESP_FAIL: The NCP fails to register the image
+ */
+esp_err_t esp_zb_ota_upgrade_server_notify_req(esp_zb_ota_upgrade_server_notify_req_t *req);
+
+#ifdef __cplusplus
+}
+#endif
@@ -372,6 +372,32 @@ typedef struct esp_zb_zcl_color_step_color_temperature_cmd_s {
     uint16_t color_temperature_maximum;     /*!< The field specifies a upper bound on the Color-Temperature attribute*/
 } esp_zb_zcl_color_step_color_temperature_cmd_t;
 
+/**
+ * @brief The Zigbee ZCL configure report record struct
+ *
+ */
+typedef struct esp_zb_zcl_config_report_record_s {
+    esp_zb_zcl_cmd_direction_t direction;   /*!< Direction field specifies whether values of the attribute are to be reported, or whether reports of the
+                                                 attribute are to be received.*/
+    uint16_t attributeID;                   /*!< Attribute ID to report */
+    uint8_t attrType;                       /*!< Attribute type to report refer to esp_zb_zcl_attr_type_t */
+    uint16_t min_interval;                  /*!< Minimum reporting interval */
+    uint16_t max_interval;                  /*!< Maximum reporting interval */
+    void *reportable_change;                /*!< Minimum change to attribute will result in report, NULL for the discrete attribute */
+} esp_zb_zcl_config_report_record_t;
+
+/**
+ * @brief The Zigbee ZCL configure report command struct
+ *
+ */
+typedef struct esp_zb_zcl_config_report_cmd_s {
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd;               /*!< Basic command info */
+    esp_zb_zcl_address_mode_t address_mode;             /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+    uint16_t clusterID;                                 /*!< Cluster ID to report */
+    uint16_t record_number;                             /*!< Number of report configuration record in the record_field */
+    esp_zb_zcl_config_report_record_t *record_field;    /*!< Report configuration records, @ref esp_zb_zcl_config_report_record_s */
+} esp_zb_zcl_config_report_cmd_t;
+
 /**
  * @brief The Zigbee ZCL custom cluster command struct
  *
@@ -696,6 +722,19 @@ uint8_t esp_zb_zcl_color_step_color_temperature_cmd_req(esp_zb_zcl_color_step_co
  */
 uint8_t esp_zb_zcl_custom_cluster_cmd_req(esp_zb_zcl_custom_cluster_cmd_req_t *cmd_req);
 
+/**
+ * @brief   Send configure reporting command
+ *
+ * @param[in]  cmd_req  pointer to the config report command @ref esp_zb_zcl_config_report_cmd_s
+ *
+ * @return
+ *      - ESP_OK: The NCP sends the command
+ *      - ESP_ERR_INVALID_ARG: No reporting record
+ *      - ESP_ERR_NO_MEM: Failed to allocate the frame
+ *      - ESP_FAIL: The NCP rejects the command
+ */
+esp_err_t esp_zb_zcl_config_report_cmd_req(esp_zb_zcl_config_report_cmd_t *cmd_req);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,147 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_zigbee_type.h"
+#include "esp_zigbee_zcl_command.h"
+
+/**
+ * @brief A target of the fan-out request
+ *
+ */
+typedef struct esp_zb_zcl_fanout_target_s {
+    uint16_t short_addr;                                /*!< The short address of the target */
+    uint8_t endpoint;                                   /*!< The endpoint of the target */
+} esp_zb_zcl_fanout_target_t;
+
+/**
+ * @brief An attribute read from a target
+ *
+ */
+typedef struct esp_zb_zcl_fanout_attr_s {
+    uint16_t id;                                        /*!< The attribute identifier */
+    uint8_t status;                                     /*!< The status of the attribute, refer to esp_zb_zcl_status_t */
+    uint8_t type;                                       /*!< The type of the attribute, refer to esp_zb_zcl_attr_type_t */
+    uint16_t size;                                      /*!< The size of the value */
+    const void *value;                                  /*!< The value of the attribute, valid only in the callback */
+} esp_zb_zcl_fanout_attr_t;
+
+/**
+ * @brief The status of an attribute configured by the bulk reporting configuration
+ *
+ */
+typedef struct esp_zb_zcl_fanout_config_status_s {
+    uint8_t status;                                     /*!< The status of the reporting configuration, refer to esp_zb_zcl_status_t */
+    uint8_t direction;                                  /*!< The direction of the reporting configuration */
+    uint16_t attribute_id;                              /*!< The attribute identifier, 0xFFFF if all the attributes succeed */
+} esp_zb_zcl_fanout_config_status_t;
+
+/**
+ * @brief The result of a target of the fan-out request
+ *
+ */
+typedef struct esp_zb_zcl_fanout_result_s {
+    uint16_t short_addr;                                /*!< The short address of the target */
+    uint8_t endpoint;                                   /*!< The endpoint of the target */
+    uint8_t status;                                     /*!< The status of the response, ESP_ZB_ZCL_STATUS_TIMEOUT if the target does not answer */
+    uint16_t cluster_id;                                /*!< The cluster read or configured */
+    uint8_t attr_count;                                 /*!< The number of the entries in the attr_list or the config_list */
+    const esp_zb_zcl_fanout_attr_t *attr_list;          /*!< The attributes read, NULL for the bulk reporting configuration */
+    const esp_zb_zcl_fanout_config_status_t *config_list; /*!< The statuses of the reporting configuration, NULL for the fan-out read */
+} esp_zb_zcl_fanout_result_t;
+
+/**
+ * @brief A callback for the results of the fan-out request
+ *
+ * @note It is called from the main loop once per target, then once with the result NULL when all the targets are done.
+ *       The lists in the result are valid only in the callback.
+ *
+ * @param[in] handle   The handle of the fan-out request
+ * @param[in] result   The result of a target, NULL if the fan-out request is done
+ * @param[in] user_ctx The user context of the fan-out request
+ *
+ */
+typedef void (*esp_zb_zcl_fanout_callback_t)(uint8_t handle, const esp_zb_zcl_fanout_result_t *result, void *user_ctx);
+
+/**
+ * @brief The fan-out read request
+ *
+ */
+typedef struct esp_zb_zcl_fanout_read_cmd_s {
+    uint8_t src_endpoint;                               /*!< The source endpoint of the read requests */
+    uint16_t cluster_id;                                /*!< The cluster to read */
+    uint16_t interval_ms;                               /*!< The interval between two read requests, 0 for the default of the NCP */
+    uint16_t timeout_ms;                                /*!< The time to wait for the response of a target, 0 for the default of the NCP */
+    uint8_t attr_number;                                /*!< The number of the attributes in the attr_field */
+    const uint16_t *attr_field;                         /*!< The attributes to read */
+    uint16_t target_count;                              /*!< The number of the targets in the target_list */
+    const esp_zb_zcl_fanout_target_t *target_list;      /*!< The targets to read */
+    esp_zb_zcl_fanout_callback_t cb;                    /*!< The callback for the results */
+    void *user_ctx;                                     /*!< The user context passed to the callback */
+} esp_zb_zcl_fanout_read_cmd_t;
+
+/**
+ * @brief Read the same attributes from many nodes with one request to the NCP.
+ *
+ * @note The NCP paces the unicast read requests and aggregates the responses into a few notifications, the targets
+ *       which do not answer in time are reported with ESP_ZB_ZCL_STATUS_TIMEOUT.
+ *
+ * @param[in]  cmd_req The fan-out read request
+ * @param[out] handle  The handle of the fan-out read passed to the callback, could be NULL
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not support the fan-out read
+ *      - ESP_ERR_INVALID_SIZE: The request does not fit in a frame
+ *      - ESP_ERR_NO_MEM: Too many fan-out reads in progress
+ *      - ESP_FAIL: The NCP rejects the request
+ */
+esp_err_t esp_zb_zcl_fanout_read_attr_cmd_req(const esp_zb_zcl_fanout_read_cmd_t *cmd_req, uint8_t *handle);
+
+/**
+ * @brief The bulk reporting configuration request
+ *
+ */
+typedef struct esp_zb_zcl_fanout_config_report_cmd_s {
+    uint8_t src_endpoint;                               /*!< The source endpoint of the configure reporting commands */
+    uint16_t cluster_id;                                /*!< The cluster to configure */
+    uint16_t interval_ms;                               /*!< The interval between two commands, 0 for the default of the NCP */
+    uint16_t timeout_ms;                                /*!< The time to wait for the response of a target, 0 for the default of the NCP */
+    uint8_t record_number;                              /*!< The number of the reporting records in the record_field */
+    const esp_zb_zcl_config_report_record_t *record_field;  /*!< The reporting profile applied to every target */
+    uint16_t target_count;                              /*!< The number of the targets in the target_list */
+    const esp_zb_zcl_fanout_target_t *target_list;      /*!< The targets to configure */
+    esp_zb_zcl_fanout_callback_t cb;                    /*!< The callback for the results */
+    void *user_ctx;                                     /*!< The user context passed to the callback */
+} esp_zb_zcl_fanout_config_report_cmd_t;
+
+/**
+ * @brief Configure the same reporting on many nodes with one request to the NCP.
+ *
+ * @note It is used to switch the nodes from polling to reporting at commissioning time. The NCP paces the configure
+ *       reporting commands like the fan-out read and aggregates the responses, the targets which do not answer in time
+ *       are reported with ESP_ZB_ZCL_STATUS_TIMEOUT.
+ *
+ * @param[in]  cmd_req The bulk reporting configuration request
+ * @param[out] handle  The handle of the request passed to the callback, could be NULL
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not support the fan-out request
+ *      - ESP_ERR_INVALID_SIZE: The request does not fit in a frame
+ *      - ESP_ERR_NO_MEM: Too many fan-out requests in progress
+ *      - ESP_FAIL: The NCP rejects the request
+ */
+esp_err_t esp_zb_zcl_fanout_config_report_cmd_req(const esp_zb_zcl_fanout_config_report_cmd_t *cmd_req, uint8_t *handle);
+
+#ifdef __cplusplus
+}
+#endif
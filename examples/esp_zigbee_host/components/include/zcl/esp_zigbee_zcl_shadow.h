@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_zigbee_type.h"
+#include "esp_zigbee_zcl_command.h"
+
+/**
+ * @brief An attribute kept in the attribute shadow
+ *
+ */
+typedef struct esp_zb_zcl_shadow_attr_s {
+    uint16_t short_addr;                                /*!< The short address of the node */
+    uint8_t endpoint;                                   /*!< The endpoint of the node */
+    uint16_t cluster_id;                                /*!< The cluster identifier */
+    uint16_t attr_id;                                   /*!< The attribute identifier */
+    uint8_t type;                                       /*!< The type of the attribute, refer to esp_zb_zcl_attr_type_t */
+    uint8_t size;                                       /*!< The size of the value, 0 if no value is kept */
+    uint32_t age_ms;                                    /*!< The milliseconds since the value was reported or read */
+    const void *value;                                  /*!< The value of the attribute */
+} esp_zb_zcl_shadow_attr_t;
+
+/**
+ * @brief A callback for the attributes updated in the attribute shadow
+ *
+ * @note It is called from the main loop for each attribute reported or read, the value is valid only in the callback.
+ *
+ * @param[in] attr     The attribute updated
+ * @param[in] user_ctx The user context passed to esp_zb_zcl_shadow_update_handler_register()
+ *
+ */
+typedef void (*esp_zb_zcl_shadow_update_callback_t)(const esp_zb_zcl_shadow_attr_t *attr, void *user_ctx);
+
+/**
+ * @brief The read request served by the attribute shadow
+ *
+ */
+typedef struct esp_zb_zcl_shadow_read_cmd_s {
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd;               /*!< Basic command info, the destination is the short address of the node */
+    uint16_t cluster_id;                                /*!< The cluster identifier */
+    uint16_t attr_id;                                   /*!< The attribute identifier */
+    uint32_t max_age_ms;                                /*!< The maximum age of the value kept, 0 to always read it from the node */
+} esp_zb_zcl_shadow_read_cmd_t;
+
+/**
+ * @brief Read an attribute from the attribute shadow, it goes to the air only if the value kept is missing or stale.
+ *
+ * @note The attribute shadow is fed by the attribute reports and the read attribute responses notified by the NCP.
+ *       On a stale miss a read request is sent to the node unless one is already in flight, and the stale value is
+ *       still copied if it is kept. The fresh value is delivered to the update callback when the response arrives.
+ *
+ * @param[in]  cmd_req    The read request
+ * @param[out] attr       The attribute kept, its value points to the value buffer if it is copied
+ * @param[out] value      The buffer to copy the value to, could be NULL to get the type and the size only
+ * @param[in]  value_size The size of the value buffer
+ *
+ * @return
+ *      - ESP_OK: The value kept is not older than the maximum age
+ *      - ESP_ERR_NOT_FINISHED: The value kept is missing or stale, a read request is sent or in flight
+ *      - ESP_ERR_INVALID_SIZE: The value buffer is smaller than the size of the value
+ *      - ESP_ERR_NOT_SUPPORTED: The attribute shadow is disabled
+ */
+esp_err_t esp_zb_zcl_shadow_read(const esp_zb_zcl_shadow_read_cmd_t *cmd_req, esp_zb_zcl_shadow_attr_t *attr, void *value, uint8_t value_size);
+
+/**
+ * @brief Register the callback for the attributes updated in the attribute shadow
+ *
+ * @param[in] cb       The callback, NULL to unregister it
+ * @param[in] user_ctx The user context passed to the callback
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The attribute shadow is disabled
+ */
+esp_err_t esp_zb_zcl_shadow_update_handler_register(esp_zb_zcl_shadow_update_callback_t cb, void *user_ctx);
+
+/**
+ * @brief Remove all the attributes of a node from the attribute shadow, e.g. after the node leaves the network
+ *
+ * @param[in] short_addr The short address of the node
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The attribute shadow is disabled
+ */
+esp_err_t esp_zb_zcl_shadow_remove_node(uint16_t short_addr);
+
+/**
+ * @brief Remove all the attributes from the attribute shadow
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The attribute shadow is disabled
+ */
+esp_err_t esp_zb_zcl_shadow_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+#include "esp_zigbee_type.h"
+
+#define ESP_ZB_NODE_EP_NUM          4           /*!< The maximum number of the endpoints kept for a node on the NCP */
+#define ESP_ZB_NODE_CLUSTER_NUM     8           /*!< The maximum number of the clusters kept for an endpoint on the NCP */
+
+/**
+ * @brief The endpoint of a node in the node table
+ *
+ */
+typedef struct esp_zb_node_endpoint_s {
+    uint8_t endpoint;                                   /*!< The endpoint identifier */
+    uint16_t profile_id;                                /*!< The profile identifier of the endpoint */
+    uint8_t cluster_count;                              /*!< The number of the clusters matched on the endpoint */
+    uint16_t cluster_list[ESP_ZB_NODE_CLUSTER_NUM];     /*!< The clusters matched on the endpoint by the match descriptor requests */
+} esp_zb_node_endpoint_t;
+
+/**
+ * @brief The node in the node table kept on the NCP
+ *
+ */
+typedef struct esp_zb_node_info_s {
+    uint16_t short_addr;                                /*!< The short address of the node */
+    esp_zb_ieee_addr_t ieee_addr;                       /*!< The IEEE address of the node */
+    uint8_t capability;                                 /*!< The MAC capability of the node from the device announcement */
+    uint8_t lqi;                                        /*!< The LQI of the last frame received from the node */
+    uint32_t age;                                       /*!< The seconds since the node was last seen, 0xFFFFFFFF if not seen since the NCP boots */
+    uint8_t ep_count;                                   /*!< The number of the endpoints */
+    esp_zb_node_endpoint_t ep[ESP_ZB_NODE_EP_NUM];      /*!< The endpoints of the node */
+} esp_zb_node_info_t;
+
+/**
+ * @brief A callback for each node in the node table
+ *
+ * @param[in] node     The node
+ * @param[in] user_ctx The user context passed to esp_zb_node_table_foreach()
+ *
+ * @return
+ *      - true: Continue with the next node
+ *      - false: Stop the iteration
+ */
+typedef bool (*esp_zb_node_table_callback_t)(const esp_zb_node_info_t *node, void *user_ctx);
+
+/**
+ * @brief Iterate the node table kept on the NCP, a page of nodes is fetched per frame.
+ *
+ * @note It is used to rebuild the model of the network after the host restarts, without discovering the nodes over the air.
+ *
+ * @param[in] cb       The callback for each node
+ * @param[in] user_ctx The user context passed to the callback
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not keep the node table
+ *      - ESP_ERR_NO_MEM: Failed to allocate the page buffer
+ *      - ESP_FAIL: The NCP fails to dump the node table
+ */
+esp_err_t esp_zb_node_table_foreach(esp_zb_node_table_callback_t cb, void *user_ctx);
+
+/**
+ * @brief Query a node in the node table by its short address
+ *
+ * @param[in]  short_addr The short address of the node
+ * @param[out] node       The node found
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not keep the node table
+ *      - ESP_ERR_NOT_FOUND: The node is not in the node table
+ */
+esp_err_t esp_zb_node_table_query_by_short(uint16_t short_addr, esp_zb_node_info_t *node);
+
+/**
+ * @brief Query a node in the node table by its IEEE address
+ *
+ * @param[in]  ieee_addr The IEEE address of the node
+ * @param[out] node      The node found
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not keep the node table
+ *      - ESP_ERR_NOT_FOUND: The node is not in the node table
+ */
+esp_err_t esp_zb_node_table_query_by_ieee(const esp_zb_ieee_addr_t ieee_addr, esp_zb_node_info_t *node);
+
+/**
+ * @brief Clear the node table on the NCP and its copy in the NVS of the NCP
+ *
+ * @return
+ *      - ESP_OK: On success
+ *      - ESP_ERR_NOT_SUPPORTED: The NCP does not keep the node table
+ *      - ESP_FAIL: The NCP fails to clear the node table
+ */
+esp_err_t esp_zb_node_table_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
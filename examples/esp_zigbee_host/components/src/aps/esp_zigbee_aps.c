@@ -0,0 +1,431 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "esp_host_zb.h"
+
+#include "esp_zigbee_zcl_command.h"
+#include "esp_zigbee_aps.h"
+
+#define HOST_APS_CHUNK_SESSION_NUM      4                   /*!< The maximum number of the chunked indications in progress */
+#define HOST_APS_CHUNK_TIMEOUT_MS       5000                /*!< The chunked indication is dropped if no progress in this time */
+#define HOST_APS_CHUNK_ACK_TIMEOUT_MS   1000                /*!< The window end chunk is sent again if not acknowledged in this time */
+#define HOST_APS_CHUNK_ACK_RETRIES      3                   /*!< The number of times the window end chunk is sent again */
+
+static const char *TAG = "ESP_ZB_APS";
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t basic_cmd;                       /*!< Basic command info */
+    uint8_t  dst_addr_mode;                                 /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+    uint16_t profile_id;                                    /*!< Profile id */
+    uint16_t cluster_id;                                    /*!< Cluster id */
+    uint8_t tx_options;                                     /*!< The transmission options for the ASDU to be transferred, refer to esp_zb_apsde_tx_opt_t */
+    bool use_alias;                                         /*!< The next higher layer may use the UseAlias parameter to request alias usage by NWK layer for the current frame.*/
+    esp_zb_addr_u alias_src_addr;                           /*!< The source address to be used for this NSDU. If the use_alias is true */
+    uint8_t alias_seq_num;                                  /*!< The sequence number to be used for this NSDU. If the use_alias is true */
+    uint8_t radius;                                         /*!< The distance, in hops, that a transmitted frame will be allowed to travel through the network.*/
+    uint32_t asdu_length;                                   /*!< The number of octets comprising the ASDU to be transferred */
+} ESP_ZNSP_ZB_PACKED_STRUCT esp_host_zb_aps_data_t;
+
+typedef struct {
+    uint8_t states;                                         /*!< The states of the device */
+    uint8_t dst_addr_mode;                                  /*!< Reserved, the addressing mode for the destination address used in this primitive and of the APDU that has been received.*/
+    esp_zb_addr_u dst_addr;                                 /*!< The individual device address or group address to which the ASDU is directed.*/
+    uint8_t dst_endpoint;                                   /*!< The target endpoint on the local entity to which the ASDU is directed.*/
+    uint8_t src_addr_mode;                                  /*!< Reserved, The addressing mode for the source address used in this primitive and of the APDU that has been received.*/
+    esp_zb_addr_u src_addr;                                 /*!< The individual device address of the entity from which the ASDU has been received.*/
+    uint8_t src_endpoint;                                   /*!< The number of the individual endpoint of the entity from which the ASDU has been received.*/
+    uint16_t profile_id;                                    /*!< The identifier of the profile from which this frame originated.*/
+    uint16_t cluster_id;                                    /*!< The identifier of the received object.*/
+    uint8_t indication_status;                              /*!< The status of the incoming frame processing, 0: on success */
+    uint8_t security_status;                                /*!< UNSECURED if the ASDU was received without any security. SECURED_NWK_KEY if the received ASDU was secured with the NWK key.*/
+    uint8_t lqi;                                            /*!< The link quality indication delivered by the NLDE.*/
+    int rx_time;                                            /*!< Reserved, a time indication for the received packet based on the local clock */
+    uint32_t asdu_length;                                   /*!< The number of octets comprising the ASDU being indicated by the APSDE.*/
+} ESP_ZNSP_ZB_PACKED_STRUCT esp_host_zb_aps_data_ind_t;
+
+typedef struct {
+    uint8_t states;                                         /*!< The states of the device */
+    uint8_t dst_addr_mode;                                  /*!< The addressing mode for the destination address used in this primitive and of the APDU to be transferred.*/
+    esp_zb_zcl_basic_cmd_t basic_cmd;                       /*!< Basic command info */
+    int tx_time;                                            /*!< Reserved */
+    uint8_t  confirm_status;                                /*!< The status of data confirm. 0: success, otherwise failed */
+    uint32_t asdu_length;                                   /*!< The length of ASDU*/
+} ESP_ZNSP_ZB_PACKED_STRUCT esp_host_zb_aps_data_confirm_t;
+
+/**
+ * @brief Type to represent a chunked APS data indication from the NCP.
+ *
+ */
+typedef struct {
+    bool        in_use;                                     /*!< The session is in progress */
+    uint8_t     session;                                    /*!< The session handle allocated by the NCP */
+    uint8_t     block;                                      /*!< The first block in the pool */
+    uint8_t     block_count;                                /*!< The number of blocks in the pool */
+    uint16_t    chunk_size;                                 /*!< The maximum payload length of one chunk */
+    uint8_t     window;                                     /*!< The number of chunks sent by the NCP before waiting for the acknowledgement */
+    uint32_t    total_length;                               /*!< The total length of the ASDU */
+    uint32_t    offset;                                     /*!< The next expected offset */
+    TickType_t  tick;                                       /*!< The tick of the last progress */
+    esp_host_zb_aps_data_ind_t ind;                         /*!< The APS data indication from the NCP */
+} esp_host_zb_aps_chunk_session_t;
+
+static esp_zb_apsde_data_indication_callback_t s_aps_data_indication_cb;
+static esp_zb_apsde_data_confirm_callback_t s_aps_data_confirm_cb;
+
+static uint8_t s_aps_chunk_pool[CONFIG_HOST_APS_CHUNK_POOL_BLOCKS][CONFIG_HOST_APS_CHUNK_SIZE];
+static uint32_t s_aps_chunk_pool_map;
+static esp_host_zb_aps_chunk_session_t s_aps_chunk_session[HOST_APS_CHUNK_SESSION_NUM];
+
+static void esp_host_zb_aps_chunk_session_free(esp_host_zb_aps_chunk_session_t *session)
+{
+    s_aps_chunk_pool_map &= ~(((1ULL << session->block_count) - 1) << session->block);
+    session->in_use = false;
+}
+
+static esp_host_zb_aps_chunk_session_t *esp_host_zb_aps_chunk_session_alloc(const esp_host_zb_aps_chunk_begin_t *begin)
+{
+    esp_host_zb_aps_chunk_session_t *session = NULL;
+    uint32_t block_count = (begin->chunk.total_length + CONFIG_HOST_APS_CHUNK_SIZE - 1) / CONFIG_HOST_APS_CHUNK_SIZE;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!block_count || block_count > CONFIG_HOST_APS_CHUNK_POOL_BLOCKS || !begin->chunk_size || !begin->window) {
+        return NULL;
+    }
+
+    for (int i = 0; i < HOST_APS_CHUNK_SESSION_NUM; i ++) {
+        if (s_aps_chunk_session[i].in_use && ((now - s_aps_chunk_session[i].tick) > pdMS_TO_TICKS(HOST_APS_CHUNK_TIMEOUT_MS)
+                                              || s_aps_chunk_session[i].session == begin->chunk.session)) {
+            esp_host_zb_aps_chunk_session_free(&s_aps_chunk_session[i]);
+        }
+        if (!session && !s_aps_chunk_session[i].in_use) {
+            session = &s_aps_chunk_session[i];
+        }
+    }
+
+    if (session) {
+        uint32_t mask = (uint32_t)((1ULL << block_count) - 1);
+        int block = 0;
+        for (; block + block_count <= CONFIG_HOST_APS_CHUNK_POOL_BLOCKS; block ++) {
+            if (!(s_aps_chunk_pool_map & (mask << block))) {
+                break;
+            }
+        }
+
+        if (block + block_count > CONFIG_HOST_APS_CHUNK_POOL_BLOCKS) {
+            return NULL;
+        }
+
+        s_aps_chunk_pool_map |= (mask << block);
+        memset(session, 0, sizeof(esp_host_zb_aps_chunk_session_t));
+        session->in_use = true;
+        session->session = begin->chunk.session;
+        session->block = block;
+        session->block_count = block_count;
+        session->chunk_size = begin->chunk_size;
+        session->window = begin->window;
+        session->total_length = begin->chunk.total_length;
+        session->tick = now;
+    }
+
+    return session;
+}
+
+static esp_host_zb_aps_chunk_session_t *esp_host_zb_aps_chunk_session_get(uint8_t handle)
+{
+    for (int i = 0; i < HOST_APS_CHUNK_SESSION_NUM; i ++) {
+        if (s_aps_chunk_session[i].in_use && s_aps_chunk_session[i].session == handle) {
+            return &s_aps_chunk_session[i];
+        }
+    }
+
+    return NULL;
+}
+
+static inline uint8_t *esp_host_zb_aps_chunk_session_buffer(esp_host_zb_aps_chunk_session_t *session)
+{
+    return s_aps_chunk_pool[session->block];
+}
+
+static esp_err_t esp_host_zb_aps_chunk_ack(uint8_t session, uint8_t status, uint32_t offset)
+{
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+    esp_host_zb_aps_chunk_ack_t chunk_ack = {
+        .status = status,
+        .session = session,
+        .offset = offset,
+    };
+
+    esp_host_zb_output(ESP_ZNSP_APS_DATA_CHUNK_ACK, &chunk_ack, sizeof(esp_host_zb_aps_chunk_ack_t), &output, &outlen);
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
+
+static void esp_host_zb_aps_data_indication(const esp_host_zb_aps_data_ind_t *aps_data, uint8_t *asdu)
+{
+    esp_zb_apsde_data_ind_t ind = {
+        .status = aps_data->indication_status,
+        .dst_addr_mode = aps_data->dst_addr_mode,
+        .dst_short_addr = aps_data->dst_addr.addr_short,
+        .dst_endpoint = aps_data->dst_endpoint,
+        .src_addr_mode = aps_data->src_addr_mode,
+        .src_short_addr = aps_data->src_addr.addr_short,
+        .src_endpoint = aps_data->src_endpoint,
+        .profile_id = aps_data->profile_id,
+        .cluster_id = aps_data->cluster_id,
+        .asdu_length = aps_data->asdu_length,
+        .asdu = aps_data->asdu_length ? asdu : NULL,
+        .security_status = aps_data->security_status,
+        .lqi = aps_data->lqi,
+        .rx_time = aps_data->rx_time,
+    };
+
+    if (s_aps_data_indication_cb) {
+        s_aps_data_indication_cb(ind);
+    }
+}
+
+esp_err_t esp_host_zb_aps_data_indication_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_aps_data_ind_t), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data indication");
+
+    const esp_host_zb_aps_data_ind_t *aps_data = (const esp_host_zb_aps_data_ind_t *)input;
+    ESP_RETURN_ON_FALSE(inlen - sizeof(esp_host_zb_aps_data_ind_t) >= aps_data->asdu_length, ESP_ERR_INVALID_SIZE, TAG, "Invalid APS data indication length");
+
+    esp_host_zb_aps_data_indication(aps_data, (uint8_t *)input + sizeof(esp_host_zb_aps_data_ind_t));
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_aps_data_confirm_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_aps_data_confirm_t), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data confirm");
+
+    const esp_host_zb_aps_data_confirm_t *aps_data = (const esp_host_zb_aps_data_confirm_t *)input;
+    /* The NCP does not echo the ASDU which has been sent in chunks */
+    bool has_asdu = (inlen - sizeof(esp_host_zb_aps_data_confirm_t) >= aps_data->asdu_length) && aps_data->asdu_length;
+    esp_zb_apsde_data_confirm_t confirm = {
+        .status = aps_data->confirm_status,
+        .dst_addr_mode = aps_data->dst_addr_mode,
+        .dst_endpoint = aps_data->basic_cmd.dst_endpoint,
+        .src_endpoint = aps_data->basic_cmd.src_endpoint,
+        .tx_time = aps_data->tx_time,
+        .asdu_length = aps_data->asdu_length,
+        .asdu = has_asdu ? (uint8_t *)input + sizeof(esp_host_zb_aps_data_confirm_t) : NULL,
+    };
+    memcpy(&confirm.dst_addr, &aps_data->basic_cmd.dst_addr_u, sizeof(esp_zb_addr_u));
+
+    if (s_aps_data_confirm_cb) {
+        s_aps_data_confirm_cb(confirm);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_aps_data_chunk_begin_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_aps_chunk_begin_t) + sizeof(esp_host_zb_aps_data_ind_t), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data chunk begin");
+
+    const esp_host_zb_aps_chunk_begin_t *begin = (const esp_host_zb_aps_chunk_begin_t *)input;
+    esp_host_zb_aps_chunk_session_t *session = esp_host_zb_aps_chunk_session_alloc(begin);
+    if (!session) {
+        ESP_LOGW(TAG, "No chunk pool for the APS data indication with length %" PRIu32, begin->chunk.total_length);
+        esp_host_zb_aps_chunk_ack(begin->chunk.session, ESP_ZNSP_ERR_NO_MEM, 0);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(&session->ind, input + sizeof(esp_host_zb_aps_chunk_begin_t), sizeof(esp_host_zb_aps_data_ind_t));
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_aps_data_chunk_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_aps_chunk_t), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data chunk");
+
+    const esp_host_zb_aps_chunk_t *chunk = (const esp_host_zb_aps_chunk_t *)input;
+    uint16_t len = inlen - sizeof(esp_host_zb_aps_chunk_t);
+    esp_host_zb_aps_chunk_session_t *session = esp_host_zb_aps_chunk_session_get(chunk->session);
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NOT_FOUND, TAG, "Unknown APS data chunk session %d", chunk->session);
+
+    /* Only the chunk in sequence is accepted, the NCP resends from the acknowledged offset on a gap */
+    if (chunk->offset == session->offset && len <= session->chunk_size && chunk->offset + len <= session->total_length) {
+        memcpy(esp_host_zb_aps_chunk_session_buffer(session) + chunk->offset, input + sizeof(esp_host_zb_aps_chunk_t), len);
+        session->offset += len;
+        session->tick = xTaskGetTickCount();
+    }
+
+    if ((((chunk->offset / session->chunk_size) + 1) % session->window == 0) || (chunk->offset + len >= session->total_length)) {
+        esp_host_zb_aps_chunk_ack(session->session, ESP_ZNSP_SUCCESS, session->offset);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_aps_data_chunk_end_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_aps_chunk_t), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data chunk end");
+
+    const esp_host_zb_aps_chunk_t *chunk = (const esp_host_zb_aps_chunk_t *)input;
+    esp_host_zb_aps_chunk_session_t *session = esp_host_zb_aps_chunk_session_get(chunk->session);
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NOT_FOUND, TAG, "Unknown APS data chunk session %d", chunk->session);
+
+    esp_err_t ret = ESP_ERR_INVALID_SIZE;
+    if (session->offset == session->total_length) {
+        session->ind.asdu_length = session->total_length;
+        esp_host_zb_aps_data_indication(&session->ind, esp_host_zb_aps_chunk_session_buffer(session));
+        ret = ESP_OK;
+    }
+    esp_host_zb_aps_chunk_session_free(session);
+
+    return ret;
+}
+
+static esp_err_t esp_host_zb_aps_data_chunk_request(const esp_host_zb_aps_data_t *aps_data, const uint8_t *asdu)
+{
+    struct {
+        uint8_t status;
+        esp_host_zb_aps_chunk_begin_t begin;
+    } ESP_ZNSP_ZB_PACKED_STRUCT begin_rsp = {
+        .status = ESP_ZNSP_ERR_FATAL,
+    };
+    struct {
+        esp_host_zb_aps_chunk_begin_t begin;
+        esp_host_zb_aps_data_t        req;
+    } ESP_ZNSP_ZB_PACKED_STRUCT begin_req = {
+        .begin = {
+            .chunk = {
+                .total_length = aps_data->asdu_length,
+            },
+            .chunk_size = CONFIG_HOST_APS_CHUNK_SIZE,
+            .window = CONFIG_HOST_APS_CHUNK_WINDOW,
+        },
+    };
+    uint16_t outlen = sizeof(begin_rsp);
+
+    memcpy(&begin_req.req, aps_data, sizeof(esp_host_zb_aps_data_t));
+    esp_host_zb_output(ESP_ZNSP_APS_DATA_CHUNK_BEGIN, &begin_req, sizeof(begin_req), &begin_rsp, &outlen);
+    ESP_RETURN_ON_FALSE(begin_rsp.status == ESP_ZNSP_SUCCESS, (begin_rsp.status == ESP_ZNSP_ERR_NO_MEM) ? ESP_ERR_NO_MEM : ESP_FAIL,
+                        TAG, "Failed to begin the APS data chunks with status %d", begin_rsp.status);
+
+    uint16_t chunk_size = begin_rsp.begin.chunk_size;
+    uint8_t window = begin_rsp.begin.window;
+    ESP_RETURN_ON_FALSE(chunk_size && window, ESP_FAIL, TAG, "Invalid APS data chunk parameters");
+
+    uint8_t *buffer = calloc(1, sizeof(esp_host_zb_aps_chunk_t) + chunk_size);
+    ESP_RETURN_ON_FALSE(buffer, ESP_ERR_NO_MEM, TAG, "No memory for the APS data chunk");
+
+    esp_err_t ret = ESP_OK;
+    esp_host_zb_aps_chunk_t chunk = {
+        .session = begin_rsp.begin.chunk.session,
+        .total_length = aps_data->asdu_length,
+        .offset = 0,
+    };
+
+    while (chunk.offset < chunk.total_length) {
+        uint16_t len = MIN(chunk_size, chunk.total_length - chunk.offset);
+        memcpy(buffer, &chunk, sizeof(esp_host_zb_aps_chunk_t));
+        memcpy(buffer + sizeof(esp_host_zb_aps_chunk_t), asdu + chunk.offset, len);
+
+        if ((((chunk.offset / chunk_size) + 1) % window == 0) || (chunk.offset + len >= chunk.total_length)) {
+            esp_host_zb_aps_chunk_ack_t chunk_ack = {
+                .status = ESP_ZNSP_ERR_FATAL,
+            };
+            /* The window end chunk is sent again if it or its acknowledgement is lost */
+            for (int retry = 0; retry <= HOST_APS_CHUNK_ACK_RETRIES; retry++) {
+                outlen = sizeof(esp_host_zb_aps_chunk_ack_t);
+                if (esp_host_zb_output_timeout(ESP_ZNSP_APS_DATA_CHUNK, buffer, sizeof(esp_host_zb_aps_chunk_t) + len, &chunk_ack,
+                                               &outlen, HOST_APS_CHUNK_ACK_TIMEOUT_MS) != ESP_ERR_TIMEOUT) {
+                    break;
+                }
+                ESP_LOGW(TAG, "No acknowledgement for the APS data chunk at offset %" PRIu32 ", retry %d", chunk.offset, retry);
+            }
+            if (chunk_ack.status != ESP_ZNSP_SUCCESS || chunk_ack.offset > chunk.total_length) {
+                ESP_LOGE(TAG, "Failed to send the APS data chunk at offset %" PRIu32 " with status %d", chunk.offset, chunk_ack.status);
+                ret = ESP_FAIL;
+                break;
+            }
+            /* Go back to the acknowledged offset if some chunks in the window have been dropped by the NCP */
+            chunk.offset = chunk_ack.offset;
+        } else {
+            esp_host_zb_output_nowait(ESP_ZNSP_APS_DATA_CHUNK, buffer, sizeof(esp_host_zb_aps_chunk_t) + len);
+            chunk.offset += len;
+        }
+    }
+
+    free(buffer);
+    buffer = NULL;
+
+    if (ret == ESP_OK) {
+        uint8_t output = ESP_ZNSP_ERR_FATAL;
+        outlen = sizeof(uint8_t);
+        esp_host_zb_output(ESP_ZNSP_APS_DATA_CHUNK_END, &chunk, sizeof(esp_host_zb_aps_chunk_t), &output, &outlen);
+        ret = (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+    }
+
+    return ret;
+}
+
+esp_err_t esp_zb_aps_data_request(esp_zb_apsde_data_req_t *req)
+{
+    ESP_RETURN_ON_FALSE(req && (req->asdu || !req->asdu_length), ESP_ERR_INVALID_ARG, TAG, "Invalid APS data request");
+
+    esp_host_zb_aps_data_t aps_data = {
+        .basic_cmd = {
+            .dst_endpoint = req->dst_endpoint,
+            .src_endpoint = req->src_endpoint,
+        },
+        .dst_addr_mode = req->dst_addr_mode,
+        .profile_id = req->profile_id,
+        .cluster_id = req->cluster_id,
+        .tx_options = req->tx_options,
+        .use_alias = req->use_alias,
+        .alias_seq_num = req->alias_seq_num,
+        .radius = req->radius,
+        .asdu_length = req->asdu_length,
+    };
+    aps_data.basic_cmd.dst_addr_u.addr_short = req->dst_short_addr;
+    aps_data.alias_src_addr.addr_short = req->alias_src_addr;
+
+    if (req->asdu_length > CONFIG_HOST_APS_CHUNK_SIZE && (esp_host_frame_caps()->features & ESP_HOST_FEATURE_APS_CHUNK)) {
+        return esp_host_zb_aps_data_chunk_request(&aps_data, req->asdu);
+    }
+
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+    uint16_t data_len = sizeof(esp_host_zb_aps_data_t) + req->asdu_length;
+    uint8_t *data = calloc(1, data_len);
+    ESP_RETURN_ON_FALSE(data, ESP_ERR_NO_MEM, TAG, "No memory for the APS data request");
+
+    memcpy(data, &aps_data, sizeof(esp_host_zb_aps_data_t));
+    if (req->asdu_length) {
+        memcpy(data + sizeof(esp_host_zb_aps_data_t), req->asdu, req->asdu_length);
+    }
+    esp_host_zb_output(ESP_ZNSP_APS_DATA_REQUEST, data, data_len, &output, &outlen);
+    free(data);
+    data = NULL;
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
+
+void esp_zb_aps_data_indication_handler_register(esp_zb_apsde_data_indication_callback_t cb)
+{
+    s_aps_data_indication_cb = cb;
+}
+
+void esp_zb_aps_data_confirm_handler_register(esp_zb_apsde_data_confirm_callback_t cb)
+{
+    s_aps_data_confirm_cb = cb;
+}
@@ -0,0 +1,330 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sys/queue.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "esp_host_alarm.h"
+
+/** Definition of the hierarchical timer wheel
+ *
+ * The level 0 has one slot per tick, each slot of the level N covers all the slots of the level N - 1.
+ * The alarms of a slot of the level N are moved to the lower levels when the level N - 1 wraps around.
+ */
+#define HOST_ALARM_WHEEL_BITS       6                                   /*!< The bits of the tick indexed by one level */
+#define HOST_ALARM_WHEEL_SLOTS      (1 << HOST_ALARM_WHEEL_BITS)        /*!< The number of the slots of one level */
+#define HOST_ALARM_WHEEL_MASK       (HOST_ALARM_WHEEL_SLOTS - 1)
+#define HOST_ALARM_WHEEL_LEVELS     5                                   /*!< The levels cover 1 << 30 ticks */
+#define HOST_ALARM_MAX_TICKS        ((TickType_t)1 << 29)               /*!< The longest timeout, the rest of the range absorbs the delay of the main loop */
+#define HOST_ALARM_HASH_SIZE        16                                  /*!< The number of the buckets to look up the alarms to cancel */
+#define HOST_ALARM_EXPIRED          0xFF                                /*!< The level of the alarm expired but not executed yet */
+
+static const char *TAG = "ESP_HOST_ALARM";
+
+/**
+ * @brief Type to represent the alarm scheduled.
+ *
+ */
+typedef struct esp_host_alarm_s {
+    TAILQ_ENTRY(esp_host_alarm_s)   entry;      /*!< The entry in the slot or in the expired list */
+    LIST_ENTRY(esp_host_alarm_s)    hash;       /*!< The entry in the hash bucket */
+    esp_zb_callback_t               cb;         /*!< The function to call */
+    uint8_t                         param;      /*!< The parameter to pass to the function */
+    uint8_t                         level;      /*!< The level of the wheel, HOST_ALARM_EXPIRED if expired */
+    uint8_t                         slot;       /*!< The slot of the level */
+    TickType_t                      expires;    /*!< The tick when the alarm expires */
+} esp_host_alarm_t;
+
+TAILQ_HEAD(esp_host_alarm_slot_s, esp_host_alarm_s);
+LIST_HEAD(esp_host_alarm_bucket_s, esp_host_alarm_s);
+
+/**
+ * @brief Type to represent the timer wheel.
+ *
+ */
+typedef struct {
+    SemaphoreHandle_t               lock;                                                       /*!< The lock of the wheel */
+    TickType_t                      tick;                                                       /*!< The next tick to process */
+    uint64_t                        bitmap[HOST_ALARM_WHEEL_LEVELS];                            /*!< The slots not empty of each level */
+    struct esp_host_alarm_slot_s    wheel[HOST_ALARM_WHEEL_LEVELS][HOST_ALARM_WHEEL_SLOTS];     /*!< The alarms not expired */
+    struct esp_host_alarm_slot_s    expired;                                                    /*!< The alarms expired in order */
+    struct esp_host_alarm_bucket_s  hash[HOST_ALARM_HASH_SIZE];                                 /*!< The alarms by the callback and the parameter */
+} esp_host_alarm_wheel_t;
+
+static esp_host_alarm_wheel_t s_host_alarm;
+
+static inline uint8_t esp_host_alarm_hash(esp_zb_callback_t cb, uint8_t param)
+{
+    return (((uintptr_t)cb >> 2) ^ param) & (HOST_ALARM_HASH_SIZE - 1);
+}
+
+static inline uint8_t esp_host_alarm_first(uint64_t bitmap, uint8_t start)
+{
+    uint64_t rotated = start ? ((bitmap >> start) | (bitmap << (HOST_ALARM_WHEEL_SLOTS - start))) : bitmap;
+
+    return (start + __builtin_ctzll(rotated)) & HOST_ALARM_WHEEL_MASK;
+}
+
+static void esp_host_alarm_add(esp_host_alarm_t *alarm)
+{
+    TickType_t delta = alarm->expires - s_host_alarm.tick;
+    uint8_t level = 0;
+
+    /* The tick of the alarm already processed, execute it with the alarms expired */
+    if ((int32_t)delta < 0) {
+        alarm->level = HOST_ALARM_EXPIRED;
+        TAILQ_INSERT_TAIL(&s_host_alarm.expired, alarm, entry);
+        return;
+    }
+
+    while (level < HOST_ALARM_WHEEL_LEVELS - 1 && (delta >> (HOST_ALARM_WHEEL_BITS * (level + 1)))) {
+        level ++;
+    }
+
+    alarm->level = level;
+    alarm->slot = (alarm->expires >> (HOST_ALARM_WHEEL_BITS * level)) & HOST_ALARM_WHEEL_MASK;
+    TAILQ_INSERT_TAIL(&s_host_alarm.wheel[level][alarm->slot], alarm, entry);
+    s_host_alarm.bitmap[level] |= (1ULL << alarm->slot);
+}
+
+static void esp_host_alarm_remove(esp_host_alarm_t *alarm)
+{
+    if (alarm->level == HOST_ALARM_EXPIRED) {
+        TAILQ_REMOVE(&s_host_alarm.expired, alarm, entry);
+    } else {
+        TAILQ_REMOVE(&s_host_alarm.wheel[alarm->level][alarm->slot], alarm, entry);
+        if (TAILQ_EMPTY(&s_host_alarm.wheel[alarm->level][alarm->slot])) {
+            s_host_alarm.bitmap[alarm->level] &= ~(1ULL << alarm->slot);
+        }
+    }
+    LIST_REMOVE(alarm, hash);
+}
+
+static void esp_host_alarm_cascade(uint8_t level, uint8_t slot)
+{
+    struct esp_host_alarm_slot_s list = TAILQ_HEAD_INITIALIZER(list);
+    esp_host_alarm_t *alarm = NULL;
+
+    if (!(s_host_alarm.bitmap[level] & (1ULL << slot))) {
+        return;
+    }
+
+    /* Detach the slot first, an alarm could be added back to the same slot */
+    TAILQ_CONCAT(&list, &s_host_alarm.wheel[level][slot], entry);
+    s_host_alarm.bitmap[level] &= ~(1ULL << slot);
+
+    while ((alarm = TAILQ_FIRST(&list)) != NULL) {
+        TAILQ_REMOVE(&list, alarm, entry);
+        esp_host_alarm_add(alarm);
+    }
+}
+
+static void esp_host_alarm_advance(TickType_t now)
+{
+    while ((int32_t)(now - s_host_alarm.tick) >= 0) {
+        uint8_t index = s_host_alarm.tick & HOST_ALARM_WHEEL_MASK;
+        esp_host_alarm_t *alarm = NULL;
+
+        if (!(s_host_alarm.bitmap[0] >> index)) {
+            /* Skip the empty slots up to the next wrap around of the level 0 */
+            TickType_t next = (s_host_alarm.tick | HOST_ALARM_WHEEL_MASK) + 1;
+            s_host_alarm.tick = ((int32_t)(next - now) > 0) ? now + 1 : next;
+        } else {
+            while ((alarm = TAILQ_FIRST(&s_host_alarm.wheel[0][index])) != NULL) {
+                TAILQ_REMOVE(&s_host_alarm.wheel[0][index], alarm, entry);
+                alarm->level = HOST_ALARM_EXPIRED;
+                TAILQ_INSERT_TAIL(&s_host_alarm.expired, alarm, entry);
+            }
+            s_host_alarm.bitmap[0] &= ~(1ULL << index);
+            s_host_alarm.tick ++;
+        }
+
+        /* Move the alarms of the next slot of the upper levels down once the level 0 wraps around */
+        if (!(s_host_alarm.tick & HOST_ALARM_WHEEL_MASK)) {
+            for (uint8_t level = 1; level < HOST_ALARM_WHEEL_LEVELS; level ++) {
+                uint8_t slot = (s_host_alarm.tick >> (HOST_ALARM_WHEEL_BITS * level)) & HOST_ALARM_WHEEL_MASK;
+                esp_host_alarm_cascade(level, slot);
+                if (slot) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static bool esp_host_alarm_next(TickType_t *expires)
+{
+    bool found = false;
+
+    if (!TAILQ_EMPTY(&s_host_alarm.expired)) {
+        *expires = TAILQ_FIRST(&s_host_alarm.expired)->expires;
+        return true;
+    }
+
+    /* The slots of the level 0 hold the alarms expiring exactly at their tick */
+    if (s_host_alarm.bitmap[0]) {
+        uint8_t index = s_host_alarm.tick & HOST_ALARM_WHEEL_MASK;
+        uint8_t slot = esp_host_alarm_first(s_host_alarm.bitmap[0], index);
+        *expires = s_host_alarm.tick + ((slot - index) & HOST_ALARM_WHEEL_MASK);
+        found = true;
+    }
+
+    /* The first slot not empty of the upper levels holds the earliest alarm of the level */
+    for (uint8_t level = 1; level < HOST_ALARM_WHEEL_LEVELS; level ++) {
+        if (!s_host_alarm.bitmap[level]) {
+            continue;
+        }
+
+        uint8_t index = ((s_host_alarm.tick >> (HOST_ALARM_WHEEL_BITS * level)) + 1) & HOST_ALARM_WHEEL_MASK;
+        uint8_t slot = esp_host_alarm_first(s_host_alarm.bitmap[level], index);
+        esp_host_alarm_t *alarm = NULL;
+
+        TAILQ_FOREACH(alarm, &s_host_alarm.wheel[level][slot], entry) {
+            if (!found || (int32_t)(alarm->expires - *expires) < 0) {
+                *expires = alarm->expires;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+esp_err_t esp_host_alarm_schedule(esp_zb_callback_t cb, uint8_t param, uint32_t time)
+{
+    ESP_RETURN_ON_FALSE(cb, ESP_ERR_INVALID_ARG, TAG, "Invalid callback");
+    ESP_RETURN_ON_FALSE(s_host_alarm.lock, ESP_ERR_INVALID_STATE, TAG, "Alarm is not initialized");
+
+    esp_host_alarm_t *alarm = calloc(1, sizeof(esp_host_alarm_t));
+    ESP_RETURN_ON_FALSE(alarm, ESP_ERR_NO_MEM, TAG, "No memory for the alarm");
+
+    /* Round up, the alarm never expires before the timeout */
+    uint64_t ticks = ((uint64_t)time * configTICK_RATE_HZ + 999) / 1000;
+
+    alarm->cb = cb;
+    alarm->param = param;
+    alarm->expires = xTaskGetTickCount() + ((ticks < HOST_ALARM_MAX_TICKS) ? (TickType_t)ticks : HOST_ALARM_MAX_TICKS);
+
+    xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+    esp_host_alarm_add(alarm);
+    LIST_INSERT_HEAD(&s_host_alarm.hash[esp_host_alarm_hash(cb, param)], alarm, hash);
+    xSemaphoreGive(s_host_alarm.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_alarm_cancel(esp_zb_callback_t cb, uint8_t param)
+{
+    ESP_RETURN_ON_FALSE(s_host_alarm.lock, ESP_ERR_INVALID_STATE, TAG, "Alarm is not initialized");
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+    esp_host_alarm_t *alarm = LIST_FIRST(&s_host_alarm.hash[esp_host_alarm_hash(cb, param)]);
+    while (alarm) {
+        esp_host_alarm_t *next = LIST_NEXT(alarm, hash);
+        if (alarm->cb == cb && alarm->param == param) {
+            esp_host_alarm_remove(alarm);
+            free(alarm);
+            ret = ESP_OK;
+        }
+        alarm = next;
+    }
+    xSemaphoreGive(s_host_alarm.lock);
+
+    return ret;
+}
+
+TickType_t esp_host_alarm_process(void)
+{
+    esp_host_alarm_t *alarm = NULL;
+    TickType_t expires = 0;
+    TickType_t wait = portMAX_DELAY;
+
+    if (!s_host_alarm.lock) {
+        return portMAX_DELAY;
+    }
+
+    xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+    esp_host_alarm_advance(xTaskGetTickCount());
+    xSemaphoreGive(s_host_alarm.lock);
+
+    /* Take the alarms one by one, the callback could cancel or schedule the others */
+    do {
+        xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+        alarm = TAILQ_FIRST(&s_host_alarm.expired);
+        if (alarm) {
+            esp_host_alarm_remove(alarm);
+        }
+        xSemaphoreGive(s_host_alarm.lock);
+
+        if (alarm) {
+            alarm->cb(alarm->param);
+            free(alarm);
+        }
+    } while (alarm);
+
+    xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+    if (esp_host_alarm_next(&expires)) {
+        TickType_t now = xTaskGetTickCount();
+        wait = ((int32_t)(expires - now) > 0) ? expires - now : 0;
+    }
+    xSemaphoreGive(s_host_alarm.lock);
+
+    return wait;
+}
+
+esp_err_t esp_host_alarm_init(void)
+{
+    if (s_host_alarm.lock) {
+        return ESP_OK;
+    }
+
+    s_host_alarm.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_host_alarm.lock, ESP_ERR_NO_MEM, TAG, "No memory for the alarm lock");
+
+    s_host_alarm.tick = xTaskGetTickCount();
+    memset(s_host_alarm.bitmap, 0, sizeof(s_host_alarm.bitmap));
+    for (uint8_t level = 0; level < HOST_ALARM_WHEEL_LEVELS; level ++) {
+        for (uint8_t slot = 0; slot < HOST_ALARM_WHEEL_SLOTS; slot ++) {
+            TAILQ_INIT(&s_host_alarm.wheel[level][slot]);
+        }
+    }
+    TAILQ_INIT(&s_host_alarm.expired);
+    for (uint8_t i = 0; i < HOST_ALARM_HASH_SIZE; i ++) {
+        LIST_INIT(&s_host_alarm.hash[i]);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_alarm_deinit(void)
+{
+    if (!s_host_alarm.lock) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_host_alarm.lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < HOST_ALARM_HASH_SIZE; i ++) {
+        esp_host_alarm_t *alarm = NULL;
+        while ((alarm = LIST_FIRST(&s_host_alarm.hash[i])) != NULL) {
+            esp_host_alarm_remove(alarm);
+            free(alarm);
+        }
+    }
+    xSemaphoreGive(s_host_alarm.lock);
+
+    vSemaphoreDelete(s_host_alarm.lock);
+    s_host_alarm.lock = NULL;
+
+    return ESP_OK;
+}
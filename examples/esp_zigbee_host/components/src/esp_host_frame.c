@@ -6,23 +6,856 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <sys/param.h>
 
 #include <esp_err.h>
 #include "esp_log.h"
 #include "esp_crc.h"
 #include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
 
 #include "slip.h"
+#include "lz.h"
 #include "esp_host_zb.h"
 #include "esp_host_bus.h"
 
+#define HOST_FRAME_MAX_SIZE              (HOST_BUS_BUF_SIZE - sizeof(esp_host_header_t) - sizeof(uint16_t))
+
 static const char* TAG = "ESP_ZNSP_FRAME";
 
+#if CONFIG_HOST_FRAME_RELIABLE
+#define HOST_FRAME_WINDOW                CONFIG_HOST_FRAME_RELIABLE_WINDOW
+#define HOST_FRAME_PENDING_QUEUE_LEN     32
+#define HOST_FRAME_PENDING_RESERVED      8
+#define HOST_FRAME_CREDIT_TIMEOUT_MS     (CONFIG_HOST_FRAME_RELIABLE_RETRANSMIT_MS * (CONFIG_HOST_FRAME_RELIABLE_MAX_RETRIES + 1))
+#define HOST_FRAME_MAX_RESYNCS           3
+
+/**
+ * @brief Type to represent the frame sent to the NCP and not acknowledged yet.
+ *
+ */
+typedef struct {
+    uint8_t    *data;                   /*!< The frame header and payload followed by the room for the checksum, NULL if the slot is free */
+    uint16_t    len;                    /*!< The length of the frame header and payload */
+    uint8_t     seq;                    /*!< The link sequence number of the frame */
+    uint8_t     retries;                /*!< The number of the retransmissions */
+    bool        acked;                  /*!< The frame has been selectively acknowledged by the NCP */
+    bool        nacked;                 /*!< The frame has been retransmitted on NACK since the last timeout */
+    TickType_t  tick;                   /*!< The tick of the last transmission */
+} esp_host_frame_tx_t;
+
+/**
+ * @brief Type to represent the frame received out of order from the NCP.
+ *
+ */
+typedef struct {
+    uint8_t    *data;                   /*!< The frame header and payload, NULL if the slot is free */
+    uint8_t     seq;                    /*!< The link sequence number of the frame */
+} esp_host_frame_rx_t;
+
+/**
+ * @brief Type to represent the frame waiting for a free slot in the window.
+ *
+ */
+typedef struct {
+    uint8_t    *data;                   /*!< The frame header and payload followed by the room for the checksum */
+    uint16_t    len;                    /*!< The length of the frame header and payload */
+    bool        credit;                 /*!< The producer took a credit for the frame, given back when it leaves the queue */
+} esp_host_frame_pending_t;
+
+/**
+ * @brief Type to represent the reliable link with the NCP.
+ *
+ */
+typedef struct {
+    SemaphoreHandle_t   lock;                       /*!< The lock of the transmit state */
+    TimerHandle_t       timer;                      /*!< The retransmission timer */
+    QueueHandle_t       pending;                    /*!< The frames waiting for a free slot in the window */
+    SemaphoreHandle_t   credit;                     /*!< The room of the pending queue left to the producers */
+    TaskHandle_t        rx_task;                    /*!< The task receiving the frames, it never waits for a credit */
+    bool                enabled;                    /*!< The frames are transmitted reliably, negotiated with the NCP */
+    uint8_t             window;                     /*!< The window negotiated with the NCP */
+    bool                sync;                       /*!< The next transmitted frame carries the SYNC flag */
+    uint8_t             resyncs;                    /*!< The resyncs since the NCP acknowledged a frame */
+    uint8_t             tx_base;                    /*!< The oldest link sequence number not acknowledged */
+    uint8_t             tx_next;                    /*!< The next link sequence number to transmit */
+    esp_host_frame_tx_t  tx[HOST_FRAME_WINDOW];       /*!< The frames in flight */
+    bool                rx_synced;                  /*!< The expected link sequence number is known */
+    uint8_t             rx_next;                    /*!< The next expected link sequence number */
+    esp_host_frame_rx_t  rx[HOST_FRAME_WINDOW];       /*!< The frames received out of order */
+} esp_host_frame_link_t;
+
+static esp_host_frame_link_t s_host_link;
+#endif
+
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+#define HOST_FRAME_COMPRESSION_STATS_NUM         16      /*!< The number of the frame IDs tracked, the last one collects the others */
+#define HOST_FRAME_COMPRESSION_STATS_INTERVAL    100     /*!< Log the benchmark every this number of the frames compressed */
+
+/**
+ * @brief Type to represent the compression cost in one direction.
+ *
+ */
+typedef struct {
+    uint32_t count;                     /*!< The number of the frames */
+    uint32_t raw_bytes;                 /*!< The payload bytes before the compression */
+    uint32_t wire_bytes;                /*!< The payload bytes on the bus */
+    uint32_t cost_us;                   /*!< The CPU time spent on the codec */
+} esp_host_frame_compression_cost_t;
+
+/**
+ * @brief Type to represent the compression benchmark of one frame ID.
+ *
+ */
+typedef struct {
+    uint16_t id;                                    /*!< The frame ID */
+    esp_host_frame_compression_cost_t tx;            /*!< The compression of the frames sent to the NCP */
+    esp_host_frame_compression_cost_t rx;            /*!< The decompression of the frames received from the NCP */
+} esp_host_frame_compression_stats_t;
+
+static esp_host_frame_compression_stats_t s_host_compression_stats[HOST_FRAME_COMPRESSION_STATS_NUM];
+static uint32_t s_host_compression_stats_count = 0;
+static portMUX_TYPE s_host_compression_stats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+static esp_host_frame_caps_t s_host_caps = {
+    .version = 0,
+    .max_frame_size = HOST_FRAME_MAX_SIZE,
+    .window = 0,
+    .features = 0,
+};
+
+static esp_err_t esp_host_frame_encode(uint8_t *data, uint16_t len, uint8_t **output, uint16_t *outlen)
+{
+    /* CheckSum */
+    uint16_t crc_val = esp_crc16_le(UINT16_MAX, data, len);
+    memcpy(data + len, &crc_val, sizeof(uint16_t));
+
+    /* SLIP */
+    slip_encode(data, len + sizeof(uint16_t), output, outlen);
+
+    return (*output) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t esp_host_frame_send(uint8_t *data, uint16_t len)
+{
+    uint8_t *output = NULL;
+    uint16_t outlen = 0;
+    esp_err_t ret = esp_host_frame_encode(data, len, &output, &outlen);
+
+    /* Response */
+    if (ret == ESP_OK) {
+        ret = esp_host_bus_output(output, outlen);
+    }
+
+    if (output) {
+        free(output);
+        output = NULL;
+    }
+
+    return ret;
+}
+
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+static void esp_host_frame_compression_record(uint16_t id, bool tx, uint16_t raw_len, uint16_t wire_len, uint32_t cost_us)
+{
+    esp_host_frame_compression_stats_t *stats = NULL;
+    bool dump = false;
+
+    portENTER_CRITICAL_SAFE(&s_host_compression_stats_spinlock);
+    for (int i = 0; i < HOST_FRAME_COMPRESSION_STATS_NUM && !stats; i++) {
+        if (s_host_compression_stats[i].id == id || (s_host_compression_stats[i].tx.count + s_host_compression_stats[i].rx.count) == 0) {
+            stats = &s_host_compression_stats[i];
+        }
+    }
+
+    if (!stats) {
+        /* The last entry collects the frame IDs not tracked */
+        stats = &s_host_compression_stats[HOST_FRAME_COMPRESSION_STATS_NUM - 1];
+        id = 0xFFFF;
+    }
+
+    stats->id = id;
+    esp_host_frame_compression_cost_t *cost = tx ? &stats->tx : &stats->rx;
+    cost->count++;
+    cost->raw_bytes += raw_len;
+    cost->wire_bytes += wire_len;
+    cost->cost_us += cost_us;
+    if (tx && (++s_host_compression_stats_count % HOST_FRAME_COMPRESSION_STATS_INTERVAL) == 0) {
+        dump = true;
+    }
+    portEXIT_CRITICAL_SAFE(&s_host_compression_stats_spinlock);
+
+    if (dump) {
+        esp_host_frame_compression_stats_dump();
+    }
+}
+#endif
+
+#if CONFIG_HOST_FRAME_COMPRESSION
+/* Return the compressed frame if it saves bytes, otherwise the data itself */
+static uint8_t *esp_host_frame_compress(uint8_t *data)
+{
+    esp_host_header_t *host_header = (esp_host_header_t *)data;
+    uint16_t data_head_len = sizeof(esp_host_header_t);
+    uint16_t raw_len = host_header->len;
+
+    if (!(s_host_caps.features & ESP_HOST_FEATURE_COMPRESSION) || raw_len < CONFIG_HOST_FRAME_COMPRESSION_THRESHOLD) {
+        return data;
+    }
+
+    /* The compressed payload is the original length followed by the LZ stream, one byte shorter at least */
+    uint8_t *output = calloc(1, data_head_len + raw_len + sizeof(uint16_t));
+    if (!output) {
+        return data;
+    }
+
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+    int64_t start = esp_timer_get_time();
+#endif
+    uint16_t lz_len = raw_len - sizeof(uint16_t) - 1;
+    esp_err_t ret = lz_compress(data + data_head_len, raw_len, output + data_head_len + sizeof(uint16_t), &lz_len);
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+    esp_host_frame_compression_record(host_header->id, true, raw_len, (ret == ESP_OK) ? lz_len + sizeof(uint16_t) : raw_len,
+                                     esp_timer_get_time() - start);
+#endif
+    if (ret != ESP_OK) {
+        free(output);
+        return data;
+    }
+
+    memcpy(output, data, data_head_len);
+    memcpy(output + data_head_len, &raw_len, sizeof(uint16_t));
+    host_header = (esp_host_header_t *)output;
+    host_header->len = lz_len + sizeof(uint16_t);
+    host_header->flags.reserved |= ESP_HOST_FRAME_FLAG_COMPRESSED;
+    free(data);
+
+    return output;
+}
+
+static esp_err_t esp_host_frame_decompress(const uint8_t *data, uint8_t **output)
+{
+    const esp_host_header_t *host_header = (const esp_host_header_t *)data;
+    uint16_t data_head_len = sizeof(esp_host_header_t);
+    uint16_t raw_len = 0;
+
+    if (host_header->len < sizeof(uint16_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(&raw_len, data + data_head_len, sizeof(uint16_t));
+    *output = calloc(1, data_head_len + raw_len);
+    if (!*output) {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+    int64_t start = esp_timer_get_time();
+#endif
+    uint16_t outlen = raw_len;
+    esp_err_t ret = lz_decompress(data + data_head_len + sizeof(uint16_t), host_header->len - sizeof(uint16_t),
+                                  *output + data_head_len, &outlen);
+    if (ret != ESP_OK || outlen != raw_len) {
+        ESP_LOGE(TAG, "Decompress frame 0x%04x fail", host_header->id);
+        free(*output);
+        *output = NULL;
+        return (ret != ESP_OK) ? ret : ESP_ERR_INVALID_SIZE;
+    }
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+    esp_host_frame_compression_record(host_header->id, false, raw_len, host_header->len, esp_timer_get_time() - start);
+#endif
+
+    memcpy(*output, data, data_head_len);
+    esp_host_header_t *header = (esp_host_header_t *)*output;
+    header->len = raw_len;
+    header->flags.reserved &= ~ESP_HOST_FRAME_FLAG_COMPRESSED;
+
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Complete the request waiting for a response which could not be handled, the NCP error frame ID and the
+ * sequence number of the response let it match the request. A notification is only dropped.
+ */
+static esp_err_t esp_host_frame_error(const esp_host_header_t *src, esp_err_t err)
+{
+    esp_host_header_t error_header = {
+        .id = 0xFFFF,
+        .sn = src->sn,
+        .len = 1,
+    };
+    error_header.flags.type = ESP_ZNSP_TYPE_RSPONSE;
+
+    if (src->flags.type != ESP_ZNSP_TYPE_RSPONSE) {
+        ESP_LOGW(TAG, "Drop the notification 0x%04x", src->id);
+        return ESP_OK;
+    }
+
+    return esp_host_zb_input(&error_header, &err, 1);
+}
+
+static esp_err_t esp_host_frame_dispatch(uint8_t *data)
+{
+    esp_host_header_t *host_header = (esp_host_header_t *)data;
+
+    /* Checked once the frame is acknowledged, so the NCP does not retransmit it */
+    if (host_header->flags.version > ESP_HOST_FRAME_VERSION) {
+        ESP_LOGE(TAG, "Unsupported protocol version %d, expect %d", host_header->flags.version, ESP_HOST_FRAME_VERSION);
+        return esp_host_frame_error(host_header, ESP_ERR_NOT_SUPPORTED);
+    }
+
+#if CONFIG_HOST_FRAME_COMPRESSION
+    if (host_header->flags.reserved & ESP_HOST_FRAME_FLAG_COMPRESSED) {
+        uint8_t *output = NULL;
+        esp_err_t ret = esp_host_frame_decompress(data, &output);
+        if (ret != ESP_OK) {
+            return esp_host_frame_error(host_header, ret);
+        }
+
+        ret = esp_host_frame_dispatch(output);
+        free(output);
+
+        return ret;
+    }
+#endif
+
+    uint8_t *payload = (host_header->len != 0) ? data + sizeof(esp_host_header_t) : NULL;
+
+    /* Packet Payload */
+    return esp_host_zb_input(host_header, payload, host_header->len);
+}
+
+#if CONFIG_HOST_FRAME_RELIABLE
+static esp_host_frame_tx_t *esp_host_frame_link_tx_get(uint8_t seq)
+{
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        if (s_host_link.tx[i].data && s_host_link.tx[i].seq == seq) {
+            return &s_host_link.tx[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void esp_host_frame_link_tx_free(esp_host_frame_tx_t *slot)
+{
+    free(slot->data);
+    memset(slot, 0, sizeof(esp_host_frame_tx_t));
+}
+
+static esp_host_frame_rx_t *esp_host_frame_link_rx_get(uint8_t seq)
+{
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        if (s_host_link.rx[i].data && s_host_link.rx[i].seq == seq) {
+            return &s_host_link.rx[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void esp_host_frame_link_rx_reset(uint8_t seq)
+{
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        free(s_host_link.rx[i].data);
+        s_host_link.rx[i].data = NULL;
+    }
+
+    s_host_link.rx_next = seq;
+    s_host_link.rx_synced = true;
+}
+
+/* Must be called with the link lock held, it takes the ownership of the data */
+static esp_err_t esp_host_frame_link_transmit(uint8_t *data, uint16_t len)
+{
+    uint16_t data_head_len = sizeof(esp_host_header_t);
+    esp_host_frame_tx_t *slot = NULL;
+    uint8_t *frame = NULL;
+
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        if (!s_host_link.tx[i].data) {
+            slot = &s_host_link.tx[i];
+            break;
+        }
+    }
+
+    /* The payload starts with the link sequence number, the transaction sequence number is kept in the header */
+    frame = slot ? malloc(len + 1 + sizeof(uint16_t)) : NULL;
+    if (!frame) {
+        ESP_LOGE(TAG, "No room for the frame 0x%04x", ((esp_host_header_t *)data)->id);
+        free(data);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(frame, data, data_head_len);
+    frame[data_head_len] = s_host_link.tx_next;
+    memcpy(frame + data_head_len + 1, data + data_head_len, len - data_head_len);
+    free(data);
+
+    esp_host_header_t *host_header = (esp_host_header_t *)frame;
+    host_header->len++;
+    host_header->flags.reserved |= ESP_HOST_FRAME_FLAG_RELIABLE;
+    if (s_host_link.sync) {
+        host_header->flags.reserved |= ESP_HOST_FRAME_FLAG_SYNC;
+    }
+
+    slot->data = frame;
+    slot->len = len + 1;
+    slot->seq = s_host_link.tx_next++;
+    slot->tick = xTaskGetTickCount();
+    s_host_link.sync = false;
+
+    return esp_host_frame_send(slot->data, slot->len);
+}
+
+/* Must be called with the link lock held */
+static void esp_host_frame_link_admit(void)
+{
+    esp_host_frame_pending_t pending;
+
+    while ((uint8_t)(s_host_link.tx_next - s_host_link.tx_base) < s_host_link.window
+            && xQueueReceive(s_host_link.pending, &pending, 0) == pdTRUE) {
+        if (pending.credit) {
+            xSemaphoreGive(s_host_link.credit);
+        }
+        esp_host_frame_link_transmit(pending.data, pending.len);
+    }
+}
+
+/* Must be called with the link lock held, the frames are dropped only when the link is disabled */
+static void esp_host_frame_link_flush(void)
+{
+    esp_host_frame_pending_t pending;
+
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        if (s_host_link.tx[i].data) {
+            esp_host_frame_link_tx_free(&s_host_link.tx[i]);
+        }
+    }
+
+    while (xQueueReceive(s_host_link.pending, &pending, 0) == pdTRUE) {
+        if (pending.credit) {
+            xSemaphoreGive(s_host_link.credit);
+        }
+        free(pending.data);
+    }
+
+    s_host_link.tx_base = s_host_link.tx_next;
+    s_host_link.sync = true;
+}
+
+/* Must be called with the link lock held, the frames in flight are kept and sent again from the oldest one with the
+ * SYNC flag, so the NCP restarts the expected link sequence number from it if it has lost the track */
+static void esp_host_frame_link_resync(void)
+{
+    esp_host_frame_tx_t *slot = NULL;
+
+    for (uint8_t seq = s_host_link.tx_base; seq != s_host_link.tx_next; seq++) {
+        slot = esp_host_frame_link_tx_get(seq);
+        if (!slot) {
+            continue;
+        }
+
+        if (seq == s_host_link.tx_base) {
+            ((esp_host_header_t *)slot->data)->flags.reserved |= ESP_HOST_FRAME_FLAG_SYNC;
+        }
+
+        slot->retries = 0;
+        slot->acked = false;
+        slot->nacked = false;
+        slot->tick = xTaskGetTickCount();
+        esp_host_frame_send(slot->data, slot->len);
+    }
+}
+
+static esp_err_t esp_host_frame_link_output(uint8_t *data, uint16_t len)
+{
+    esp_host_frame_pending_t pending = {
+        .data = data,
+        .len = len,
+        .credit = false,
+    };
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+    if (uxQueueMessagesWaiting(s_host_link.pending) == 0
+            && (uint8_t)(s_host_link.tx_next - s_host_link.tx_base) < s_host_link.window) {
+        ret = esp_host_frame_link_transmit(data, len);
+        xSemaphoreGive(s_host_link.lock);
+        return ret;
+    }
+    xSemaphoreGive(s_host_link.lock);
+
+    /* The producer waits until the NCP acknowledges the frames queued before. The receiving task handles the
+     * acknowledgements so it never waits, its frames use the room reserved in the queue */
+    if (xTaskGetCurrentTaskHandle() != s_host_link.rx_task) {
+        if (xSemaphoreTake(s_host_link.credit, pdMS_TO_TICKS(HOST_FRAME_CREDIT_TIMEOUT_MS)) != pdTRUE) {
+            /* The NCP has not acknowledged any frame for a whole retransmission cycle, the producer gives up
+             * instead of stalling its task until the link is restored */
+            ESP_LOGE(TAG, "No room on the link, drop the frame 0x%04x", ((esp_host_header_t *)data)->id);
+            free(data);
+            return ESP_ERR_TIMEOUT;
+        }
+        pending.credit = true;
+    }
+
+    xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+    if (!s_host_link.enabled) {
+        /* The link has been restored to the legacy mode while waiting */
+        if (pending.credit) {
+            xSemaphoreGive(s_host_link.credit);
+        }
+        ret = esp_host_frame_send(data, len);
+        free(data);
+    } else if (xQueueSend(s_host_link.pending, &pending, 0) != pdTRUE) {
+        ESP_LOGE(TAG, "Pending frame queue full, drop the frame 0x%04x", ((esp_host_header_t *)data)->id);
+        if (pending.credit) {
+            xSemaphoreGive(s_host_link.credit);
+        }
+        free(data);
+        ret = ESP_ERR_NO_MEM;
+    }
+    /* The window may have been opened while waiting */
+    esp_host_frame_link_admit();
+    xSemaphoreGive(s_host_link.lock);
+
+    return ret;
+}
+
+static esp_err_t esp_host_frame_link_ack(esp_znsp_type_t type)
+{
+    uint8_t data[sizeof(esp_host_header_t) + sizeof(esp_host_frame_ack_t) + sizeof(uint16_t)] = { 0 };
+    esp_host_header_t *host_header = (esp_host_header_t *)data;
+    esp_host_frame_ack_t *ack = (esp_host_frame_ack_t *)(data + sizeof(esp_host_header_t));
+
+    host_header->flags.type = type;
+    host_header->len = sizeof(esp_host_frame_ack_t);
+    ack->ack = s_host_link.rx_next;
+    for (int i = 0; i < HOST_FRAME_WINDOW - 1; i++) {
+        if (esp_host_frame_link_rx_get(s_host_link.rx_next + 1 + i)) {
+            ack->sack |= (1 << i);
+        }
+    }
+
+    return esp_host_frame_send(data, sizeof(esp_host_header_t) + sizeof(esp_host_frame_ack_t));
+}
+
+static esp_err_t esp_host_frame_link_ack_input(esp_host_header_t *host_header, const esp_host_frame_ack_t *ack)
+{
+    esp_host_frame_tx_t *slot = NULL;
+
+    if (host_header->len < sizeof(esp_host_frame_ack_t)) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+    /* Cumulative acknowledgement */
+    if ((uint8_t)(ack->ack - s_host_link.tx_base) <= (uint8_t)(s_host_link.tx_next - s_host_link.tx_base)) {
+        while (s_host_link.tx_base != ack->ack) {
+            slot = esp_host_frame_link_tx_get(s_host_link.tx_base++);
+            if (slot) {
+                esp_host_frame_link_tx_free(slot);
+            }
+            s_host_link.resyncs = 0;
+        }
+    }
+
+    /* Selective acknowledgement */
+    for (int i = 0; i < HOST_FRAME_WINDOW - 1; i++) {
+        if ((ack->sack & (1 << i)) && (slot = esp_host_frame_link_tx_get(ack->ack + 1 + i))) {
+            slot->acked = true;
+        }
+    }
+
+    /* Fast retransmission of the missing frame */
+    if (host_header->flags.type == ESP_ZNSP_TYPE_NACK && (slot = esp_host_frame_link_tx_get(ack->ack)) && !slot->nacked) {
+        slot->nacked = true;
+        slot->tick = xTaskGetTickCount();
+        esp_host_frame_send(slot->data, slot->len);
+    }
+
+    esp_host_frame_link_admit();
+    xSemaphoreGive(s_host_link.lock);
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_host_frame_link_input(uint8_t *data, uint16_t len)
+{
+    esp_host_header_t *host_header = (esp_host_header_t *)data;
+    esp_host_frame_rx_t *slot = NULL;
+    esp_znsp_type_t type = ESP_ZNSP_TYPE_ACK;
+    uint8_t seq = 0;
+    esp_err_t ret = ESP_OK;
+
+    if (host_header->flags.type == ESP_ZNSP_TYPE_ACK || host_header->flags.type == ESP_ZNSP_TYPE_NACK) {
+        return esp_host_frame_link_ack_input(host_header, (const esp_host_frame_ack_t *)(data + sizeof(esp_host_header_t)));
+    }
+
+    if (!(host_header->flags.reserved & ESP_HOST_FRAME_FLAG_RELIABLE)) {
+        return esp_host_frame_dispatch(data);
+    }
+
+    if (host_header->len < 1) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* Strip the link sequence number, the frame is dispatched with the transaction sequence number only */
+    seq = data[sizeof(esp_host_header_t)];
+    memmove(data + sizeof(esp_host_header_t), data + sizeof(esp_host_header_t) + 1, host_header->len - 1);
+    host_header->len--;
+    len--;
+
+    /* A SYNC frame restarts the link unless it is the retransmission of the frame delivered recently */
+    if (!s_host_link.rx_synced || ((host_header->flags.reserved & ESP_HOST_FRAME_FLAG_SYNC)
+            && (uint8_t)(s_host_link.rx_next - 1 - seq) >= HOST_FRAME_WINDOW)) {
+        esp_host_frame_link_rx_reset(seq);
+    }
+
+    if (seq == s_host_link.rx_next) {
+        /* The copy kept out of order is superseded by this one */
+        if ((slot = esp_host_frame_link_rx_get(seq))) {
+            free(slot->data);
+            slot->data = NULL;
+        }
+
+        /* Acknowledge the frames once they are queued to the main loop only, a frame which finds the queue full is
+         * retransmitted by the NCP, so the NCP is slowed down instead of the frame being lost */
+        ret = esp_host_frame_dispatch(data);
+        if (ret != ESP_ERR_NO_MEM) {
+            s_host_link.rx_next++;
+            while ((slot = esp_host_frame_link_rx_get(s_host_link.rx_next))
+                    && esp_host_frame_dispatch(slot->data) != ESP_ERR_NO_MEM) {
+                free(slot->data);
+                slot->data = NULL;
+                s_host_link.rx_next++;
+            }
+        }
+        esp_host_frame_link_ack(ESP_ZNSP_TYPE_ACK);
+
+        return ret;
+    } else if ((uint8_t)(seq - s_host_link.rx_next) < HOST_FRAME_WINDOW) {
+        type = ESP_ZNSP_TYPE_NACK;
+        for (int i = 0; i < HOST_FRAME_WINDOW && !esp_host_frame_link_rx_get(seq); i++) {
+            if (!s_host_link.rx[i].data) {
+                s_host_link.rx[i].data = malloc(len);
+                if (s_host_link.rx[i].data) {
+                    memcpy(s_host_link.rx[i].data, data, len);
+                    s_host_link.rx[i].seq = seq;
+                }
+                break;
+            }
+        }
+    }
+
+    esp_host_frame_link_ack(type);
+
+    return ret;
+}
+
+static void esp_host_frame_link_timeout(TimerHandle_t timer)
+{
+    TickType_t now = xTaskGetTickCount();
+    esp_host_frame_tx_t *slot = NULL;
+
+    xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+    for (uint8_t seq = s_host_link.tx_base; seq != s_host_link.tx_next; seq++) {
+        slot = esp_host_frame_link_tx_get(seq);
+        if (!slot || slot->acked || (now - slot->tick) < pdMS_TO_TICKS(CONFIG_HOST_FRAME_RELIABLE_RETRANSMIT_MS)) {
+            continue;
+        }
+
+        if (slot->retries >= CONFIG_HOST_FRAME_RELIABLE_MAX_RETRIES && s_host_link.resyncs >= HOST_FRAME_MAX_RESYNCS) {
+            /* The NCP is gone, the frames in flight are dropped and the producers waiting get their credits back.
+             * The link stays in the legacy mode until the NCP negotiates it again */
+            ESP_LOGE(TAG, "Frame %d is not acknowledged after %d resyncs, fall back to the legacy mode", seq, s_host_link.resyncs);
+            s_host_link.enabled = false;
+            s_host_caps.features &= ~ESP_HOST_FEATURE_RELIABLE;
+            esp_host_frame_link_flush();
+            break;
+        }
+
+        if (slot->retries >= CONFIG_HOST_FRAME_RELIABLE_MAX_RETRIES) {
+            ESP_LOGW(TAG, "Frame %d is not acknowledged after %d retries, resync the link", seq, slot->retries);
+            s_host_link.resyncs++;
+            esp_host_frame_link_resync();
+            break;
+        }
+
+        slot->retries++;
+        slot->nacked = false;
+        slot->tick = now;
+        esp_host_frame_send(slot->data, slot->len);
+    }
+    esp_host_frame_link_admit();
+    xSemaphoreGive(s_host_link.lock);
+}
+#endif
+
+esp_err_t esp_host_frame_compression_stats_dump(void)
+{
+#if CONFIG_HOST_FRAME_COMPRESSION_BENCHMARK
+    esp_host_frame_compression_stats_t stats[HOST_FRAME_COMPRESSION_STATS_NUM];
+
+    portENTER_CRITICAL_SAFE(&s_host_compression_stats_spinlock);
+    memcpy(stats, s_host_compression_stats, sizeof(stats));
+    portEXIT_CRITICAL_SAFE(&s_host_compression_stats_spinlock);
+
+    ESP_LOGI(TAG, "Frame compression benchmark, threshold %d bytes", CONFIG_HOST_FRAME_COMPRESSION_THRESHOLD);
+    for (int i = 0; i < HOST_FRAME_COMPRESSION_STATS_NUM; i++) {
+        esp_host_frame_compression_cost_t *tx = &stats[i].tx;
+        esp_host_frame_compression_cost_t *rx = &stats[i].rx;
+
+        if (tx->count + rx->count == 0) {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "id 0x%04x: tx %" PRIu32 " frames %" PRIu32 "/%" PRIu32 " bytes %" PRIu32 " us/frame, "
+                 "rx %" PRIu32 " frames %" PRIu32 "/%" PRIu32 " bytes %" PRIu32 " us/frame", stats[i].id,
+                 tx->count, tx->wire_bytes, tx->raw_bytes, tx->count ? tx->cost_us / tx->count : 0,
+                 rx->count, rx->wire_bytes, rx->raw_bytes, rx->count ? rx->cost_us / rx->count : 0);
+    }
+
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void esp_host_frame_caps_get(esp_host_frame_caps_t *caps)
+{
+    caps->version = ESP_HOST_FRAME_VERSION;
+    caps->max_frame_size = HOST_FRAME_MAX_SIZE;
+    caps->window = 0;
+    caps->features = ESP_HOST_FEATURE_APS_PUSH | ESP_HOST_FEATURE_APS_CHUNK | ESP_HOST_FEATURE_OTA_SERVER
+                     | ESP_HOST_FEATURE_NODE_TABLE | ESP_HOST_FEATURE_ZCL_FANOUT;
+#if CONFIG_HOST_FRAME_RELIABLE
+    caps->window = HOST_FRAME_WINDOW;
+    caps->features |= ESP_HOST_FEATURE_RELIABLE;
+#endif
+#if CONFIG_HOST_FRAME_COMPRESSION
+    caps->features |= ESP_HOST_FEATURE_COMPRESSION;
+#endif
+}
+
+esp_err_t esp_host_frame_caps_negotiate(const esp_host_frame_caps_t *peer)
+{
+    esp_host_frame_caps_t caps = {
+        .version = 0,
+        .max_frame_size = HOST_FRAME_MAX_SIZE,
+        .window = 0,
+        .features = 0,
+    };
+
+    if (peer) {
+        esp_host_frame_caps_get(&caps);
+        caps.version = MIN(caps.version, peer->version);
+        caps.max_frame_size = MIN(caps.max_frame_size, peer->max_frame_size);
+        caps.window = MIN(caps.window, peer->window);
+        caps.features &= peer->features;
+        if (caps.window == 0) {
+            caps.features &= ~ESP_HOST_FEATURE_RELIABLE;
+        }
+    }
+
+#if CONFIG_HOST_FRAME_RELIABLE
+    xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+    s_host_link.window = caps.window;
+    s_host_link.enabled = (caps.features & ESP_HOST_FEATURE_RELIABLE) ? true : false;
+    s_host_link.resyncs = 0;
+    if (!s_host_link.enabled) {
+        esp_host_frame_link_flush();
+    }
+    xSemaphoreGive(s_host_link.lock);
+#endif
+    s_host_caps = caps;
+
+    ESP_LOGI(TAG, "Link version %d, max frame size %d, window %d, features 0x%" PRIx32, caps.version, caps.max_frame_size,
+             caps.window, caps.features);
+
+    return ESP_OK;
+}
+
+const esp_host_frame_caps_t *esp_host_frame_caps(void)
+{
+    return &s_host_caps;
+}
+
+esp_err_t esp_host_frame_init(void)
+{
+#if CONFIG_HOST_FRAME_RELIABLE
+    memset(&s_host_link, 0, sizeof(esp_host_frame_link_t));
+    s_host_link.sync = true;
+    s_host_link.tx_next = esp_random() & 0xFF;
+    s_host_link.tx_base = s_host_link.tx_next;
+    s_host_link.lock = xSemaphoreCreateMutex();
+    s_host_link.pending = xQueueCreate(HOST_FRAME_PENDING_QUEUE_LEN, sizeof(esp_host_frame_pending_t));
+    s_host_link.credit = xSemaphoreCreateCounting(HOST_FRAME_PENDING_QUEUE_LEN - HOST_FRAME_PENDING_RESERVED,
+                                                  HOST_FRAME_PENDING_QUEUE_LEN - HOST_FRAME_PENDING_RESERVED);
+    s_host_link.timer = xTimerCreate("host_frame", pdMS_TO_TICKS(CONFIG_HOST_FRAME_RELIABLE_RETRANSMIT_MS), pdTRUE, NULL,
+                                    esp_host_frame_link_timeout);
+    if (!s_host_link.lock || !s_host_link.pending || !s_host_link.credit || !s_host_link.timer) {
+        esp_host_frame_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    return (xTimerStart(s_host_link.timer, 0) == pdPASS) ? ESP_OK : ESP_FAIL;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t esp_host_frame_deinit(void)
+{
+#if CONFIG_HOST_FRAME_RELIABLE
+    if (s_host_link.timer) {
+        xTimerDelete(s_host_link.timer, portMAX_DELAY);
+        s_host_link.timer = NULL;
+    }
+
+    if (s_host_link.lock && s_host_link.pending && s_host_link.credit) {
+        xSemaphoreTake(s_host_link.lock, portMAX_DELAY);
+        esp_host_frame_link_flush();
+        xSemaphoreGive(s_host_link.lock);
+    }
+
+    if (s_host_link.pending) {
+        vQueueDelete(s_host_link.pending);
+        s_host_link.pending = NULL;
+    }
+
+    if (s_host_link.credit) {
+        vSemaphoreDelete(s_host_link.credit);
+        s_host_link.credit = NULL;
+    }
+
+    if (s_host_link.lock) {
+        vSemaphoreDelete(s_host_link.lock);
+        s_host_link.lock = NULL;
+    }
+
+    for (int i = 0; i < HOST_FRAME_WINDOW; i++) {
+        free(s_host_link.rx[i].data);
+        s_host_link.rx[i].data = NULL;
+    }
+#endif
+    return ESP_OK;
+}
+
 esp_err_t esp_host_frame_input(const void *buffer, uint16_t len)
 {
     esp_err_t ret = ESP_ERR_INVALID_ARG;
     uint8_t *output = NULL;
     uint16_t outlen = 0;
+    bool valid = false;
 
     do {
         if (!buffer) {
@@ -49,7 +882,6 @@ esp_err_t esp_host_frame_input(const void *buffer, uint16_t len)
 
         /* Packet Header */
         esp_host_header_t *host_header = (esp_host_header_t *)output;
-        uint8_t *payload = NULL;
 
         if (host_header->len + data_head_len > outlen) {
             ESP_LOGE(TAG, "Invalid packet len %d, expect %d", outlen, host_header->len + data_head_len);
@@ -68,14 +900,15 @@ esp_err_t esp_host_frame_input(const void *buffer, uint16_t len)
             break;
         }
 
-        if (host_header->len != 0) {
-            payload = (uint8_t *)output + data_head_len;
-        }
-
         ESP_LOG_BUFFER_HEX_LEVEL(TAG, output, outlen, ESP_LOG_INFO);
 
-        /* Packet Payload */
-        ret = esp_host_zb_input(host_header, payload, host_header->len);
+        valid = true;
+#if CONFIG_HOST_FRAME_RELIABLE
+        s_host_link.rx_task = xTaskGetCurrentTaskHandle();
+        ret = esp_host_frame_link_input(output, data_head_len + host_header->len);
+#else
+        ret = esp_host_frame_dispatch(output);
+#endif
     } while(0);
 
     if (output) {
@@ -83,17 +916,23 @@ esp_err_t esp_host_frame_input(const void *buffer, uint16_t len)
         output = NULL;
     }
 
+    if (!valid) {
+        ESP_LOGD(TAG, "Drop the invalid frame");
+#if CONFIG_HOST_FRAME_RELIABLE
+        /* The corrupted frame is retransmitted by the NCP on NACK, a legacy NCP does not know the NACK frame */
+        if (s_host_link.enabled) {
+            esp_host_frame_link_ack(ESP_ZNSP_TYPE_NACK);
+        }
+#endif
+    }
+
     return ret;
 }
 
 esp_err_t esp_host_frame_output(esp_host_header_t *data_header, const void *buffer, uint16_t len)
 {
-    uint8_t *output = NULL;
-    uint16_t outlen = 0;
-
     uint16_t data_head_len = sizeof(esp_host_header_t);
     uint16_t size = data_head_len + len + sizeof(uint16_t);
-    esp_err_t ret = ESP_OK;
 
     /* Alloc Data Buffer */
     uint8_t *data = calloc(1, size);
@@ -103,6 +942,7 @@ esp_err_t esp_host_frame_output(esp_host_header_t *data_header, const void *buff
     }
 
     /* Packet Header */
+    data_header->flags.version = s_host_caps.version;
     memcpy(data, data_header, data_head_len);
 
     /* Packet Payload */
@@ -110,20 +950,18 @@ esp_err_t esp_host_frame_output(esp_host_header_t *data_header, const void *buff
         memcpy(data + data_head_len, buffer, len);
     }
 
-    /* CheckSum */
-    uint16_t crc_val = esp_crc16_le(UINT16_MAX, data, data_head_len + len);
-    memcpy(data + data_head_len + len, &crc_val, sizeof(uint16_t));
+#if CONFIG_HOST_FRAME_COMPRESSION
+    data = esp_host_frame_compress(data);
+    len = ((esp_host_header_t *)data)->len;
+#endif
 
-    /* SLIP */
-    slip_encode(data, size, &output, &outlen);
-    free(data);
-
-    /* Response */
-    ret = esp_host_bus_output(output, outlen);
-    if (output) {
-        free(output);
-        output = NULL;
+#if CONFIG_HOST_FRAME_RELIABLE
+    if (s_host_link.enabled) {
+        return esp_host_frame_link_output(data, data_head_len + len);
     }
+#endif
+    esp_err_t ret = esp_host_frame_send(data, data_head_len + len);
+    free(data);
 
     return ret;
 }
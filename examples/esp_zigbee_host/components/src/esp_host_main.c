@@ -16,6 +16,7 @@
 
 #include "esp_host_bus.h"
 #include "esp_host_main.h"
+#include "esp_host_frame.h"
 
 #include "zb_config_platform.h"
 
@@ -117,8 +118,13 @@ static void esp_host_main_task(void *pv)
 esp_err_t esp_host_init(esp_host_connection_mode_t mode)
 {
     esp_host_bus_t *bus = NULL;
-    esp_err_t ret = esp_host_bus_init(&bus);
+    esp_err_t ret = esp_host_frame_init();
 
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = esp_host_bus_init(&bus);
     s_host_dev.bus = bus;
 
     return (bus && bus->init) ? bus->init(mode) : ret;
@@ -138,6 +144,7 @@ esp_err_t esp_host_deinit(void)
 
     esp_host_bus_deinit(bus);
     s_host_dev.bus = NULL;
+    esp_host_frame_deinit();
 
     return ESP_OK;
 }
@@ -12,15 +12,21 @@
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_system.h"
-#include "esp_random.h"
 
 #include "esp_host_main.h"
 #include "esp_host_zb.h"
+#include "esp_host_alarm.h"
 
 #include "zb_config_platform.h"
 #include "esp_zigbee_core.h"
 #include "esp_zigbee_zcl_command.h"
 
+#define HOST_HELLO_TIMEOUT_MS   1000                        /*!< The time to wait for the hello answer from the NCP */
+#define HOST_ZB_WAKEUP_ID       0xFFFF                      /*!< The event to wake up the main loop, not a frame ID */
+#define HOST_ZB_ERROR_ID        0xFFFF                      /*!< The response of the NCP to a frame it could not handle */
+
+static const char *TAG = "ESP_ZNSP_ZB";
+
 typedef struct {
     esp_zb_ieee_addr_t  extendedPanId;                      /*!< The network's extended PAN identifier */
     uint16_t            panId;                              /*!< The network's PAN identifier */
@@ -33,6 +39,7 @@ typedef struct {
  */
 typedef struct {
     uint16_t        id;                                     /*!< The frame ID */
+    uint8_t         sn;                                     /*!< The sequence number of the frame */
     uint16_t        size;                                   /*!< Data size on the event */
     void            *data;                                  /*!< Data on the event */
 } esp_host_zb_ctx_t;
@@ -41,6 +48,10 @@ static esp_host_zb_network_t        s_host_zb_network;
 static QueueHandle_t                output_queue;           /*!< The queue handler for wait response */
 static QueueHandle_t                notify_queue;           /*!< The queue handler for wait notification */
 static SemaphoreHandle_t            lock_semaphore;
+static TaskHandle_t                 main_loop_task;         /*!< The task running the main loop */
+static uint8_t                      s_request_sn;           /*!< The sequence number of the last request */
+static bool                         s_request_stale;        /*!< A request timed out, its response could still arrive */
+static uint8_t                      s_request_stale_sn;     /*!< The sequence number of the request timed out */
 
 static esp_err_t esp_host_zb_form_network_fn(const uint8_t *input, uint16_t inlen)
 {
@@ -180,6 +191,17 @@ static const esp_host_zb_func_t host_zb_func_table[] = {
     {ESP_ZNSP_ZDO_BIND_SET, esp_host_zb_set_bind_fn},
     {ESP_ZNSP_ZDO_UNBIND_SET, esp_host_zb_set_unbind_fn},
     {ESP_ZNSP_ZDO_FIND_MATCH, esp_host_zb_find_match_fn},
+    {ESP_ZNSP_APS_DATA_INDICATION, esp_host_zb_aps_data_indication_fn},
+    {ESP_ZNSP_APS_DATA_CONFIRM, esp_host_zb_aps_data_confirm_fn},
+    {ESP_ZNSP_APS_DATA_CHUNK_BEGIN, esp_host_zb_aps_data_chunk_begin_fn},
+    {ESP_ZNSP_APS_DATA_CHUNK, esp_host_zb_aps_data_chunk_fn},
+    {ESP_ZNSP_APS_DATA_CHUNK_END, esp_host_zb_aps_data_chunk_end_fn},
+    {ESP_ZNSP_OTA_SERVER_BLOCK_REQUEST, esp_host_zb_ota_server_block_request_fn},
+    {ESP_ZNSP_OTA_SERVER_STATUS, esp_host_zb_ota_server_status_fn},
+    {ESP_ZNSP_ZCL_ATTR_READ_FANOUT_RESULT, esp_host_zb_zcl_fanout_result_fn},
+    {ESP_ZNSP_ZCL_REPORT_CONFIG_BULK_RESULT, esp_host_zb_zcl_fanout_result_fn},
+    {ESP_ZNSP_ZCL_ATTR_READ, esp_host_zb_zcl_attr_read_fn},
+    {ESP_ZNSP_ZCL_ATTR_REPORT, esp_host_zb_zcl_attr_report_fn},
 };
 
 esp_err_t esp_host_zb_input(esp_host_header_t *host_header, const void *buffer, uint16_t len)
@@ -188,11 +210,16 @@ esp_err_t esp_host_zb_input(esp_host_header_t *host_header, const void *buffer,
     BaseType_t ret = 0;
     esp_host_zb_ctx_t host_ctx = {
         .id = host_header->id,
+        .sn = host_header->sn,
         .size = len,
     };
 
     if (buffer) {
         host_ctx.data = calloc(1, len);
+        if (!host_ctx.data) {
+            ESP_LOGE(TAG, "Malloc frame 0x%04x fail", host_header->id);
+            return ESP_ERR_NO_MEM;
+        }
         memcpy(host_ctx.data, buffer, len);
     }
 
@@ -201,14 +228,42 @@ esp_err_t esp_host_zb_input(esp_host_header_t *host_header, const void *buffer,
     } else {
         ret = xQueueSend(queue, &host_ctx, 0);
     }
-    return (ret == pdTRUE) ? ESP_OK : ESP_FAIL ;
+
+    /* The reliable link does not acknowledge the frame which is not queued, the NCP sends it again */
+    if (ret != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full, frame 0x%04x not queued", host_header->id);
+        free(host_ctx.data);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
 }
 
-esp_err_t esp_host_zb_output(uint16_t id, const void *buffer, uint16_t len, void *output, uint16_t *outlen)
+/**
+ * @brief Check whether a response answers the request, the responses to the requests timed out are dropped.
+ *
+ */
+static bool esp_host_zb_response_match(const esp_host_zb_ctx_t *host_ctx, uint16_t id, uint8_t sn)
+{
+    if (host_ctx->sn == sn && (host_ctx->id == id || host_ctx->id == HOST_ZB_ERROR_ID)) {
+        /* The NCP answers in order, no late response could come after this one */
+        s_request_stale = false;
+        return true;
+    }
+
+    if (s_request_stale && host_ctx->sn == s_request_stale_sn) {
+        s_request_stale = false;
+        return false;
+    }
+
+    /* The error answered to a corrupted request carries no sequence number, it is only trusted if no answer is late */
+    return (host_ctx->id == HOST_ZB_ERROR_ID && !s_request_stale);
+}
+
+static esp_err_t esp_host_zb_request(uint16_t id, const void *buffer, uint16_t len, void *output, uint16_t *outlen, TickType_t timeout)
 {
     esp_host_header_t data_header = {
         .id = id,
-        .sn = esp_random() % 0xFF,
         .len = len,
         .flags = {
             .version = 0,
@@ -216,13 +271,19 @@ esp_err_t esp_host_zb_output(uint16_t id, const void *buffer, uint16_t len, void
     };
     data_header.flags.type = ESP_ZNSP_TYPE_REQUEST;
 
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    esp_host_zb_ctx_t host_ctx;
+    TimeOut_t time_out;
+
     xSemaphoreTakeRecursive(lock_semaphore, portMAX_DELAY);
+    /* The NCP echoes the sequence number, so the late answer of an earlier request is not taken for this one */
+    data_header.sn = ++ s_request_sn;
     esp_host_frame_output(&data_header, buffer, len);
 
-    esp_host_zb_ctx_t host_ctx;
-    xQueueReceive(output_queue, &host_ctx, portMAX_DELAY);
-    if (host_ctx.data) {
-        if ((host_ctx.id == id)) {
+    vTaskSetTimeOutState(&time_out);
+    while (xQueueReceive(output_queue, &host_ctx, timeout) == pdTRUE) {
+        bool match = esp_host_zb_response_match(&host_ctx, id, data_header.sn);
+        if (match && host_ctx.id == id && host_ctx.data) {
             if (output) {
                 memcpy(output, host_ctx.data, host_ctx.size);
             }
@@ -234,10 +295,72 @@ esp_err_t esp_host_zb_output(uint16_t id, const void *buffer, uint16_t len, void
 
         free(host_ctx.data);
         host_ctx.data = NULL;
+
+        if (match) {
+            ret = (host_ctx.id == id) ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+            break;
+        }
+
+        ESP_LOGW(TAG, "Drop the late response 0x%04x (sn %d)", host_ctx.id, host_ctx.sn);
+        if (xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE) {
+            break;
+        }
+    }
+
+    if (ret == ESP_ERR_TIMEOUT) {
+        s_request_stale = true;
+        s_request_stale_sn = data_header.sn;
     }
     xSemaphoreGiveRecursive(lock_semaphore);
 
-    return  ESP_OK;
+    return ret;
+}
+
+esp_err_t esp_host_zb_output(uint16_t id, const void *buffer, uint16_t len, void *output, uint16_t *outlen)
+{
+    return esp_host_zb_request(id, buffer, len, output, outlen, portMAX_DELAY);
+}
+
+esp_err_t esp_host_zb_output_timeout(uint16_t id, const void *buffer, uint16_t len, void *output, uint16_t *outlen, uint32_t timeout_ms)
+{
+    return esp_host_zb_request(id, buffer, len, output, outlen, pdMS_TO_TICKS(timeout_ms));
+}
+
+static esp_err_t esp_host_zb_hello(void)
+{
+    esp_host_frame_caps_t local;
+    esp_host_frame_caps_t peer;
+    uint16_t outlen = sizeof(esp_host_frame_caps_t);
+
+    esp_host_frame_caps_get(&local);
+    memset(&peer, 0, sizeof(esp_host_frame_caps_t));
+    esp_err_t ret = esp_host_zb_request(ESP_ZNSP_SYSTEM_HELLO, &local, sizeof(esp_host_frame_caps_t), &peer, &outlen,
+                                        pdMS_TO_TICKS(HOST_HELLO_TIMEOUT_MS));
+    if (ret != ESP_OK || outlen < sizeof(esp_host_frame_caps_t)) {
+        ESP_LOGW(TAG, "The NCP does not support the hello frame (%s), stay in the legacy mode", esp_err_to_name(ret));
+        return esp_host_frame_caps_negotiate(NULL);
+    }
+
+    return esp_host_frame_caps_negotiate(&peer);
+}
+
+esp_err_t esp_host_zb_output_nowait(uint16_t id, const void *buffer, uint16_t len)
+{
+    esp_host_header_t data_header = {
+        .id = id,
+        .len = len,
+        .flags = {
+            .version = 0,
+        }
+    };
+    data_header.flags.type = ESP_ZNSP_TYPE_REQUEST;
+
+    xSemaphoreTakeRecursive(lock_semaphore, portMAX_DELAY);
+    data_header.sn = ++ s_request_sn;
+    esp_err_t ret = esp_host_frame_output(&data_header, buffer, len);
+    xSemaphoreGiveRecursive(lock_semaphore);
+
+    return ret;
 }
 
 void *esp_zb_app_signal_get_params(uint32_t *signal_p)
@@ -250,12 +373,15 @@ void *esp_zb_app_signal_get_params(uint32_t *signal_p)
 void esp_zb_main_loop_iteration(void)
 {
     esp_host_zb_ctx_t host_ctx;
+
+    main_loop_task = xTaskGetCurrentTaskHandle();
     while (1) {
-       if (xQueueReceive(notify_queue, &host_ctx, pdMS_TO_TICKS(100)) != pdTRUE) {
+       /* Execute the alarms expired, then block until the next alarm expires or a notification arrives */
+       if (xQueueReceive(notify_queue, &host_ctx, esp_host_alarm_process()) != pdTRUE) {
             continue;
        }
 
-       for (int i = 0; i <= sizeof(host_zb_func_table) / sizeof(host_zb_func_table[0]); i ++) {
+       for (int i = 0; i < sizeof(host_zb_func_table) / sizeof(host_zb_func_table[0]); i ++) {
             if (host_ctx.id != host_zb_func_table[i].id) {
                 continue;
             }
@@ -271,6 +397,24 @@ void esp_zb_main_loop_iteration(void)
     }
 }
 
+esp_err_t esp_host_zb_wakeup(void)
+{
+    esp_host_zb_ctx_t host_ctx = {
+        .id = HOST_ZB_WAKEUP_ID,
+        .size = 0,
+        .data = NULL,
+    };
+
+    if (!notify_queue || xTaskGetCurrentTaskHandle() == main_loop_task) {
+        return ESP_OK;
+    }
+
+    /* The main loop wakes up anyway if the queue is full */
+    xQueueSend(notify_queue, &host_ctx, 0);
+
+    return ESP_OK;
+}
+
 esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list)
 {
     return ESP_OK;
@@ -280,10 +424,12 @@ esp_err_t esp_zb_platform_config(esp_zb_platform_config_t *config)
 {
     ESP_ERROR_CHECK(esp_host_init(config->host_config.host_mode));
     ESP_ERROR_CHECK(esp_host_start());
+    ESP_ERROR_CHECK(esp_host_alarm_init());
+    ESP_ERROR_CHECK(esp_host_zb_zcl_shadow_init());
 
     output_queue = xQueueCreate(HOST_EVENT_QUEUE_LEN, sizeof(esp_host_zb_ctx_t));
     notify_queue = xQueueCreate(HOST_EVENT_QUEUE_LEN, sizeof(esp_host_zb_ctx_t));
     lock_semaphore = xSemaphoreCreateRecursiveMutex();
 
-    return ESP_OK;
+    return esp_host_zb_hello();
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "esp_host_zb.h"
+#include "esp_host_alarm.h"
 
 #include "esp_zigbee_core.h"
 #include "esp_zigbee_zcl_command.h"
@@ -18,7 +19,14 @@ esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask)
 
 void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time)
 {
+    if (esp_host_alarm_schedule(cb, param, time) == ESP_OK) {
+        esp_host_zb_wakeup();
+    }
+}
 
+void esp_zb_scheduler_alarm_cancel(esp_zb_callback_t cb, uint8_t param)
+{
+    esp_host_alarm_cancel(cb, param);
 }
 
 esp_err_t esp_zb_set_primary_network_channel_set(uint32_t channel_mask)
@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include "lz.h"
+
+#define LZ_HASH(p)  ((((uint32_t)(p)[0] << 16 | (p)[1] << 8 | (p)[2]) * 2654435761U) >> (32 - LZ_HASH_LOG))
+
+esp_err_t lz_compress(const uint8_t *inbuf, uint16_t inlen, uint8_t *outbuf, uint16_t *outlen)
+{
+    /* The position + 1 of the latest 3 bytes with the same hash, 0 if none */
+    uint16_t htab[1 << LZ_HASH_LOG] = { 0 };
+    uint16_t size = *outlen;
+    uint16_t ip = 0;
+    uint16_t op = 1;                /* The first byte is reserved for the control of the literal run */
+    uint8_t  lit = 0;
+
+    if (!inbuf || !outbuf || !inlen || size < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (ip < inlen) {
+        if (ip + 2 < inlen) {
+            uint32_t h = LZ_HASH(inbuf + ip);
+            uint16_t ref = htab[h];
+            htab[h] = ip + 1;
+
+            if (ref && (ip - ref) < LZ_MAX_OFFSET && !memcmp(inbuf + ref - 1, inbuf + ip, 3)) {
+                uint16_t off = ip - ref;
+                uint16_t max = (inlen - ip < LZ_MAX_MATCH) ? inlen - ip : LZ_MAX_MATCH;
+                uint16_t len = 3;
+
+                while (len < max && inbuf[ref - 1 + len] == inbuf[ip + len]) {
+                    len++;
+                }
+
+                /* Close the literal run, or drop its control if it is empty */
+                if (lit) {
+                    outbuf[op - lit - 1] = lit - 1;
+                    lit = 0;
+                } else {
+                    op--;
+                }
+
+                /* The back reference and the control of the next literal run */
+                if (op + 4 > size) {
+                    return ESP_ERR_INVALID_SIZE;
+                }
+
+                len -= 2;
+                if (len < 7) {
+                    outbuf[op++] = (off >> 8) + (len << 5);
+                } else {
+                    outbuf[op++] = (off >> 8) + (7 << 5);
+                    outbuf[op++] = len - 7;
+                }
+                outbuf[op++] = off & 0xFF;
+                op++;
+                ip += len + 2;
+                continue;
+            }
+        }
+
+        if (op + 1 > size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        outbuf[op++] = inbuf[ip++];
+        if (++lit == LZ_MAX_LITERAL) {
+            outbuf[op - lit - 1] = lit - 1;
+            lit = 0;
+            if (op + 1 > size) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            op++;
+        }
+    }
+
+    if (lit) {
+        outbuf[op - lit - 1] = lit - 1;
+    } else {
+        op--;
+    }
+
+    *outlen = op;
+
+    return ESP_OK;
+}
+
+esp_err_t lz_decompress(const uint8_t *inbuf, uint16_t inlen, uint8_t *outbuf, uint16_t *outlen)
+{
+    uint16_t size = *outlen;
+    uint16_t ip = 0;
+    uint16_t op = 0;
+
+    if (!inbuf || !outbuf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (ip < inlen) {
+        uint8_t ctrl = inbuf[ip++];
+        uint16_t len = 0;
+
+        if (ctrl < (1 << 5)) {
+            /* Literal run */
+            len = ctrl + 1;
+            if (ip + len > inlen) {
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            if (op + len > size) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+
+            memcpy(outbuf + op, inbuf + ip, len);
+            ip += len;
+            op += len;
+        } else {
+            /* Back reference */
+            len = ctrl >> 5;
+            if (len == 7) {
+                if (ip >= inlen) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                len += inbuf[ip++];
+            }
+            len += 2;
+
+            if (ip >= inlen) {
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            uint16_t off = (((ctrl & 0x1F) << 8) | inbuf[ip++]) + 1;
+            if (off > op) {
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            if (op + len > size) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+
+            /* The source could overlap the destination, copy byte by byte */
+            for (uint16_t i = 0; i < len; i++, op++) {
+                outbuf[op] = outbuf[op - off];
+            }
+        }
+    }
+
+    *outlen = op;
+
+    return ESP_OK;
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "esp_host_zb.h"
+
+#include "esp_zigbee_ota.h"
+
+#define HOST_OTA_IMAGE_NUM          8                       /*!< The maximum number of the OTA images registered on the NCP */
+
+static const char *TAG = "ESP_ZB_OTA";
+
+/**
+ * @brief Type to represent the callbacks of the OTA image registered on the NCP.
+ *
+ */
+typedef struct {
+    esp_zb_ota_upgrade_server_read_callback_t read_cb;      /*!< Read the image data, NULL if the image is not registered */
+    esp_zb_ota_upgrade_server_status_callback_t status_cb;  /*!< Report the upgrade status of the clients */
+} esp_host_zb_ota_image_cb_t;
+
+static esp_host_zb_ota_image_cb_t s_ota_image_cb[HOST_OTA_IMAGE_NUM];
+
+esp_err_t esp_host_zb_ota_server_block_request_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_ota_block_t), ESP_ERR_INVALID_ARG, TAG, "Invalid OTA block request");
+
+    const esp_host_zb_ota_block_t *request = (const esp_host_zb_ota_block_t *)input;
+    esp_host_zb_ota_block_t *block = calloc(1, sizeof(esp_host_zb_ota_block_t) + request->size);
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(block, ESP_ERR_NO_MEM, TAG, "Malloc OTA block fail");
+    memcpy(block, request, sizeof(esp_host_zb_ota_block_t));
+
+    if (request->index >= HOST_OTA_IMAGE_NUM || !s_ota_image_cb[request->index].read_cb) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else {
+        ret = s_ota_image_cb[request->index].read_cb(request->index, request->offset, request->size, (uint8_t *)(block + 1));
+    }
+
+    if (ret != ESP_OK) {
+        /* An empty block tells the NCP to abort the client instead of waiting for the data */
+        ESP_LOGW(TAG, "Failed to read the OTA image %d at offset %" PRIu32 ": %s", request->index, request->offset, esp_err_to_name(ret));
+        block->size = 0;
+    }
+
+    /* The NCP does not answer the data, the main loop is not blocked while the clients download */
+    esp_host_zb_output_nowait(ESP_ZNSP_OTA_SERVER_BLOCK_DATA, block, sizeof(esp_host_zb_ota_block_t) + block->size);
+    free(block);
+    block = NULL;
+
+    return ret;
+}
+
+esp_err_t esp_host_zb_ota_server_status_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_ota_status_t), ESP_ERR_INVALID_ARG, TAG, "Invalid OTA server status");
+
+    const esp_host_zb_ota_status_t *status = (const esp_host_zb_ota_status_t *)input;
+
+    ESP_LOGI(TAG, "OTA client 0x%04hx image %d status %d at offset %" PRIu32, status->short_addr, status->index, status->status, status->offset);
+    if (status->index < HOST_OTA_IMAGE_NUM && s_ota_image_cb[status->index].status_cb) {
+        s_ota_image_cb[status->index].status_cb(status->short_addr, status->index, status->status, status->offset);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_ota_upgrade_server_notify_req(esp_zb_ota_upgrade_server_notify_req_t *req)
+{
+    ESP_RETURN_ON_FALSE(req && req->read_cb && req->index < HOST_OTA_IMAGE_NUM && req->ota_file_header.image_size, ESP_ERR_INVALID_ARG,
+                        TAG, "Invalid OTA upgrade server notify request");
+    ESP_RETURN_ON_FALSE(esp_host_frame_caps()->features & ESP_HOST_FEATURE_OTA_SERVER, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "The NCP does not serve the OTA images from the host");
+
+    esp_host_zb_ota_image_t image = {
+        .endpoint = req->endpoint,
+        .index = req->index,
+        .notify_on = req->notify_on,
+        .ota_upgrade_time = req->ota_upgrade_time,
+        .manufacturer_code = req->ota_file_header.manufacturer_code,
+        .image_type = req->ota_file_header.image_type,
+        .file_version = req->ota_file_header.file_version,
+        .image_size = req->ota_file_header.image_size,
+    };
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+
+    /* The callbacks must be in place before the NCP requests the first block */
+    s_ota_image_cb[req->index].read_cb = req->read_cb;
+    s_ota_image_cb[req->index].status_cb = req->status_cb;
+
+    esp_host_zb_output(ESP_ZNSP_OTA_SERVER_NOTIFY, &image, sizeof(esp_host_zb_ota_image_t), &output, &outlen);
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
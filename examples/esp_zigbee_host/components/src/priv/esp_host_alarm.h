@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#include "esp_zigbee_type.h"
+
+/**
+ * @brief   Initialize the alarm scheduler.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ */
+esp_err_t esp_host_alarm_init(void);
+
+/**
+ * @brief   Deinitialize the alarm scheduler, the alarms not expired are dropped.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ */
+esp_err_t esp_host_alarm_deinit(void);
+
+/**
+ * @brief   Schedule the callback to be executed by the host main loop after the timeout.
+ *
+ * @param[in] cb    The function to call
+ * @param[in] param The parameter to pass to the function
+ * @param[in] time  The timeout, in millisecond
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_NO_MEM: no memory for the alarm
+ *    - others: refer to esp_err.h
+ */
+esp_err_t esp_host_alarm_schedule(esp_zb_callback_t cb, uint8_t param, uint32_t time);
+
+/**
+ * @brief   Cancel all the alarms scheduled with the callback and the parameter.
+ *
+ * @param[in] cb    The function to cancel
+ * @param[in] param The parameter to pass to the function to cancel
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_NOT_FOUND: no alarm is scheduled with the callback and the parameter
+ */
+esp_err_t esp_host_alarm_cancel(esp_zb_callback_t cb, uint8_t param);
+
+/**
+ * @brief   Execute the expired alarms.
+ *
+ * @note It shall be called by the host main loop only, the callbacks are executed in its context.
+ *
+ * @return The ticks until the next alarm expires, portMAX_DELAY if no alarm is scheduled
+ */
+TickType_t esp_host_alarm_process(void);
+
+#ifdef __cplusplus
+}
+#endif
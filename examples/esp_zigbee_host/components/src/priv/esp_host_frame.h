@@ -12,6 +12,25 @@ extern "C" {
 #include <stdint.h>
 #include "esp_err.h"
 
+/** Definition of the bits in the reserved flags of the frame header
+ *
+ */
+#define ESP_HOST_FRAME_FLAG_RELIABLE    0x01    /*!< The payload starts with the link sequence number and the frame must be acknowledged */
+#define ESP_HOST_FRAME_FLAG_SYNC        0x02    /*!< The receiver restarts the expected link sequence number from this frame */
+#define ESP_HOST_FRAME_FLAG_COMPRESSED    0x04    /*!< The payload is the original length followed by the LZ compressed payload */
+
+/** Definition of the protocol version and the feature bits exchanged in the hello frame
+ *
+ */
+#define ESP_HOST_FRAME_VERSION           1           /*!< The latest protocol version supported */
+#define ESP_HOST_FEATURE_COMPRESSION     (1 << 2)    /*!< The frame payload is compressed */
+#define ESP_HOST_FEATURE_RELIABLE        (1 << 3)    /*!< The reliable sliding window transport */
+#define ESP_HOST_FEATURE_APS_PUSH        (1 << 4)    /*!< The APS data indication is pushed without polling */
+#define ESP_HOST_FEATURE_APS_CHUNK       (1 << 5)    /*!< The large APS data is transferred in chunks */
+#define ESP_HOST_FEATURE_OTA_SERVER      (1 << 6)    /*!< The OTA image data is served by the host on demand */
+#define ESP_HOST_FEATURE_NODE_TABLE      (1 << 7)    /*!< The node table is kept on the NCP */
+#define ESP_HOST_FEATURE_ZCL_FANOUT      (1 << 8)    /*!< The attributes are read from many nodes with one request */
+
 /**
  * @brief Type to represent the protocol frame used between the host and the NCP.
  *
@@ -27,6 +46,86 @@ typedef struct {
     uint16_t len;                               /*!< The payload length for request, response and notify */
 } __attribute__((packed)) esp_host_header_t;
 
+/**
+ * @brief Type to represent the payload of the link acknowledgement frame.
+ *
+ */
+typedef struct {
+    uint8_t  ack;                               /*!< The next expected link sequence number, all the frames before it have been received */
+    uint16_t sack;                              /*!< The bit n is set if the frame with link sequence number ack + 1 + n has been received */
+} __attribute__((packed)) esp_host_frame_ack_t;
+
+/**
+ * @brief Type to represent the payload of the hello frame.
+ *
+ */
+typedef struct {
+    uint8_t  version;                           /*!< The protocol version */
+    uint16_t max_frame_size;                    /*!< The maximum payload length of the frame could be received */
+    uint8_t  window;                            /*!< The window of the reliable transport, 0 if not supported */
+    uint32_t features;                          /*!< The feature bits, refer to ESP_HOST_FEATURE_* */
+} __attribute__((packed)) esp_host_frame_caps_t;
+
+/**
+ * @brief  Initialize the frame link with the NCP.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ *
+ */
+esp_err_t esp_host_frame_init(void);
+
+/**
+ * @brief  Deinitialize the frame link with the NCP.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ *
+ */
+esp_err_t esp_host_frame_deinit(void);
+
+/**
+ * @brief  Get the capabilities supported locally.
+ *
+ * @param[out] caps The pointer to storage the local capabilities @ref esp_host_frame_caps_t
+ *
+ */
+void esp_host_frame_caps_get(esp_host_frame_caps_t *caps);
+
+/**
+ * @brief  Switch the link to the best mode mutually supported with the NCP.
+ *
+ * @note The link stays in the legacy mode with the version 0 and no features until it is called.
+ *
+ * @param[in] peer The capabilities of the NCP, NULL to restore the legacy mode
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - others: refer to esp_err.h
+ *
+ */
+esp_err_t esp_host_frame_caps_negotiate(const esp_host_frame_caps_t *peer);
+
+/**
+ * @brief  Get the capabilities negotiated with the NCP.
+ *
+ * @return The pointer to the negotiated capabilities @ref esp_host_frame_caps_t
+ *
+ */
+const esp_host_frame_caps_t *esp_host_frame_caps(void);
+
+/**
+ * @brief  Log the compression ratio and the CPU cost per frame ID.
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_NOT_SUPPORTED: the compression benchmark is not enabled
+ *
+ */
+esp_err_t esp_host_frame_compression_stats_dump(void);
+
 /** 
  * @brief  Output to host.
  * 
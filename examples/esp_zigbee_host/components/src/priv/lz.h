@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/** Definition of the LZ codec parameters
+ *
+ * The stream is a sequence of literal runs and back references:
+ *  - 000LLLLL, followed by L + 1 literal bytes
+ *  - LLLOOOOO [EEEEEEEE] OOOOOOOO, copy L + 2 bytes (L + E + 2 if L is 7) from the offset O + 1 bytes back
+ */
+#define LZ_HASH_LOG             8                           /* The hash table is (1 << LZ_HASH_LOG) * 2 bytes on the stack */
+#define LZ_MAX_LITERAL          32                          /* The maximum length of one literal run */
+#define LZ_MAX_OFFSET           (1 << 13)                   /* The maximum distance of one back reference */
+#define LZ_MAX_MATCH            (7 + 255 + 2)               /* The maximum length of one back reference */
+
+/**
+ * @brief   Compress a packet into the buffer located at "outbuf".
+ *
+ * @param[in]     inbuf  The pointer to store a packet data
+ * @param[in]     inlen  The length of a packet data
+ * @param[out]    outbuf The pointer to store a compressed packet data
+ * @param[inout]  outlen The size of the outbuf as input, the length of a compressed packet data as output
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_INVALID_SIZE: the compressed packet data does not fit in the outbuf
+ *    - others: refer to esp_err.h
+ */
+esp_err_t lz_compress(const uint8_t *inbuf, uint16_t inlen, uint8_t *outbuf, uint16_t *outlen);
+
+/**
+ * @brief   Decompress a packet into the buffer located at "outbuf".
+ *
+ * @param[in]     inbuf  The pointer to store a compressed packet data
+ * @param[in]     inlen  The length of a compressed packet data
+ * @param[out]    outbuf The pointer to store a packet data
+ * @param[inout]  outlen The size of the outbuf as input, the length of a packet data as output
+ *
+ * @return
+ *    - ESP_OK: succeed
+ *    - ESP_ERR_INVALID_SIZE: the packet data does not fit in the outbuf
+ *    - ESP_ERR_INVALID_ARG: the compressed packet data is corrupted
+ */
+esp_err_t lz_decompress(const uint8_t *inbuf, uint16_t inlen, uint8_t *outbuf, uint16_t *outlen);
+
+#ifdef __cplusplus
+}
+#endif
@@ -67,3 +67,95 @@ uint8_t esp_zb_zcl_custom_cluster_cmd_req(esp_zb_zcl_custom_cluster_cmd_t *cmd_r
 
     return ESP_OK;
 }
+
+/**
+ * @brief Get the size of the analog attribute type, the discrete types have no reportable change.
+ *
+ */
+static uint8_t esp_host_zb_zcl_analog_size(uint8_t type)
+{
+    if (type >= ESP_ZB_ZCL_ATTR_TYPE_U8 && type <= ESP_ZB_ZCL_ATTR_TYPE_S64) {
+        return (type & 0x07) + 1;
+    }
+
+    switch (type) {
+        case ESP_ZB_ZCL_ATTR_TYPE_SEMI:
+            return 2;
+        case ESP_ZB_ZCL_ATTR_TYPE_SINGLE:
+        case ESP_ZB_ZCL_ATTR_TYPE_TIME_OF_DAY:
+        case ESP_ZB_ZCL_ATTR_TYPE_DATE:
+        case ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME:
+            return 4;
+        case ESP_ZB_ZCL_ATTR_TYPE_DOUBLE:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+uint16_t esp_host_zb_zcl_report_config_encode(const esp_zb_zcl_config_report_record_t *record_field, uint16_t record_number, uint8_t *data)
+{
+    uint16_t len = 0;
+
+    for (int i = 0; i < record_number; i ++) {
+        esp_host_zb_report_config_record_t record = {
+            .direction = record_field[i].direction,
+            .attribute_id = record_field[i].attributeID,
+            .attr_type = record_field[i].attrType,
+            .min_interval = record_field[i].min_interval,
+            .max_interval = record_field[i].max_interval,
+            .change_size = record_field[i].reportable_change ? esp_host_zb_zcl_analog_size(record_field[i].attrType) : 0,
+        };
+
+        if (data) {
+            memcpy(data + len, &record, sizeof(esp_host_zb_report_config_record_t));
+            if (record.change_size) {
+                memcpy(data + len + sizeof(esp_host_zb_report_config_record_t), record_field[i].reportable_change, record.change_size);
+            }
+        }
+        len += sizeof(esp_host_zb_report_config_record_t) + record.change_size;
+    }
+
+    return len;
+}
+
+esp_err_t esp_zb_zcl_config_report_cmd_req(esp_zb_zcl_config_report_cmd_t *cmd_req)
+{
+    typedef struct {
+        esp_zb_zcl_basic_cmd_t zcl_basic_cmd;                   /*!< Basic command info */
+        uint8_t  address_mode;                                  /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+        uint16_t cluster_id;                                    /*!< Cluster ID to configure */
+        uint16_t record_number;                                 /*!< Number of the reporting records */
+    } ESP_ZNSP_ZB_PACKED_STRUCT esp_host_zb_report_config_t;
+
+    if (!cmd_req || !cmd_req->record_number || !cmd_req->record_field) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t data_len = sizeof(esp_host_zb_report_config_t);
+    uint16_t records_len = esp_host_zb_zcl_report_config_encode(cmd_req->record_field, cmd_req->record_number, NULL);
+    uint8_t *data = calloc(1, data_len + records_len);
+    esp_host_zb_report_config_t report_config = {
+        .zcl_basic_cmd = cmd_req->zcl_basic_cmd,
+        .address_mode = cmd_req->address_mode,
+        .cluster_id = cmd_req->clusterID,
+        .record_number = cmd_req->record_number,
+    };
+
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(data, &report_config, data_len);
+    esp_host_zb_zcl_report_config_encode(cmd_req->record_field, cmd_req->record_number, data + data_len);
+    data_len += records_len;
+
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+
+    esp_host_zb_output(ESP_ZNSP_ZCL_REPORT_CONFIG, data, data_len, &output, &outlen);
+    free(data);
+    data = NULL;
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
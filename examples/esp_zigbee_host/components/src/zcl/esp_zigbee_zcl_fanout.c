@@ -0,0 +1,290 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "esp_host_zb.h"
+
+#include "esp_zigbee_zcl_fanout.h"
+
+#define HOST_ZCL_FANOUT_NUM         4                       /*!< The maximum number of the fan-out requests in progress */
+
+static const char *TAG = "ESP_ZB_FANOUT";
+
+/**
+ * @brief Type to represent a fan-out request waiting for the results.
+ *
+ */
+typedef struct {
+    bool in_use;                                            /*!< The fan-out request is in progress */
+    uint16_t id;                                            /*!< The frame ID of the request */
+    uint8_t handle;                                         /*!< The handle of the fan-out request */
+    esp_zb_zcl_fanout_callback_t cb;                        /*!< The callback for the results */
+    void *user_ctx;                                         /*!< The user context passed to the callback */
+} esp_host_zb_fanout_ctx_t;
+
+static esp_host_zb_fanout_ctx_t s_fanout_ctx[HOST_ZCL_FANOUT_NUM];
+static uint8_t s_fanout_handle = 0;
+
+static esp_host_zb_fanout_ctx_t *esp_host_zb_fanout_ctx_get(uint8_t handle)
+{
+    for (int i = 0; i < HOST_ZCL_FANOUT_NUM; i ++) {
+        if (s_fanout_ctx[i].in_use && s_fanout_ctx[i].handle == handle) {
+            return &s_fanout_ctx[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Decode the attributes read from a target.
+ *
+ * @return The bytes of the attributes decoded, 0 if they are truncated
+ */
+static uint16_t esp_host_zb_fanout_attr_decode(const uint8_t *buffer, uint16_t size, uint8_t count, esp_zb_zcl_fanout_attr_t *attr_list)
+{
+    uint16_t len = 0;
+
+    for (int i = 0; i < count; i ++) {
+        if (size < len + sizeof(esp_host_zb_fanout_attr_t)) {
+            return 0;
+        }
+
+        const esp_host_zb_fanout_attr_t *attr = (const esp_host_zb_fanout_attr_t *)(buffer + len);
+        len += sizeof(esp_host_zb_fanout_attr_t);
+        if (size < len + attr->size) {
+            return 0;
+        }
+
+        attr_list[i].id = attr->id;
+        attr_list[i].status = attr->status;
+        attr_list[i].type = attr->type;
+        attr_list[i].size = attr->size;
+        attr_list[i].value = attr->size ? buffer + len : NULL;
+        len += attr->size;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Decode the statuses of the reporting configuration of a target.
+ *
+ * @return The bytes of the statuses decoded, 0 if they are truncated
+ */
+static uint16_t esp_host_zb_fanout_config_decode(const uint8_t *buffer, uint16_t size, uint8_t count, esp_zb_zcl_fanout_config_status_t *config_list)
+{
+    uint16_t len = count * sizeof(esp_host_zb_fanout_config_status_t);
+
+    if (size < len) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i ++) {
+        const esp_host_zb_fanout_config_status_t *config_status = (const esp_host_zb_fanout_config_status_t *)buffer + i;
+        config_list[i].status = config_status->status;
+        config_list[i].direction = config_status->direction;
+        config_list[i].attribute_id = config_status->attribute_id;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Decode the result of a target and call the callback.
+ *
+ * @return The bytes of the record decoded, 0 if the record is truncated
+ */
+static uint16_t esp_host_zb_fanout_record_decode(const esp_host_zb_fanout_ctx_t *ctx, uint16_t cluster_id, const uint8_t *buffer, uint16_t size)
+{
+    const esp_host_zb_fanout_record_t *record = (const esp_host_zb_fanout_record_t *)buffer;
+    bool read = (ctx->id == ESP_ZNSP_ZCL_ATTR_READ_FANOUT);
+    void *list = NULL;
+    uint16_t len = sizeof(esp_host_zb_fanout_record_t);
+
+    if (size < len) {
+        return 0;
+    }
+
+    if (record->attr_count) {
+        list = calloc(record->attr_count, read ? sizeof(esp_zb_zcl_fanout_attr_t) : sizeof(esp_zb_zcl_fanout_config_status_t));
+        if (!list) {
+            ESP_LOGE(TAG, "Malloc fan-out result fail");
+            return 0;
+        }
+
+        uint16_t entries_len = read ? esp_host_zb_fanout_attr_decode(buffer + len, size - len, record->attr_count, list)
+                                    : esp_host_zb_fanout_config_decode(buffer + len, size - len, record->attr_count, list);
+        len = entries_len ? len + entries_len : 0;
+    }
+
+    if (len && ctx->cb) {
+        esp_zb_zcl_fanout_result_t result = {
+            .short_addr = record->short_addr,
+            .endpoint = record->endpoint,
+            .status = record->status,
+            .cluster_id = cluster_id,
+            .attr_count = record->attr_count,
+            .attr_list = read ? list : NULL,
+            .config_list = read ? NULL : list,
+        };
+        ctx->cb(ctx->handle, &result, ctx->user_ctx);
+    }
+
+    free(list);
+    list = NULL;
+
+    return len;
+}
+
+esp_err_t esp_host_zb_zcl_fanout_result_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen >= sizeof(esp_host_zb_fanout_result_t), ESP_ERR_INVALID_ARG, TAG, "Invalid fan-out result");
+
+    const esp_host_zb_fanout_result_t *result = (const esp_host_zb_fanout_result_t *)input;
+    esp_host_zb_fanout_ctx_t *ctx = esp_host_zb_fanout_ctx_get(result->handle);
+    uint16_t offset = sizeof(esp_host_zb_fanout_result_t);
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(ctx, ESP_ERR_NOT_FOUND, TAG, "Drop the results of the unknown fan-out request %d", result->handle);
+
+    for (int i = 0; i < result->count; i ++) {
+        uint16_t len = esp_host_zb_fanout_record_decode(ctx, result->cluster_id, input + offset, inlen - offset);
+        if (!len) {
+            ESP_LOGE(TAG, "Truncated results of the fan-out request %d", result->handle);
+            ret = ESP_FAIL;
+            break;
+        }
+        offset += len;
+    }
+
+    /* The done flag comes with the last notification even if its records are truncated */
+    if (result->done) {
+        if (ctx->cb) {
+            ctx->cb(ctx->handle, NULL, ctx->user_ctx);
+        }
+        ctx->in_use = false;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Send a fan-out request, the field is the attribute list or the reporting records in the wire format.
+ *
+ */
+static esp_err_t esp_host_zb_fanout_request(uint16_t id, esp_host_zb_fanout_t *request, const uint8_t *field, uint16_t field_len,
+                                            const esp_zb_zcl_fanout_target_t *target_list, esp_zb_zcl_fanout_callback_t cb, void *user_ctx,
+                                            uint8_t *handle)
+{
+    ESP_RETURN_ON_FALSE(esp_host_frame_caps()->features & ESP_HOST_FEATURE_ZCL_FANOUT, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "The NCP does not support the fan-out request");
+
+    uint32_t data_len = sizeof(esp_host_zb_fanout_t) + field_len + request->target_count * sizeof(esp_host_zb_fanout_target_t);
+    esp_host_zb_fanout_ctx_t *ctx = NULL;
+    uint8_t *data = NULL;
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+
+    ESP_RETURN_ON_FALSE(data_len <= esp_host_frame_caps()->max_frame_size, ESP_ERR_INVALID_SIZE, TAG,
+                        "Too many targets for a frame: %d", request->target_count);
+
+    for (int i = 0; i < HOST_ZCL_FANOUT_NUM; i ++) {
+        if (!s_fanout_ctx[i].in_use) {
+            ctx = &s_fanout_ctx[i];
+            break;
+        }
+    }
+    ESP_RETURN_ON_FALSE(ctx, ESP_ERR_NO_MEM, TAG, "Too many fan-out requests in progress");
+
+    data = calloc(1, data_len);
+    ESP_RETURN_ON_FALSE(data, ESP_ERR_NO_MEM, TAG, "Malloc fan-out request fail");
+
+    /* The handle is chosen before the request is sent, the first results could arrive before the answer is handled */
+    do {
+        s_fanout_handle ++;
+    } while (esp_host_zb_fanout_ctx_get(s_fanout_handle));
+    ctx->id = id;
+    ctx->handle = s_fanout_handle;
+    ctx->cb = cb;
+    ctx->user_ctx = user_ctx;
+    ctx->in_use = true;
+
+    request->handle = ctx->handle;
+    memcpy(data, request, sizeof(esp_host_zb_fanout_t));
+    memcpy(data + sizeof(esp_host_zb_fanout_t), field, field_len);
+
+    esp_host_zb_fanout_target_t *target = (esp_host_zb_fanout_target_t *)(data + sizeof(esp_host_zb_fanout_t) + field_len);
+    for (int i = 0; i < request->target_count; i ++) {
+        target[i].short_addr = target_list[i].short_addr;
+        target[i].endpoint = target_list[i].endpoint;
+    }
+
+    esp_host_zb_output(id, data, data_len, &output, &outlen);
+    free(data);
+    data = NULL;
+
+    if (output != ESP_ZNSP_SUCCESS) {
+        ctx->in_use = false;
+        return ESP_FAIL;
+    }
+
+    if (handle) {
+        *handle = ctx->handle;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_zcl_fanout_read_attr_cmd_req(const esp_zb_zcl_fanout_read_cmd_t *cmd_req, uint8_t *handle)
+{
+    ESP_RETURN_ON_FALSE(cmd_req && cmd_req->attr_number && cmd_req->attr_field && cmd_req->target_count && cmd_req->target_list,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid fan-out read request");
+
+    esp_host_zb_fanout_t request = {
+        .src_endpoint = cmd_req->src_endpoint,
+        .cluster_id = cmd_req->cluster_id,
+        .interval_ms = cmd_req->interval_ms,
+        .timeout_ms = cmd_req->timeout_ms,
+        .field_number = cmd_req->attr_number,
+        .target_count = cmd_req->target_count,
+    };
+
+    return esp_host_zb_fanout_request(ESP_ZNSP_ZCL_ATTR_READ_FANOUT, &request, (const uint8_t *)cmd_req->attr_field,
+                                      cmd_req->attr_number * sizeof(uint16_t), cmd_req->target_list, cmd_req->cb, cmd_req->user_ctx, handle);
+}
+
+esp_err_t esp_zb_zcl_fanout_config_report_cmd_req(const esp_zb_zcl_fanout_config_report_cmd_t *cmd_req, uint8_t *handle)
+{
+    ESP_RETURN_ON_FALSE(cmd_req && cmd_req->record_number && cmd_req->record_field && cmd_req->target_count && cmd_req->target_list,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid bulk reporting configuration request");
+
+    esp_host_zb_fanout_t request = {
+        .src_endpoint = cmd_req->src_endpoint,
+        .cluster_id = cmd_req->cluster_id,
+        .interval_ms = cmd_req->interval_ms,
+        .timeout_ms = cmd_req->timeout_ms,
+        .field_number = cmd_req->record_number,
+        .target_count = cmd_req->target_count,
+    };
+    uint16_t records_len = esp_host_zb_zcl_report_config_encode(cmd_req->record_field, cmd_req->record_number, NULL);
+    uint8_t *records = calloc(1, records_len);
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(records, ESP_ERR_NO_MEM, TAG, "Malloc reporting records fail");
+    esp_host_zb_zcl_report_config_encode(cmd_req->record_field, cmd_req->record_number, records);
+
+    ret = esp_host_zb_fanout_request(ESP_ZNSP_ZCL_REPORT_CONFIG_BULK, &request, records, records_len, cmd_req->target_list, cmd_req->cb,
+                                     cmd_req->user_ctx, handle);
+    free(records);
+    records = NULL;
+
+    return ret;
+}
@@ -0,0 +1,497 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "esp_host_zb.h"
+
+#include "esp_zigbee_zcl_shadow.h"
+
+#if CONFIG_HOST_ZCL_SHADOW
+#define HOST_ZCL_SHADOW_ENTRIES         CONFIG_HOST_ZCL_SHADOW_ENTRIES
+#else
+#define HOST_ZCL_SHADOW_ENTRIES         0
+#endif
+
+#define HOST_ZCL_SHADOW_INLINE_SIZE     8               /*!< The values not longer than it are kept in the slot */
+#define HOST_ZCL_SHADOW_EVICT_PROBE     8               /*!< The number of the slots looked at to replace the oldest attribute */
+#define HOST_ZCL_SHADOW_PENDING_NUM     8               /*!< The maximum number of the read requests tracked in flight */
+#define HOST_ZCL_SHADOW_PENDING_MS      3000            /*!< The time to wait for the response before reading again */
+
+static const char *TAG = "ESP_ZB_SHADOW";
+
+/**
+ * @brief Type to represent the state of a slot in the attribute shadow.
+ *
+ */
+typedef enum {
+    ESP_HOST_ZB_SHADOW_EMPTY,                           /*!< The slot is never used, the probing stops here */
+    ESP_HOST_ZB_SHADOW_USED,                            /*!< The slot keeps an attribute */
+    ESP_HOST_ZB_SHADOW_DELETED,                         /*!< The attribute is removed, the probing goes on */
+} esp_host_zb_shadow_state_t;
+
+/**
+ * @brief Type to represent a slot of the attribute shadow, 24 bytes.
+ *
+ */
+typedef struct {
+    uint32_t timestamp;                                 /*!< The milliseconds since boot when the value is updated */
+    uint16_t short_addr;                                /*!< The short address of the node */
+    uint16_t cluster_id;                                /*!< The cluster identifier */
+    uint16_t attr_id;                                   /*!< The attribute identifier */
+    uint8_t endpoint;                                   /*!< The endpoint of the node */
+    uint8_t state;                                      /*!< The state of the slot, refer to esp_host_zb_shadow_state_t */
+    uint8_t type;                                       /*!< The type of the attribute */
+    uint8_t size;                                       /*!< The size of the value */
+    union {
+        uint8_t data[HOST_ZCL_SHADOW_INLINE_SIZE];      /*!< The value not longer than the inline size */
+        uint8_t *ptr;                                   /*!< The value longer than the inline size */
+    } value;                                            /*!< The value of the attribute */
+} esp_host_zb_shadow_slot_t;
+
+/**
+ * @brief Type to represent a read request in flight.
+ *
+ */
+typedef struct {
+    bool in_use;                                        /*!< The read request is in flight */
+    uint64_t key;                                       /*!< The key of the attribute read */
+    uint32_t timestamp;                                 /*!< The milliseconds since boot when the request is sent */
+} esp_host_zb_shadow_pending_t;
+
+typedef struct {
+    esp_host_zb_shadow_slot_t *slots;                   /*!< The open addressing table, NULL if the shadow is disabled */
+    uint16_t slot_num;                                  /*!< The number of the slots, at least 8 / 7 of the entries */
+    uint16_t used;                                      /*!< The number of the slots keeping an attribute */
+    uint16_t deleted;                                   /*!< The number of the slots removed and not reused yet */
+    SemaphoreHandle_t lock;                             /*!< The lock between the main loop and the readers */
+    esp_zb_zcl_shadow_update_callback_t cb;             /*!< The callback for the attributes updated */
+    void *user_ctx;                                     /*!< The user context passed to the callback */
+    esp_host_zb_shadow_pending_t pending[HOST_ZCL_SHADOW_PENDING_NUM];  /*!< The read requests in flight */
+} esp_host_zb_shadow_t;
+
+static esp_host_zb_shadow_t s_shadow;
+
+static uint32_t esp_host_zb_shadow_now(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static uint64_t esp_host_zb_shadow_key(uint16_t short_addr, uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    return ((uint64_t)short_addr << 40) | ((uint64_t)endpoint << 32) | ((uint32_t)cluster_id << 16) | attr_id;
+}
+
+static uint64_t esp_host_zb_shadow_slot_key(const esp_host_zb_shadow_slot_t *slot)
+{
+    return esp_host_zb_shadow_key(slot->short_addr, slot->endpoint, slot->cluster_id, slot->attr_id);
+}
+
+static uint16_t esp_host_zb_shadow_home(uint64_t key)
+{
+    /* Fibonacci hashing spreads the attributes of the same cluster on the nodes with close short addresses */
+    return (uint16_t)((uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) % s_shadow.slot_num);
+}
+
+static uint8_t *esp_host_zb_shadow_value(esp_host_zb_shadow_slot_t *slot)
+{
+    return (slot->size > HOST_ZCL_SHADOW_INLINE_SIZE) ? slot->value.ptr : slot->value.data;
+}
+
+static void esp_host_zb_shadow_value_free(esp_host_zb_shadow_slot_t *slot)
+{
+    if (slot->size > HOST_ZCL_SHADOW_INLINE_SIZE) {
+        free(slot->value.ptr);
+        slot->value.ptr = NULL;
+    }
+    slot->size = 0;
+}
+
+static esp_host_zb_shadow_slot_t *esp_host_zb_shadow_find(uint64_t key)
+{
+    uint16_t index = esp_host_zb_shadow_home(key);
+
+    for (int i = 0; i < s_shadow.slot_num; i ++) {
+        esp_host_zb_shadow_slot_t *slot = &s_shadow.slots[index];
+        if (slot->state == ESP_HOST_ZB_SHADOW_EMPTY) {
+            break;
+        }
+        if (slot->state == ESP_HOST_ZB_SHADOW_USED && esp_host_zb_shadow_slot_key(slot) == key) {
+            return slot;
+        }
+        index = (index + 1) % s_shadow.slot_num;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Take a slot for a new attribute, the oldest attribute near its home slot is replaced if the shadow is full.
+ *
+ */
+static esp_host_zb_shadow_slot_t *esp_host_zb_shadow_alloc(uint64_t key)
+{
+    uint16_t index = esp_host_zb_shadow_home(key);
+    esp_host_zb_shadow_slot_t *oldest = NULL;
+
+    for (int i = 0; i < s_shadow.slot_num; i ++) {
+        esp_host_zb_shadow_slot_t *slot = &s_shadow.slots[index];
+        if (slot->state == ESP_HOST_ZB_SHADOW_DELETED) {
+            s_shadow.deleted --;
+            s_shadow.used ++;
+            return slot;
+        }
+        if (slot->state == ESP_HOST_ZB_SHADOW_EMPTY) {
+            if ((s_shadow.used + s_shadow.deleted) < HOST_ZCL_SHADOW_ENTRIES || !oldest) {
+                s_shadow.used ++;
+                return slot;
+            }
+            break;
+        }
+        if (i < HOST_ZCL_SHADOW_EVICT_PROBE && (!oldest || (int32_t)(slot->timestamp - oldest->timestamp) < 0)) {
+            oldest = slot;
+        }
+        index = (index + 1) % s_shadow.slot_num;
+    }
+
+    /* The slots between the home slot and the oldest one are all used, the new attribute is still found by probing */
+    if (oldest) {
+        esp_host_zb_shadow_value_free(oldest);
+    }
+
+    return oldest;
+}
+
+static esp_err_t esp_host_zb_shadow_store(uint64_t key, uint8_t type, const void *value, uint8_t size)
+{
+    esp_host_zb_shadow_slot_t *slot = esp_host_zb_shadow_find(key);
+
+    if (!slot) {
+        slot = esp_host_zb_shadow_alloc(key);
+        ESP_RETURN_ON_FALSE(slot, ESP_ERR_NO_MEM, TAG, "No slot in the attribute shadow");
+        slot->state = ESP_HOST_ZB_SHADOW_USED;
+        slot->short_addr = (uint16_t)(key >> 40);
+        slot->endpoint = (uint8_t)(key >> 32);
+        slot->cluster_id = (uint16_t)(key >> 16);
+        slot->attr_id = (uint16_t)key;
+        slot->size = 0;
+    }
+
+    if (slot->size != size) {
+        esp_host_zb_shadow_value_free(slot);
+        if (size > HOST_ZCL_SHADOW_INLINE_SIZE) {
+            slot->value.ptr = malloc(size);
+            if (!slot->value.ptr) {
+                ESP_LOGE(TAG, "Malloc attribute value fail");
+                slot->state = ESP_HOST_ZB_SHADOW_DELETED;
+                s_shadow.used --;
+                s_shadow.deleted ++;
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        slot->size = size;
+    }
+
+    memcpy(esp_host_zb_shadow_value(slot), value, size);
+    slot->type = type;
+    slot->timestamp = esp_host_zb_shadow_now();
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Turn the removed slots before an empty slot back to empty, so the probing stops earlier.
+ *
+ */
+static void esp_host_zb_shadow_trim(uint16_t index)
+{
+    while (s_shadow.slots[index].state == ESP_HOST_ZB_SHADOW_DELETED
+           && s_shadow.slots[(index + 1) % s_shadow.slot_num].state == ESP_HOST_ZB_SHADOW_EMPTY) {
+        s_shadow.slots[index].state = ESP_HOST_ZB_SHADOW_EMPTY;
+        s_shadow.deleted --;
+        index = (index + s_shadow.slot_num - 1) % s_shadow.slot_num;
+    }
+}
+
+/**
+ * @brief Track a read request of the attribute.
+ *
+ * @return true if the request should be sent, false if one is already in flight
+ */
+static bool esp_host_zb_shadow_pending_set(uint64_t key, uint32_t now)
+{
+    esp_host_zb_shadow_pending_t *entry = NULL;
+
+    for (int i = 0; i < HOST_ZCL_SHADOW_PENDING_NUM; i ++) {
+        esp_host_zb_shadow_pending_t *pending = &s_shadow.pending[i];
+        if (pending->in_use && pending->key == key) {
+            if ((now - pending->timestamp) < HOST_ZCL_SHADOW_PENDING_MS) {
+                return false;
+            }
+            entry = pending;
+            break;
+        }
+        if (!entry || (entry->in_use && (!pending->in_use || (int32_t)(pending->timestamp - entry->timestamp) < 0))) {
+            entry = pending;
+        }
+    }
+
+    entry->in_use = true;
+    entry->key = key;
+    entry->timestamp = now;
+
+    return true;
+}
+
+static void esp_host_zb_shadow_pending_clear(uint64_t key)
+{
+    for (int i = 0; i < HOST_ZCL_SHADOW_PENDING_NUM; i ++) {
+        if (s_shadow.pending[i].in_use && s_shadow.pending[i].key == key) {
+            s_shadow.pending[i].in_use = false;
+        }
+    }
+}
+
+static void esp_host_zb_shadow_update(uint16_t short_addr, uint8_t endpoint, uint16_t cluster_id, const esp_host_zb_zcl_attr_t *attr,
+                                      const uint8_t *value)
+{
+    uint64_t key = esp_host_zb_shadow_key(short_addr, endpoint, cluster_id, attr->id);
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+    esp_host_zb_shadow_pending_clear(key);
+    if (attr->size) {
+        ret = esp_host_zb_shadow_store(key, attr->type, value, attr->size);
+    }
+    xSemaphoreGive(s_shadow.lock);
+
+    if (ret == ESP_OK && attr->size && s_shadow.cb) {
+        esp_zb_zcl_shadow_attr_t shadow_attr = {
+            .short_addr = short_addr,
+            .endpoint = endpoint,
+            .cluster_id = cluster_id,
+            .attr_id = attr->id,
+            .type = attr->type,
+            .size = attr->size,
+            .age_ms = 0,
+            .value = value,
+        };
+        s_shadow.cb(&shadow_attr, s_shadow.user_ctx);
+    }
+}
+
+esp_err_t esp_host_zb_zcl_attr_read_fn(const uint8_t *input, uint16_t inlen)
+{
+    ESP_RETURN_ON_FALSE(input && inlen > sizeof(esp_host_zb_zcl_cmd_info_t), ESP_ERR_INVALID_ARG, TAG, "Invalid read attribute response");
+
+    const esp_host_zb_zcl_cmd_info_t *info = (const esp_host_zb_zcl_cmd_info_t *)input;
+    uint8_t count = input[sizeof(esp_host_zb_zcl_cmd_info_t)];
+    uint16_t offset = sizeof(esp_host_zb_zcl_cmd_info_t) + sizeof(uint8_t);
+    uint16_t short_addr = 0;
+
+    if (!s_shadow.slots || info->status != ESP_ZB_ZCL_STATUS_SUCCESS || info->addr_type != ESP_ZB_ZCL_ADDR_TYPE_SHORT) {
+        return ESP_OK;
+    }
+
+    memcpy(&short_addr, info->src_addr, sizeof(uint16_t));
+    /* Each record is the status of the attribute, the attribute header and the value */
+    for (int i = 0; i < count; i ++) {
+        ESP_RETURN_ON_FALSE(inlen >= offset + sizeof(uint8_t) + sizeof(esp_host_zb_zcl_attr_t), ESP_ERR_INVALID_SIZE, TAG,
+                            "Truncated read attribute response from 0x%04hx", short_addr);
+        uint8_t attr_status = input[offset];
+        const esp_host_zb_zcl_attr_t *attr = (const esp_host_zb_zcl_attr_t *)(input + offset + sizeof(uint8_t));
+        offset += sizeof(uint8_t) + sizeof(esp_host_zb_zcl_attr_t);
+        ESP_RETURN_ON_FALSE(inlen >= offset + attr->size, ESP_ERR_INVALID_SIZE, TAG, "Truncated read attribute response from 0x%04hx",
+                            short_addr);
+        if (attr_status == ESP_ZB_ZCL_STATUS_SUCCESS) {
+            esp_host_zb_shadow_update(short_addr, info->src_endpoint, info->cluster, attr, input + offset);
+        }
+        offset += attr->size;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_zcl_attr_report_fn(const uint8_t *input, uint16_t inlen)
+{
+    uint16_t offset = sizeof(esp_host_zb_zcl_report_attr_t) + sizeof(esp_host_zb_zcl_attr_t);
+
+    ESP_RETURN_ON_FALSE(input && inlen >= offset, ESP_ERR_INVALID_ARG, TAG, "Invalid attribute report");
+
+    const esp_host_zb_zcl_report_attr_t *report = (const esp_host_zb_zcl_report_attr_t *)input;
+    const esp_host_zb_zcl_attr_t *attr = (const esp_host_zb_zcl_attr_t *)(input + sizeof(esp_host_zb_zcl_report_attr_t));
+    uint16_t short_addr = 0;
+
+    if (!s_shadow.slots || report->status != ESP_ZB_ZCL_STATUS_SUCCESS || report->addr_type != ESP_ZB_ZCL_ADDR_TYPE_SHORT) {
+        return ESP_OK;
+    }
+
+    memcpy(&short_addr, report->src_addr, sizeof(uint16_t));
+    ESP_RETURN_ON_FALSE(inlen >= offset + attr->size, ESP_ERR_INVALID_SIZE, TAG, "Truncated attribute report from 0x%04hx", short_addr);
+    esp_host_zb_shadow_update(short_addr, report->src_endpoint, report->cluster, attr, input + offset);
+
+    return ESP_OK;
+}
+
+static esp_err_t esp_host_zb_shadow_read_request(const esp_zb_zcl_shadow_read_cmd_t *cmd_req)
+{
+    typedef struct {
+        esp_zb_zcl_basic_cmd_t zcl_basic_cmd;               /*!< Basic command info */
+        uint8_t  address_mode;                              /*!< APS addressing mode constants refer to esp_zb_zcl_address_mode_t */
+        uint16_t cluster_id;                                /*!< Cluster ID to read */
+        uint8_t  attr_number;                               /*!< Number of attribute in the attr_field */
+        uint16_t attr_id;                                   /*!< The attribute to read */
+    } ESP_ZNSP_ZB_PACKED_STRUCT esp_host_zb_read_attr_t;
+
+    esp_host_zb_read_attr_t read_attr = {
+        .zcl_basic_cmd = cmd_req->zcl_basic_cmd,
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .cluster_id = cmd_req->cluster_id,
+        .attr_number = 1,
+        .attr_id = cmd_req->attr_id,
+    };
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+
+    esp_host_zb_output(ESP_ZNSP_ZCL_ATTR_READ, &read_attr, sizeof(esp_host_zb_read_attr_t), &output, &outlen);
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_zb_zcl_shadow_read(const esp_zb_zcl_shadow_read_cmd_t *cmd_req, esp_zb_zcl_shadow_attr_t *attr, void *value, uint8_t value_size)
+{
+    ESP_RETURN_ON_FALSE(cmd_req && attr, ESP_ERR_INVALID_ARG, TAG, "Invalid attribute shadow read");
+    ESP_RETURN_ON_FALSE(s_shadow.slots, ESP_ERR_NOT_SUPPORTED, TAG, "The attribute shadow is disabled");
+
+    uint16_t short_addr = cmd_req->zcl_basic_cmd.dst_addr_u.addr_short;
+    uint64_t key = esp_host_zb_shadow_key(short_addr, cmd_req->zcl_basic_cmd.dst_endpoint, cmd_req->cluster_id, cmd_req->attr_id);
+    uint32_t now = esp_host_zb_shadow_now();
+    esp_err_t ret = ESP_ERR_NOT_FINISHED;
+    bool copied = true;
+    bool request = false;
+
+    memset(attr, 0, sizeof(esp_zb_zcl_shadow_attr_t));
+    attr->short_addr = short_addr;
+    attr->endpoint = cmd_req->zcl_basic_cmd.dst_endpoint;
+    attr->cluster_id = cmd_req->cluster_id;
+    attr->attr_id = cmd_req->attr_id;
+
+    xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+    esp_host_zb_shadow_slot_t *slot = esp_host_zb_shadow_find(key);
+    if (slot) {
+        attr->type = slot->type;
+        attr->size = slot->size;
+        attr->age_ms = now - slot->timestamp;
+        if (value) {
+            copied = (value_size >= slot->size);
+            if (copied) {
+                memcpy(value, esp_host_zb_shadow_value(slot), slot->size);
+                attr->value = value;
+            }
+        }
+        if (cmd_req->max_age_ms && attr->age_ms <= cmd_req->max_age_ms) {
+            ret = ESP_OK;
+        }
+    }
+    if (ret != ESP_OK) {
+        request = esp_host_zb_shadow_pending_set(key, now);
+    }
+    xSemaphoreGive(s_shadow.lock);
+
+    /* The lock is not held while waiting for the NCP, the response is handled by the main loop */
+    if (request && esp_host_zb_shadow_read_request(cmd_req) != ESP_OK) {
+        xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+        esp_host_zb_shadow_pending_clear(key);
+        xSemaphoreGive(s_shadow.lock);
+        ESP_LOGW(TAG, "Failed to read the attribute 0x%04x of the cluster 0x%04x from 0x%04hx", cmd_req->attr_id, cmd_req->cluster_id, short_addr);
+        ret = ESP_FAIL;
+    }
+
+    return copied ? ret : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t esp_zb_zcl_shadow_update_handler_register(esp_zb_zcl_shadow_update_callback_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(s_shadow.slots, ESP_ERR_NOT_SUPPORTED, TAG, "The attribute shadow is disabled");
+
+    xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+    s_shadow.cb = cb;
+    s_shadow.user_ctx = user_ctx;
+    xSemaphoreGive(s_shadow.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_zcl_shadow_remove_node(uint16_t short_addr)
+{
+    ESP_RETURN_ON_FALSE(s_shadow.slots, ESP_ERR_NOT_SUPPORTED, TAG, "The attribute shadow is disabled");
+
+    xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+    for (int i = 0; i < s_shadow.slot_num; i ++) {
+        esp_host_zb_shadow_slot_t *slot = &s_shadow.slots[i];
+        if (slot->state != ESP_HOST_ZB_SHADOW_USED || slot->short_addr != short_addr) {
+            continue;
+        }
+        esp_host_zb_shadow_value_free(slot);
+        slot->state = ESP_HOST_ZB_SHADOW_DELETED;
+        s_shadow.used --;
+        s_shadow.deleted ++;
+        esp_host_zb_shadow_trim(i);
+    }
+    xSemaphoreGive(s_shadow.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_zcl_shadow_clear(void)
+{
+    ESP_RETURN_ON_FALSE(s_shadow.slots, ESP_ERR_NOT_SUPPORTED, TAG, "The attribute shadow is disabled");
+
+    xSemaphoreTake(s_shadow.lock, portMAX_DELAY);
+    for (int i = 0; i < s_shadow.slot_num; i ++) {
+        if (s_shadow.slots[i].state == ESP_HOST_ZB_SHADOW_USED) {
+            esp_host_zb_shadow_value_free(&s_shadow.slots[i]);
+        }
+    }
+    memset(s_shadow.slots, 0, s_shadow.slot_num * sizeof(esp_host_zb_shadow_slot_t));
+    memset(s_shadow.pending, 0, sizeof(s_shadow.pending));
+    s_shadow.used = 0;
+    s_shadow.deleted = 0;
+    xSemaphoreGive(s_shadow.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_host_zb_zcl_shadow_init(void)
+{
+    if (!HOST_ZCL_SHADOW_ENTRIES || s_shadow.slots) {
+        return ESP_OK;
+    }
+
+    /* Keep the load factor of the linear probing under 7 / 8 */
+    s_shadow.slot_num = HOST_ZCL_SHADOW_ENTRIES + HOST_ZCL_SHADOW_ENTRIES / 7 + 1;
+    s_shadow.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_shadow.lock, ESP_ERR_NO_MEM, TAG, "Create attribute shadow lock fail");
+
+    s_shadow.slots = calloc(s_shadow.slot_num, sizeof(esp_host_zb_shadow_slot_t));
+    if (!s_shadow.slots) {
+        ESP_LOGE(TAG, "Malloc attribute shadow of %d slots fail", s_shadow.slot_num);
+        vSemaphoreDelete(s_shadow.lock);
+        s_shadow.lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Attribute shadow of %d entries, %d bytes", HOST_ZCL_SHADOW_ENTRIES,
+             (int)(s_shadow.slot_num * sizeof(esp_host_zb_shadow_slot_t)));
+
+    return ESP_OK;
+}
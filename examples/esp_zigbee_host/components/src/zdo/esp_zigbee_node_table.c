@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "esp_host_zb.h"
+
+#include "esp_zigbee_node_table.h"
+
+static const char *TAG = "ESP_ZB_NODE";
+
+/**
+ * @brief Decode a node from the wire format, the endpoints and clusters beyond the limits of the host are dropped.
+ *
+ * @return The bytes of the node decoded, 0 if the node is truncated
+ */
+static uint16_t esp_host_zb_node_decode(const uint8_t *buffer, uint16_t size, esp_zb_node_info_t *node)
+{
+    const esp_host_zb_node_t *entry = (const esp_host_zb_node_t *)buffer;
+    uint16_t len = sizeof(esp_host_zb_node_t);
+
+    if (size < len) {
+        return 0;
+    }
+
+    memset(node, 0, sizeof(esp_zb_node_info_t));
+    node->short_addr = entry->short_addr;
+    memcpy(node->ieee_addr, entry->ieee_addr, sizeof(esp_zb_ieee_addr_t));
+    node->capability = entry->capability;
+    node->lqi = entry->lqi;
+    node->age = entry->age;
+
+    for (int i = 0; i < entry->ep_count; i ++) {
+        if (size < len + sizeof(esp_host_zb_node_ep_t)) {
+            return 0;
+        }
+
+        const esp_host_zb_node_ep_t *ep = (const esp_host_zb_node_ep_t *)(buffer + len);
+        uint16_t clusters_len = ep->cluster_count * sizeof(uint16_t);
+        len += sizeof(esp_host_zb_node_ep_t);
+        if (size < len + clusters_len) {
+            return 0;
+        }
+
+        if (node->ep_count < ESP_ZB_NODE_EP_NUM) {
+            esp_zb_node_endpoint_t *node_ep = &node->ep[node->ep_count ++];
+            node_ep->endpoint = ep->endpoint;
+            node_ep->profile_id = ep->profile_id;
+            node_ep->cluster_count = MIN(ep->cluster_count, ESP_ZB_NODE_CLUSTER_NUM);
+            memcpy(node_ep->cluster_list, buffer + len, node_ep->cluster_count * sizeof(uint16_t));
+        }
+        len += clusters_len;
+    }
+
+    return len;
+}
+
+static esp_err_t esp_host_zb_node_table_query(const esp_host_zb_node_query_t *query, esp_zb_node_info_t *node)
+{
+    uint16_t outlen = esp_host_frame_caps()->max_frame_size;
+    uint8_t *output = NULL;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(node, ESP_ERR_INVALID_ARG, TAG, "Invalid node");
+    ESP_RETURN_ON_FALSE(esp_host_frame_caps()->features & ESP_HOST_FEATURE_NODE_TABLE, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "The NCP does not keep the node table");
+
+    output = calloc(1, outlen);
+    ESP_RETURN_ON_FALSE(output, ESP_ERR_NO_MEM, TAG, "Malloc node table query fail");
+
+    esp_host_zb_output(ESP_ZNSP_NODE_TABLE_QUERY, query, sizeof(esp_host_zb_node_query_t), output, &outlen);
+    if (outlen > sizeof(uint8_t) && output[0] == ESP_ZNSP_SUCCESS) {
+        ret = esp_host_zb_node_decode(output + sizeof(uint8_t), outlen - sizeof(uint8_t), node) ? ESP_OK : ESP_FAIL;
+    }
+
+    free(output);
+    output = NULL;
+
+    return ret;
+}
+
+esp_err_t esp_zb_node_table_foreach(esp_zb_node_table_callback_t cb, void *user_ctx)
+{
+    uint16_t size = esp_host_frame_caps()->max_frame_size;
+    esp_host_zb_node_dump_t dump = {
+        .index = 0,
+        .count = 0,
+    };
+    esp_zb_node_info_t node;
+    uint8_t *output = NULL;
+    esp_err_t ret = ESP_OK;
+    bool more = true;
+
+    ESP_RETURN_ON_FALSE(cb, ESP_ERR_INVALID_ARG, TAG, "Invalid node table callback");
+    ESP_RETURN_ON_FALSE(esp_host_frame_caps()->features & ESP_HOST_FEATURE_NODE_TABLE, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "The NCP does not keep the node table");
+
+    output = calloc(1, size);
+    ESP_RETURN_ON_FALSE(output, ESP_ERR_NO_MEM, TAG, "Malloc node table page fail");
+
+    while (more) {
+        uint16_t outlen = size;
+        const esp_host_zb_node_page_t *page = (const esp_host_zb_node_page_t *)output;
+
+        memset(output, 0, size);
+        esp_host_zb_output(ESP_ZNSP_NODE_TABLE_DUMP, &dump, sizeof(esp_host_zb_node_dump_t), output, &outlen);
+        if (outlen < sizeof(esp_host_zb_node_page_t) || page->status != ESP_ZNSP_SUCCESS) {
+            ESP_LOGE(TAG, "Failed to dump the node table from the slot %d", dump.index);
+            ret = ESP_FAIL;
+            break;
+        }
+
+        uint16_t offset = sizeof(esp_host_zb_node_page_t);
+        for (int i = 0; i < page->count && more; i ++) {
+            uint16_t len = esp_host_zb_node_decode(output + offset, outlen - offset, &node);
+            if (!len) {
+                ESP_LOGE(TAG, "Truncated node table page from the slot %d", dump.index);
+                ret = ESP_FAIL;
+                more = false;
+                break;
+            }
+            offset += len;
+            more = cb(&node, user_ctx);
+        }
+
+        /* The next index never goes backwards, a page without progress ends the iteration */
+        if (page->next_index == 0xFFFF || page->next_index <= dump.index) {
+            more = false;
+        }
+        dump.index = page->next_index;
+    }
+
+    free(output);
+    output = NULL;
+
+    return ret;
+}
+
+esp_err_t esp_zb_node_table_query_by_short(uint16_t short_addr, esp_zb_node_info_t *node)
+{
+    esp_host_zb_node_query_t query = {
+        .short_addr = short_addr,
+    };
+
+    ESP_RETURN_ON_FALSE(short_addr != 0xFFFF, ESP_ERR_INVALID_ARG, TAG, "Invalid short address");
+
+    return esp_host_zb_node_table_query(&query, node);
+}
+
+esp_err_t esp_zb_node_table_query_by_ieee(const esp_zb_ieee_addr_t ieee_addr, esp_zb_node_info_t *node)
+{
+    esp_host_zb_node_query_t query = {
+        .short_addr = 0xFFFF,
+    };
+
+    ESP_RETURN_ON_FALSE(ieee_addr, ESP_ERR_INVALID_ARG, TAG, "Invalid IEEE address");
+    memcpy(query.ieee_addr, ieee_addr, sizeof(esp_zb_ieee_addr_t));
+
+    return esp_host_zb_node_table_query(&query, node);
+}
+
+esp_err_t esp_zb_node_table_clear(void)
+{
+    uint8_t output = ESP_ZNSP_ERR_FATAL;
+    uint16_t outlen = sizeof(uint8_t);
+
+    ESP_RETURN_ON_FALSE(esp_host_frame_caps()->features & ESP_HOST_FEATURE_NODE_TABLE, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "The NCP does not keep the node table");
+
+    esp_host_zb_output(ESP_ZNSP_NODE_TABLE_CLEAR, NULL, 0, &output, &outlen);
+
+    return (output == ESP_ZNSP_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
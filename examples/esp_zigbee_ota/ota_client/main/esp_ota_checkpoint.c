@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA checkpoint Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include "esp_check.h"
+#include "nvs.h"
+#include "esp_ota_checkpoint.h"
+
+#define OTA_CHECKPOINT_KEY            "checkpoint"
+
+static const char *TAG = "ESP_OTA_CHECKPOINT";
+
+esp_err_t esp_ota_checkpoint_load(esp_ota_checkpoint_t *checkpoint)
+{
+    nvs_handle_t handle = 0;
+    size_t size = sizeof(esp_ota_checkpoint_t);
+    esp_err_t ret = nvs_open(OTA_CHECKPOINT_NAMESPACE, NVS_READONLY, &handle);
+
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to open NVS namespace, status: %s", esp_err_to_name(ret));
+    ret = nvs_get_blob(handle, OTA_CHECKPOINT_KEY, checkpoint, &size);
+    nvs_close(handle);
+    if (ret == ESP_ERR_NVS_NOT_FOUND || (ret == ESP_OK && size != sizeof(esp_ota_checkpoint_t))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ret;
+}
+
+esp_err_t esp_ota_checkpoint_save(const esp_ota_checkpoint_t *checkpoint)
+{
+    nvs_handle_t handle = 0;
+    esp_err_t ret = nvs_open(OTA_CHECKPOINT_NAMESPACE, NVS_READWRITE, &handle);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to open NVS namespace, status: %s", esp_err_to_name(ret));
+    ret = nvs_set_blob(handle, OTA_CHECKPOINT_KEY, checkpoint, sizeof(esp_ota_checkpoint_t));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+esp_err_t esp_ota_checkpoint_clear(void)
+{
+    nvs_handle_t handle = 0;
+    esp_err_t ret = nvs_open(OTA_CHECKPOINT_NAMESPACE, NVS_READWRITE, &handle);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to open NVS namespace, status: %s", esp_err_to_name(ret));
+    ret = nvs_erase_key(handle, OTA_CHECKPOINT_KEY);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return (ret == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : ret;
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA checkpoint Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_CHECKPOINT_NAMESPACE      "ota_client"                            /* The NVS namespace of the checkpoint */
+#define OTA_CHECKPOINT_INTERVAL       (8 * 4096)                              /* Record the checkpoint every this number of bytes written to the flash */
+
+/* The progress of the download persisted across reboot */
+typedef struct esp_ota_checkpoint_s {
+    uint16_t manufacturer_code;     /* The manufacturer code of the image being downloaded */
+    uint16_t image_type;            /* The image type of the image being downloaded */
+    uint32_t file_version;          /* The file version of the image being downloaded */
+    uint32_t image_size;            /* The size of the image being downloaded */
+    uint32_t offset;                /* The bytes written to the flash, sector aligned */
+    uint8_t digest[32];             /* The SHA-256 of the bytes written to the flash */
+} esp_ota_checkpoint_t;
+
+/**
+ * @brief Load the checkpoint from the NVS.
+ *
+ * @param[out] checkpoint The checkpoint
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no checkpoint
+ */
+esp_err_t esp_ota_checkpoint_load(esp_ota_checkpoint_t *checkpoint);
+
+/**
+ * @brief Save the checkpoint to the NVS.
+ *
+ * @param[in] checkpoint The checkpoint
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - others: refer to nvs.h
+ */
+esp_err_t esp_ota_checkpoint_save(const esp_ota_checkpoint_t *checkpoint);
+
+/**
+ * @brief Erase the checkpoint from the NVS, the next download starts from the beginning.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - others: refer to nvs.h
+ */
+esp_err_t esp_ota_checkpoint_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
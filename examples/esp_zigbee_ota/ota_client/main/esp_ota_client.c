@@ -13,17 +13,82 @@
  */
 
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
 #include "esp_check.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_ota_client.h"
+#include "esp_ota_checkpoint.h"
+#include "esp_ota_decoder.h"
+#include "esp_ota_sink.h"
 
 static const char *TAG = "ESP_OTA_CLIENT";
 
 static const esp_partition_t *s_ota_partition = NULL;
-static esp_ota_handle_t s_ota_handle = 0;
+
+/* The adaptive block size, it is halved when a block is retried and grows back on a clean link */
+typedef struct ota_block_control_s {
+    uint8_t block_size;     /* The data size of query block image */
+    bool adaptive;          /* The block size is adapted to the link */
+    uint16_t clean_blocks;  /* The blocks received since the last retry */
+    uint16_t stalls;        /* The number of blocks delayed by a retry */
+    int64_t gap;            /* The average time between two blocks without retry, in microseconds */
+    int64_t last_time;      /* The time of the last block, in microseconds */
+} ota_block_control_t;
+
+static ota_block_control_t s_block_control;
+
+static void zb_ota_upgrade_set_block_size(uint8_t block_size)
+{
+    esp_zb_zcl_ota_upgrade_client_variable_t variable_config = {
+        .timer_query = ESP_ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF,
+        .hw_version = OTA_UPGRADE_HW_VERSION,
+        .max_data_size = block_size,
+    };
+
+    esp_zb_zcl_set_attribute_val(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_DATA_ID, &variable_config, false);
+    s_block_control.block_size = block_size;
+}
+
+/* Start a download with the block size, 0 to adapt it to the link */
+static void zb_ota_block_control_reset(uint8_t block_size)
+{
+    memset(&s_block_control, 0, sizeof(ota_block_control_t));
+    s_block_control.adaptive = !block_size;
+    zb_ota_upgrade_set_block_size(block_size ? block_size : OTA_UPGRADE_MAX_DATA_SIZE);
+}
+
+static void zb_ota_block_control_update(int64_t now)
+{
+    int64_t gap = now - s_block_control.last_time;
+    uint8_t block_size = s_block_control.block_size;
+
+    if (s_block_control.last_time) {
+        if (s_block_control.gap && gap > MAX(OTA_BLOCK_STALL_MIN * 1000LL, s_block_control.gap * 4)) {
+            /* A block was lost, smaller blocks are less likely to be dropped on a congested link */
+            block_size = MAX(block_size / 2, OTA_UPGRADE_MIN_DATA_SIZE);
+            s_block_control.clean_blocks = 0;
+            s_block_control.stalls++;
+        } else {
+            s_block_control.gap = s_block_control.gap ? s_block_control.gap + (gap - s_block_control.gap) / 8 : gap;
+            if (++s_block_control.clean_blocks >= OTA_BLOCK_CLEAN_BLOCKS) {
+                block_size = MIN(block_size + OTA_BLOCK_SIZE_STEP, OTA_UPGRADE_MAX_DATA_SIZE);
+                s_block_control.clean_blocks = 0;
+            }
+        }
+        if (s_block_control.adaptive && block_size != s_block_control.block_size) {
+            ESP_LOGI(TAG, "-- OTA block size: %d -> %d, stalls: %d", s_block_control.block_size, block_size, s_block_control.stalls);
+            zb_ota_upgrade_set_block_size(block_size);
+        }
+    }
+    s_block_control.last_time = now;
+}
 
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
 {
@@ -58,11 +123,129 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     }
 }
 
+/* The offset the OTA client requests the next block from, a non-zero value resumes the download */
+static uint32_t zb_ota_upgrade_file_offset(void)
+{
+    esp_zb_zcl_attr_t *attr = esp_zb_zcl_get_attribute(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+                                                       ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE, ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID);
+    return (attr && attr->data_p) ? *(uint32_t *)attr->data_p : 0;
+}
+
+static void zb_ota_upgrade_set_file_offset(uint32_t offset)
+{
+    esp_zb_zcl_set_attribute_val(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID, &offset, false);
+}
+
+/* The stack requests the next upgrade from the file offset, point it back at the data kept by the checkpoint */
+static void zb_ota_upgrade_rewind_file_offset(void)
+{
+    esp_ota_checkpoint_t checkpoint;
+
+    zb_ota_upgrade_set_file_offset(esp_ota_checkpoint_load(&checkpoint) == ESP_OK ? checkpoint.offset : 0);
+}
+
+/* Continue the download interrupted by a reboot from the last checkpoint */
+static void zb_ota_upgrade_restore_checkpoint(void)
+{
+    esp_ota_checkpoint_t checkpoint;
+
+    if (esp_ota_checkpoint_load(&checkpoint) == ESP_OK) {
+        ESP_LOGI(TAG, "-- OTA checkpoint: version: 0x%lx, offset: %ld/%ld", checkpoint.file_version, checkpoint.offset,
+                 checkpoint.image_size);
+        esp_zb_zcl_set_attribute_val(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                     ESP_ZB_ZCL_ATTR_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_ID, &checkpoint.file_version, false);
+        zb_ota_upgrade_set_file_offset(checkpoint.offset);
+    }
+}
+
+#if CONFIG_OTA_BENCHMARK
+#define OTA_BENCHMARK_SIZE_MAX              8                                       /* The max amount of block sizes to sweep */
+
+/* The time of each phase of one download, the downloaded image is never applied */
+typedef struct ota_benchmark_s {
+    uint16_t round;                             /* The downloads done */
+    uint8_t sizes[OTA_BENCHMARK_SIZE_MAX];      /* The block sizes to sweep, 0 for the adaptive block size */
+    uint8_t size_count;                         /* The number of block sizes */
+    int64_t start;                              /* The time the download started, in microseconds */
+    int64_t first_block;                        /* The time of the first block, in microseconds */
+    int64_t last_block;                         /* The time of the last block, in microseconds */
+    int64_t check;                              /* The time spent to check the image, in microseconds */
+} ota_benchmark_t;
+
+static ota_benchmark_t s_benchmark;
+
+static void zb_ota_benchmark_init(void)
+{
+    const char *sizes = CONFIG_OTA_BENCHMARK_BLOCK_SIZES;
+    char *end = NULL;
+
+    while (*sizes && s_benchmark.size_count < OTA_BENCHMARK_SIZE_MAX) {
+        long size = strtol(sizes, &end, 0);
+        if (end == sizes) {
+            break;
+        }
+        s_benchmark.sizes[s_benchmark.size_count++] = MIN(MAX(size, 0), OTA_UPGRADE_MAX_DATA_SIZE);
+        sizes = (*end == ',') ? end + 1 : end;
+    }
+    if (!s_benchmark.size_count) {
+        s_benchmark.sizes[s_benchmark.size_count++] = OTA_UPGRADE_MAX_DATA_SIZE;
+    }
+}
+
+static uint8_t zb_ota_benchmark_block_size(void)
+{
+    return s_benchmark.sizes[(s_benchmark.round / CONFIG_OTA_BENCHMARK_ROUNDS) % s_benchmark.size_count];
+}
+
+static void zb_ota_benchmark_start(void)
+{
+    memset(&s_benchmark.start, 0, sizeof(ota_benchmark_t) - offsetof(ota_benchmark_t, start));
+    s_benchmark.start = esp_timer_get_time();
+}
+
+static void zb_ota_benchmark_block(int64_t now)
+{
+    if (!s_benchmark.first_block) {
+        s_benchmark.first_block = now;
+    }
+    s_benchmark.last_block = now;
+}
+
+/* Log the result in a machine-readable line and get ready to download the image again */
+static void zb_ota_benchmark_finish(uint32_t size, int64_t end_time, esp_err_t status)
+{
+    int64_t total = esp_timer_get_time() - s_benchmark.start;
+    int64_t transfer = s_benchmark.last_block - s_benchmark.first_block;
+    uint32_t downloads = s_benchmark.size_count * CONFIG_OTA_BENCHMARK_ROUNDS;
+    uint32_t image_status = 0;
+
+    ESP_LOGI(TAG, "OTA_BENCH {\"role\":\"client\",\"round\":%d,\"block_size\":%d,\"adaptive\":%s,\"final_block_size\":%d,"
+             "\"bytes\":%ld,\"bps\":%lld,\"stalls\":%d,\"status\":\"%s\",\"query_ms\":%lld,\"transfer_ms\":%lld,"
+             "\"check_ms\":%lld,\"end_ms\":%lld,\"total_ms\":%lld}",
+             s_benchmark.round, zb_ota_benchmark_block_size(), s_block_control.adaptive ? "true" : "false", s_block_control.block_size,
+             size, size * 1000000LL / MAX(transfer, 1), s_block_control.stalls, esp_err_to_name(status),
+             (s_benchmark.first_block - s_benchmark.start) / 1000, transfer / 1000, s_benchmark.check / 1000, end_time / 1000,
+             total / 1000);
+    /* Forget the downloaded image, the next image notify starts another download of it */
+    esp_zb_zcl_set_attribute_val(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_IMAGE_STATUS_ID, &image_status, false);
+    uint32_t downloaded_version = OTA_UPGRADE_DOWNLOADED_FILE_VERSION;
+    esp_zb_zcl_set_attribute_val(ESP_OTA_CLIENT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_ID, &downloaded_version, false);
+    zb_ota_upgrade_set_file_offset(0);
+    if (++s_benchmark.round == downloads) {
+        ESP_LOGI(TAG, "OTA_BENCH_DONE %ld downloads", downloads);
+    }
+}
+#endif
+
 static esp_err_t zb_ota_upgrade_status_handler(esp_zb_zcl_ota_upgrade_value_message_t messsage)
 {
     static uint32_t total_size = 0;
     static uint32_t offset = 0;
     static int64_t start_time = 0;
+    int64_t check_time = 0;
     esp_err_t ret = ESP_OK;
     if (messsage.info.status == ESP_ZB_ZCL_STATUS_SUCCESS) {
         switch (messsage.upgrade_status) {
@@ -71,24 +254,73 @@ static esp_err_t zb_ota_upgrade_status_handler(esp_zb_zcl_ota_upgrade_value_mess
             start_time = esp_timer_get_time();
             s_ota_partition = esp_ota_get_next_update_partition(NULL);
             assert(s_ota_partition);
-            ret = esp_ota_begin(s_ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &s_ota_handle);
+            /* Drop the image left by an aborted upgrade */
+            esp_ota_decoder_abort();
+            esp_ota_sink_abort();
+            offset = zb_ota_upgrade_file_offset();
+            ret = esp_ota_sink_begin(s_ota_partition, &messsage.ota_header, offset);
+            if (ret != ESP_OK && offset) {
+                /* The partial image does not match the checkpoint, which is dropped, start this upgrade over */
+                ESP_LOGW(TAG, "-- OTA upgrade can not resume from offset %ld, start from the beginning", offset);
+                offset = 0;
+                zb_ota_upgrade_set_file_offset(0);
+                ret = esp_ota_sink_begin(s_ota_partition, &messsage.ota_header, offset);
+            }
             ESP_RETURN_ON_ERROR(ret, TAG, "Failed to begin OTA partition, status: %s", esp_err_to_name(ret));
+            esp_ota_decoder_begin(offset);
+#if CONFIG_OTA_BENCHMARK
+            zb_ota_benchmark_start();
+            zb_ota_block_control_reset(zb_ota_benchmark_block_size());
+#else
+            zb_ota_block_control_reset(0);
+#endif
             break;
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
             total_size = messsage.ota_header.image_size;
             offset += messsage.payload_size;
+            zb_ota_block_control_update(esp_timer_get_time());
+#if CONFIG_OTA_BENCHMARK
+            zb_ota_benchmark_block(esp_timer_get_time());
+#endif
             ESP_LOGI(TAG, "-- OTA Client receives data: progress [%ld/%ld]", offset, total_size);
             if (messsage.payload_size && messsage.payload) {
-                ret = esp_ota_write(s_ota_handle, (const void *)messsage.payload, messsage.payload_size);
+                ret = esp_ota_decoder_write((const void *)messsage.payload, messsage.payload_size);
                 ESP_RETURN_ON_ERROR(ret, TAG, "Failed to write OTA data to partition, status: %s", esp_err_to_name(ret));
             }
             break;
+        case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+            ESP_LOGW(TAG, "-- OTA upgrade abort");
+            esp_ota_decoder_abort();
+            esp_ota_sink_abort();
+            /* The blocks after the checkpoint are lost, the next upgrade resumes from the checkpoint */
+            zb_ota_upgrade_rewind_file_offset();
+            break;
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
             ESP_LOGI(TAG, "-- OTA upgrade apply");
             break;
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
-            ret = offset == total_size ? ESP_OK : ESP_FAIL;
-            ESP_LOGI(TAG, "-- OTA upgrade check status: %s", esp_err_to_name(ret));
+            check_time = esp_timer_get_time();
+            ret = offset == total_size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+            if (ret == ESP_OK) {
+                ret = esp_ota_decoder_end();
+            }
+            if (ret == ESP_OK) {
+                ret = esp_ota_sink_verify();
+                /* The image without a SHA-256 is only validated by esp_ota_end() */
+                ret = (ret == ESP_ERR_NOT_SUPPORTED) ? ESP_OK : ret;
+            }
+            if (ret != ESP_OK) {
+                /* The image is corrupted, never resume it */
+                esp_ota_decoder_abort();
+                esp_ota_sink_abort();
+                esp_ota_checkpoint_clear();
+                zb_ota_upgrade_set_file_offset(0);
+            }
+#if CONFIG_OTA_BENCHMARK
+            s_benchmark.check = esp_timer_get_time() - check_time;
+#endif
+            ESP_LOGI(TAG, "-- OTA upgrade check status: %s, cost time: %lld ms", esp_err_to_name(ret),
+                     (esp_timer_get_time() - check_time) / 1000);
             break;
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
             ESP_LOGI(TAG, "-- OTA Finish");
@@ -96,7 +328,16 @@ static esp_err_t zb_ota_upgrade_status_handler(esp_zb_zcl_ota_upgrade_value_mess
                      "-- OTA Information: version: 0x%lx, manufactor code: 0x%x, image type: 0x%x, total size: %ld bytes, cost time: %lld ms,",
                      messsage.ota_header.file_version, messsage.ota_header.manufacturer_code, messsage.ota_header.image_type,
                      messsage.ota_header.image_size, (esp_timer_get_time() - start_time) / 1000);
-            ret = esp_ota_end(s_ota_handle);
+            ESP_LOGI(TAG, "-- OTA throughput: %lld B/s, block size: %d, stalls: %d",
+                     offset * 1000000LL / MAX(esp_timer_get_time() - start_time, 1), s_block_control.block_size, s_block_control.stalls);
+#if CONFIG_OTA_BENCHMARK
+            check_time = esp_timer_get_time();
+            ret = esp_ota_sink_end();
+            zb_ota_benchmark_finish(offset, esp_timer_get_time() - check_time, ret);
+            /* Keep running the firmware under test */
+            break;
+#endif
+            ret = esp_ota_sink_end();
             ESP_RETURN_ON_ERROR(ret, TAG, "Failed to end OTA partition, status: %s", esp_err_to_name(ret));
             ret = esp_ota_set_boot_partition(s_ota_partition);
             ESP_RETURN_ON_ERROR(ret, TAG, "Failed to set OTA boot partition, status: %s", esp_err_to_name(ret));
@@ -162,6 +403,7 @@ static void esp_zb_task(void *pvParameters)
     };
     esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_cluster_list, endpoint_config);
     esp_zb_device_register(esp_zb_ep_list);
+    zb_ota_upgrade_restore_checkpoint();
     esp_zb_core_action_handler_register(zb_action_handler);
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     ESP_ERROR_CHECK(esp_zb_start(true));
@@ -176,6 +418,9 @@ void app_main(void)
         .host_config = ESP_ZB_DEFAULT_HOST_CONFIG(),
     };
     ESP_ERROR_CHECK(nvs_flash_init());
+#if CONFIG_OTA_BENCHMARK
+    zb_ota_benchmark_init();
+#endif
     ESP_ERROR_CHECK(esp_zb_platform_config(&config));
     xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
 }
@@ -25,6 +25,10 @@
 #define OTA_UPGRADE_DOWNLOADED_FILE_VERSION 0x01010101                              /* The attribute indicates the file version of the downloaded firmware image on the device */
 #define OTA_UPGRADE_HW_VERSION              0x0101                                  /* The parameter indicates the version of hardware */
 #define OTA_UPGRADE_MAX_DATA_SIZE           64                                      /* The parameter indicates the maximum data size of query block image */
+#define OTA_UPGRADE_MIN_DATA_SIZE           16                                      /* The smallest data size of query block image the client falls back to */
+#define OTA_BLOCK_SIZE_STEP                 8                                       /* The data size of query block image grows by this step on a clean link */
+#define OTA_BLOCK_STALL_MIN                 500                                     /* A block later than this and 4 times the average gap is counted as a retry, in millisecond */
+#define OTA_BLOCK_CLEAN_BLOCKS              32                                      /* The blocks without retry required to grow the data size */
 #define ESP_ZB_PRIMARY_CHANNEL_MASK         ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK    /* Zigbee primary channel mask use in the example */
 
 #define ESP_ZB_ZED_CONFIG()                                         \
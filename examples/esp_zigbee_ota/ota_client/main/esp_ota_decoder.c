@@ -0,0 +1,292 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA decoder Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_ota_decoder.h"
+#include "esp_ota_sink.h"
+
+#define OTA_DECODER_TOKEN_MAX         11                                      /* The longest token, the opcode and two 5 bytes varints */
+#define OTA_DECODER_TOKEN_LONG        63                                      /* The opcode length followed by a varint */
+
+static const char *TAG = "ESP_OTA_DECODER";
+
+typedef enum {
+    OTA_DECODER_STATE_HEADER,       /* Collecting the header, or the first bytes of an unpacked image */
+    OTA_DECODER_STATE_RAW,          /* Passing the unpacked image through */
+    OTA_DECODER_STATE_TOKEN,        /* Collecting the next token */
+    OTA_DECODER_STATE_LITERAL,      /* Copying the literal bytes of a token */
+} ota_decoder_state_t;
+
+typedef struct ota_decoder_s {
+    ota_decoder_state_t state;                          /* The decoding state */
+    uint8_t header[OTA_DECODER_HEADER_SIZE];            /* The header received so far */
+    uint8_t token[OTA_DECODER_TOKEN_MAX];               /* The token received so far */
+    uint8_t header_len;                                 /* The bytes in the header */
+    uint8_t token_len;                                  /* The bytes in the token */
+    uint32_t literal;                                   /* The literal bytes left in the current token */
+    uint8_t flags;                                      /* The flags of the packed image */
+    uint32_t image_size;                                /* The size of the unpacked image */
+    const esp_partition_t *base;                        /* The running partition holding the base image */
+    uint32_t base_size;                                 /* The size of the base image */
+    uint8_t *window;                                    /* The history window, the unpacked data is flushed from here */
+    uint32_t mask;                                      /* The size of the window minus one */
+    uint32_t pos;                                       /* The bytes unpacked */
+    uint32_t flushed;                                   /* The bytes written to the OTA sink */
+    uint32_t received;                                  /* The packed bytes received */
+} ota_decoder_t;
+
+static ota_decoder_t s_decoder;
+
+static uint32_t ota_decoder_get_u32(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/* Parse a LEB128 varint, return the bytes used, 0 if incomplete or -1 if overlong */
+static int ota_decoder_get_varint(const uint8_t *buf, uint8_t len, uint32_t *value)
+{
+    *value = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        if (i == 5) {
+            return -1;
+        }
+        *value |= (uint32_t)(buf[i] & 0x7f) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return len >= 5 ? -1 : 0;
+}
+
+/* Write the unflushed part of the window to the OTA sink, it never wraps as the window is flushed on every wrap */
+static esp_err_t ota_decoder_flush(void)
+{
+    uint32_t size = s_decoder.pos - s_decoder.flushed;
+    esp_err_t ret = ESP_OK;
+
+    if (size) {
+        ret = esp_ota_sink_write(s_decoder.window + (s_decoder.flushed & s_decoder.mask), size);
+        s_decoder.flushed = s_decoder.pos;
+    }
+    return ret;
+}
+
+static esp_err_t ota_decoder_emit(uint8_t byte)
+{
+    s_decoder.window[s_decoder.pos & s_decoder.mask] = byte;
+    s_decoder.pos++;
+    return (s_decoder.pos & s_decoder.mask) ? ESP_OK : ota_decoder_flush();
+}
+
+static esp_err_t ota_decoder_copy_window(uint32_t length, uint32_t distance)
+{
+    ESP_RETURN_ON_FALSE(distance <= s_decoder.mask + 1 && distance <= s_decoder.pos, ESP_ERR_INVALID_ARG, TAG,
+                        "Back reference %ld out of window", distance);
+    for (uint32_t i = 0; i < length; i++) {
+        ESP_RETURN_ON_ERROR(ota_decoder_emit(s_decoder.window[(s_decoder.pos - distance) & s_decoder.mask]), TAG,
+                            "Failed to write unpacked data");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_decoder_copy_base(uint32_t length, uint32_t offset)
+{
+    ESP_RETURN_ON_FALSE(s_decoder.base && offset <= s_decoder.base_size && length <= s_decoder.base_size - offset,
+                        ESP_ERR_INVALID_ARG, TAG, "Base reference %ld out of image", offset);
+    while (length) {
+        uint32_t index = s_decoder.pos & s_decoder.mask;
+        uint32_t chunk = MIN(length, s_decoder.mask + 1 - index);
+        ESP_RETURN_ON_ERROR(esp_partition_read(s_decoder.base, offset, s_decoder.window + index, chunk), TAG,
+                            "Failed to read base image");
+        s_decoder.pos += chunk;
+        offset += chunk;
+        length -= chunk;
+        if (!(s_decoder.pos & s_decoder.mask)) {
+            ESP_RETURN_ON_ERROR(ota_decoder_flush(), TAG, "Failed to write unpacked data");
+        }
+    }
+    return ESP_OK;
+}
+
+/* Parse the collected token, return ESP_ERR_NOT_FINISHED if more bytes are needed */
+static esp_err_t ota_decoder_token(void)
+{
+    uint8_t opcode = s_decoder.token[0];
+    uint32_t length = opcode & 0x3f;
+    uint32_t extra = 0;
+    uint32_t arg = 0;
+    uint8_t used = 1;
+    int ret = 0;
+
+    if (!(opcode & 0x80)) {
+        s_decoder.literal = (opcode & 0x7f) + 1;
+        s_decoder.state = OTA_DECODER_STATE_LITERAL;
+        return ESP_OK;
+    }
+    if (length == OTA_DECODER_TOKEN_LONG) {
+        ret = ota_decoder_get_varint(s_decoder.token + used, s_decoder.token_len - used, &extra);
+        ESP_RETURN_ON_FALSE(ret >= 0, ESP_ERR_INVALID_ARG, TAG, "Invalid token length");
+        if (!ret) {
+            return ESP_ERR_NOT_FINISHED;
+        }
+        used += ret;
+    }
+    ret = ota_decoder_get_varint(s_decoder.token + used, s_decoder.token_len - used, &arg);
+    ESP_RETURN_ON_FALSE(ret >= 0, ESP_ERR_INVALID_ARG, TAG, "Invalid token argument");
+    if (!ret) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    length += extra + ((opcode & 0x40) ? 4 : 3);
+    ESP_RETURN_ON_FALSE(length <= s_decoder.image_size - s_decoder.pos, ESP_ERR_INVALID_ARG, TAG, "Token exceeds the image");
+    s_decoder.state = OTA_DECODER_STATE_TOKEN;
+    return (opcode & 0x40) ? ota_decoder_copy_base(length, arg) : ota_decoder_copy_window(length, arg + 1);
+}
+
+/* Check the header, allocate the window and make sure the running firmware is the base of the delta */
+static esp_err_t ota_decoder_start(void)
+{
+    uint8_t version = s_decoder.header[4];
+    uint8_t window_log = s_decoder.header[6];
+    uint32_t crc = 0;
+
+    s_decoder.flags = s_decoder.header[5];
+    s_decoder.image_size = ota_decoder_get_u32(s_decoder.header + 8);
+    s_decoder.base_size = ota_decoder_get_u32(s_decoder.header + 12);
+    ESP_RETURN_ON_FALSE(version == OTA_DECODER_VERSION && window_log <= OTA_DECODER_WINDOW_LOG, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Unsupported packed image, version: %d, window log: %d", version, window_log);
+    s_decoder.window = malloc(1 << OTA_DECODER_WINDOW_LOG);
+    ESP_RETURN_ON_FALSE(s_decoder.window, ESP_ERR_NO_MEM, TAG, "Failed to allocate decoder window");
+    s_decoder.mask = (1 << OTA_DECODER_WINDOW_LOG) - 1;
+    if (s_decoder.flags & OTA_DECODER_FLAG_DELTA) {
+        s_decoder.base = esp_ota_get_running_partition();
+        ESP_RETURN_ON_FALSE(s_decoder.base && s_decoder.base_size <= s_decoder.base->size, ESP_ERR_INVALID_CRC, TAG,
+                            "Running firmware is smaller than the delta base");
+        for (uint32_t offset = 0; offset < s_decoder.base_size; offset += s_decoder.mask + 1) {
+            uint32_t chunk = MIN(s_decoder.base_size - offset, s_decoder.mask + 1);
+            ESP_RETURN_ON_ERROR(esp_partition_read(s_decoder.base, offset, s_decoder.window, chunk), TAG, "Failed to read base image");
+            crc = esp_crc32_le(crc, s_decoder.window, chunk);
+        }
+        ESP_RETURN_ON_FALSE(crc == ota_decoder_get_u32(s_decoder.header + 16), ESP_ERR_INVALID_CRC, TAG,
+                            "Running firmware is not the delta base");
+    }
+    /* The unpacked data never maps back to the received offset, the download restarts after a reboot */
+    esp_ota_sink_disable_checkpoint();
+    ESP_LOGI(TAG, "-- OTA packed image, flags: 0x%x, size: %ld, base size: %ld", s_decoder.flags, s_decoder.image_size,
+             s_decoder.base_size);
+    s_decoder.state = OTA_DECODER_STATE_TOKEN;
+    return ESP_OK;
+}
+
+static esp_err_t ota_decoder_process(const uint8_t *input, uint32_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (size && ret == ESP_OK) {
+        switch (s_decoder.state) {
+        case OTA_DECODER_STATE_HEADER:
+            s_decoder.header[s_decoder.header_len++] = *input++;
+            size--;
+            if (s_decoder.header_len == sizeof(uint32_t) && ota_decoder_get_u32(s_decoder.header) != OTA_DECODER_MAGIC) {
+                s_decoder.state = OTA_DECODER_STATE_RAW;
+                ret = esp_ota_sink_write(s_decoder.header, s_decoder.header_len);
+            } else if (s_decoder.header_len == OTA_DECODER_HEADER_SIZE) {
+                ret = ota_decoder_start();
+            }
+            break;
+        case OTA_DECODER_STATE_RAW:
+            ret = esp_ota_sink_write(input, size);
+            size = 0;
+            break;
+        case OTA_DECODER_STATE_TOKEN:
+            if (s_decoder.token_len == 0) {
+                ESP_RETURN_ON_FALSE(s_decoder.pos < s_decoder.image_size, ESP_ERR_INVALID_ARG, TAG, "Data after the end of the image");
+            }
+            s_decoder.token[s_decoder.token_len++] = *input++;
+            size--;
+            ret = ota_decoder_token();
+            if (ret == ESP_ERR_NOT_FINISHED) {
+                ret = ESP_OK;
+            } else {
+                s_decoder.token_len = 0;
+            }
+            break;
+        case OTA_DECODER_STATE_LITERAL: {
+            uint32_t chunk = MIN(size, s_decoder.literal);
+            ESP_RETURN_ON_FALSE(chunk <= s_decoder.image_size - s_decoder.pos, ESP_ERR_INVALID_ARG, TAG, "Literal exceeds the image");
+            for (uint32_t i = 0; i < chunk && ret == ESP_OK; i++) {
+                ret = ota_decoder_emit(input[i]);
+            }
+            input += chunk;
+            size -= chunk;
+            s_decoder.literal -= chunk;
+            if (!s_decoder.literal) {
+                s_decoder.state = OTA_DECODER_STATE_TOKEN;
+            }
+            break;
+        }
+        default:
+            ret = ESP_ERR_INVALID_STATE;
+            break;
+        }
+    }
+    return ret;
+}
+
+esp_err_t esp_ota_decoder_begin(uint32_t offset)
+{
+    esp_ota_decoder_abort();
+    /* Only the unpacked image is checkpointed, so a resumed download is passed through */
+    s_decoder.state = offset ? OTA_DECODER_STATE_RAW : OTA_DECODER_STATE_HEADER;
+    s_decoder.received = offset;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_decoder_write(const void *data, uint32_t size)
+{
+    esp_err_t ret = ota_decoder_process((const uint8_t *)data, size);
+
+    s_decoder.received += size;
+    if (ret == ESP_OK && s_decoder.window) {
+        ret = ota_decoder_flush();
+    }
+    return ret;
+}
+
+esp_err_t esp_ota_decoder_end(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (s_decoder.state == OTA_DECODER_STATE_HEADER) {
+        /* An unpacked image smaller than the magic */
+        ret = esp_ota_sink_write(s_decoder.header, s_decoder.header_len);
+    } else if (s_decoder.state != OTA_DECODER_STATE_RAW) {
+        ESP_RETURN_ON_FALSE(s_decoder.state == OTA_DECODER_STATE_TOKEN && !s_decoder.token_len && s_decoder.pos == s_decoder.image_size,
+                            ESP_ERR_INVALID_SIZE, TAG, "Packed image is truncated at %ld/%ld", s_decoder.pos, s_decoder.image_size);
+        ESP_LOGI(TAG, "-- OTA unpacked %ld bytes from %ld bytes received", s_decoder.pos, s_decoder.received);
+    }
+    esp_ota_decoder_abort();
+    return ret;
+}
+
+esp_err_t esp_ota_decoder_abort(void)
+{
+    free(s_decoder.window);
+    memset(&s_decoder, 0, sizeof(ota_decoder_t));
+    return ESP_OK;
+}
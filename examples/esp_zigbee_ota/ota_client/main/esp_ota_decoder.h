@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA decoder Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Definition of the packed OTA image, generated by tools/ota_pack/ota_pack.py
+ *
+ * The image starts with a header, all the fields are little-endian:
+ *  - uint32 magic, uint8 version, uint8 flags, uint8 window log, uint8 reserved
+ *  - uint32 size of the unpacked image
+ *  - uint32 size and CRC32 of the base image, the running firmware the delta is made against
+ *
+ * The header is followed by a sequence of tokens, the lengths and offsets are LEB128 varints:
+ *  - 0LLLLLLL, followed by L + 1 literal bytes
+ *  - 10LLLLLL [length] distance, copy L + 3 (+ length if L is 63) bytes from the distance + 1 bytes back
+ *  - 11LLLLLL [length] offset, copy L + 4 (+ length if L is 63) bytes from the offset of the base image
+ *
+ * An image which does not start with the magic is written to the flash as it is.
+ */
+#define OTA_DECODER_MAGIC             0x50544f5a                              /* "ZOTP" */
+#define OTA_DECODER_VERSION           1                                       /* The version of the packed image format */
+#define OTA_DECODER_FLAG_COMPRESSED   0x01                                    /* The image is compressed by back references */
+#define OTA_DECODER_FLAG_DELTA        0x02                                    /* The image is a delta against the running firmware */
+#define OTA_DECODER_HEADER_SIZE       20                                      /* The size of the packed image header */
+#define OTA_DECODER_WINDOW_LOG        13                                      /* The largest history window the decoder supports, 8 KB */
+
+/**
+ * @brief Start to decode an image, the unpacked data is written to the OTA sink.
+ *
+ * @param[in] offset The offset the download is resumed from, only unpacked images are resumed
+ *
+ * @return
+ *      - ESP_OK on success
+ */
+esp_err_t esp_ota_decoder_begin(uint32_t offset);
+
+/**
+ * @brief Decode the next part of the image, the data could be split at any byte.
+ *
+ * @param[in] data The received data of the image
+ * @param[in] size The size of the data
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if the packed image requires an unsupported feature or window
+ *      - ESP_ERR_INVALID_CRC if the running firmware is not the base of the delta
+ *      - ESP_ERR_INVALID_ARG if the packed image is corrupted
+ *      - others: the error of the OTA sink
+ */
+esp_err_t esp_ota_decoder_write(const void *data, uint32_t size);
+
+/**
+ * @brief Finish decoding the image.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_SIZE if the packed image is truncated
+ */
+esp_err_t esp_ota_decoder_end(void);
+
+/**
+ * @brief Drop the image being decoded.
+ *
+ * @return
+ *      - ESP_OK on success
+ */
+esp_err_t esp_ota_decoder_abort(void);
+
+#ifdef __cplusplus
+}
+#endif
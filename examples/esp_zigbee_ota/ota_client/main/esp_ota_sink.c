@@ -0,0 +1,401 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA sink Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_app_format.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "mbedtls/sha256.h"
+#include "esp_ota_checkpoint.h"
+#include "esp_ota_sink.h"
+
+#define OTA_SINK_STOP                 OTA_SINK_BUFFER_NUM                     /* The buffer index asking the flash writer to stop */
+#define OTA_SINK_HASH_SIZE            32                                      /* The size of the SHA-256 appended to the image */
+
+static const char *TAG = "ESP_OTA_SINK";
+
+/* The time spent in each phase of the image writing, in microseconds */
+typedef struct ota_sink_timing_s {
+    int64_t start;          /* The time the sink began */
+    int64_t copy;           /* Copying the blocks into the staging buffers, on the Zigbee task */
+    int64_t stall;          /* Waiting for a free staging buffer, on the Zigbee task */
+    int64_t write;          /* Writing the staging buffers to the flash, on the flash writer task */
+    int64_t end;            /* Validating the image in esp_ota_end() */
+    uint32_t stalls;        /* The number of blocks delayed by the flash writer */
+} ota_sink_timing_t;
+
+typedef struct ota_sink_s {
+    esp_ota_handle_t handle;                            /* The OTA handle */
+    const esp_partition_t *partition;                   /* The OTA partition being written */
+    esp_ota_checkpoint_t checkpoint;                    /* The progress persisted across reboot */
+    mbedtls_sha256_context sha;                         /* The SHA-256 of the bytes written to the flash */
+    uint8_t digest[OTA_SINK_HASH_SIZE];                 /* The SHA-256 of the bytes before the appended SHA-256 */
+    uint8_t hash[OTA_SINK_HASH_SIZE];                   /* The SHA-256 appended to the image */
+    uint8_t hash_len;                                   /* The bytes of the appended SHA-256 written */
+    uint8_t segment[sizeof(esp_image_segment_header_t)]; /* The segment header being parsed */
+    uint8_t segment_len;                                /* The bytes of the segment header being parsed */
+    uint8_t segments;                                   /* The segment headers left to parse */
+    uint32_t next;                                      /* The offset of the next segment header */
+    uint32_t hash_offset;                               /* The offset of the appended SHA-256, 0 until the segment table is parsed */
+    bool hash_appended;                                 /* The image header announces an appended SHA-256 */
+    bool stopped;                                       /* The flash writer is stopped */
+    TaskHandle_t task;                                  /* The flash writer task */
+    QueueHandle_t free_queue;                           /* The indexes of the staging buffers free to fill */
+    QueueHandle_t full_queue;                           /* The indexes of the staging buffers to write to the flash */
+    SemaphoreHandle_t done;                             /* Given by the flash writer once it stops */
+    uint8_t *buffers[OTA_SINK_BUFFER_NUM];              /* The staging buffers */
+    uint32_t sizes[OTA_SINK_BUFFER_NUM];                /* The bytes filled in each staging buffer */
+    int current;                                        /* The staging buffer being filled, -1 if none */
+    volatile esp_err_t error;                           /* The first error of the flash writer */
+    uint32_t received;                                  /* The bytes copied into the sink */
+    uint32_t written;                                   /* The bytes written to the flash */
+    uint32_t checkpointed;                              /* The bytes recorded by the last checkpoint */
+    volatile bool checkpointing;                        /* The progress is checkpointed */
+    ota_sink_timing_t timing;                           /* The time of each phase */
+} ota_sink_t;
+
+static ota_sink_t *s_sink = NULL;
+
+/* The SHA-256 of all the bytes hashed */
+static void ota_sink_digest(ota_sink_t *sink, uint8_t *digest)
+{
+    mbedtls_sha256_context sha;
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_clone(&sha, &sink->sha);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+}
+
+/* Follow the image header and the segment table to the appended SHA-256, a segment header may straddle two buffers */
+static void ota_sink_parse(ota_sink_t *sink, const uint8_t *data, uint32_t size, uint32_t offset)
+{
+    uint32_t end = offset + size;
+
+    if (!offset) {
+        const esp_image_header_t *header = (const esp_image_header_t *)data;
+        sink->hash_appended = size >= sizeof(esp_image_header_t) && header->magic == ESP_IMAGE_HEADER_MAGIC && header->hash_appended == 1;
+        sink->segments = sink->hash_appended ? header->segment_count : 0;
+        sink->next = sizeof(esp_image_header_t);
+    }
+    while (sink->segments && sink->next < end) {
+        uint32_t chunk = MIN(sizeof(esp_image_segment_header_t) - sink->segment_len, end - sink->next);
+        esp_image_segment_header_t segment;
+
+        memcpy(sink->segment + sink->segment_len, data + (sink->next - offset), chunk);
+        sink->segment_len += chunk;
+        sink->next += chunk;
+        if (sink->segment_len < sizeof(esp_image_segment_header_t)) {
+            break;
+        }
+        memcpy(&segment, sink->segment, sizeof(segment));
+        sink->segment_len = 0;
+        if (segment.data_len > sink->partition->size - sink->next) {
+            /* The segment table is broken, the image is left to esp_ota_end() to reject */
+            sink->segments = 0;
+            break;
+        }
+        sink->next += segment.data_len;
+        if (!--sink->segments) {
+            /* The checksum byte pads the segments to 16 bytes, the SHA-256 of all the bytes before follows */
+            sink->hash_offset = (sink->next + 1 + 15) & ~15;
+        }
+    }
+}
+
+/* Hash the data written at the offset, the digest is taken where the appended SHA-256 starts, which is kept aside */
+static void ota_sink_hash(ota_sink_t *sink, const uint8_t *data, uint32_t size, uint32_t offset)
+{
+    uint32_t end = offset + size;
+
+    ota_sink_parse(sink, data, size, offset);
+    if (sink->hash_offset && sink->hash_offset >= offset && sink->hash_offset < end) {
+        uint32_t before = sink->hash_offset - offset;
+        mbedtls_sha256_update(&sink->sha, data, before);
+        ota_sink_digest(sink, sink->digest);
+        mbedtls_sha256_update(&sink->sha, data + before, size - before);
+    } else {
+        mbedtls_sha256_update(&sink->sha, data, size);
+    }
+    if (sink->hash_offset && sink->hash_len < OTA_SINK_HASH_SIZE && end > sink->hash_offset + sink->hash_len) {
+        uint32_t from = sink->hash_offset + sink->hash_len;
+        uint32_t chunk = MIN(OTA_SINK_HASH_SIZE - sink->hash_len, end - from);
+        memcpy(sink->hash + sink->hash_len, data + (from - offset), chunk);
+        sink->hash_len += chunk;
+    }
+}
+
+/* Record the flushed prefix, a reboot after this point resumes the download from here */
+static void ota_sink_checkpoint(ota_sink_t *sink)
+{
+    ota_sink_digest(sink, sink->checkpoint.digest);
+    sink->checkpoint.offset = sink->written;
+    if (esp_ota_checkpoint_save(&sink->checkpoint) == ESP_OK) {
+        sink->checkpointed = sink->written;
+    }
+}
+
+/* Each staging buffer covers exactly one sector, so the sector is erased right before it is written */
+static esp_err_t ota_sink_flush(ota_sink_t *sink, uint8_t index)
+{
+    esp_err_t ret = esp_partition_erase_range(sink->partition, sink->written, OTA_SINK_BUFFER_SIZE);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to erase OTA partition, status: %s", esp_err_to_name(ret));
+    ret = esp_ota_write_with_offset(sink->handle, sink->buffers[index], sink->sizes[index], sink->written);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to write OTA data to partition, status: %s", esp_err_to_name(ret));
+    ota_sink_hash(sink, sink->buffers[index], sink->sizes[index], sink->written);
+    sink->written += sink->sizes[index];
+    if (sink->checkpointing && sink->sizes[index] == OTA_SINK_BUFFER_SIZE && sink->written < sink->checkpoint.image_size &&
+            sink->written - sink->checkpointed >= OTA_CHECKPOINT_INTERVAL) {
+        ota_sink_checkpoint(sink);
+    }
+    return ESP_OK;
+}
+
+static void ota_sink_writer_task(void *pvParameters)
+{
+    ota_sink_t *sink = (ota_sink_t *)pvParameters;
+    uint8_t index = 0;
+
+    while (xQueueReceive(sink->full_queue, &index, portMAX_DELAY) == pdTRUE && index != OTA_SINK_STOP) {
+        if (sink->error == ESP_OK) {
+            int64_t start = esp_timer_get_time();
+            sink->error = ota_sink_flush(sink, index);
+            sink->timing.write += esp_timer_get_time() - start;
+        }
+        xQueueSend(sink->free_queue, &index, 0);
+    }
+    xSemaphoreGive(sink->done);
+    vTaskDelete(NULL);
+}
+
+static void ota_sink_free(void)
+{
+    for (int i = 0; i < OTA_SINK_BUFFER_NUM; i++) {
+        free(s_sink->buffers[i]);
+    }
+    if (s_sink->free_queue) {
+        vQueueDelete(s_sink->free_queue);
+    }
+    if (s_sink->full_queue) {
+        vQueueDelete(s_sink->full_queue);
+    }
+    if (s_sink->done) {
+        vSemaphoreDelete(s_sink->done);
+    }
+    mbedtls_sha256_free(&s_sink->sha);
+    free(s_sink);
+    s_sink = NULL;
+}
+
+/* Commit the staging buffer being filled and wait for the flash writer to stop */
+static void ota_sink_stop(void)
+{
+    uint8_t index = OTA_SINK_STOP;
+
+    if (s_sink->stopped) {
+        return;
+    }
+
+    if (s_sink->current >= 0 && s_sink->sizes[s_sink->current]) {
+        index = s_sink->current;
+        xQueueSend(s_sink->full_queue, &index, portMAX_DELAY);
+        index = OTA_SINK_STOP;
+    }
+    s_sink->current = -1;
+    xQueueSend(s_sink->full_queue, &index, portMAX_DELAY);
+    xSemaphoreTake(s_sink->done, portMAX_DELAY);
+    s_sink->stopped = true;
+}
+
+/* Hash the partially downloaded image and compare it with the checkpoint, the first staging buffer is used to read the flash */
+static esp_err_t ota_sink_resume(uint32_t offset)
+{
+    esp_ota_checkpoint_t *checkpoint = &s_sink->checkpoint;
+    esp_ota_checkpoint_t saved = { 0 };
+    uint8_t digest[sizeof(saved.digest)];
+    esp_err_t ret = esp_ota_checkpoint_load(&saved);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "No OTA checkpoint to resume from offset %ld", offset);
+    ESP_RETURN_ON_FALSE(saved.manufacturer_code == checkpoint->manufacturer_code && saved.image_type == checkpoint->image_type &&
+                        saved.file_version == checkpoint->file_version && saved.image_size == checkpoint->image_size &&
+                        saved.offset == offset && offset <= s_sink->partition->size,
+                        ESP_ERR_INVALID_STATE, TAG, "OTA checkpoint does not match the image being downloaded");
+    for (uint32_t read = 0; read < offset; read += OTA_SINK_BUFFER_SIZE) {
+        uint32_t chunk = MIN(offset - read, OTA_SINK_BUFFER_SIZE);
+        ret = esp_partition_read(s_sink->partition, read, s_sink->buffers[0], chunk);
+        ESP_RETURN_ON_ERROR(ret, TAG, "Failed to read OTA partition, status: %s", esp_err_to_name(ret));
+        ota_sink_hash(s_sink, s_sink->buffers[0], chunk, read);
+    }
+    ota_sink_digest(s_sink, digest);
+    ESP_RETURN_ON_FALSE(memcmp(digest, saved.digest, sizeof(digest)) == 0, ESP_ERR_INVALID_CRC, TAG,
+                        "OTA partition does not match the checkpoint");
+    s_sink->written = offset;
+    s_sink->received = offset;
+    s_sink->checkpointed = offset;
+    ESP_LOGI(TAG, "-- OTA sink resumes from offset %ld", offset);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_sink_begin(const esp_partition_t *partition, const esp_zb_ota_file_header_t *header, uint32_t offset)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(partition && header, ESP_ERR_INVALID_ARG, TAG, "Invalid OTA partition");
+    ESP_RETURN_ON_FALSE(!s_sink, ESP_ERR_INVALID_STATE, TAG, "OTA sink is busy");
+    s_sink = calloc(1, sizeof(ota_sink_t));
+    ESP_RETURN_ON_FALSE(s_sink, ESP_ERR_NO_MEM, TAG, "Failed to allocate OTA sink");
+    s_sink->partition = partition;
+    s_sink->checkpoint.manufacturer_code = header->manufacturer_code;
+    s_sink->checkpoint.image_type = header->image_type;
+    s_sink->checkpoint.file_version = header->file_version;
+    s_sink->checkpoint.image_size = header->image_size;
+    mbedtls_sha256_init(&s_sink->sha);
+    mbedtls_sha256_starts(&s_sink->sha, 0);
+    s_sink->checkpointing = true;
+    s_sink->current = -1;
+    s_sink->timing.start = esp_timer_get_time();
+    s_sink->free_queue = xQueueCreate(OTA_SINK_BUFFER_NUM, sizeof(uint8_t));
+    /* One more item for the stop request */
+    s_sink->full_queue = xQueueCreate(OTA_SINK_BUFFER_NUM + 1, sizeof(uint8_t));
+    s_sink->done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(s_sink->free_queue && s_sink->full_queue && s_sink->done, ESP_ERR_NO_MEM, err, TAG, "Failed to create OTA sink queues");
+    for (uint8_t i = 0; i < OTA_SINK_BUFFER_NUM; i++) {
+        s_sink->buffers[i] = malloc(OTA_SINK_BUFFER_SIZE);
+        ESP_GOTO_ON_FALSE(s_sink->buffers[i], ESP_ERR_NO_MEM, err, TAG, "Failed to allocate OTA staging buffer");
+        xQueueSend(s_sink->free_queue, &i, 0);
+    }
+    if (offset) {
+        ret = ota_sink_resume(offset);
+        if (ret != ESP_OK) {
+            /* The partial image is useless, the download has to start over */
+            esp_ota_checkpoint_clear();
+            goto err;
+        }
+    } else {
+        esp_ota_checkpoint_clear();
+    }
+    /* No sector is erased here with sequential writes, so the partial image survives */
+    ret = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &s_sink->handle);
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "Failed to begin OTA partition, status: %s", esp_err_to_name(ret));
+    ESP_GOTO_ON_FALSE(xTaskCreate(ota_sink_writer_task, "OTA_sink", OTA_SINK_TASK_STACK, s_sink, OTA_SINK_TASK_PRIORITY, &s_sink->task) == pdTRUE,
+                      ESP_ERR_NO_MEM, abort, TAG, "Failed to create OTA sink task");
+    return ESP_OK;
+abort:
+    esp_ota_abort(s_sink->handle);
+err:
+    ota_sink_free();
+    return ret;
+}
+
+esp_err_t esp_ota_sink_write(const void *data, uint32_t size)
+{
+    const uint8_t *input = (const uint8_t *)data;
+
+    ESP_RETURN_ON_FALSE(s_sink, ESP_ERR_INVALID_STATE, TAG, "OTA sink is not started");
+    while (size && s_sink->error == ESP_OK) {
+        if (s_sink->current < 0) {
+            uint8_t free_index = 0;
+            int64_t wait_start = esp_timer_get_time();
+            if (!uxQueueMessagesWaiting(s_sink->free_queue)) {
+                /* The flash writer falls behind, hold the Zigbee task so that the next block request is delayed */
+                s_sink->timing.stalls++;
+            }
+            ESP_RETURN_ON_FALSE(xQueueReceive(s_sink->free_queue, &free_index, pdMS_TO_TICKS(OTA_SINK_STALL_TIMEOUT)) == pdTRUE,
+                                ESP_ERR_TIMEOUT, TAG, "OTA flash writer is stuck");
+            s_sink->timing.stall += esp_timer_get_time() - wait_start;
+            s_sink->current = free_index;
+            s_sink->sizes[free_index] = 0;
+        }
+
+        int64_t start = esp_timer_get_time();
+        uint8_t index = s_sink->current;
+        uint32_t chunk = MIN(size, OTA_SINK_BUFFER_SIZE - s_sink->sizes[index]);
+        memcpy(s_sink->buffers[index] + s_sink->sizes[index], input, chunk);
+        s_sink->sizes[index] += chunk;
+        s_sink->received += chunk;
+        input += chunk;
+        size -= chunk;
+        if (s_sink->sizes[index] == OTA_SINK_BUFFER_SIZE) {
+            xQueueSend(s_sink->full_queue, &index, portMAX_DELAY);
+            s_sink->current = -1;
+        }
+        s_sink->timing.copy += esp_timer_get_time() - start;
+    }
+    return s_sink->error;
+}
+
+esp_err_t esp_ota_sink_disable_checkpoint(void)
+{
+    ESP_RETURN_ON_FALSE(s_sink, ESP_ERR_INVALID_STATE, TAG, "OTA sink is not started");
+    s_sink->checkpointing = false;
+    return esp_ota_checkpoint_clear();
+}
+
+esp_err_t esp_ota_sink_verify(void)
+{
+    ESP_RETURN_ON_FALSE(s_sink, ESP_ERR_INVALID_STATE, TAG, "OTA sink is not started");
+    /* No more data is expected, the hash is complete once the flash writer drains the staging buffers */
+    ota_sink_stop();
+    ESP_RETURN_ON_ERROR(s_sink->error, TAG, "Failed to write OTA data to partition, status: %s", esp_err_to_name(s_sink->error));
+    ESP_RETURN_ON_FALSE(s_sink->hash_appended, ESP_ERR_NOT_SUPPORTED, TAG, "OTA image has no appended SHA-256");
+    ESP_RETURN_ON_FALSE(s_sink->hash_offset && s_sink->hash_len == OTA_SINK_HASH_SIZE, ESP_ERR_INVALID_SIZE, TAG,
+                        "OTA image is too short for its segment table");
+    ESP_RETURN_ON_FALSE(memcmp(s_sink->digest, s_sink->hash, OTA_SINK_HASH_SIZE) == 0, ESP_ERR_INVALID_CRC, TAG,
+                        "OTA image does not match its SHA-256");
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_sink_end(void)
+{
+    esp_err_t ret = ESP_OK;
+    int64_t start = 0;
+
+    ESP_RETURN_ON_FALSE(s_sink, ESP_ERR_INVALID_STATE, TAG, "OTA sink is not started");
+    ota_sink_stop();
+    ret = s_sink->error;
+    if (ret == ESP_OK) {
+        start = esp_timer_get_time();
+        ret = esp_ota_end(s_sink->handle);
+        s_sink->timing.end = esp_timer_get_time() - start;
+    } else {
+        esp_ota_abort(s_sink->handle);
+    }
+    /* The image is either complete or broken, never resume it */
+    esp_ota_checkpoint_clear();
+    ESP_LOGI(TAG, "-- OTA sink: %ld/%ld bytes written in %lld ms, copy: %lld ms, stall: %lld ms (%ld blocks), flash: %lld ms, end: %lld ms",
+             s_sink->written, s_sink->received, (esp_timer_get_time() - s_sink->timing.start) / 1000, s_sink->timing.copy / 1000,
+             s_sink->timing.stall / 1000, s_sink->timing.stalls, s_sink->timing.write / 1000, s_sink->timing.end / 1000);
+    ota_sink_free();
+    return ret;
+}
+
+esp_err_t esp_ota_sink_abort(void)
+{
+    if (!s_sink) {
+        return ESP_OK;
+    }
+    /* The checkpoint is kept, the download is resumed from it by the next upgrade of the same image */
+    ota_sink_stop();
+    esp_ota_abort(s_sink->handle);
+    ota_sink_free();
+    return ESP_OK;
+}
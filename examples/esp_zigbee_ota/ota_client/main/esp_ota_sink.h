@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA sink Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_zigbee_ota.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_SINK_BUFFER_SIZE          4096                                    /* The size of one staging buffer, one flash sector */
+#define OTA_SINK_BUFFER_NUM           3                                       /* The number of staging buffers */
+#define OTA_SINK_TASK_PRIORITY        4                                       /* The priority of the flash writer task, lower than the Zigbee task */
+#define OTA_SINK_TASK_STACK           3072                                    /* The stack size of the flash writer task */
+#define OTA_SINK_STALL_TIMEOUT        5000                                    /* The longest time to wait for a free staging buffer, in millisecond */
+
+/**
+ * @brief Start to write an image to the partition, the flash is written by a separate task.
+ *
+ * @note The progress is checkpointed to the NVS every OTA_CHECKPOINT_INTERVAL bytes. A non-zero offset resumes the
+ *       download, the partial image in the partition is only kept if it matches the checkpoint.
+ *
+ * @param[in] partition The OTA partition to write
+ * @param[in] header    The header of the image to download
+ * @param[in] offset    The offset to resume the download from, 0 to start from the beginning
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if an image is being written, or the offset does not match the checkpoint
+ *      - ESP_ERR_INVALID_CRC if the partial image does not match the checkpoint
+ *      - ESP_ERR_NO_MEM if the staging buffers can not be allocated
+ */
+esp_err_t esp_ota_sink_begin(const esp_partition_t *partition, const esp_zb_ota_file_header_t *header, uint32_t offset);
+
+/**
+ * @brief Copy the data into the staging buffers, the full buffers are committed to the flash in the background.
+ *
+ * @note The caller is blocked while all the staging buffers are waiting for the flash, which delays the next block request.
+ *
+ * @param[in] data The data of the image
+ * @param[in] size The size of the data
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the flash writer does not release a buffer in time
+ *      - others: the error of the flash writer
+ */
+esp_err_t esp_ota_sink_write(const void *data, uint32_t size);
+
+/**
+ * @brief Stop checkpointing the image being written, for the data written which does not match the received offset.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if no image is being written
+ */
+esp_err_t esp_ota_sink_disable_checkpoint(void);
+
+/**
+ * @brief Wait for the flash writer and check the image against the SHA-256 appended to it.
+ *
+ * @note The SHA-256 is located through the image header and the segment table, a signature block after it is ignored. It
+ *       is computed while the image is written, so a corrupted image is rejected before the partition is read back. The
+ *       partition is still read back by esp_ota_sink_end(), because esp_ota_end() validates the image and its signature
+ *       again. No more data could be written after this call.
+ *
+ * @return
+ *      - ESP_OK if the image matches its SHA-256
+ *      - ESP_ERR_NOT_SUPPORTED if the image header does not announce an appended SHA-256
+ *      - ESP_ERR_INVALID_SIZE if the image ends before the SHA-256 located by its segment table
+ *      - ESP_ERR_INVALID_CRC if the image is corrupted
+ *      - others: the error of the flash writer
+ */
+esp_err_t esp_ota_sink_verify(void);
+
+/**
+ * @brief Commit the remaining data, wait for the flash writer and validate the image.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - others: the error of the flash writer or esp_ota_end()
+ */
+esp_err_t esp_ota_sink_end(void);
+
+/**
+ * @brief Drop the image being written, the checkpoint is kept for the download to be resumed.
+ *
+ * @return
+ *      - ESP_OK on success
+ */
+esp_err_t esp_ota_sink_abort(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,411 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA image store Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#include <string.h>
+#include "esp_check.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_ota_image_store.h"
+
+/* The partition starts with two copies of the index written alternately, the images follow sector aligned */
+#define OTA_IMAGE_STORE_MAGIC         0x4f544149                                            /* "OTAI" */
+#define OTA_IMAGE_STORE_SECTOR_SIZE   0x1000
+#define OTA_IMAGE_STORE_INDEX_COPIES  2
+#define OTA_IMAGE_STORE_DATA_OFFSET   (OTA_IMAGE_STORE_SECTOR_SIZE * OTA_IMAGE_STORE_INDEX_COPIES)
+#define OTA_IMAGE_STORE_ALIGN(size)   (((size) + OTA_IMAGE_STORE_SECTOR_SIZE - 1) & ~(OTA_IMAGE_STORE_SECTOR_SIZE - 1))
+
+static const char *TAG = "ESP_OTA_IMAGE_STORE";
+
+/* The location of one image in the partition */
+typedef struct ota_image_store_entry_s {
+    uint16_t manufacturer_code;     /* The manufacturer code of the image */
+    uint16_t image_type;            /* The image type of the image */
+    uint32_t file_version;          /* The file version of the image */
+    uint32_t offset;                /* The offset of the image in the partition */
+    uint32_t image_size;            /* The size of the image, 0 if the entry is free */
+} ota_image_store_entry_t;
+
+/* The index stored in the first sectors of the partition */
+typedef struct ota_image_store_index_s {
+    uint32_t magic;                 /* OTA_IMAGE_STORE_MAGIC */
+    uint32_t sequence;              /* Incremented on each write, the copy with the latest sequence is used */
+    uint32_t crc;                   /* The CRC32 of the entries */
+    uint32_t reserved;
+    ota_image_store_entry_t entries[OTA_IMAGE_STORE_MAX_IMAGES];
+} ota_image_store_index_t;
+
+_Static_assert(sizeof(ota_image_store_index_t) <= OTA_IMAGE_STORE_SECTOR_SIZE, "OTA image store index exceeds one sector");
+
+typedef struct ota_image_store_s {
+    const esp_partition_t *partition;               /* The data partition */
+    esp_partition_mmap_handle_t mmap_handle;        /* The mapping of the whole partition */
+    const uint8_t *base;                            /* The partition mapped into the memory */
+    SemaphoreHandle_t lock;                         /* The lock of the index */
+    uint8_t copy;                                   /* The copy of the index written last */
+    ota_image_store_index_t index;                  /* The index loaded from the flash */
+    ota_image_store_index_t update;                 /* The index being written, it replaces the index once on the flash */
+    ota_image_store_entry_t retired[OTA_IMAGE_STORE_MAX_IMAGES]; /* The images removed while acquired, their space is kept */
+    uint8_t refs[OTA_IMAGE_STORE_MAX_IMAGES];       /* The number of the references to each image */
+    uint8_t sorted[OTA_IMAGE_STORE_MAX_IMAGES];     /* The entries in use sorted by manufacturer code, image type and file version */
+    uint8_t count;                                  /* The number of the entries in use */
+    bool adding;                                    /* An image is being added */
+    ota_image_store_entry_t pending;                /* The image being added */
+    uint32_t written;                               /* The bytes of the image being added written so far */
+} ota_image_store_t;
+
+static ota_image_store_t s_store;
+
+static inline uint64_t ota_image_store_key(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version)
+{
+    return ((uint64_t)manufacturer_code << 48) | ((uint64_t)image_type << 32) | file_version;
+}
+
+static inline uint64_t ota_image_store_entry_key(uint8_t slot)
+{
+    const ota_image_store_entry_t *entry = &s_store.index.entries[slot];
+    return ota_image_store_key(entry->manufacturer_code, entry->image_type, entry->file_version);
+}
+
+static void ota_image_store_sort(void)
+{
+    s_store.count = 0;
+    for (uint8_t slot = 0; slot < OTA_IMAGE_STORE_MAX_IMAGES; slot++) {
+        if (!s_store.index.entries[slot].image_size) {
+            continue;
+        }
+        /* Insertion sort, the index changes only when an image is added or removed */
+        int pos = s_store.count++;
+        while (pos > 0 && ota_image_store_entry_key(s_store.sorted[pos - 1]) > ota_image_store_entry_key(slot)) {
+            s_store.sorted[pos] = s_store.sorted[pos - 1];
+            pos--;
+        }
+        s_store.sorted[pos] = slot;
+    }
+}
+
+/* The first position in the sorted entries whose key is greater than the key */
+static uint8_t ota_image_store_upper_bound(uint64_t key)
+{
+    uint8_t low = 0;
+    uint8_t high = s_store.count;
+
+    while (low < high) {
+        uint8_t mid = (low + high) / 2;
+        if (ota_image_store_entry_key(s_store.sorted[mid]) <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int ota_image_store_lookup(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version)
+{
+    uint64_t key = ota_image_store_key(manufacturer_code, image_type, file_version);
+    uint8_t pos = ota_image_store_upper_bound(key);
+
+    return (pos && ota_image_store_entry_key(s_store.sorted[pos - 1]) == key) ? s_store.sorted[pos - 1] : -1;
+}
+
+static void ota_image_store_fill(const ota_image_store_entry_t *entry, esp_ota_image_t *image)
+{
+    image->manufacturer_code = entry->manufacturer_code;
+    image->image_type = entry->image_type;
+    image->file_version = entry->file_version;
+    image->image_size = entry->image_size;
+    image->data = s_store.base + entry->offset;
+}
+
+/* Write the update to the other copy, the index in use is replaced only once the write succeeds */
+static esp_err_t ota_image_store_write_index(void)
+{
+    ota_image_store_index_t *update = &s_store.update;
+    uint8_t copy = s_store.copy ^ 1;
+    uint32_t address = copy * OTA_IMAGE_STORE_SECTOR_SIZE;
+
+    update->magic = OTA_IMAGE_STORE_MAGIC;
+    update->sequence = s_store.index.sequence + 1;
+    update->crc = esp_crc32_le(0, (const uint8_t *)update->entries, sizeof(update->entries));
+    /* Write the other copy, the current one stays valid if the write is interrupted */
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_store.partition, address, OTA_IMAGE_STORE_SECTOR_SIZE), TAG,
+                        "Failed to erase the index");
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_store.partition, address, update, sizeof(ota_image_store_index_t)), TAG,
+                        "Failed to write the index");
+    s_store.copy = copy;
+    for (uint8_t slot = 0; slot < OTA_IMAGE_STORE_MAX_IMAGES; slot++) {
+        /* The clients still downloading an image removed keep it until they release it */
+        if (s_store.refs[slot] && s_store.index.entries[slot].image_size && !update->entries[slot].image_size) {
+            s_store.retired[slot] = s_store.index.entries[slot];
+        }
+    }
+    memcpy(&s_store.index, update, sizeof(ota_image_store_index_t));
+    ota_image_store_sort();
+    return ESP_OK;
+}
+
+static bool ota_image_store_read_index(uint8_t copy, ota_image_store_index_t *index)
+{
+    if (esp_partition_read(s_store.partition, copy * OTA_IMAGE_STORE_SECTOR_SIZE, index, sizeof(ota_image_store_index_t)) != ESP_OK) {
+        return false;
+    }
+    return index->magic == OTA_IMAGE_STORE_MAGIC &&
+           index->crc == esp_crc32_le(0, (const uint8_t *)index->entries, sizeof(index->entries));
+}
+
+/* First fit of the size between the images stored, sector aligned */
+static uint32_t ota_image_store_allocate(uint32_t size)
+{
+    uint32_t offset = OTA_IMAGE_STORE_DATA_OFFSET;
+    bool moved = true;
+
+    size = OTA_IMAGE_STORE_ALIGN(size);
+    while (moved) {
+        moved = false;
+        for (uint16_t slot = 0; slot < OTA_IMAGE_STORE_MAX_IMAGES * 2; slot++) {
+            /* The space of the images retired is not reused until they are released */
+            const ota_image_store_entry_t *entry = (slot < OTA_IMAGE_STORE_MAX_IMAGES) ? &s_store.index.entries[slot]
+                                                   : &s_store.retired[slot - OTA_IMAGE_STORE_MAX_IMAGES];
+            uint32_t end = entry->offset + OTA_IMAGE_STORE_ALIGN(entry->image_size);
+            if (entry->image_size && entry->offset < offset + size && offset < end) {
+                offset = end;
+                moved = true;
+            }
+        }
+    }
+    return (offset + size <= s_store.partition->size) ? offset : 0;
+}
+
+esp_err_t esp_ota_image_store_init(const char *label)
+{
+    ota_image_store_index_t *copies = NULL;
+    const void *base = NULL;
+    uint8_t valid = 0;
+
+    s_store.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    ESP_RETURN_ON_FALSE(s_store.partition, ESP_ERR_NOT_FOUND, TAG, "Failed to find the %s partition", label);
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(s_store.partition, 0, s_store.partition->size, ESP_PARTITION_MMAP_DATA, &base,
+                                           &s_store.mmap_handle), TAG, "Failed to map the %s partition", label);
+    s_store.base = base;
+    s_store.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_NO_MEM, TAG, "Failed to create the lock");
+
+    copies = calloc(OTA_IMAGE_STORE_INDEX_COPIES, sizeof(ota_image_store_index_t));
+    ESP_RETURN_ON_FALSE(copies, ESP_ERR_NO_MEM, TAG, "Failed to allocate the index");
+    for (uint8_t copy = 0; copy < OTA_IMAGE_STORE_INDEX_COPIES; copy++) {
+        if (!ota_image_store_read_index(copy, &copies[copy])) {
+            continue;
+        }
+        if (!valid || (int32_t)(copies[copy].sequence - copies[s_store.copy].sequence) > 0) {
+            s_store.copy = copy;
+        }
+        valid |= 1 << copy;
+    }
+    if (valid) {
+        memcpy(&s_store.index, &copies[s_store.copy], sizeof(ota_image_store_index_t));
+    } else {
+        /* The first write goes to the copy 0 */
+        memset(&s_store.index, 0, sizeof(ota_image_store_index_t));
+        s_store.copy = 1;
+    }
+    free(copies);
+    ota_image_store_sort();
+    ESP_LOGI(TAG, "OTA image store: %d images in %s (0x%lx bytes)", s_store.count, label, s_store.partition->size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_image_store_find(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version, uint8_t *index,
+                                   esp_ota_image_t *image)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(s_store.lock && image, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    /* The newest image of the manufacturer code and image type is right before the greatest key of them */
+    uint8_t pos = ota_image_store_upper_bound(ota_image_store_key(manufacturer_code, image_type, UINT32_MAX));
+    if (pos) {
+        uint8_t slot = s_store.sorted[pos - 1];
+        const ota_image_store_entry_t *entry = &s_store.index.entries[slot];
+        if (entry->manufacturer_code == manufacturer_code && entry->image_type == image_type && entry->file_version > file_version) {
+            ota_image_store_fill(entry, image);
+            if (index) {
+                *index = slot;
+            }
+            ret = ESP_OK;
+        }
+    }
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_get(uint8_t index, esp_ota_image_t *image)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(s_store.lock && image, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    if (index < OTA_IMAGE_STORE_MAX_IMAGES && s_store.index.entries[index].image_size) {
+        ota_image_store_fill(&s_store.index.entries[index], image);
+        ret = ESP_OK;
+    } else if (index < OTA_IMAGE_STORE_MAX_IMAGES && s_store.retired[index].image_size) {
+        ota_image_store_fill(&s_store.retired[index], image);
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_acquire(uint8_t index, esp_ota_image_t *image)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    ESP_RETURN_ON_FALSE(s_store.lock && image, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    /* An image retired is not handed to new clients */
+    if (index < OTA_IMAGE_STORE_MAX_IMAGES && s_store.index.entries[index].image_size && s_store.refs[index] < UINT8_MAX) {
+        ota_image_store_fill(&s_store.index.entries[index], image);
+        s_store.refs[index]++;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_release(uint8_t index)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_INVALID_STATE, TAG, "OTA image store is not initialized");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(index < OTA_IMAGE_STORE_MAX_IMAGES && s_store.refs[index], ESP_ERR_INVALID_STATE, exit, TAG,
+                      "OTA image %d is not acquired", index);
+    if (!--s_store.refs[index] && s_store.retired[index].image_size) {
+        ESP_LOGI(TAG, "Release the space of the OTA image removed at index %d", index);
+        s_store.retired[index].image_size = 0;
+    }
+exit:
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_add_begin(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version, uint32_t image_size)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t offset = 0;
+
+    ESP_RETURN_ON_FALSE(s_store.lock && image_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(!s_store.adding, ESP_ERR_INVALID_STATE, exit, TAG, "Another image is being added");
+    offset = ota_image_store_allocate(image_size);
+    ESP_GOTO_ON_FALSE(offset, ESP_ERR_NO_MEM, exit, TAG, "No space for the image of %ld bytes", image_size);
+    ESP_GOTO_ON_ERROR(esp_partition_erase_range(s_store.partition, offset, OTA_IMAGE_STORE_ALIGN(image_size)), exit, TAG,
+                      "Failed to erase the space of the image");
+    s_store.pending = (ota_image_store_entry_t) {
+        .manufacturer_code = manufacturer_code,
+        .image_type = image_type,
+        .file_version = file_version,
+        .offset = offset,
+        .image_size = image_size,
+    };
+    s_store.written = 0;
+    s_store.adding = true;
+exit:
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_add_write(const void *data, uint32_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_INVALID_STATE, TAG, "OTA image store is not initialized");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(s_store.adding, ESP_ERR_INVALID_STATE, exit, TAG, "No image is being added");
+    ESP_GOTO_ON_FALSE(s_store.written + size <= s_store.pending.image_size, ESP_ERR_INVALID_SIZE, exit, TAG, "Image exceeds its size");
+    ESP_GOTO_ON_ERROR(esp_partition_write(s_store.partition, s_store.pending.offset + s_store.written, data, size), exit, TAG,
+                      "Failed to write the image");
+    s_store.written += size;
+exit:
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_add_end(uint8_t *index)
+{
+    esp_err_t ret = ESP_OK;
+    int replaced = -1;
+    int slot = -1;
+
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_INVALID_STATE, TAG, "OTA image store is not initialized");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(s_store.adding, ESP_ERR_INVALID_STATE, exit, TAG, "No image is being added");
+    ESP_GOTO_ON_FALSE(s_store.written == s_store.pending.image_size, ESP_ERR_INVALID_SIZE, exit, TAG, "Image is incomplete");
+    replaced = ota_image_store_lookup(s_store.pending.manufacturer_code, s_store.pending.image_type, s_store.pending.file_version);
+    /* The index of an image acquired keeps pointing at it, so its slot is not reused */
+    for (int i = 0; i < OTA_IMAGE_STORE_MAX_IMAGES && slot < 0; i++) {
+        if (!s_store.index.entries[i].image_size && !s_store.refs[i]) {
+            slot = i;
+        }
+    }
+    /* Replace the image with the same version in its slot if the index is full */
+    slot = (slot < 0 && replaced >= 0 && !s_store.refs[replaced]) ? replaced : slot;
+    ESP_GOTO_ON_FALSE(slot >= 0, ESP_ERR_NO_MEM, exit, TAG, "OTA image store index is full");
+    memcpy(&s_store.update, &s_store.index, sizeof(ota_image_store_index_t));
+    if (replaced >= 0) {
+        s_store.update.entries[replaced].image_size = 0;
+    }
+    s_store.update.entries[slot] = s_store.pending;
+    ESP_GOTO_ON_ERROR(ota_image_store_write_index(), exit, TAG, "Failed to add the image");
+    ESP_LOGI(TAG, "Add OTA image (manufacturer: 0x%x, image type: 0x%x, version: 0x%lx, size: %ld) at index %d",
+             s_store.pending.manufacturer_code, s_store.pending.image_type, s_store.pending.file_version, s_store.pending.image_size, slot);
+    if (index) {
+        *index = slot;
+    }
+    s_store.adding = false;
+exit:
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
+
+esp_err_t esp_ota_image_store_add_abort(void)
+{
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_INVALID_STATE, TAG, "OTA image store is not initialized");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    s_store.adding = false;
+    xSemaphoreGive(s_store.lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_image_store_remove(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version)
+{
+    esp_err_t ret = ESP_OK;
+    int slot = -1;
+
+    ESP_RETURN_ON_FALSE(s_store.lock, ESP_ERR_INVALID_STATE, TAG, "OTA image store is not initialized");
+    xSemaphoreTake(s_store.lock, portMAX_DELAY);
+    slot = ota_image_store_lookup(manufacturer_code, image_type, file_version);
+    ESP_GOTO_ON_FALSE(slot >= 0, ESP_ERR_NOT_FOUND, exit, TAG, "OTA image is not in the store");
+    /* The flash space is reused once all the clients still downloading the image release it */
+    memcpy(&s_store.update, &s_store.index, sizeof(ota_image_store_index_t));
+    s_store.update.entries[slot].image_size = 0;
+    ESP_GOTO_ON_ERROR(ota_image_store_write_index(), exit, TAG, "Failed to remove the image");
+    ESP_LOGI(TAG, "Remove OTA image (manufacturer: 0x%x, image type: 0x%x, version: 0x%lx) at index %d", manufacturer_code,
+             image_type, file_version, slot);
+exit:
+    xSemaphoreGive(s_store.lock);
+    return ret;
+}
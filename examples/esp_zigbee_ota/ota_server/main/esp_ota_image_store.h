@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee OTA image store Example
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_IMAGE_STORE_LABEL         "ota_store"                                           /* The label of the data partition holding the OTA images */
+#define OTA_IMAGE_STORE_MAX_IMAGES    64                                                    /* The max amount of OTA images in the store */
+
+/* The OTA image located in the store */
+typedef struct esp_ota_image_s {
+    uint16_t manufacturer_code;     /* The manufacturer code of the image */
+    uint16_t image_type;            /* The image type of the image */
+    uint32_t file_version;          /* The file version of the image */
+    uint32_t image_size;            /* The size of the image in bytes */
+    const uint8_t *data;            /* The image memory-mapped from the flash */
+} esp_ota_image_t;
+
+/**
+ * @brief Load the index of the store and map the images into the memory.
+ *
+ * @param[in] label The label of the data partition
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the partition does not exist
+ */
+esp_err_t esp_ota_image_store_init(const char *label);
+
+/**
+ * @brief Look up the newest image of the manufacturer code and image type which is newer than the version, in O(log n).
+ *
+ * @param[in]  manufacturer_code The manufacturer code of the client
+ * @param[in]  image_type        The image type of the client
+ * @param[in]  file_version      The file version running on the client, 0 to get the newest image
+ * @param[out] index             The index of the image in the store, it does not change until the image is removed
+ * @param[out] image             The image found
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no newer image
+ */
+esp_err_t esp_ota_image_store_find(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version, uint8_t *index,
+                                   esp_ota_image_t *image);
+
+/**
+ * @brief Get the image by its index in the store.
+ *
+ * @note An image removed while it is acquired is still returned until it is released.
+ *
+ * @param[in]  index The index of the image
+ * @param[out] image The image
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no image at the index
+ */
+esp_err_t esp_ota_image_store_get(uint8_t index, esp_ota_image_t *image);
+
+/**
+ * @brief Get the image by its index in the store and keep it mapped until it is released.
+ *
+ * @note If the image is removed meanwhile, it disappears from the lookup but its index and flash space are not reused
+ *       until the last reference is released.
+ *
+ * @param[in]  index The index of the image
+ * @param[out] image The image
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if there is no image at the index, or it is removed
+ */
+esp_err_t esp_ota_image_store_acquire(uint8_t index, esp_ota_image_t *image);
+
+/**
+ * @brief Release the image acquired by esp_ota_image_store_acquire().
+ *
+ * @param[in] index The index of the image
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the image is not acquired
+ */
+esp_err_t esp_ota_image_store_release(uint8_t index);
+
+/**
+ * @brief Start to add an image, the flash space is allocated and erased.
+ *
+ * @note An image with the same manufacturer code, image type and file version is replaced once the new image is added.
+ *
+ * @param[in] manufacturer_code The manufacturer code of the image
+ * @param[in] image_type        The image type of the image
+ * @param[in] file_version      The file version of the image
+ * @param[in] image_size        The size of the image in bytes
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if another image is being added
+ *      - ESP_ERR_NO_MEM if the store is full
+ */
+esp_err_t esp_ota_image_store_add_begin(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version, uint32_t image_size);
+
+/**
+ * @brief Write the next part of the image being added.
+ *
+ * @param[in] data The data of the image
+ * @param[in] size The size of the data
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_SIZE if the data exceeds the size of the image
+ */
+esp_err_t esp_ota_image_store_add_write(const void *data, uint32_t size);
+
+/**
+ * @brief Finish adding the image, it is visible to the lookup once the index is written.
+ *
+ * @param[out] index The index of the image added, could be NULL
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_SIZE if the image is not completely written
+ */
+esp_err_t esp_ota_image_store_add_end(uint8_t *index);
+
+/**
+ * @brief Abort adding the image, the flash space is released.
+ *
+ * @return
+ *      - ESP_OK on success
+ */
+esp_err_t esp_ota_image_store_add_abort(void);
+
+/**
+ * @brief Remove an image from the store.
+ *
+ * @note The flash space of an image acquired is reused only once it is released.
+ *
+ * @param[in] manufacturer_code The manufacturer code of the image
+ * @param[in] image_type        The image type of the image
+ * @param[in] file_version      The file version of the image
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the image is not in the store
+ */
+esp_err_t esp_ota_image_store_remove(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version);
+
+#ifdef __cplusplus
+}
+#endif
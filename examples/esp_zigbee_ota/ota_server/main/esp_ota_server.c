@@ -12,15 +12,64 @@
  * CONDITIONS OF ANY KIND, either express or implied.
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_ota_server.h"
+#include "aps/esp_zigbee_aps.h"
 #include "nvs_flash.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 
 static const char *TAG = "ESP_OTA_SERVER";
 
 static esp_err_t zb_ota_next_data_handler(esp_zb_ota_zcl_information_t message, uint16_t index, uint8_t size, uint8_t **data);
 
+/* Register the newest image newer than the file version to the OTA server, the index of the store is the OTA image index */
+static esp_err_t zb_ota_upgrade_server_register_image(uint16_t manufacturer_code, uint16_t image_type, uint32_t file_version, bool notify_on)
+{
+    esp_ota_image_t image;
+    uint8_t index = 0;
+
+    if (esp_ota_image_store_find(manufacturer_code, image_type, file_version, &index, &image) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_zb_ota_upgrade_server_notify_req_t req = {
+        .endpoint = ESP_OTA_SERVER_ENDPOINT,
+        .index = index,
+        .notify_on = notify_on,
+        .ota_upgrade_time = OTA_UPGRADE_TIME,
+        .ota_file_header =
+            {
+                .manufacturer_code = image.manufacturer_code,
+                .image_type = image.image_type,
+                .file_version = image.file_version,
+                .image_size = image.image_size,
+            },
+        .next_data_cb = zb_ota_next_data_handler,
+    };
+    return esp_zb_ota_upgrade_server_notify_req(&req);
+}
+
+/* Add the image embedded in the firmware to the store on the first boot */
+static esp_err_t ota_image_store_add_embedded_image(void)
+{
+    esp_ota_image_t image;
+    uint32_t image_size = ota_file_end - ota_file_start;
+
+    if (esp_ota_image_store_find(OTA_UPGRADE_MANUFACTURER, OTA_UPGRADE_IMAGE_TYPE, 0, NULL, &image) == ESP_OK) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(esp_ota_image_store_add_begin(OTA_UPGRADE_MANUFACTURER, OTA_UPGRADE_IMAGE_TYPE, OTA_UPGRADE_FILE_VERSION, image_size),
+                        TAG, "Failed to add the embedded OTA image");
+    if (esp_ota_image_store_add_write(ota_file_start, image_size) != ESP_OK) {
+        esp_ota_image_store_add_abort();
+        return ESP_FAIL;
+    }
+    return esp_ota_image_store_add_end(NULL);
+}
+
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
 {
     ESP_RETURN_ON_FALSE(esp_zb_bdb_start_top_level_commissioning(mode_mask) == ESP_OK, , TAG, "Failed to start Zigbee commissioning");
@@ -75,22 +124,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE: {
         dev_annce_params = (esp_zb_zdo_signal_device_annce_params_t *)esp_zb_app_signal_get_params(p_sg_p);
         ESP_LOGI(TAG, "New device commissioned or rejoined (short: 0x%04hx)", dev_annce_params->device_short_addr);
-        esp_zb_ota_upgrade_server_notify_req_t req = {
-            .endpoint = ESP_OTA_SERVER_ENDPOINT,
-            .index = OTA_UPGRADE_INDEX,
-            .notify_on = true,
-            .ota_upgrade_time = OTA_UPGRADE_TIME,
-            .ota_file_header =
-                {
-                    .manufacturer_code = OTA_UPGRADE_MANUFACTURER,
-                    .image_type = OTA_UPGRADE_IMAGE_TYPE,
-                    .file_version = OTA_UPGRADE_FILE_VERSION,
-                    .image_size = ota_file_end - ota_file_start,
-                },
-            .next_data_cb = zb_ota_next_data_handler,
-        };
-        esp_zb_ota_upgrade_server_notify_req(&req);
-        ESP_LOGI(TAG, "OTA Server notify");
+        if (zb_ota_upgrade_server_register_image(OTA_UPGRADE_MANUFACTURER, OTA_UPGRADE_IMAGE_TYPE, 0, true) == ESP_OK) {
+            ESP_LOGI(TAG, "OTA Server notify");
+        }
         break;
     }
     case ESP_ZB_NWK_SIGNAL_PERMIT_JOIN_STATUS:
@@ -109,21 +145,419 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     }
 }
 
-static uint32_t s_ota_image_offset = 0;
+/* The transfer state of one OTA client */
+typedef struct ota_server_session_s {
+    bool in_use;            /* The session is allocated to the client */
+    uint16_t short_addr;    /* The short address of the client */
+    uint32_t offset;        /* The file offset following the last block served to the client */
+    bool block_request;     /* The file offset of the Image Block Request being served is known */
+    uint32_t block_offset;  /* The file offset of the Image Block Request being served */
+    uint8_t index;          /* The index of the image in the store */
+    bool acquired;          /* The image is acquired from the store */
+    uint8_t block_size;     /* The size of the last block requested by the client */
+    uint8_t retries;        /* The number of times the client restarted the transfer */
+    uint8_t lqi;            /* The average link quality of the frames from the client, 0 if unknown */
+    uint16_t period;        /* The minimum block period assigned to the client, in millisecond */
+    uint16_t sent_period;   /* The minimum block period sent to the client in the last WAIT_FOR_DATA, in millisecond */
+    uint16_t clean_blocks;  /* The blocks served since the last retry */
+    uint16_t stalls;        /* The number of block requests delayed by a retry */
+    uint32_t blocks;        /* The number of blocks served */
+    int64_t gap;            /* The average time between two block requests without retry, in microseconds */
+    int64_t start_time;     /* The time of the first block, in microseconds */
+    int64_t last_time;      /* The time of the last block, in microseconds */
+} ota_server_session_t;
+
+/* The transfer metrics of all the OTA clients */
+typedef struct ota_server_stats_s {
+    uint8_t active;         /* The number of sessions transferring */
+    uint16_t completed;     /* The number of sessions ended successfully */
+    uint16_t aborted;       /* The number of sessions aborted */
+    uint64_t bytes;         /* The bytes served to all the clients */
+    int64_t busy_time;      /* The time with at least one session transferring, in microseconds */
+    int64_t busy_since;     /* The time the first of the active sessions started, in microseconds */
+} ota_server_stats_t;
+
+static ota_server_session_t s_ota_sessions[OTA_UPGRADE_SESSION_MAX];
+static ota_server_stats_t s_ota_stats;
+
+static uint32_t ota_throughput(uint64_t bytes, int64_t time_us)
+{
+    return (time_us > 0) ? (uint32_t)(bytes * 1000000 / time_us) : 0;
+}
+
+#if CONFIG_OTA_BENCHMARK
+#define OTA_BENCHMARK_JITTER_MAX            8                                       /* The max amount of query jitters to sweep */
+
+/* The rounds of the benchmark, the clients are notified again once all of them finish a download */
+typedef struct ota_benchmark_s {
+    uint16_t round;                                 /* The current round */
+    uint8_t clients;                                /* The most sessions transferring at the same time in the round */
+    uint8_t jitters[OTA_BENCHMARK_JITTER_MAX];      /* The query jitters to sweep */
+    uint8_t jitter_count;                           /* The number of query jitters */
+    bool scheduled;                                 /* The next round is scheduled */
+} ota_benchmark_t;
+
+static ota_benchmark_t s_benchmark;
+
+static void zb_ota_benchmark_init(void)
+{
+    const char *jitters = CONFIG_OTA_BENCHMARK_QUERY_JITTERS;
+    char *end = NULL;
+
+    while (*jitters && s_benchmark.jitter_count < OTA_BENCHMARK_JITTER_MAX) {
+        long jitter = strtol(jitters, &end, 0);
+        if (end == jitters) {
+            break;
+        }
+        s_benchmark.jitters[s_benchmark.jitter_count++] = MIN(MAX(jitter, 1), 100);
+        jitters = (*end == ',') ? end + 1 : end;
+    }
+    if (!s_benchmark.jitter_count) {
+        s_benchmark.jitters[s_benchmark.jitter_count++] = OTA_UPGRADE_QUERY_JITTER;
+    }
+}
+
+static uint8_t zb_ota_benchmark_jitter(void)
+{
+    return s_benchmark.jitters[s_benchmark.round % s_benchmark.jitter_count];
+}
+
+static void zb_ota_benchmark_set_jitter(void)
+{
+    esp_zb_zcl_ota_upgrade_server_variable_t variable = {
+        .query_jitter = zb_ota_benchmark_jitter(),
+        .current_time = OTA_UPGRADE_CURRENT_TIME,
+        .file_count = OTA_UPGRADE_IMAGE_COUNT,
+    };
+
+    esp_zb_zcl_set_attribute_val(ESP_OTA_SERVER_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_DATA_ID, &variable, false);
+}
+
+static void zb_ota_benchmark_next_round(uint8_t param)
+{
+    s_benchmark.scheduled = false;
+    s_benchmark.round++;
+    s_benchmark.clients = 0;
+    zb_ota_benchmark_set_jitter();
+    ESP_LOGI(TAG, "OTA_BENCH_ROUND %d, query jitter: %d", s_benchmark.round, zb_ota_benchmark_jitter());
+    if (zb_ota_upgrade_server_register_image(OTA_UPGRADE_MANUFACTURER, OTA_UPGRADE_IMAGE_TYPE, 0, true) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to notify the OTA image of round %d", s_benchmark.round);
+    }
+}
+
+/* Log the result of the session in a machine-readable line, the next round starts once all the clients are idle */
+static void zb_ota_benchmark_report(const ota_server_session_t *session, bool success, int64_t elapsed)
+{
+    ESP_LOGI(TAG, "OTA_BENCH {\"role\":\"server\",\"round\":%d,\"client\":\"0x%04x\",\"status\":\"%s\",\"jitter\":%d,"
+             "\"clients\":%d,\"bytes\":%ld,\"time_ms\":%lld,\"bps\":%ld,\"block_size\":%d,\"retries\":%d,\"stalls\":%d,"
+             "\"period\":%d,\"lqi\":%d}",
+             s_benchmark.round, session->short_addr, success ? "finished" : "aborted", zb_ota_benchmark_jitter(), s_benchmark.clients,
+             session->offset, elapsed / 1000, ota_throughput(session->offset, elapsed), session->block_size, session->retries,
+             session->stalls, session->period, session->lqi);
+    if (s_ota_stats.active || s_benchmark.scheduled) {
+        return;
+    }
+    if (s_benchmark.round + 1 < CONFIG_OTA_BENCHMARK_ROUNDS) {
+        s_benchmark.scheduled = true;
+        esp_zb_scheduler_alarm(zb_ota_benchmark_next_round, 0, CONFIG_OTA_BENCHMARK_ROUND_DELAY);
+    } else {
+        ESP_LOGI(TAG, "OTA_BENCH_DONE %d rounds", CONFIG_OTA_BENCHMARK_ROUNDS);
+    }
+}
+#endif
+
+static ota_server_session_t *ota_session_find(uint16_t short_addr)
+{
+    for (int i = 0; i < OTA_UPGRADE_SESSION_MAX; i++) {
+        if (s_ota_sessions[i].in_use && s_ota_sessions[i].short_addr == short_addr) {
+            return &s_ota_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void ota_session_start(ota_server_session_t *session, int64_t now)
+{
+    if (session->start_time) {
+        return;
+    }
+    if (!s_ota_stats.active++) {
+        s_ota_stats.busy_since = now;
+    }
+#if CONFIG_OTA_BENCHMARK
+    s_benchmark.clients = MAX(s_benchmark.clients, s_ota_stats.active);
+#endif
+    session->start_time = now;
+}
+
+static void ota_session_stop(ota_server_session_t *session, int64_t now)
+{
+    if (!session->start_time) {
+        return;
+    }
+    if (!--s_ota_stats.active) {
+        s_ota_stats.busy_time += now - s_ota_stats.busy_since;
+    }
+    session->start_time = 0;
+}
+
+/* Let the store reclaim the image once no client downloads it */
+static void ota_session_release(ota_server_session_t *session)
+{
+    if (session->acquired) {
+        esp_ota_image_store_release(session->index);
+        session->acquired = false;
+    }
+}
+
+/* Open the session of the client, NULL if all the sessions belong to the clients still transferring */
+static ota_server_session_t *ota_session_open(uint16_t short_addr)
+{
+    ota_server_session_t *session = ota_session_find(short_addr);
+    ota_server_session_t *oldest = NULL;
+    int64_t now = esp_timer_get_time();
+
+    if (session) {
+        return session;
+    }
+    for (int i = 0; i < OTA_UPGRADE_SESSION_MAX; i++) {
+        if (!s_ota_sessions[i].in_use) {
+            session = &s_ota_sessions[i];
+            break;
+        }
+        if (!oldest || s_ota_sessions[i].last_time < oldest->last_time) {
+            oldest = &s_ota_sessions[i];
+        }
+    }
+    if (!session) {
+        /* The session moved to another client would serve it from a wrong offset, only a silent client is dropped */
+        if (now - oldest->last_time < OTA_UPGRADE_SESSION_TIMEOUT * 1000LL) {
+            ESP_LOGW(TAG, "OTA session table full, refuse the client 0x%x", short_addr);
+            return NULL;
+        }
+        ESP_LOGW(TAG, "OTA session table full, drop the silent session of 0x%x", oldest->short_addr);
+        if (oldest->start_time) {
+            ota_session_stop(oldest, now);
+            s_ota_stats.aborted++;
+        }
+        ota_session_release(oldest);
+        session = oldest;
+    }
+    memset(session, 0, sizeof(ota_server_session_t));
+    session->in_use = true;
+    session->short_addr = short_addr;
+    session->last_time = now;
+    return session;
+}
+
+/* Adapt the minimum block period of the client, it backs off on retries and creeps back on a clean link */
+static void ota_pacing_update(ota_server_session_t *session, int64_t gap)
+{
+    uint16_t floor = (s_ota_stats.active - 1) * OTA_PACING_SESSION_PERIOD;
+    int64_t stall = MAX(OTA_PACING_STALL_MIN * 1000LL, session->gap * 4);
+
+    if (session->lqi && session->lqi < OTA_PACING_LQI_LOW) {
+        floor += OTA_PACING_LQI_PERIOD;
+    }
+    if (session->gap && gap > stall) {
+        /* The client waited for a lost block, back off */
+        session->period = MIN(session->period * 2 + OTA_PACING_PERIOD_STEP, OTA_PACING_PERIOD_MAX);
+        session->clean_blocks = 0;
+        session->stalls++;
+    } else {
+        session->gap = session->gap ? session->gap + (gap - session->gap) / 8 : gap;
+        if (++session->clean_blocks >= OTA_PACING_CLEAN_BLOCKS) {
+            session->period = session->period > OTA_PACING_PERIOD_STEP ? session->period - OTA_PACING_PERIOD_STEP : 0;
+            session->clean_blocks = 0;
+        }
+    }
+    session->period = MIN(MAX(session->period, floor), OTA_PACING_PERIOD_MAX);
+}
+
+/* Read the file offset of the Image Block Request, the stack does not pass it to the next data handler. Return the
+ * length of the ZCL header, 0 if the frame is not an Image Block Request */
+static uint16_t ota_block_request_parse(const esp_zb_apsde_data_ind_t *ind, uint32_t *offset)
+{
+    const uint8_t *zcl = ind->asdu;
+    uint16_t head = 3;
+
+    if (!zcl || ind->asdu_length < head) {
+        return 0;
+    }
+    /* The cluster specific command to the server, the manufacturer code is present if the frame control tells */
+    if (zcl[0] & 0x04) {
+        head += 2;
+    }
+    if ((zcl[0] & 0x03) != 0x01 || (zcl[0] & 0x08) || ind->asdu_length < head + 14 || zcl[head - 1] != OTA_BLOCK_REQUEST_CMD) {
+        return 0;
+    }
+    /* Field control, manufacturer code, image type and file version come before the file offset */
+    zcl += head + 9;
+    *offset = zcl[0] | (zcl[1] << 8) | (zcl[2] << 16) | ((uint32_t)zcl[3] << 24);
+    return head;
+}
+
+/*
+ * Answer the Image Block Request with WAIT_FOR_DATA if the client comes before its minimum block period or the period
+ * has changed since it was last sent. The client requests the same block again once the period elapses, and uses the
+ * period carried in the response for the following requests. The MinimumBlockPeriod attribute is read-only on the
+ * client, so the pacing is done by the server only.
+ */
+static bool ota_pacing_wait(ota_server_session_t *session, const esp_zb_apsde_data_ind_t *ind, uint16_t head)
+{
+    int64_t early = session->last_time + session->period * 1000LL - esp_timer_get_time();
+    uint32_t request_time = OTA_UPGRADE_CURRENT_TIME + (early > 0 ? early / 1000000 : 0);
+    uint8_t asdu[5 + 11] = { 0 };
+    uint8_t len = 0;
+
+    if (!session->start_time || (early <= 0 && session->period == session->sent_period)) {
+        return false;
+    }
+    /* The cluster specific command to the client with the sequence number and the manufacturer code of the request */
+    asdu[len++] = 0x19 | (ind->asdu[0] & 0x04);
+    if (ind->asdu[0] & 0x04) {
+        asdu[len++] = ind->asdu[1];
+        asdu[len++] = ind->asdu[2];
+    }
+    asdu[len++] = ind->asdu[head - 2];
+    asdu[len++] = OTA_BLOCK_RESPONSE_CMD;
+    asdu[len++] = OTA_BLOCK_WAIT_FOR_DATA;
+    for (int i = 0; i < 4; i++) {
+        asdu[len + i] = (OTA_UPGRADE_CURRENT_TIME >> (i * 8)) & 0xFF;
+        asdu[len + 4 + i] = (request_time >> (i * 8)) & 0xFF;
+    }
+    len += 8;
+    asdu[len++] = session->period & 0xFF;
+    asdu[len++] = session->period >> 8;
+
+    esp_zb_apsde_data_req_t req = {
+        .dst_addr_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .dst_short_addr = ind->src_short_addr,
+        .dst_endpoint = ind->src_endpoint,
+        .profile_id = ind->profile_id,
+        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+        .src_endpoint = ind->dst_endpoint,
+        .asdu_length = len,
+        .asdu = asdu,
+        .tx_options = ESP_ZB_APSDE_TX_OPT_ACK_TX,
+    };
+    if (esp_zb_aps_data_request(&req) != ESP_OK) {
+        return false;
+    }
+    session->sent_period = session->period;
+    return true;
+}
+
+/* Track the link quality and the block requests of the clients, the frames are still processed by the stack */
+static bool zb_apsde_data_indication_handler(esp_zb_apsde_data_ind_t ind)
+{
+    ota_server_session_t *session = NULL;
+    uint32_t offset = 0;
+    uint16_t head = 0;
+
+    if (ind.status == 0 && ind.cluster_id == ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE) {
+        head = ota_block_request_parse(&ind, &offset);
+        session = head ? ota_session_open(ind.src_short_addr) : ota_session_find(ind.src_short_addr);
+        if (session) {
+            session->lqi = session->lqi ? (session->lqi * 7 + ind.lqi) / 8 : ind.lqi;
+            session->block_request = head ? true : false;
+            session->block_offset = offset;
+            /* The request answered with WAIT_FOR_DATA is not handed to the stack */
+            if (head && ota_pacing_wait(session, &ind, head)) {
+                session->block_request = false;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void ota_session_close(ota_server_session_t *session, bool success)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = session->start_time ? now - session->start_time : 0;
+    int64_t busy_time = 0;
+
+    if (session->start_time) {
+        if (success) {
+            s_ota_stats.completed++;
+        } else {
+            s_ota_stats.aborted++;
+        }
+    }
+    ota_session_stop(session, now);
+    busy_time = s_ota_stats.active ? s_ota_stats.busy_time + now - s_ota_stats.busy_since : s_ota_stats.busy_time;
+
+    ESP_LOGI(TAG, "OTA client 0x%x %s: %ld bytes in %lld ms, %ld B/s, block size %d, retries %d, stalls %d, period %d ms, lqi %d",
+             session->short_addr, success ? "finished" : "aborted", session->offset, elapsed / 1000,
+             ota_throughput(session->offset, elapsed), session->block_size, session->retries, session->stalls, session->period,
+             session->lqi);
+    ESP_LOGI(TAG, "OTA server: %d active, %d completed, %d aborted, %llu bytes, %ld B/s", s_ota_stats.active,
+             s_ota_stats.completed, s_ota_stats.aborted, s_ota_stats.bytes, ota_throughput(s_ota_stats.bytes, busy_time));
+#if CONFIG_OTA_BENCHMARK
+    zb_ota_benchmark_report(session, success, elapsed);
+#endif
+    ota_session_release(session);
+    session->in_use = false;
+}
+
+/*
+ * Serve the block from the file offset of the Image Block Request, so a request repeated after a lost response gets the
+ * same data again. The blocks are assumed in sequence only if the request has not been seen by the APS data indication
+ * handler, each block then follows the one served before.
+ */
 static esp_err_t zb_ota_next_data_handler(esp_zb_ota_zcl_information_t message, uint16_t index, uint8_t size, uint8_t **data)
 {
-    switch (index) {
-    case OTA_UPGRADE_INDEX:
-        *data = (uint8_t *)ota_file_start + s_ota_image_offset;
-        s_ota_image_offset += size;
-        break;
-    default:
-        ESP_LOGW(TAG, "Failed to locate the OTA image using the index (%d)", index);
-        return ESP_FAIL;
-        break;
+    ota_server_session_t *session = NULL;
+    int64_t now = esp_timer_get_time();
+    esp_ota_image_t image;
+    uint32_t offset = 0;
+
+    ESP_RETURN_ON_FALSE(index <= UINT8_MAX, ESP_FAIL, TAG, "Failed to locate the OTA image using the index (%d)", index);
+    session = ota_session_open(message.src_addr.u.short_addr);
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NO_MEM, TAG, "No OTA session for the client 0x%x", message.src_addr.u.short_addr);
+    if (!session->acquired || session->index != index) {
+        ota_session_release(session);
+        /* The image is held until the session closes, so removing it does not cut the download short */
+        ESP_RETURN_ON_FALSE(esp_ota_image_store_acquire(index, &image) == ESP_OK, ESP_FAIL, TAG,
+                            "Failed to locate the OTA image using the index (%d)", index);
+        session->acquired = true;
+    } else {
+        ESP_RETURN_ON_FALSE(esp_ota_image_store_get(index, &image) == ESP_OK, ESP_FAIL, TAG,
+                            "Failed to locate the OTA image using the index (%d)", index);
+    }
+    if (session->index != index) {
+        /* The client moves to another image, start from its beginning */
+        ota_session_stop(session, now);
+        session->offset = 0;
+        session->index = index;
+    }
+    offset = session->block_request ? session->block_offset : session->offset;
+    session->block_request = false;
+    ESP_RETURN_ON_FALSE(offset + size <= image.image_size, ESP_FAIL, TAG, "OTA client 0x%x requests beyond the image",
+                        session->short_addr);
+    if (session->blocks && offset < session->offset) {
+        ESP_LOGW(TAG, "OTA client 0x%x requests the block at %ld again", session->short_addr, offset);
+    } else {
+        s_ota_stats.bytes += size;
     }
-    ESP_LOGI(TAG, "-- OTA Server transmits data from 0x%x to 0x%x: progress [%ld/%d]", message.dst_short_addr, message.src_addr.u.short_addr,
-             s_ota_image_offset, (ota_file_end - ota_file_start));
+    if (session->start_time) {
+        ota_pacing_update(session, now - session->last_time);
+    }
+    ota_session_start(session, now);
+    /* The image is mapped from the flash, the block is served without copying */
+    *data = (uint8_t *)image.data + offset;
+    session->offset = offset + size;
+    session->block_size = size;
+    session->last_time = now;
+    if (++session->blocks % OTA_PACING_REPORT_BLOCKS == 0) {
+        ESP_LOGI(TAG, "OTA client 0x%x pacing: block size %d, period %d ms, lqi %d, stalls %d, %ld B/s", session->short_addr,
+                 session->block_size, session->period, session->lqi, session->stalls,
+                 ota_throughput(session->offset, now - session->start_time));
+    }
+    ESP_LOGI(TAG, "-- OTA Server transmits data from 0x%x to 0x%x: progress [%ld/%ld], %ld B/s", message.dst_short_addr, session->short_addr,
+             session->offset, image.image_size, ota_throughput(session->offset, now - session->start_time));
     return (*data) ? ESP_OK : ESP_FAIL;
 }
 
@@ -137,7 +571,10 @@ static esp_err_t zb_ota_upgrade_server_status_handler(esp_zb_zcl_ota_upgrade_ser
         ESP_LOGI(TAG, "OTA upgrade time: 0x%lx", *message.upgrade_time);
     }
     if(message.server_status == ESP_ZB_ZCL_OTA_UPGRADE_SERVER_ABORTED || message.server_status == ESP_ZB_ZCL_OTA_UPGRADE_SERVER_END) {
-        s_ota_image_offset = 0;
+        ota_server_session_t *session = ota_session_find(message.zcl_addr.u.short_addr);
+        if (session) {
+            ota_session_close(session, message.server_status == ESP_ZB_ZCL_OTA_UPGRADE_SERVER_END);
+        }
     }
     return ret;
 }
@@ -152,8 +589,17 @@ static esp_err_t zb_ota_upgrade_server_query_image_handler(esp_zb_zcl_ota_upgrad
     if (message.table_idx) {
         ESP_LOGI(TAG, "OTA table index: 0x%x", *message.table_idx);
     }
-    ESP_RETURN_ON_FALSE((message.image_type == OTA_UPGRADE_IMAGE_TYPE && message.manufacturer_code == OTA_UPGRADE_MANUFACTURER), ESP_ERR_NOT_FOUND,
-                        TAG, "OTA query image mismatch");
+    /* The client queries again after it gives up a transfer, restart its session from the beginning of the image */
+    ota_server_session_t *session = ota_session_open(message.zcl_addr.u.short_addr);
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NO_MEM, TAG, "No OTA session for the client 0x%x", message.zcl_addr.u.short_addr);
+    ESP_RETURN_ON_FALSE(zb_ota_upgrade_server_register_image(message.manufacturer_code, message.image_type, message.version, false) == ESP_OK,
+                        ESP_ERR_NOT_FOUND, TAG, "OTA query image mismatch");
+    if (session->offset) {
+        ota_session_stop(session, esp_timer_get_time());
+        session->offset = 0;
+        session->retries++;
+        ESP_LOGW(TAG, "OTA client 0x%x restarts the transfer (retries: %d)", session->short_addr, session->retries);
+    }
     return ret;
 }
 
@@ -200,8 +646,13 @@ static void esp_zb_task(void *pvParameters)
     };
     esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_cluster_list, endpoint_config);
     esp_zb_device_register(esp_zb_ep_list);
+#if CONFIG_OTA_BENCHMARK
+    zb_ota_benchmark_init();
+    zb_ota_benchmark_set_jitter();
+#endif
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_aps_data_indication_handler_register(zb_apsde_data_indication_handler);
     ESP_ERROR_CHECK(esp_zb_start(false));
     esp_zb_main_loop_iteration();
 }
@@ -213,6 +664,8 @@ void app_main(void)
         .host_config = ESP_ZB_DEFAULT_HOST_CONFIG(),
     };
     ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK(esp_ota_image_store_init(OTA_IMAGE_STORE_LABEL));
+    ESP_ERROR_CHECK(ota_image_store_add_embedded_image());
     ESP_ERROR_CHECK(esp_zb_platform_config(&config));
     xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
 }
\ No newline at end of file
@@ -13,21 +13,35 @@
  */
 
 #include "esp_zigbee_core.h"
+#include "esp_ota_image_store.h"
 
 /* Zigbee configuration */
 #define MAX_CHILDREN                  10                                                    /* The max amount of connected devices */
 #define INSTALLCODE_POLICY_ENABLE     false                                                 /* Enable the install code policy for security */
 #define ESP_OTA_SERVER_ENDPOINT       5                                                     /* OTA Server endpoint identifier */
 /* Zigbee OTA Configuration */
-#define OTA_UPGRADE_INDEX             0                                                     /* The index of OTA upgrade image */
 #define OTA_UPGRADE_FILE_VERSION      0x01010110                                            /* The test file version of the running firmware image on the device */
 #define OTA_UPGRADE_MANUFACTURER      0x1001                                                /* The test value for the manufacturer of the device */
 #define OTA_UPGRADE_IMAGE_TYPE        0x1011                                                /* The image type of the file that the client is currently downloading */
 #define OTA_UPGRADE_TIME              OTA_UPGRADE_CURRENT_TIME + OTA_UPGRADE_OFFSET_TIME    /* Upgrade time indicates the time that the client shall upgrade to running new image, offset time value is of 5 seconds */
 #define OTA_UPGRADE_QUERY_JITTER      0x64                                                  /* Query jitter indicates whether the client receiving Image Notify Command */
 #define OTA_UPGRADE_CURRENT_TIME      0x12345                                               /* Test current time of ota server, currently zcl time cluster is not supported */
-#define OTA_UPGRADE_IMAGE_COUNT       1                                                     /* The number of OTA image for OTA server */
+#define OTA_UPGRADE_IMAGE_COUNT       OTA_IMAGE_STORE_MAX_IMAGES                            /* The number of OTA image for OTA server */
 #define OTA_UPGRADE_OFFSET_TIME       5                                                     /* Offset time value in seconds, use as upgrade delay.*/
+#define OTA_UPGRADE_SESSION_MAX       16                                                    /* The max amount of OTA clients upgrading at the same time */
+#define OTA_UPGRADE_SESSION_TIMEOUT   60000                                                 /* The session of a client silent for this time could be given to another client, in millisecond */
+#define OTA_BLOCK_REQUEST_CMD         0x03                                                  /* The command ID of the Image Block Request of the OTA upgrade cluster */
+#define OTA_BLOCK_RESPONSE_CMD        0x05                                                  /* The command ID of the Image Block Response of the OTA upgrade cluster */
+#define OTA_BLOCK_WAIT_FOR_DATA       0x97                                                  /* The status of the Image Block Response telling the client to wait */
+/* OTA pacing configuration, the minimum block period of each client is adapted to its link and the load of the server */
+#define OTA_PACING_PERIOD_MAX         1000                                                  /* The longest minimum block period assigned to a client, in millisecond */
+#define OTA_PACING_PERIOD_STEP        10                                                    /* The minimum block period is shortened by this step on a clean link, in millisecond */
+#define OTA_PACING_SESSION_PERIOD     20                                                    /* The minimum block period added for each other client transferring, in millisecond */
+#define OTA_PACING_LQI_LOW            128                                                   /* The link quality below which the link is considered weak */
+#define OTA_PACING_LQI_PERIOD         50                                                    /* The minimum block period added for a weak link, in millisecond */
+#define OTA_PACING_STALL_MIN          500                                                   /* A block request later than this and 4 times the average gap is counted as a retry, in millisecond */
+#define OTA_PACING_CLEAN_BLOCKS       32                                                    /* The blocks without retry required to shorten the minimum block period */
+#define OTA_PACING_REPORT_BLOCKS      64                                                    /* Report the effective throughput of a client every this number of blocks */
 #define ESP_ZB_PRIMARY_CHANNEL_MASK     (1l << 13)                                          /* Zigbee primary channel mask use in the example */
 
 /* ota_file.bin */
@@ -23,6 +23,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
+#include "sleep_poll_controller.h"
 #include "esp_zb_sleepy_end_device.h"
 
 #ifdef CONFIG_PM_ENABLE
@@ -40,12 +41,23 @@ static const char *TAG = "ESP_ZB_DEEP_SLEEP";
 
 static RTC_DATA_ATTR struct timeval s_sleep_enter_time;
 static esp_timer_handle_t s_oneshot_timer;
+static bool s_commissioning = false;
 
 /********************* Define functions **************************/
 static void s_oneshot_timer_callback(void* arg)
 {
+    /* Stay awake while a transaction is in flight, the response is lost in the deep sleep */
+    if (sleep_poll_controller_state() == SLEEP_POLL_STATE_ACTIVE) {
+        ESP_ERROR_CHECK(esp_timer_start_once(s_oneshot_timer, SLEEP_POLL_ACTIVE_INTERVAL_MS * 1000));
+        return;
+    }
+
+    /* The wake-up timer is the poll interval of the device, it is short after an activity and backs off when idle */
+    uint32_t wakeup_time_ms = sleep_poll_controller_sleep();
+    ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup((uint64_t)wakeup_time_ms * 1000));
+
     /* Enter deep sleep */
-    ESP_LOGI(TAG, "Enter deep sleep");
+    ESP_LOGI(TAG, "Enter deep sleep for %" PRIu32 "ms", wakeup_time_ms);
     gettimeofday(&s_sleep_enter_time, NULL);
     esp_deep_sleep_start();
 }
@@ -70,6 +82,7 @@ static void zb_deep_sleep_init(void)
     gettimeofday(&now, NULL);
     int sleep_time_ms = (now.tv_sec - s_sleep_enter_time.tv_sec) * 1000 + (now.tv_usec - s_sleep_enter_time.tv_usec) / 1000;
     esp_sleep_wakeup_cause_t wake_up_cause = esp_sleep_get_wakeup_cause();
+    ESP_ERROR_CHECK(sleep_poll_controller_init(NULL, NULL));
     switch (wake_up_cause) {
     case ESP_SLEEP_WAKEUP_TIMER: {
         ESP_LOGI(TAG, "Wake up from timer. Time spent in deep sleep and boot: %dms", sleep_time_ms);
@@ -77,6 +90,7 @@ static void zb_deep_sleep_init(void)
     }
     case ESP_SLEEP_WAKEUP_EXT1: {
         ESP_LOGI(TAG, "Wake up from GPIO. Time spent in deep sleep and boot: %dms", sleep_time_ms);
+        sleep_poll_controller_activity();
         break;
     }
     case ESP_SLEEP_WAKEUP_UNDEFINED:
@@ -85,11 +99,14 @@ static void zb_deep_sleep_init(void)
         break;
     }
 
+    for (sleep_poll_state_t state = SLEEP_POLL_STATE_ACTIVE; state < SLEEP_POLL_STATE_MAX; state ++) {
+        sleep_poll_stats_t stats;
+        sleep_poll_controller_get_stats(state, &stats);
+        ESP_LOGI(TAG, "Poll state %d: %" PRIu32 " wake-ups, %" PRIu64 "ms radio on", state, stats.wake_count, stats.radio_on_ms);
+    }
+
     /* Set the methods of how to wake up: */
-    /* 1. RTC timer waking-up */
-    const int wakeup_time_sec = 20;
-    ESP_LOGI(TAG, "Enabling timer wakeup, %ds\n", wakeup_time_sec);
-    ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup(wakeup_time_sec * 1000000));
+    /* 1. RTC timer waking-up, it is enabled with the poll interval of the controller before entering the deep sleep */
 
     /* 2. GPIO waking-up */
 #if CONFIG_IDF_TARGET_ESP32C6
@@ -124,9 +141,30 @@ static void zb_deep_sleep_start(void)
     ESP_ERROR_CHECK(esp_timer_start_once(s_oneshot_timer, before_deep_sleep_time_sec * 1000000));
 }
 
+/* The network steering is the transaction of the example, the device does not sleep before it joins. The attach after
+ * each deep sleep is not one, otherwise every wake-up would count as an activity and stop the idle back-off. */
+static esp_err_t zb_commissioning_start(uint8_t mode_mask)
+{
+    esp_err_t ret = esp_zb_bdb_start_top_level_commissioning(mode_mask);
+
+    if (ret == ESP_OK && !s_commissioning) {
+        s_commissioning = true;
+        sleep_poll_controller_transaction_begin();
+    }
+    return ret;
+}
+
+static void zb_commissioning_done(void)
+{
+    if (s_commissioning) {
+        s_commissioning = false;
+        sleep_poll_controller_transaction_end();
+    }
+}
+
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
 {
-    ESP_RETURN_ON_FALSE(esp_zb_bdb_start_top_level_commissioning(mode_mask) == ESP_OK, , TAG, "Failed to start Zigbee bdb commissioning");
+    ESP_RETURN_ON_FALSE(zb_commissioning_start(mode_mask) == ESP_OK, , TAG, "Failed to start Zigbee bdb commissioning");
 }
 
 void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
@@ -145,7 +183,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             ESP_LOGI(TAG, "Device started up in %s factory-reset mode", esp_zb_bdb_is_factory_new() ? "" : "non");
             if (esp_zb_bdb_is_factory_new()) {
                 ESP_LOGI(TAG, "Start network steering");
-                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+                zb_commissioning_start(ESP_ZB_BDB_MODE_NETWORK_STEERING);
             } else {
                 zb_deep_sleep_start();
                 ESP_LOGI(TAG, "Device rebooted");
@@ -165,6 +203,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                      "Address: 0x%04hx)",
                      extended_pan_id[7], extended_pan_id[6], extended_pan_id[5], extended_pan_id[4], extended_pan_id[3], extended_pan_id[2],
                      extended_pan_id[1], extended_pan_id[0], esp_zb_get_pan_id(), esp_zb_get_current_channel(), esp_zb_get_short_address());
+            zb_commissioning_done();
             zb_deep_sleep_start();
         } else {
             ESP_LOGI(TAG, "Network steering was not successful (status: %d)", err_status);
@@ -194,6 +233,7 @@ static esp_err_t zb_attribute_handler(const esp_zb_zcl_set_attr_value_message_t
         if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF) {
             if (message->attribute.id == ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
                 light_state = message->attribute.data.value ? *(bool *)message->attribute.data.value : light_state;
+                sleep_poll_controller_activity();
                 ESP_LOGI(TAG, "Light sets to %s", light_state ? "On" : "Off");
             }
         }
@@ -0,0 +1,79 @@
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+import json
+import os
+import pathlib
+import sys
+import pexpect
+import pytest
+from constants import ZigbeeCIConstants
+
+sys.path.insert(0, str(pathlib.Path(__file__).parents[1] / 'tools' / 'ota_bench'))
+import ota_bench_summary  # noqa: E402
+
+OTA_CURRENT_DIR_CLIENT = str(pathlib.Path(__file__).parent) + '/esp_zigbee_ota/ota_client'
+OTA_CURRENT_DIR_SERVER = str(pathlib.Path(__file__).parent) + '/esp_zigbee_ota/ota_server'
+ota_benchmark_build_dir_1 = OTA_CURRENT_DIR_CLIENT + '|' + OTA_CURRENT_DIR_SERVER
+ota_benchmark_build_dir_2 = OTA_CURRENT_DIR_CLIENT + '|' + OTA_CURRENT_DIR_CLIENT + '|' + OTA_CURRENT_DIR_SERVER
+
+OTA_BENCH_PATTERN = r'OTA_BENCH(?:_DONE| (\{[^\r\n]*\}))'
+OTA_BENCH_ROUND_TIMEOUT = 300
+# The summary of a previous run, the test fails if the median throughput drops by more than the threshold
+OTA_BENCH_BASELINE = os.getenv('OTA_BENCH_BASELINE')
+OTA_BENCH_THRESHOLD = float(os.getenv('OTA_BENCH_THRESHOLD', ota_bench_summary.REGRESSION_THRESHOLD))
+
+
+def collect_records(dut, timeout):
+    """Collect the OTA_BENCH records of the device until it logs OTA_BENCH_DONE or stays silent for the timeout"""
+    records = []
+    while True:
+        try:
+            match = dut.expect(OTA_BENCH_PATTERN, timeout=timeout)
+        except pexpect.TIMEOUT:
+            break
+        if not match.group(1):
+            break
+        record = match.group(1)
+        records.append(json.loads(record.decode() if isinstance(record, bytes) else record))
+    return records
+
+
+# Zigbee OTA throughput benchmark, the clients download the image again in each round without applying it
+@pytest.mark.esp32h2
+@pytest.mark.zigbee_multi_dut
+@pytest.mark.parametrize('count, app_path, config, erase_all', [
+    (2, ota_benchmark_build_dir_1, 'benchmark', 'y'),
+    (3, ota_benchmark_build_dir_2, 'benchmark', 'y'),
+], indirect=True, )
+@pytest.mark.usefixtures('teardown_fixture')
+def test_zb_ota_benchmark(dut, count, app_path, config, erase_all, session_tempdir):
+    server = dut[-1]
+    clients = dut[:-1]
+
+    server_records = collect_records(server, OTA_BENCH_ROUND_TIMEOUT)
+    client_records = []
+    for client in clients:
+        # The clients finish before the server reports the last round, their logs are already buffered
+        client_records.extend(collect_records(client, 5))
+    records = server_records + client_records
+    assert server_records, 'No OTA benchmark record from the server'
+
+    for record in server_records:
+        assert record['status'] == 'finished', record
+        assert str(record['bytes']) == ZigbeeCIConstants.ota_total_package, record
+    for record in client_records:
+        assert record['status'] == 'ESP_OK', record
+        assert str(record['bytes']) == ZigbeeCIConstants.ota_total_package, record
+
+    result_path = os.path.join(session_tempdir, f'ota_benchmark_{len(clients)}_clients.jsonl')
+    with open(result_path, 'w') as f:
+        for record in records:
+            f.write(json.dumps(record) + '\n')
+    summary = ota_bench_summary.summarize(records)
+    with open(result_path.replace('.jsonl', '_summary.json'), 'w') as f:
+        json.dump(summary, f, indent=2, sort_keys=True)
+    regressions = []
+    if OTA_BENCH_BASELINE:
+        with open(OTA_BENCH_BASELINE, 'r') as f:
+            regressions = ota_bench_summary.compare(summary, json.load(f), OTA_BENCH_THRESHOLD)
+    ota_bench_summary.report(summary)
+    assert not regressions, f'OTA throughput regression: {regressions}'
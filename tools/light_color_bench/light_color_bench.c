@@ -0,0 +1,157 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host benchmark of the fixed-point color conversion of the light driver against the float one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "light_color.h"
+
+#define BENCH_ROUNDS    16              /* The number of times the whole input space is converted for the throughput */
+
+typedef void (*bench_rgb_fn_t)(uint16_t a, uint16_t b, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+typedef struct {
+    unsigned long count;                /* The number of the values compared */
+    unsigned long mismatch;             /* The number of the values differing */
+    unsigned long error_sum;            /* The sum of the absolute errors */
+    int error_max;                      /* The maximum absolute error */
+} bench_error_t;
+
+static volatile uint8_t s_sink;
+
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_error_add(bench_error_t *error, uint8_t fixed, uint8_t reference)
+{
+    int diff = abs((int)fixed - (int)reference);
+
+    error->count ++;
+    error->mismatch += (diff != 0);
+    error->error_sum += diff;
+    if (diff > error->error_max) {
+        error->error_max = diff;
+    }
+}
+
+static void bench_error_print(const char *name, const bench_error_t *error)
+{
+    printf("%-12s values %8lu  mismatch %6.2f%%  mean error %.4f  max error %d\n", name, error->count,
+           100.0 * error->mismatch / error->count, (double)error->error_sum / error->count, error->error_max);
+}
+
+static void xy_fixed(uint16_t x, uint16_t y, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    light_color_xy_to_rgb(x, y, red, green, blue);
+}
+
+static void xy_float(uint16_t x, uint16_t y, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    light_color_xy_to_rgb_float(x, y, red, green, blue);
+}
+
+static void hs_fixed(uint16_t hue, uint16_t sat, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    light_color_hue_sat_to_rgb(hue, sat, red, green, blue);
+}
+
+static void hs_float(uint16_t hue, uint16_t sat, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    light_color_hue_sat_to_rgb_float(hue, sat, red, green, blue);
+}
+
+static void level_fixed(uint16_t color, uint16_t level, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    *red = *green = *blue = light_color_level(color, level);
+}
+
+static void level_float(uint16_t color, uint16_t level, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    *red = *green = *blue = light_color_level_float(color, level);
+}
+
+/* The xy inputs cover the CIE chart with a step of 256, y = 0 is skipped as the float conversion divides by it */
+static uint16_t bench_xy_input(int i)
+{
+    return (uint16_t)(i << 8);
+}
+
+static uint16_t bench_byte_input(int i)
+{
+    return (uint16_t)i;
+}
+
+static void bench_accuracy(const char *name, bench_rgb_fn_t fixed, bench_rgb_fn_t reference, uint16_t (*input)(int), int first_b)
+{
+    bench_error_t error = {0};
+    uint8_t fixed_rgb[3], reference_rgb[3];
+
+    for (int a = 0; a < 256; a ++) {
+        for (int b = first_b; b < 256; b ++) {
+            fixed(input(a), input(b), &fixed_rgb[0], &fixed_rgb[1], &fixed_rgb[2]);
+            reference(input(a), input(b), &reference_rgb[0], &reference_rgb[1], &reference_rgb[2]);
+            for (int i = 0; i < 3; i ++) {
+                bench_error_add(&error, fixed_rgb[i], reference_rgb[i]);
+            }
+        }
+    }
+
+    bench_error_print(name, &error);
+}
+
+static double bench_throughput(bench_rgb_fn_t fn, uint16_t (*input)(int), int first_b)
+{
+    unsigned long calls = 0;
+    uint8_t red, green, blue;
+    double start = bench_now_ns();
+
+    for (int round = 0; round < BENCH_ROUNDS; round ++) {
+        for (int a = 0; a < 256; a ++) {
+            for (int b = first_b; b < 256; b ++) {
+                fn(input(a), input(b), &red, &green, &blue);
+                s_sink ^= red ^ green ^ blue;
+                calls ++;
+            }
+        }
+    }
+
+    return (bench_now_ns() - start) / calls;
+}
+
+static void bench_compare(const char *name, bench_rgb_fn_t fixed, bench_rgb_fn_t reference, uint16_t (*input)(int), int first_b)
+{
+    double fixed_ns = bench_throughput(fixed, input, first_b);
+    double reference_ns = bench_throughput(reference, input, first_b);
+
+    printf("%-12s fixed %7.2f ns/call  float %7.2f ns/call  speedup %.2fx\n", name, fixed_ns, reference_ns, reference_ns / fixed_ns);
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t gamma = (argc > 1) ? (uint16_t)atoi(argv[1]) : LIGHT_COLOR_GAMMA_LINEAR;
+
+    light_color_init(gamma);
+    printf("Light color conversion, gamma %d.%02d\n\nAccuracy against the float conversion:\n", gamma / 100, gamma % 100);
+    bench_accuracy("xy", xy_fixed, xy_float, bench_xy_input, 1);
+    bench_accuracy("hue_sat", hs_fixed, hs_float, bench_byte_input, 0);
+    bench_accuracy("level", level_fixed, level_float, bench_byte_input, 0);
+
+    printf("\nThroughput:\n");
+    bench_compare("xy", xy_fixed, xy_float, bench_xy_input, 1);
+    bench_compare("hue_sat", hs_fixed, hs_float, bench_byte_input, 0);
+    bench_compare("level", level_fixed, level_float, bench_byte_input, 0);
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+#
+
+"""
+Script to summarize the OTA benchmark records and compare them with a baseline.
+
+The records are the "OTA_BENCH" lines logged by the ota_client and ota_server examples built with CONFIG_OTA_BENCHMARK,
+one JSON object per line.
+"""
+
+import argparse
+import json
+import logging
+import re
+import statistics
+import sys
+
+RECORD_PATTERN = re.compile(r'OTA_BENCH (\{.*\})')
+METRICS = {
+    'client': ('bps', 'stalls', 'query_ms', 'transfer_ms', 'check_ms', 'end_ms', 'total_ms'),
+    'server': ('bps', 'time_ms', 'retries', 'stalls', 'period', 'lqi'),
+}
+GROUPS = {
+    'client': ('block_size', ),
+    'server': ('clients', 'jitter'),
+}
+REGRESSION_THRESHOLD = 10.0
+
+
+def load_records(paths):
+    """Load the records from JSON lines files or raw device logs"""
+    records = []
+    for path in paths:
+        with open(path, 'r', errors='replace') as f:
+            for line in f:
+                line = line.strip()
+                match = RECORD_PATTERN.search(line)
+                text = match.group(1) if match else line
+                if not text.startswith('{'):
+                    continue
+                try:
+                    records.append(json.loads(text))
+                except ValueError:
+                    logging.warning('Skip the malformed record: %s', text)
+    return records
+
+
+def summarize(records):
+    """Group the records by role and configuration, the median is used as it is robust to the retried transfers"""
+    summary = {}
+    for record in records:
+        role = record.get('role')
+        if role not in METRICS:
+            continue
+        key = '%s:%s' % (role, ','.join('%s=%s' % (name, record.get(name)) for name in GROUPS[role]))
+        group = summary.setdefault(key, {'role': role, 'runs': 0, 'failed': 0, 'samples': {name: [] for name in METRICS[role]}})
+        group['runs'] += 1
+        if record.get('status') not in ('ESP_OK', 'finished'):
+            group['failed'] += 1
+            continue
+        for name in METRICS[role]:
+            if name in record:
+                group['samples'][name].append(record[name])
+    for group in summary.values():
+        samples = group.pop('samples')
+        group['median'] = {name: statistics.median(values) for name, values in samples.items() if values}
+        group['mean'] = {name: statistics.mean(values) for name, values in samples.items() if values}
+        group['stdev'] = {name: statistics.stdev(values) if len(values) > 1 else 0 for name, values in samples.items() if values}
+    return summary
+
+
+def compare(summary, baseline, threshold):
+    """Return the configurations whose median throughput dropped by more than the threshold percentage"""
+    regressions = []
+    for key, group in summary.items():
+        if key not in baseline or 'bps' not in group['median'] or 'bps' not in baseline[key]['median']:
+            continue
+        base_bps = baseline[key]['median']['bps']
+        bps = group['median']['bps']
+        change = 100.0 * (bps - base_bps) / base_bps if base_bps else 0.0
+        group['change'] = change
+        if change < -threshold:
+            regressions.append((key, base_bps, bps, change))
+    return regressions
+
+
+def report(summary):
+    for key in sorted(summary):
+        group = summary[key]
+        median = group['median']
+        logging.info('%-40s runs %3d failed %2d  median %6d B/s  mean %8.1f B/s  stdev %7.1f%s', key, group['runs'],
+                     group['failed'], median.get('bps', 0), group['mean'].get('bps', 0), group['stdev'].get('bps', 0),
+                     '  change %+.1f%%' % group['change'] if 'change' in group else '')
+        phases = ', '.join('%s %s' % (name, median[name]) for name in METRICS[group['role']] if name != 'bps' and name in median)
+        if phases:
+            logging.info('%-40s %s', '', phases)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Summarize the Zigbee OTA benchmark records')
+    parser.add_argument('records', nargs='+', help='The JSON lines files or the device logs holding the OTA_BENCH records')
+    parser.add_argument('--baseline', help='The summary of a previous run to compare with')
+    parser.add_argument('--threshold', type=float, default=REGRESSION_THRESHOLD,
+                        help='The drop of the median throughput in percentage reported as a regression')
+    parser.add_argument('--output', help='Write the summary to the file, it could be used as the baseline of the next run')
+    args = parser.parse_args()
+    logging.basicConfig(format='%(message)s', level=logging.INFO)
+
+    summary = summarize(load_records(args.records))
+    if not summary:
+        sys.exit('No OTA benchmark record found')
+    regressions = []
+    if args.baseline:
+        with open(args.baseline, 'r') as f:
+            regressions = compare(summary, json.load(f), args.threshold)
+    report(summary)
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(summary, f, indent=2, sort_keys=True)
+    for key, base_bps, bps, change in regressions:
+        logging.error('Regression of %s: %d -> %d B/s (%.1f%%)', key, base_bps, bps, change)
+    if regressions:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
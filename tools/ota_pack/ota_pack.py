@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+#
+
+"""
+Script to pack an OTA upgrade image, compressed and optionally as a delta against the running firmware.
+
+The format is decoded by examples/esp_zigbee_ota/ota_client/main/esp_ota_decoder.c.
+"""
+
+import argparse
+import logging
+import struct
+import sys
+import zlib
+
+MAGIC = 0x50544f5a
+VERSION = 1
+FLAG_COMPRESSED = 0x01
+FLAG_DELTA = 0x02
+HEADER_FORMAT = '<IBBBBIII'
+
+WINDOW_LOG = 13
+MIN_MATCH = 3
+MIN_BASE_MATCH = 8
+MAX_LITERAL = 128
+TOKEN_LONG = 63
+HASH_LEN = 4
+BASE_HASH_LEN = 8
+MAX_CHAIN = 64
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def match_length(a, a_pos, b, b_pos, limit):
+    length = 0
+    while length < limit and a[a_pos + length] == b[b_pos + length]:
+        length += 1
+    return length
+
+
+class Packer(object):
+    def __init__(self, image, base=None, window_log=WINDOW_LOG):
+        self.image = image
+        self.base = base or b''
+        self.window = 1 << window_log
+        self.window_log = window_log
+        self.out = bytearray()
+        self.literals = bytearray()
+        self.stats = {'literal': 0, 'window': 0, 'base': 0}
+
+    def flush_literals(self):
+        for i in range(0, len(self.literals), MAX_LITERAL):
+            run = self.literals[i:i + MAX_LITERAL]
+            self.out.append(len(run) - 1)
+            self.out += run
+        self.stats['literal'] += len(self.literals)
+        self.literals = bytearray()
+
+    def copy(self, base, length, arg):
+        self.flush_literals()
+        opcode = 0xc0 if base else 0x80
+        code = length - (4 if base else 3)
+        if code >= TOKEN_LONG:
+            self.out.append(opcode | TOKEN_LONG)
+            self.out += varint(code - TOKEN_LONG)
+        else:
+            self.out.append(opcode | code)
+        self.out += varint(arg)
+        self.stats['base' if base else 'window'] += length
+
+    def index_base(self):
+        index = {}
+        base = self.base
+        for pos in range(len(base) - BASE_HASH_LEN, -1, -1):
+            index[base[pos:pos + BASE_HASH_LEN]] = pos
+        return index
+
+    def pack(self):
+        image = self.image
+        size = len(image)
+        base_index = self.index_base() if self.base else {}
+        chains = {}
+        base_delta = None
+        pos = 0
+        while pos < size:
+            best_len, best_arg, best_base = 0, 0, False
+            limit = size - pos
+            # Code moved as a block keeps the same displacement, try it before the index lookup
+            candidates = []
+            if base_delta is not None and 0 <= pos + base_delta < len(self.base):
+                candidates.append(pos + base_delta)
+            if limit >= BASE_HASH_LEN and image[pos:pos + BASE_HASH_LEN] in base_index:
+                candidates.append(base_index[image[pos:pos + BASE_HASH_LEN]])
+            for cand in candidates:
+                length = match_length(image, pos, self.base, cand, min(limit, len(self.base) - cand))
+                if length >= MIN_BASE_MATCH and length > best_len:
+                    best_len, best_arg, best_base = length, cand, True
+            key = image[pos:pos + HASH_LEN]
+            chain = chains.get(key, [])
+            for cand in reversed(chain[-MAX_CHAIN:]):
+                if pos - cand > self.window:
+                    break
+                length = match_length(image, pos, image, cand, limit)
+                # A back reference costs 2 to 4 bytes, it has to beat the base copy by more than that
+                if length >= MIN_MATCH and length > best_len + (4 if best_base else 0):
+                    best_len, best_arg, best_base = length, pos - cand - 1, False
+            end = pos + (best_len if best_len else 1)
+            for i in range(pos, min(end, size - HASH_LEN + 1)):
+                chains.setdefault(image[i:i + HASH_LEN], []).append(i)
+            if best_len:
+                self.copy(best_base, best_len, best_arg)
+                if best_base:
+                    base_delta = best_arg - pos
+            else:
+                self.literals.append(image[pos])
+            pos = end
+        self.flush_literals()
+        flags = FLAG_COMPRESSED | (FLAG_DELTA if self.base else 0)
+        header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, flags, self.window_log, 0, size, len(self.base),
+                             zlib.crc32(self.base) & 0xffffffff)
+        return header + bytes(self.out)
+
+
+def unpack(packed, base=b''):
+    magic, version, flags, window_log, _, size, base_size, base_crc = struct.unpack_from(HEADER_FORMAT, packed)
+    if magic != MAGIC:
+        return packed
+    assert version == VERSION and base_size == len(base) and base_crc == zlib.crc32(base) & 0xffffffff
+    out = bytearray()
+    pos = struct.calcsize(HEADER_FORMAT)
+
+    def get_varint():
+        nonlocal pos
+        value, shift = 0, 0
+        while True:
+            byte = packed[pos]
+            pos += 1
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    while pos < len(packed):
+        opcode = packed[pos]
+        pos += 1
+        if not opcode & 0x80:
+            out += packed[pos:pos + (opcode & 0x7f) + 1]
+            pos += (opcode & 0x7f) + 1
+            continue
+        length = opcode & 0x3f
+        if length == TOKEN_LONG:
+            length += get_varint()
+        arg = get_varint()
+        if opcode & 0x40:
+            out += base[arg:arg + length + 4]
+        else:
+            for _ in range(length + 3):
+                out.append(out[-arg - 1])
+    assert len(out) == size
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack an OTA upgrade image for the Zigbee OTA client')
+    parser.add_argument('input', help='The firmware image to upgrade to')
+    parser.add_argument('output', help='The packed image')
+    parser.add_argument('--base', help='The firmware image running on the client, to generate a delta')
+    parser.add_argument('--window-log', type=int, default=WINDOW_LOG, choices=range(8, WINDOW_LOG + 1),
+                        help='The log2 of the history window, the client supports up to %d' % WINDOW_LOG)
+    parser.add_argument('--block-size', type=int, default=64, help='The OTA block size used to estimate the airtime')
+    args = parser.parse_args()
+    logging.basicConfig(format='%(message)s', level=logging.INFO)
+
+    with open(args.input, 'rb') as f:
+        image = f.read()
+    base = b''
+    if args.base:
+        with open(args.base, 'rb') as f:
+            base = f.read()
+    packer = Packer(image, base, args.window_log)
+    packed = packer.pack()
+    if unpack(packed, base) != image:
+        sys.exit('Failed to verify the packed image')
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+
+    blocks = (len(image) + args.block_size - 1) // args.block_size
+    packed_blocks = (len(packed) + args.block_size - 1) // args.block_size
+    logging.info('Image: %d bytes, packed: %d bytes (%.1f%%)', len(image), len(packed), 100.0 * len(packed) / len(image))
+    logging.info('Unpacked from literals: %d, window: %d, base: %d bytes', packer.stats['literal'], packer.stats['window'],
+                 packer.stats['base'])
+    logging.info('Blocks of %d bytes: %d -> %d, airtime reduction: %.1f%%', args.block_size, blocks, packed_blocks,
+                 100.0 * (blocks - packed_blocks) / blocks)
+
+
+if __name__ == '__main__':
+    main()